@@ -84,4 +84,10 @@ unsigned int osTimerGetFrequency()
     return b->getTimerFrequency();
 }
 
+bool IRQosTimerInitTimePage(time_page& page) noexcept
+{
+    //Time is corrected in software, processes can't compute it from a counter
+    return false;
+}
+
 } //namespace miosix
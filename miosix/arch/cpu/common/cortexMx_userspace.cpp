@@ -315,6 +315,7 @@ static constexpr unsigned int dataIdx=2*4; ///<index into regValues of process d
  */
 static constexpr unsigned int codeIdx=2*0; ///<index into regValues of process code
 static constexpr unsigned int dataIdx=2*1; ///<index into regValues of process data
+static constexpr unsigned int mapIdx=2*2;  ///<index into regValues of file mapping
 #endif //defined(__CORTEX_M) && __CORTEX_M == 33 && __MPU_PRESENT==1
 
 MPUConfiguration::MPUConfiguration(const unsigned int *elfBase, unsigned int elfSize,
@@ -427,6 +428,8 @@ MPUConfiguration::MPUConfiguration(const unsigned int *elfBase, unsigned int elf
                 | MPU_RASR_C_Msk          //Cacheable, write through
                 | 1                       //Enable bit
                 | sizeToMpu(imageSize)<<1;
+    regValues[4]=MPU_RBAR_VALID_Msk | 5;  //Region 5, file mapping
+    regValues[5]=0;                       //Disabled until a file is mapped
     #endif
     #else //__MPU_PRESENT==1
     #warning Architecture does not provide an MPU, userspace memory protection will not be enforced
@@ -436,6 +439,8 @@ MPUConfiguration::MPUConfiguration(const unsigned int *elfBase, unsigned int elf
     regValues[1]=codeEnd;
     regValues[2]=dataStart;
     regValues[3]=dataEnd;
+    regValues[4]=0;
+    regValues[5]=0;
     #endif //__MPU_PRESENT==1
 }
 
@@ -459,6 +464,10 @@ void MPUConfiguration::dumpConfiguration()
         iprintf("* Memory region %d 0x%08x-0x%08x rwx\n",i,base,end);
         #endif //__MPU_PRESENT==1
     }
+    size_t base, end;
+    if(mappedRegion(base,end))
+        iprintf("* Mapped region 0x%08x-0x%08x r%c-\n",base,end,
+                mapWritable ? 'w' : '-');
 }
 
 tuple<const unsigned int*, unsigned int> MPUConfiguration::roundRegionForMPU(
@@ -507,12 +516,15 @@ tuple<const unsigned int*, unsigned int> MPUConfiguration::roundRegionForMPU(
 bool MPUConfiguration::withinForReading(const void *ptr, size_t size) const
 {
     size_t base=reinterpret_cast<size_t>(ptr);
-    size_t codeStart,codeEnd,dataStart,dataEnd;
+    size_t codeStart,codeEnd,dataStart,dataEnd,mapStart=0,mapEnd=0;
     tie(codeStart,codeEnd)=decodeMpuRegion(regValues[codeIdx],regValues[codeIdx+1]);
     tie(dataStart,dataEnd)=decodeMpuRegion(regValues[dataIdx],regValues[dataIdx+1]);
+    mappedRegion(mapStart,mapEnd);
     //The last check is to prevent a wraparound to be considered valid
     return (   (base>=codeStart && base+size<=codeEnd)
-            || (base>=dataStart && base+size<=dataEnd)) && base+size>=base;
+            || (base>=dataStart && base+size<=dataEnd)
+            || (base>=mapStart && base+size<=mapEnd && mapStart<mapEnd))
+            && base+size>=base;
 }
 
 bool MPUConfiguration::withinForWriting(const void *ptr, size_t size) const
@@ -522,8 +534,12 @@ bool MPUConfiguration::withinForWriting(const void *ptr, size_t size) const
     size_t base=reinterpret_cast<size_t>(ptr);
     size_t dataStart,dataEnd;
     tie(dataStart,dataEnd)=decodeMpuRegion(regValues[dataIdx],regValues[dataIdx+1]);
+    size_t mapStart=0,mapEnd=0;
+    if(mapWritable) mappedRegion(mapStart,mapEnd);
     //The last check is to prevent a wraparound to be considered valid
-    return base>=dataStart && base+size<=dataEnd && base+size>=base;
+    return (   (base>=dataStart && base+size<=dataEnd)
+            || (base>=mapStart && base+size<=mapEnd && mapStart<mapEnd))
+            && base+size>=base;
 }
 
 bool MPUConfiguration::withinForReading(const char* str) const
@@ -536,11 +552,105 @@ bool MPUConfiguration::withinForReading(const char* str) const
         return strnlen(str,codeEnd-base)<codeEnd-base;
     if((base>=dataStart) && (base<dataEnd))
         return strnlen(str,dataEnd-base)<dataEnd-base;
+    size_t mapStart,mapEnd;
+    if(mappedRegion(mapStart,mapEnd) && (base>=mapStart) && (base<mapEnd))
+        return strnlen(str,mapEnd-base)<mapEnd-base;
+    return false;
+}
+
+#if __CORTEX_M == 33 && __MPU_PRESENT==1
+
+bool MPUConfiguration::IRQaddMappedRegion(const unsigned int *base,
+        unsigned int size, bool writable)
+{
+    //All the regions that can be switched at run-time are already used to
+    //carve the process code and data out of the kernel memory layout
     return false;
 }
 
+void MPUConfiguration::IRQremoveMappedRegion() {}
+
+bool MPUConfiguration::mappedRegion(size_t& start, size_t& end) const
+{
+    return false;
+}
+
+bool MPUConfiguration::IRQaddPeripheralRegion(const unsigned int *base,
+        unsigned int size)
+{
+    return false;
+}
+
+#else //__CORTEX_M == 33 && __MPU_PRESENT==1
+
+bool MPUConfiguration::IRQaddMappedRegion(const unsigned int *base,
+        unsigned int size, bool writable)
+{
+    const unsigned int start=reinterpret_cast<unsigned int>(base);
+    #if __MPU_PRESENT==1
+    //Force the next IRQenable() to reprogram the MPU
+    for(auto& l : loaded) if(l==this) l=nullptr;
+    regValues[mapIdx]=(start & (~0x1f))
+                    | MPU_RBAR_VALID_Msk | 5; //Region 5
+    //Privileged and unprivileged: either RW or RO
+    regValues[mapIdx+1]=(writable ? 0b011 : 0b110)<<MPU_RASR_AP_Pos
+                      | MPU_RASR_XN_Msk        //Not executable
+                      | MPU_RASR_C_Msk         //Cacheable, write through
+                      | 1                      //Enable bit
+                      | sizeToMpu(size)<<1;
+    #else //__MPU_PRESENT==1
+    regValues[mapIdx]=start;
+    regValues[mapIdx+1]=start+size;
+    #endif //__MPU_PRESENT==1
+    mapWritable=writable;
+    return true;
+}
+
+void MPUConfiguration::IRQremoveMappedRegion()
+{
+    #if __MPU_PRESENT==1
+    for(auto& l : loaded) if(l==this) l=nullptr;
+    regValues[mapIdx]=MPU_RBAR_VALID_Msk | 5;
+    #else //__MPU_PRESENT==1
+    regValues[mapIdx]=0;
+    #endif //__MPU_PRESENT==1
+    regValues[mapIdx+1]=0;
+    mapWritable=false;
+}
+
+bool MPUConfiguration::mappedRegion(size_t& start, size_t& end) const
+{
+    //Also when there is no MPU the end is zero if no file is mapped
+    if(regValues[mapIdx+1]==0) return false;
+    tie(start,end)=decodeMpuRegion(regValues[mapIdx],regValues[mapIdx+1]);
+    return true;
+}
+
+bool MPUConfiguration::IRQaddPeripheralRegion(const unsigned int *base,
+        unsigned int size)
+{
+    #if __MPU_PRESENT==1
+    //Region 4 is not used by the kernel nor changed at context switches
+    tie(base,size)=roundRegionForMPU(base,size);
+    MPU->RBAR=(reinterpret_cast<unsigned int>(base) & (~0x1f))
+             | MPU_RBAR_VALID_Msk | 4; //Region 4
+    MPU->RASR=0b010<<MPU_RASR_AP_Pos //Privileged: RW, unprivileged: RO
+             | MPU_RASR_XN_Msk       //Not executable
+             | MPU_RASR_S_Msk        //Shareable device
+             | MPU_RASR_B_Msk
+             | 1                     //Enable bit
+             | sizeToMpu(size)<<1;
+    #endif //__MPU_PRESENT==1
+    //Without MPU processes can already read all the memory
+    return true;
+}
+
+#endif //__CORTEX_M == 33 && __MPU_PRESENT==1
+
 #if __CORTEX_M == 33
 unsigned int MPUConfiguration::kernelspaceMpuConfiguration[4];
+#elif __MPU_PRESENT==1
+const MPUConfiguration *MPUConfiguration::loaded[CPU_NUM_CORES]={nullptr};
 #endif //__CORTEX_M == 33
 
 #endif //WITH_PROCESSES
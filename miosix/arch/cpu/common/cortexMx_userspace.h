@@ -97,6 +97,13 @@ inline unsigned int peekSyscallId(unsigned int *context)
     return context[SYSCALL_ID_OFFSET_IN_CTXSAVE];
 }
 
+inline void initSyscallContext(unsigned int *context, unsigned int id,
+                               unsigned int *params)
+{
+    context[SYSCALL_ID_OFFSET_IN_CTXSAVE]=id;
+    context[STACK_OFFSET_IN_CTXSAVE]=reinterpret_cast<unsigned int>(params);
+}
+
 namespace fault {
 /**
  * \internal
@@ -176,11 +183,21 @@ inline void MPUConfiguration::IRQenable()
               | MPU_CTRL_ENABLE_Msk;
     #else
     // ARMv7-M
-    // MPU regions can overlap, overlay two regions on top of kernel memory layout
-    MPU->RBAR=regValues[0];
-    MPU->RASR=regValues[1];
-    MPU->RBAR=regValues[2];
-    MPU->RASR=regValues[3];
+    // MPU regions can overlap, overlay three regions on top of kernel memory
+    // layout, the last one is disabled unless the process mapped a file.
+    // If this core is returning from a syscall served with
+    // IRQdisableForSyscall() the regions are still loaded, skip writing them
+    unsigned char coreId=getCurrentCoreId();
+    if(loaded[coreId]!=this)
+    {
+        MPU->RBAR=regValues[0];
+        MPU->RASR=regValues[1];
+        MPU->RBAR=regValues[2];
+        MPU->RASR=regValues[3];
+        MPU->RBAR=regValues[4];
+        MPU->RASR=regValues[5];
+        loaded[coreId]=this;
+    }
     #endif
 
     // Set bit 0 of CONTROL register to switch thread mode to unprivileged. When
@@ -220,10 +237,14 @@ inline void MPUConfiguration::IRQdisable()
     #else
     // ARMv7-M
     // Region 6 (process code) is disabled as it's marked executable
+    // Region 5 (file mapping) is disabled as it's marked not executable
     // Region 7 can remain enabled as from the point of view of the kernel is
     // configured in an indistinguishable way from the rest of the RAM
     MPU->RNR = 6;
     MPU->RASR= 0;
+    MPU->RNR = 5;
+    MPU->RASR= 0;
+    loaded[getCurrentCoreId()]=nullptr;
     #endif
 
     // Clear bit 0 of CONTROL register to switch thread mode to privileged. When
@@ -235,6 +256,29 @@ inline void MPUConfiguration::IRQdisable()
     #endif //__MPU_PRESENT==1
 }
 
+inline void MPUConfiguration::IRQdisableForSyscall()
+{
+    #if __MPU_PRESENT==1 && __CORTEX_M != 33
+    // ARMv7-M
+    // Region 6 (process code) is read-only for the kernel, but hot syscalls
+    // never write to the process code, and being executable it does not
+    // prevent the kernel from running. Region 7 (process data) is configured
+    // like the rest of the RAM from the point of view of the kernel. Region 5
+    // (file mapping) is not executable, Process::mmap() keeps it away from the
+    // kernel code in flash but shared memory mappings are in RAM, which on
+    // some boards holds the kernel code, so the shortcut is only possible if
+    // there is no mapping
+    if(regValues[5]==0)
+    {
+        __set_CONTROL(2);
+        return;
+    }
+    #endif //__MPU_PRESENT==1 && __CORTEX_M != 33
+    // ARMv8-M needs the kernelspace layout restored, as its process layout
+    // makes RAM outside the process non executable also for the kernel
+    IRQdisable();
+}
+
 #endif //WITH_PROCESSES
 
 } //namespace miosix
@@ -261,4 +261,10 @@ unsigned int osTimerGetFrequency()
     return 48000000;
 }
 
+bool IRQosTimerInitTimePage(time_page& page) noexcept
+{
+    //The time page is not supported on multicore
+    return false;
+}
+
 } // namespace miosix
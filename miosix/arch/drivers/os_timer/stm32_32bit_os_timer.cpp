@@ -133,6 +133,17 @@ public:
 
     static inline void IRQstopTimer() { T::get()->CR1 &= ~TIM_CR1_CEN; }
     static inline void IRQstartTimer() { T::get()->CR1 |= TIM_CR1_CEN; }
+
+    // Reading timer registers has no side effects, processes can read them
+    static inline const volatile unsigned int *IRQgetCounterRegister()
+    {
+        return reinterpret_cast<const volatile unsigned int*>(&T::get()->CNT);
+    }
+    static inline const volatile unsigned int *IRQgetOverflowRegister()
+    {
+        return reinterpret_cast<const volatile unsigned int*>(&T::get()->SR);
+    }
+    static inline unsigned int IRQgetOverflowMask() { return TIM_SR_UIF; }
     
     static unsigned int IRQTimerFrequency()
     {
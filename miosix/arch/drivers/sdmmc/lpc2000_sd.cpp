@@ -476,6 +476,7 @@ ssize_t SPISDDriver::writeBlock(const void* buffer, size_t size, off_t where)
 int SPISDDriver::ioctl(int cmd, void* arg)
 {
     DBG("SPISDDriver::ioctl()\n");
+    if(cmd==IOCTL_GET_BLOCK_GEOMETRY) return sdCardBlockGeometry(arg);
     if(cmd!=IOCTL_SYNC) return -ENOTTY;
     Lock<KernelMutex> l(mutex);
     CS_LOW();
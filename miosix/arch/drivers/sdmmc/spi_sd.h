@@ -485,6 +485,7 @@ int SPISD<SPI>::ioctl(int cmd, void* arg)
 {
     if(cardType==0) return -EIO;
     dbg("%s\n",__PRETTY_FUNCTION__);
+    if(cmd==IOCTL_GET_BLOCK_GEOMETRY) return sdCardBlockGeometry(arg);
     if(cmd!=IOCTL_SYNC) return -ENOTTY;
     Lock<KernelMutex> l(mutex);
     cs.low();
@@ -1688,6 +1688,7 @@ ssize_t SDIODriver::writeBlock(const void* buffer, size_t size, off_t where)
 int SDIODriver::ioctl(int cmd, void* arg)
 {
     DBG("SDIODriver::ioctl()\n");
+    if(cmd==IOCTL_GET_BLOCK_GEOMETRY) return sdCardBlockGeometry(arg);
     if(cmd!=IOCTL_SYNC) return -ENOTTY;
     Lock<KernelMutex> l(mutex);
     //Note: no need to select card, since status can be queried even with card
@@ -61,8 +61,9 @@ ssize_t PL011Serial::readBlock(void *buffer, size_t size, off_t where)
     Lock<KernelMutex> lock(rxMutex);
     auto bytes = reinterpret_cast<unsigned char *>(buffer);
     size_t i = 0;
-    // Block until we can read the first byte
-    rxQueue.get(bytes[i++]);
+    // Block until we can read the first byte, data may never arrive so give
+    // up if the thread is being terminated
+    if(rxQueue.getUnlessTerminated(bytes[i++])==false) return -EINTR;
     // Get bytes as long as there are bytes in the software queue or the
     // hardware FIFO.
     // As the interrupt handler never empties the FIFO unless the line is idle,
@@ -117,9 +117,14 @@ ssize_t EFM32Serial::readBlock(void *buffer, size_t size, off_t where)
         //Don't block if we have at least one char
         //This is required for \n detection
         if(result>0) break; 
-        //Wait for data in the queue
+        //Wait for data in the queue. Data may never arrive, so give up if the
+        //thread is being terminated, as Thread::terminate() wakes it only once
+        if(Thread::IRQtestTerminate())
+            return result>0 ? static_cast<ssize_t>(result) : -EINTR;
         rxWaiting=Thread::IRQgetCurrentThread();
-        do Thread::IRQglobalIrqUnlockAndWait(dLock); while(rxWaiting);
+        do Thread::IRQglobalIrqUnlockAndWait(dLock);
+        while(rxWaiting && Thread::IRQtestTerminate()==false);
+        rxWaiting=nullptr;
     }
     return result;
 }
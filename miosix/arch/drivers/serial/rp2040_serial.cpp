@@ -98,8 +98,9 @@ ssize_t RP2040PL011DmaSerial::readBlock(void *buffer, size_t size, off_t where)
     Lock<KernelMutex> lock(rxMutex);
     auto bytes = reinterpret_cast<unsigned char *>(buffer);
     size_t i = 0;
-    // Block until we can read the first byte
-    rxQueue.get(bytes[i++]);
+    // Block until we can read the first byte, data may never arrive so give
+    // up if the thread is being terminated
+    if(rxQueue.getUnlessTerminated(bytes[i++])==false) return -EINTR;
     // Get bytes as long as there are bytes in the software queue or the
     // hardware FIFO.
     // As the interrupt handler never empties the FIFO unless the line is idle,
@@ -488,9 +488,14 @@ ssize_t STM32SerialBase::readFromRxQueue(void *buffer, size_t size)
         }
         if(idle && result>0) break;
         if(result==size) break;
-        //Wait for data in the queue
+        //Wait for data in the queue. Data may never arrive, so give up if the
+        //thread is being terminated, as Thread::terminate() wakes it only once
+        if(Thread::IRQtestTerminate())
+            return result>0 ? static_cast<ssize_t>(result) : -EINTR;
         rxWaiting=Thread::IRQgetCurrentThread();
-        do Thread::IRQglobalIrqUnlockAndWait(dLock); while(rxWaiting);
+        do Thread::IRQglobalIrqUnlockAndWait(dLock);
+        while(rxWaiting && Thread::IRQtestTerminate()==false);
+        rxWaiting=nullptr;
     }
     return result;
 }
@@ -502,7 +507,22 @@ void STM32SerialBase::rxWakeup()
         rxWaiting->IRQwakeup();
         rxWaiting=nullptr;
     }
+    #ifdef WITH_FILESYSTEM
+    rxPollQueue.IRQwakeup();
+    #endif //WITH_FILESYSTEM
+}
+
+#ifdef WITH_FILESYSTEM
+int STM32SerialBase::poll(int events, PollTable& table)
+{
+    table.add(rxPollQueue);
+    FastGlobalIrqLock dLock;
+    //Writes never fail, at worst they wait for the previous ones to complete
+    int result=POLLOUT | POLLWRNORM;
+    if(rxQueue.isEmpty()==false) result|=POLLIN | POLLRDNORM;
+    return result;
 }
+#endif //WITH_FILESYSTEM
 
 int STM32SerialBase::ioctl(int cmd, void* arg)
 {
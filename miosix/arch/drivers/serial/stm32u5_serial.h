@@ -29,6 +29,7 @@
 #pragma once
 
 #include "filesystem/console/console_device.h"
+#include "filesystem/poll_table.h"
 #include "kernel/sync.h"
 #include "kernel/queue.h"
 #include "interfaces/gpio.h"
@@ -128,6 +129,13 @@ private:
      */
     int ioctl(int cmd, void* arg);
 
+    #ifdef WITH_FILESYSTEM
+    /**
+     * Common implementation of poll() for the STM32 serial
+     */
+    int poll(int events, PollTable& table);
+    #endif //WITH_FILESYSTEM
+
     friend class STM32Serial;
     friend class STM32DmaSerial;
 
@@ -139,6 +147,9 @@ private:
     DynUnsyncQueue<char> rxQueue;     ///< Receiving queue
     static const unsigned int rxQueueMin=16; ///< Minimum queue size
     Thread *rxWaiting=nullptr;        ///< Thread waiting for rx, or 0
+    #ifdef WITH_FILESYSTEM
+    PollQueue rxPollQueue;            ///< Threads polling for rx
+    #endif //WITH_FILESYSTEM
     bool idle=true;                   ///< Receiver idle
 };
 
@@ -219,6 +230,19 @@ public:
     {
         return STM32SerialBase::ioctl(cmd, arg);
     }
+
+    #ifdef WITH_FILESYSTEM
+    /**
+     * Check whether the serial port is ready for reading and writing
+     * \param events requested events (POLLIN, POLLOUT, ...)
+     * \param table poll table to add to the serial port's PollQueue
+     * \return the events that are ready
+     */
+    int poll(int events, PollTable& table)
+    {
+        return STM32SerialBase::poll(events, table);
+    }
+    #endif //WITH_FILESYSTEM
     
     /**
      * Destructor
@@ -321,6 +345,19 @@ public:
     {
         return STM32SerialBase::ioctl(cmd, arg);
     }
+
+    #ifdef WITH_FILESYSTEM
+    /**
+     * Check whether the serial port is ready for reading and writing
+     * \param events requested events (POLLIN, POLLOUT, ...)
+     * \param table poll table to add to the serial port's PollQueue
+     * \return the events that are ready
+     */
+    int poll(int events, PollTable& table)
+    {
+        return STM32SerialBase::poll(events, table);
+    }
+    #endif //WITH_FILESYSTEM
     
     /**
      * Destructor
@@ -35,15 +35,17 @@ include(SetDefaultProgramTarget)
 #     KERNEL <kernel>
 #     DIR_NAME <dir_name>
 #     PROCESSES <process1> <process2> ...
+#     OPTIONS <option1> <option2> ...
 #   )
 #
 # What it does:
 # - Copies all processes binaries to a single directory named <dir_name>
-# - Creates a romfs image with of the directory <dir_name>
+# - Creates a romfs image with of the directory <dir_name>, passing the given
+#   options to mx-buildromfs (e.g: --compress)
 # - Combines the kernel and the romfs image into a single binary image
 # - Registers a custom target (named <dir_name>) with to run the above steps
 function(miosix_add_romfs_image ROMFS_IMAGE_NAME)
-    cmake_parse_arguments(PARSE_ARGV 0 ROMFS "PROGRAM_DEFAULT" "KERNEL;DIR_NAME" "PROCESSES")
+    cmake_parse_arguments(PARSE_ARGV 0 ROMFS "PROGRAM_DEFAULT" "KERNEL;DIR_NAME" "PROCESSES;OPTIONS")
 
     # If the user did not provide a directory name, use "bin" as default
     if(NOT ROMFS_DIR_NAME)
@@ -61,7 +63,7 @@ function(miosix_add_romfs_image ROMFS_IMAGE_NAME)
     add_custom_command(
         OUTPUT ${ROMFS_IMAGE_NAME}-romfs.bin
         DEPENDS "${MIOSIX_PROCESSES_FILES}"
-        COMMAND mx-buildromfs ${ROMFS_IMAGE_NAME}-romfs.bin --from-directory ${ROMFS_DIR_NAME}
+        COMMAND mx-buildromfs ${ROMFS_IMAGE_NAME}-romfs.bin --from-directory ${ROMFS_DIR_NAME} ${ROMFS_OPTIONS}
         COMMENT "Building ${ROMFS_IMAGE_NAME}-romfs.bin"
     )
 
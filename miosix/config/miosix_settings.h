@@ -111,16 +111,47 @@ constexpr unsigned char FATFS_MAX_OPEN_FILES=8;
 /// occurs.
 constexpr unsigned int FATFS_EXTEND_BUFFER=512;
 
+/// Size in bytes of the RAM used by each mounted FATFS partition to keep a map
+/// of cluster groups known to be full, that speeds up free cluster allocation
+/// on large and nearly full volumes. Each bit of the map covers a group of
+/// clusters, and the group size is chosen so that the map fits in this size.
+/// Set to 0 to disable the map and save RAM.
+constexpr unsigned int FATFS_FREE_CLUSTER_MAP_SIZE=0;
+
+/// If true, the free cluster map is built when mounting the partition by
+/// reading the whole FAT, which also fixes a stale free cluster count. This
+/// slows down mounting large partitions. If false the map is built lazily as
+/// full cluster groups are found. Has no effect if FATFS_FREE_CLUSTER_MAP_SIZE
+/// is 0
+constexpr bool FATFS_FREE_CLUSTER_MAP_SCAN_AT_MOUNT=false;
+
 /// \def WITH_LITTLEFS
 /// Allows to enable/disable LittleFS support to save code size
 /// By default it is not defined (LittleFS is disabled)
 //#define WITH_LITTLEFS
 
+/// Default LittleFS cache size in bytes, or 0 to choose it from the block
+/// device geometry. Must be a multiple of the device read and program size,
+/// and a factor of its erase block size. Each mounted LittleFS allocates two
+/// caches, plus one for each open file
+constexpr unsigned int LITTLEFS_CACHE_SIZE=0;
+/// Default LittleFS lookahead buffer size in bytes, or 0 to choose it from the
+/// block device size. Each byte tracks the allocation state of 8 erase blocks,
+/// a buffer covering the entire device avoids rescanning the filesystem to
+/// find free blocks. Must be a multiple of 8
+constexpr unsigned int LITTLEFS_LOOKAHEAD_SIZE=0;
+
 /// \def WITH_ROMFS
 /// Allows to enable/disable RomFS support to save code size
 /// By default it is not defined (RomFS is disabled)
 //#define WITH_ROMFS
 
+/// Number of decompressed blocks of compressed RomFS files kept in RAM by each
+/// mounted RomFS. Buffers are allocated the first time a compressed file is
+/// read, and each takes the compression block size (1KByte by default) of RAM.
+/// Must be at least 1
+constexpr unsigned int ROMFS_BLOCK_CACHE_SIZE=2;
+
 /// \def SYNC_AFTER_WRITE
 /// Increases filesystem write robustness. After each write operation the
 /// filesystem is synced so that a power failure happens data is not lost
@@ -134,6 +165,32 @@ constexpr unsigned int FATFS_EXTEND_BUFFER=512;
 /// stdin, stdout, stderr, and in this case no additional files can be opened.
 const unsigned char MAX_OPEN_FILES=8;
 
+/// Number of entries of the directory entry cache shared by all filesystems,
+/// that remembers the result of looking up a name in a directory (both if it
+/// exists or not) to speed up path resolution. Each entry takes about
+/// 28+DENTRY_CACHE_NAME_LEN bytes of RAM. Set to 0 to disable the cache
+constexpr unsigned int DENTRY_CACHE_SIZE=16;
+/// Names longer than this are not cached. Must be less than 256
+constexpr unsigned int DENTRY_CACHE_NAME_LEN=24;
+
+/// Default size in bytes of the buffer of a pipe
+constexpr unsigned int PIPE_DEFAULT_SIZE=256;
+/// Maximum size in bytes of the buffer of a pipe that can be requested with
+/// fcntl(F_SETPIPE_SZ), as the buffer is allocated on the kernel heap
+constexpr unsigned int PIPE_MAX_SIZE=16384;
+
+/// Maximum number of messages of a message queue created without attributes
+constexpr unsigned int MQ_DEFAULT_MAXMSG=8;
+/// Maximum message size of a message queue created without attributes
+constexpr unsigned int MQ_DEFAULT_MSGSIZE=64;
+/// Maximum size in bytes of the buffer of a message queue, including a 12
+/// byte header for each message, as the buffer is allocated on the kernel heap
+constexpr unsigned int MQ_MAX_SIZE=16384;
+
+/// Size in bytes of the kernel heap buffer used by sendfile() to move data
+/// between files that can't be accessed directly from memory
+constexpr unsigned int SENDFILE_BUFFER_SIZE=512;
+
 /// \def WITH_PROCESSES
 /// If uncommented enables support for processes as well as threads.
 /// This enables the dynamic loader to load elf programs, the extended system
@@ -147,6 +204,42 @@ const unsigned char MAX_OPEN_FILES=8;
 #define WITH_ROMFS
 #endif
 
+/// \def WITH_PROCESS_LAZY_HEAP_ZEROING
+/// By default the kernel zeroes the entire heap of processes when they are
+/// spawned. If uncommented only .bss is zeroed, and processes zero heap memory
+/// the first time they use it. This makes spawning faster, but a process can
+/// read the data left by terminated processes in the part of its heap it did
+/// not yet use, so don't enable it if processes need to be isolated
+//#define WITH_PROCESS_LAZY_HEAP_ZEROING
+
+/// \def WITH_PROCFS
+/// If uncommented ProcFs is mounted as /proc, where each process has a
+/// directory with its resource usage as text files. The per process syscall
+/// counters take about 340 bytes of kernel RAM for each process. CPU time is
+/// only reported if WITH_CPU_TIME_COUNTER is also defined
+//#define WITH_PROCFS
+
+#if defined(WITH_PROCFS) && !defined(WITH_PROCESSES)
+#error ProcFs requires processes
+#endif //defined(WITH_PROCFS) && !defined(WITH_PROCESSES)
+
+/// \def WITH_SYSCALL_TRACE
+/// If uncommented processes can be traced by writing "+pid" to /dev/strace.
+/// The syscalls made by traced processes, with their parameters, return value
+/// and duration, are recorded in a ring buffer that is read from /dev/strace
+/// and decoded with tools/strace_print. Traced processes also keep per syscall
+/// latency histograms, which take about 4KB of kernel heap for each process.
+/// Syscalls served without leaving the SVC handler, such as getpid() and
+/// clock_gettime(), are not traced
+//#define WITH_SYSCALL_TRACE
+
+/// Number of records in the syscall trace ring buffer, each takes 48 bytes
+const unsigned int SYSCALL_TRACE_BUFFER_SIZE=64;
+
+#if defined(WITH_SYSCALL_TRACE) && !defined(WITH_PROCESSES)
+#error Syscall tracing requires processes
+#endif //defined(WITH_SYSCALL_TRACE) && !defined(WITH_PROCESSES)
+
 #endif // WITH_FILESYSTEM
 
 //
@@ -163,6 +256,28 @@ const unsigned char MAX_OPEN_FILES=8;
 /// By default it is defined (error information is printed)
 #define WITH_ERRLOG
 
+/// Size of the buffer where the terminal translates \n to \r\n before passing
+/// output to the console device. Allocated on the stack of the writing thread.
+/// Larger values reduce the number of device transactions for short lines
+constexpr unsigned int TERMINAL_TX_BUFFER_SIZE=64;
+
+/// \def WITH_DEFERRED_LOG
+/// Uncomment to enable deferredLog(), that logs from any context, IRQ
+/// included, in constant time by storing the format string and its arguments
+/// in a per-core ring. A low priority kernel thread prints them.
+//#define WITH_DEFERRED_LOG
+
+/// Number of entries in each deferred log ring, must be a power of two.
+/// Each entry takes 8+4*DEFERRED_LOG_MAX_ARGS bytes of RAM
+constexpr unsigned int DEFERRED_LOG_ENTRIES=32;
+/// Maximum number of arguments of a deferredLog() call
+constexpr unsigned int DEFERRED_LOG_MAX_ARGS=4;
+/// How often in nanoseconds the deferred log thread checks for new messages
+constexpr long long DEFERRED_LOG_POLL_PERIOD=10000000; //10ms
+
+static_assert((DEFERRED_LOG_ENTRIES & (DEFERRED_LOG_ENTRIES-1))==0,
+              "DEFERRED_LOG_ENTRIES must be a power of two");
+
 
 
 //
@@ -241,10 +356,37 @@ const unsigned int MAX_PROCESS_ARGS=16;
 /// does not contribute to the stack size.
 const unsigned int MAX_PROCESS_ARGS_BLOCK_SIZE=512;
 
+/// Maximum number of threads in a process, including the main thread. Each
+/// thread also takes a kernel thread with a SYSTEM_MODE_PROCESS_STACK_SIZE
+/// stack, while its userspace stack is allocated by the process itself
+const unsigned int MAX_THREADS_PER_PROCESS=8;
+
+/// Number of relocated .data images the kernel keeps to speed up spawning
+/// programs again at the same address. Each one takes as much kernel heap as
+/// the program .data section. Set to 0 to disable
+const unsigned int PROCESS_RELOCATION_SNAPSHOTS=4;
+
+/// A snapshot is not saved if it would leave less than this many bytes of free
+/// kernel heap
+const unsigned int PROCESS_RELOCATION_SNAPSHOT_HEAP_MARGIN=8192;
+
+/// Number of kernel threads, shared by all processes, that perform operations
+/// submitted through io rings. Also the maximum number of such operations that
+/// can block at the same time, the others are queued. The threads are created
+/// the first time a process sets up an io ring
+const unsigned int IO_RING_WORKERS=4;
+
+/// Stack size of each io ring worker thread (MUST be divisible by 4)
+const unsigned int IO_RING_WORKER_STACK_SIZE=2048;
+
+/// Maximum number of entries of io ring submission and completion rings
+const unsigned int IO_RING_MAX_ENTRIES=64;
+
 static_assert(STACK_IDLE>=STACK_MIN,"");
 static_assert(STACK_DEFAULT_FOR_PTHREAD>=STACK_MIN,"");
 static_assert(MIN_PROCESS_STACK_SIZE>=STACK_MIN,"");
 static_assert(SYSTEM_MODE_PROCESS_STACK_SIZE>=STACK_MIN,"");
+static_assert(IO_RING_WORKER_STACK_SIZE>=STACK_MIN,"");
 
 // The meaning of a thread's priority depends on the chosen scheduler.
 #ifdef SCHED_TYPE_PRIORITY
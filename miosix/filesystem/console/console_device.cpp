@@ -27,8 +27,12 @@
 
 #include "console_device.h"
 #include "filesystem/ioctl.h"
+#include "interfaces/atomic_ops.h"
 #include <errno.h>
 #include <termios.h>
+#include <cstring>
+#include <algorithm>
+#include <new>
 
 using namespace std;
 
@@ -44,32 +48,7 @@ TerminalDevice::TerminalDevice(intrusive_ref_ptr<Device> device)
 
 ssize_t TerminalDevice::write(const void *data, size_t length)
 {
-    if(binary) return device->writeBlock(data,length,0);
-    //No mutex here to avoid blocking writes while reads are in progress
-    const char *buffer=static_cast<const char*>(data);
-    const char *start=buffer;
-    //Try to write data in chunks, stop at every \n to replace with \r\n
-    //Although it may be tempting to call echoBack() from here since it performs
-    //a similar task, it is not possible, as echoBack() uses a class field,
-    //chunkStart, and write is not mutexed to allow concurrent writing
-    for(size_t i=0;i<length;i++,buffer++)
-    {
-        if(*buffer!='\n') continue;
-        if(buffer>start)
-        {
-            ssize_t r=device->writeBlock(start,buffer-start,0);
-            if(r<=0) return r;
-        }
-        ssize_t r=device->writeBlock("\r\n",2,0);//Add \r\n
-        if(r<=0) return r;
-        start=buffer+1;
-    }
-    if(buffer>start)
-    {
-        ssize_t r=device->writeBlock(start,buffer-start,0);
-        if(r<=0) return r;
-    }
-    return length;
+    return output(static_cast<const char*>(data),length,!binary);
 }
 
 ssize_t TerminalDevice::read(void *data, size_t length)
@@ -77,7 +56,8 @@ ssize_t TerminalDevice::read(void *data, size_t length)
     if(binary)
     {
         ssize_t result=device->readBlock(data,length,0);
-        if(echo && result>0) device->writeBlock(data,result,0);//Ignore write errors
+        //Ignore write errors
+        if(echo && result>0) output(static_cast<const char*>(data),result,false);
         return result;
     }
     Lock<KernelMutex> l(mutex); //Reads are serialized
@@ -106,11 +86,30 @@ int TerminalDevice::fstat(struct stat *pstat) const
 
 int TerminalDevice::isatty() const { return device->isatty(); }
 
+int TerminalDevice::poll(int events, PollTable& table)
+{
+    return device->poll(events,table);
+}
+
 #endif //WITH_FILESYSTEM
 
 int TerminalDevice::ioctl(int cmd, void *arg)
 {
-    if(int result=device->ioctl(cmd,arg)!=0) return result;
+    switch(cmd)
+    {
+        case IOCTL_GET_TX_STATS:
+            *reinterpret_cast<TerminalTxStats*>(arg)=getTxStats();
+            return 0;
+        case IOCTL_SET_ASYNC_TX:
+            return setAsyncTx(*reinterpret_cast<unsigned int*>(arg));
+        case IOCTL_SYNC:
+        case IOCTL_TCSETATTR_DRAIN:
+            flushTx();
+            break;
+        default:
+            break;
+    }
+    if(int result=device->ioctl(cmd,arg)) return result;
     termios *t=reinterpret_cast<termios*>(arg);
     switch(cmd)
     {
@@ -187,9 +186,191 @@ pair<size_t,bool> TerminalDevice::normalize(char *buffer, ssize_t begin,
 void TerminalDevice::echoBack(const char *chunkEnd, const char *sep, size_t sepLen)
 {
     if(!echo) return;
-    if(chunkEnd>chunkStart) device->writeBlock(chunkStart,chunkEnd-chunkStart,0);
+    if(chunkEnd>chunkStart) output(chunkStart,chunkEnd-chunkStart,false);
     chunkStart=chunkEnd+1;
-    if(sep) device->writeBlock(sep,sepLen,0); //Ignore write errors
+    if(sep) output(sep,sepLen,false); //Ignore write errors
+}
+
+int TerminalDevice::setAsyncTx(unsigned int queueSize)
+{
+    Lock<KernelMutex> l(txMutex);
+    if(txQuit) return -EBUSY; //Concurrent call
+    if(txQueue)
+    {
+        //The thread exits once the queue is empty and no writer is adding to
+        //it, new writers wait for the switch to complete to preserve ordering
+        txQuit=true;
+        txCv.broadcast();
+        {
+            Unlock<KernelMutex> u(l);
+            txThread->join();
+        }
+        delete[] txQueue;
+        txQueue=nullptr;
+        txThread=nullptr;
+        txPut=txGet=txUsed=0;
+        txQuit=false;
+        txCv.broadcast();
+    }
+    if(queueSize==0) return 0;
+    char *queue=new (nothrow) char[queueSize];
+    if(queue==nullptr) return -ENOMEM;
+    txQueueSize=queueSize;
+    txQueue=queue;
+    txThread=Thread::create(txThreadMain,STACK_DEFAULT_FOR_PTHREAD,
+                            DEFAULT_PRIORITY,this,Thread::JOINABLE);
+    if(txThread==nullptr)
+    {
+        delete[] txQueue;
+        txQueue=nullptr;
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+TerminalDevice::~TerminalDevice()
+{
+    setAsyncTx(0);
+}
+
+ssize_t TerminalDevice::output(const char *data, size_t length, bool translate)
+{
+    if(txQueue)
+    {
+        Lock<KernelMutex> l(txMutex);
+        while(txQuit) txCv.wait(l);
+        if(txQueue)
+        {
+            txWriters++;
+            const char *end=data+length;
+            while(data<end)
+            {
+                const char *nl=nullptr;
+                if(translate) nl=static_cast<const char*>(memchr(data,'\n',end-data));
+                const char *runEnd= nl ? nl : end;
+                enqueue(data,runEnd-data,l);
+                data=runEnd;
+                if(nl)
+                {
+                    enqueue("\r\n",2,l);
+                    data++;
+                }
+            }
+            txWriters--;
+            if(txQuit) txCv.broadcast();
+            return length;
+        }
+    }
+
+    if(translate==false) return transmit(data,length);
+    //No mutex here to avoid blocking writes while reads are in progress.
+    //Translate \n to \r\n in a staging buffer so that the device is called
+    //once per buffer instead of twice per line
+    char staging[TERMINAL_TX_BUFFER_SIZE];
+    size_t used=0;
+    const char *end=data+length;
+    while(data<end)
+    {
+        auto nl=static_cast<const char*>(memchr(data,'\n',end-data));
+        size_t run=(nl ? nl : end)-data;
+        if(used+run>sizeof(staging))
+        {
+            if(used>0)
+            {
+                ssize_t r=transmit(staging,used);
+                if(r<=0) return r;
+                used=0;
+            }
+            //Runs that don't fit are written directly, avoiding the copy
+            if(run>=sizeof(staging))
+            {
+                ssize_t r=transmit(data,run);
+                if(r<=0) return r;
+                data+=run;
+                run=0;
+            }
+        }
+        memcpy(staging+used,data,run);
+        used+=run;
+        data+=run;
+        if(nl)
+        {
+            if(used+2>sizeof(staging))
+            {
+                ssize_t r=transmit(staging,used);
+                if(r<=0) return r;
+                used=0;
+            }
+            staging[used++]='\r';
+            staging[used++]='\n';
+            data++;
+        }
+    }
+    if(used>0)
+    {
+        ssize_t r=transmit(staging,used);
+        if(r<=0) return r;
+    }
+    return length;
+}
+
+void TerminalDevice::enqueue(const char *data, size_t length,
+        Lock<KernelMutex>& l)
+{
+    while(length>0)
+    {
+        while(txUsed==txQueueSize) txCv.wait(l);
+        unsigned int chunk=min<size_t>(length,txQueueSize-txUsed);
+        //Free space may wrap around the end of the queue
+        unsigned int first=min(chunk,txQueueSize-txPut);
+        memcpy(txQueue+txPut,data,first);
+        memcpy(txQueue,data+first,chunk-first);
+        txPut+=chunk;
+        if(txPut>=txQueueSize) txPut-=txQueueSize;
+        if(txUsed==0) txCv.broadcast();
+        txUsed+=chunk;
+        data+=chunk;
+        length-=chunk;
+    }
+}
+
+ssize_t TerminalDevice::transmit(const char *data, size_t length)
+{
+    atomicAdd(&txTransactions,1);
+    atomicAdd(&txBytes,length);
+    return device->writeBlock(data,length,0);
+}
+
+void TerminalDevice::flushTx()
+{
+    if(txQueue==nullptr) return;
+    Lock<KernelMutex> l(txMutex);
+    while(txUsed>0) txCv.wait(l);
+}
+
+void *TerminalDevice::txThreadMain(void *arg)
+{
+    auto t=static_cast<TerminalDevice*>(arg);
+    Lock<KernelMutex> l(t->txMutex);
+    for(;;)
+    {
+        while(t->txUsed==0)
+        {
+            if(t->txQuit && t->txWriters==0) return nullptr;
+            t->txCv.wait(l);
+        }
+        //Transmit everything up to the end of the queue in one transaction,
+        //writers can keep adding to the free space meanwhile
+        unsigned int chunk=min(t->txUsed,t->txQueueSize-t->txGet);
+        {
+            Unlock<KernelMutex> u(l);
+            t->transmit(t->txQueue+t->txGet,chunk); //Errors can't be reported
+        }
+        t->txGet+=chunk;
+        if(t->txGet>=t->txQueueSize) t->txGet-=t->txQueueSize;
+        t->txUsed-=chunk;
+        t->txCv.broadcast();
+    }
 }
 
 
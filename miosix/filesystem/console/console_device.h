@@ -30,6 +30,7 @@
 #include "miosix_settings.h"
 #include "filesystem/devfs/devfs.h"
 #include "kernel/sync.h"
+#include "filesystem/ioctl.h"
 
 namespace miosix {
 
@@ -48,6 +49,7 @@ public:
     
     /**
      * Write data to the file, if the file supports writing.
+     * In asynchronous transmit mode returns as soon as data has been queued.
      * \param data the data to write
      * \param length the number of bytes to write
      * \return the number of written characters, or a negative number in case
@@ -96,6 +98,17 @@ public:
      * case of errors
      */
     virtual int isatty() const;
+
+    /**
+     * Check whether the terminal is ready for reading and writing.
+     * Readiness is the one of the underlying device, so when not in binary
+     * mode a read may still block waiting for a complete line after a
+     * POLLIN is returned.
+     * \param events requested events (POLLIN, POLLOUT, ...)
+     * \param table poll table to add to the device's PollQueue
+     * \return the events that are ready
+     */
+    virtual int poll(int events, PollTable& table);
     
     #endif //WITH_FILESYSTEM
     
@@ -129,6 +142,34 @@ public:
      */
     bool isBinary() const { return binary; }
     
+    /**
+     * Enable or disable asynchronous transmit mode. In this mode write()
+     * translates data into a queue and returns, while a kernel thread passes
+     * the queued data to the device in chunks as large as possible. Write
+     * errors are not reported in this mode. IOCTL_SYNC and
+     * IOCTL_TCSETATTR_DRAIN wait until the queue is empty.
+     * Can also be set with IOCTL_SET_ASYNC_TX.
+     * \param queueSize size of the queue allocated on the kernel heap, or 0 to
+     * go back to synchronous mode once the queue has been transmitted
+     * \return 0 on success, or a negative number on failure
+     */
+    int setAsyncTx(unsigned int queueSize);
+
+    /**
+     * \return transmit statistics since the terminal was created.
+     * Can also be read with IOCTL_GET_TX_STATS.
+     */
+    TerminalTxStats getTxStats() const
+    {
+        return { static_cast<unsigned int>(txBytes),
+                 static_cast<unsigned int>(txTransactions) };
+    }
+
+    /**
+     * Destructor
+     */
+    ~TerminalDevice();
+    
 private:
     /**
      * Perform normalization of a read buffer (\r\n conversion to \n, backspace)
@@ -151,12 +192,61 @@ private:
      */
     void echoBack(const char *chunkEnd, const char *sep=0, size_t sepLen=0);
     
+    /**
+     * Write data to the device, or to the queue in asynchronous mode
+     * \param data data to write
+     * \param length number of bytes to write
+     * \param translate true if \n should be translated to \r\n
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    ssize_t output(const char *data, size_t length, bool translate);
+
+    /**
+     * Add data to the asynchronous transmit queue, blocking while it is full.
+     * \param data data to add
+     * \param length number of bytes
+     * \param l lock on txMutex, released while waiting
+     */
+    void enqueue(const char *data, size_t length, Lock<KernelMutex>& l);
+
+    /**
+     * Pass data to the device, updating statistics
+     * \param data data to write
+     * \param length number of bytes to write
+     * \return the device writeBlock() return value
+     */
+    ssize_t transmit(const char *data, size_t length);
+
+    /**
+     * Wait until the asynchronous transmit queue is empty
+     */
+    void flushTx();
+
+    /**
+     * Entry point of the asynchronous transmit thread
+     * \param arg the TerminalDevice
+     */
+    static void *txThreadMain(void *arg);
+    
     intrusive_ref_ptr<Device> device; ///< Underlying TTY device
     KernelMutex mutex;                ///< Mutex to serialze concurrent reads
     const char *chunkStart;           ///< First character to echo in echoBack()
     bool echo;                        ///< True if echo enabled
     bool binary;                      ///< True if binary mode enabled
     bool skipNewline;                 ///< Used by normalize()
+    KernelMutex txMutex;              ///< Guards the transmit queue
+    ConditionVariable txCv;           ///< Signaled when the queue changes
+    char *txQueue=nullptr;            ///< Transmit queue, if asynchronous
+    unsigned int txQueueSize=0;       ///< Queue capacity
+    unsigned int txPut=0;             ///< Queue insertion index
+    unsigned int txGet=0;             ///< Queue removal index
+    unsigned int txUsed=0;            ///< Bytes in queue
+    unsigned int txWriters=0;         ///< Writers adding to the queue
+    bool txQuit=false;                ///< Switching back to synchronous mode
+    Thread *txThread=nullptr;         ///< Thread emptying the queue
+    volatile int txBytes=0;           ///< Bytes passed to the device
+    volatile int txTransactions=0;    ///< Calls to the device writeBlock()
 };
 
 /**
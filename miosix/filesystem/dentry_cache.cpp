@@ -0,0 +1,160 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#include "dentry_cache.h"
+#include <cstring>
+#include <errno.h>
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+static_assert(DENTRY_CACHE_NAME_LEN<256,"name length must fit in a byte");
+
+//
+// class DentryCache
+//
+
+DentryCache& DentryCache::instance()
+{
+    static DentryCache instance;
+    return instance;
+}
+
+int DentryCache::lookup(const void *owner, unsigned int parent,
+        const char *name, unsigned int len, DentryData& data)
+{
+    if(DENTRY_CACHE_SIZE==0 || len>DENTRY_CACHE_NAME_LEN) return 0;
+    unsigned int hash=hashName(name,len);
+    Lock<KernelMutex> l(mutex);
+    int i=find(owner,parent,name,len,hash);
+    if(i<0)
+    {
+        stats.misses++;
+        return 0;
+    }
+    entries[i].lastUse=++useCounter;
+    if(entries[i].negative)
+    {
+        stats.negativeHits++;
+        return -ENOENT;
+    }
+    stats.hits++;
+    data=entries[i].data;
+    return 1;
+}
+
+void DentryCache::invalidateDirectory(const void *owner, unsigned int parent)
+{
+    Lock<KernelMutex> l(mutex);
+    for(unsigned int i=0;i<DENTRY_CACHE_SIZE;i++)
+    {
+        if(entries[i].owner!=owner || entries[i].parent!=parent) continue;
+        entries[i].owner=nullptr;
+        stats.invalidations++;
+    }
+}
+
+void DentryCache::invalidateFilesystem(const void *owner)
+{
+    Lock<KernelMutex> l(mutex);
+    for(unsigned int i=0;i<DENTRY_CACHE_SIZE;i++)
+    {
+        if(entries[i].owner!=owner) continue;
+        entries[i].owner=nullptr;
+        stats.invalidations++;
+    }
+}
+
+DentryCacheStats DentryCache::getStats()
+{
+    Lock<KernelMutex> l(mutex);
+    return stats;
+}
+
+void DentryCache::resetStats()
+{
+    Lock<KernelMutex> l(mutex);
+    memset(&stats,0,sizeof(stats));
+}
+
+void DentryCache::insertImpl(const void *owner, unsigned int parent,
+        const char *name, unsigned int len, const DentryData *data)
+{
+    if(DENTRY_CACHE_SIZE==0 || len>DENTRY_CACHE_NAME_LEN) return;
+    unsigned int hash=hashName(name,len);
+    Lock<KernelMutex> l(mutex);
+    int i=find(owner,parent,name,len,hash);
+    if(i<0)
+    {
+        //Not found, use a free entry or replace the least recently used one
+        i=0;
+        for(unsigned int j=0;j<DENTRY_CACHE_SIZE;j++)
+        {
+            if(entries[j].owner==nullptr) { i=j; break; }
+            if(entries[j].lastUse<entries[i].lastUse) i=j;
+        }
+        if(entries[i].owner) stats.evictions++;
+        entries[i].owner=owner;
+        entries[i].parent=parent;
+        entries[i].hash=hash;
+        entries[i].len=len;
+        memcpy(entries[i].name,name,len);
+    }
+    entries[i].lastUse=++useCounter;
+    entries[i].negative= data==nullptr;
+    if(data) entries[i].data=*data;
+}
+
+int DentryCache::find(const void *owner, unsigned int parent, const char *name,
+        unsigned int len, unsigned int hash)
+{
+    for(unsigned int i=0;i<DENTRY_CACHE_SIZE;i++)
+    {
+        const Entry& e=entries[i];
+        if(e.owner!=owner || e.parent!=parent || e.hash!=hash || e.len!=len)
+            continue;
+        if(memcmp(e.name,name,len)==0) return i;
+    }
+    return -1;
+}
+
+unsigned int DentryCache::hashName(const char *name, unsigned int len)
+{
+    //FNV-1a
+    unsigned int result=2166136261u;
+    for(unsigned int i=0;i<len;i++)
+    {
+        result^=static_cast<unsigned char>(name[i]);
+        result*=16777619u;
+    }
+    return result;
+}
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
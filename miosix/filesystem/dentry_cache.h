@@ -0,0 +1,198 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+#pragma once
+
+#include "kernel/sync.h"
+#include "miosix_settings.h"
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+/**
+ * Data stored in a positive dentry cache entry. Its meaning is filesystem
+ * specific, for example it can be the inode and mode of the entry, or the
+ * position of the entry in the directory table.
+ */
+struct DentryData
+{
+    unsigned int inode; ///< Inode, or other identifier of the entry
+    unsigned int info;  ///< Type of the entry, or other filesystem data
+};
+
+/**
+ * Statistics of the dentry cache
+ */
+struct DentryCacheStats
+{
+    unsigned int hits;          ///< Lookups that found a positive entry
+    unsigned int negativeHits;  ///< Lookups that found a negative entry
+    unsigned int misses;        ///< Lookups that found nothing
+    unsigned int evictions;     ///< Entries replaced to make room
+    unsigned int invalidations; ///< Entries removed by invalidate calls
+};
+
+/**
+ * \internal
+ * Bounded cache of directory entry lookups, shared by all mounted filesystems.
+ * Entries are keyed by (owner, parent directory, name), where the owner is an
+ * object unique to a mounted filesystem and the parent directory is its inode,
+ * or any other value that identifies the directory within the filesystem.
+ * An entry can be positive (the name exists and its DentryData is cached) or
+ * negative (the name is known not to exist).
+ *
+ * Filesystems that modify their directory tree must invalidate the affected
+ * entries, and all entries of a filesystem must be invalidated when it is
+ * unmounted, as the owner pointer may be reused.
+ *
+ * All member functions are thread safe.
+ */
+class DentryCache
+{
+public:
+    /**
+     * \return the DentryCache instance
+     */
+    static DentryCache& instance();
+
+    /**
+     * Value to use as parent for entries in the root directory of filesystems
+     * that have no inode for the root directory's parent
+     */
+    static const unsigned int rootDir=0xffffffff;
+
+    /**
+     * Lookup an entry
+     * \param owner the filesystem
+     * \param parent the parent directory
+     * \param name entry name, not nul terminated
+     * \param len length of name
+     * \param data if a positive entry is found, its data is stored here
+     * \return 1 if a positive entry is found, -ENOENT if a negative entry is
+     * found, 0 if the entry is not cached
+     */
+    int lookup(const void *owner, unsigned int parent, const char *name,
+               unsigned int len, DentryData& data);
+
+    /**
+     * Add a positive entry, or replace an existing one
+     * \param owner the filesystem
+     * \param parent the parent directory
+     * \param name entry name, not nul terminated
+     * \param len length of name. If greater than DENTRY_CACHE_NAME_LEN the
+     * entry is not cached
+     * \param data entry data
+     */
+    void insert(const void *owner, unsigned int parent, const char *name,
+                unsigned int len, const DentryData& data)
+    {
+        insertImpl(owner,parent,name,len,&data);
+    }
+
+    /**
+     * Add a negative entry, or replace an existing one
+     * \param owner the filesystem
+     * \param parent the parent directory
+     * \param name entry name, not nul terminated
+     * \param len length of name. If greater than DENTRY_CACHE_NAME_LEN the
+     * entry is not cached
+     */
+    void insertNegative(const void *owner, unsigned int parent,
+                        const char *name, unsigned int len)
+    {
+        insertImpl(owner,parent,name,len,nullptr);
+    }
+
+    /**
+     * Remove all the entries of a directory, to be called whenever an entry
+     * is added to, removed from or renamed in the directory
+     * \param owner the filesystem
+     * \param parent the directory
+     */
+    void invalidateDirectory(const void *owner, unsigned int parent);
+
+    /**
+     * Remove all the entries of a filesystem, to be called on unmount
+     * \param owner the filesystem
+     */
+    void invalidateFilesystem(const void *owner);
+
+    /**
+     * \return the cache statistics
+     */
+    DentryCacheStats getStats();
+
+    /**
+     * Clear the cache statistics
+     */
+    void resetStats();
+
+private:
+    DentryCache() {}
+    DentryCache(const DentryCache&)=delete;
+    DentryCache& operator=(const DentryCache&)=delete;
+
+    /**
+     * Implementation of insert and insertNegative
+     * \param data entry data, or nullptr for a negative entry
+     */
+    void insertImpl(const void *owner, unsigned int parent, const char *name,
+                    unsigned int len, const DentryData *data);
+
+    /**
+     * \return the index of the entry, or -1 if not found
+     */
+    int find(const void *owner, unsigned int parent, const char *name,
+             unsigned int len, unsigned int hash);
+
+    /**
+     * \return a hash of the name
+     */
+    static unsigned int hashName(const char *name, unsigned int len);
+
+    struct Entry
+    {
+        const void *owner;    ///< Filesystem, nullptr if entry is unused
+        unsigned int parent;  ///< Parent directory
+        unsigned int hash;    ///< Hash of name, to speed up lookups
+        unsigned int lastUse; ///< For least recently used replacement
+        DentryData data;      ///< Entry data if positive
+        unsigned char len;    ///< Name length
+        bool negative;        ///< True if the name is known not to exist
+        char name[DENTRY_CACHE_NAME_LEN]; ///< Name, not nul terminated
+    };
+
+    KernelMutex mutex;
+    Entry entries[DENTRY_CACHE_SIZE>0 ? DENTRY_CACHE_SIZE : 1]={};
+    unsigned int useCounter=0;
+    DentryCacheStats stats={};
+};
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
@@ -30,6 +30,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include "filesystem/stringpart.h"
+#include "filesystem/poll_table.h"
 
 using namespace std;
 
@@ -94,6 +95,26 @@ public:
      */
     virtual off_t lseek(off_t pos, int whence);
 
+    /**
+     * Read data from the given position without moving the file pointer.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \param pos offset from the beginning of the file
+     * \return the number of read characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t pread(void *data, size_t len, off_t pos);
+
+    /**
+     * Write data at the given position without moving the file pointer.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \param pos offset from the beginning of the file
+     * \return the number of written characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t pwrite(const void *data, size_t len, off_t pos);
+
     /**
      * Truncate the file
      * \param size new file size
@@ -123,6 +144,14 @@ public:
      */
     virtual int ioctl(int cmd, void *arg);
 
+    /**
+     * Check whether the file is ready for reading and writing
+     * \param events requested events (POLLIN, POLLOUT, ...)
+     * \param table poll table to add to the device's PollQueue
+     * \return the events that are ready
+     */
+    virtual int poll(int events, PollTable& table);
+
 private:
     intrusive_ref_ptr<Device> dev; ///< Device file
     off_t seekPoint;               ///< Seek point (note that off_t is 64bit)
@@ -169,6 +198,24 @@ off_t DevFsFile::lseek(off_t pos, int whence)
     return seekPoint;
 }
 
+ssize_t DevFsFile::pread(void *data, size_t len, off_t pos)
+{
+    if((flags & _FREAD)==0) return -EINVAL;
+    if(flags & _NOSEEK) return -ESPIPE;
+    if(pos<0) return -EINVAL;
+    if(pos+static_cast<off_t>(len)<0) len=numeric_limits<off_t>::max()-pos;
+    return dev->readBlock(data,len,pos);
+}
+
+ssize_t DevFsFile::pwrite(const void *data, size_t len, off_t pos)
+{
+    if((flags & _FWRITE)==0) return -EINVAL;
+    if(flags & _NOSEEK) return -ESPIPE;
+    if(pos<0) return -EINVAL;
+    if(pos+static_cast<off_t>(len)<0) len=numeric_limits<off_t>::max()-pos;
+    return dev->writeBlock(data,len,pos);
+}
+
 int DevFsFile::ftruncate(off_t size) { return -EINVAL; }
 
 int DevFsFile::fstat(struct stat *pstat) const
@@ -186,6 +233,11 @@ int DevFsFile::ioctl(int cmd, void *arg)
     return dev->ioctl(cmd,arg);
 }
 
+int DevFsFile::poll(int events, PollTable& table)
+{
+    return dev->poll(events,table);
+}
+
 //
 // class Device
 //
@@ -231,6 +283,15 @@ int Device::ioctl(int cmd, void *arg)
     return -ENOTTY; //Means the operation does not apply to this descriptor
 }
 
+#ifdef WITH_FILESYSTEM
+
+int Device::poll(int events, PollTable& table)
+{
+    return events & (POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM);
+}
+
+#endif //WITH_FILESYSTEM
+
 Device::~Device() {}
 
 #ifdef WITH_DEVFS
@@ -150,6 +150,22 @@ public:
      * \return the exact return value depends on CMD, -1 is returned on error
      */
     virtual int ioctl(int cmd, void *arg);
+
+    #ifdef WITH_FILESYSTEM
+
+    /**
+     * Check whether the device is ready for reading and writing, used to
+     * implement poll(). Devices whose readiness can change must also add the
+     * table to their PollQueue before checking their state, and wake up the
+     * queue when the state changes.
+     * \param events requested events (POLLIN, POLLOUT, ...)
+     * \param table poll table to add to the device's PollQueue
+     * \return the events that are ready. The default implementation reports
+     * the device as always readable and writable
+     */
+    virtual int poll(int events, PollTable& table);
+
+    #endif //WITH_FILESYSTEM
     
     /**
      * Destructor
@@ -0,0 +1,204 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <errno.h>
+#include "filesystem/ioctl.h"
+
+namespace miosix {
+
+/**
+ * Timing of NOR flash operations, used to compute the time a real flash
+ * memory would take to complete the operations
+ */
+struct NorFlashTiming
+{
+    unsigned int readNsPerByte=20;  ///< Read time per byte
+    unsigned int progUs=700;        ///< Time to program one progSize unit
+    unsigned int eraseUs=45000;     ///< Time to erase one block
+};
+
+/**
+ * Statistics of a NOR flash
+ */
+struct NorFlashStats
+{
+    unsigned long long bytesRead;       ///< Bytes read
+    unsigned long long bytesProgrammed; ///< Bytes programmed
+    unsigned long long erases;          ///< Blocks erased
+    unsigned long long elapsedNs;       ///< Time taken by a real flash memory
+    unsigned int progErrors;            ///< Programming of non-erased bits
+    unsigned int maxEraseCount;         ///< Erase count of most erased block
+};
+
+/**
+ * Model of a NOR flash memory stored in RAM. Unlike a disk, a NOR flash must
+ * be erased in blocks before being programmed, erasing sets all bits to 1 and
+ * programming can only clear bits. Each block can only be erased a limited
+ * number of times, so the model keeps per-block erase counters.
+ *
+ * This class does not depend on the kernel so that it can also be used in host
+ * tools, use NorFlashEmulator to access it as a Device. It is not thread safe.
+ */
+class NorFlash
+{
+public:
+    /**
+     * Constructor. The memory content is initially erased
+     * \param geometry flash geometry, blockCount must not be zero
+     * \param timing flash timing
+     */
+    NorFlash(const BlockGeometry& geometry,
+             const NorFlashTiming& timing=NorFlashTiming())
+        : geometry(geometry), timing(timing),
+          storage(new unsigned char[size()]),
+          eraseCounts(new unsigned int[geometry.blockCount])
+    {
+        memset(storage.get(),0xff,size());
+        resetStats();
+    }
+
+    /**
+     * Read data
+     * \param buffer where read data is stored
+     * \param len number of bytes to read, must be a multiple of readSize
+     * \param offset where to read from, must be a multiple of readSize
+     * \return 0 on success, or a negative number on failure
+     */
+    int read(void *buffer, unsigned int len, unsigned long long offset)
+    {
+        if(check(len,offset,geometry.readSize)==false) return -EINVAL;
+        memcpy(buffer,storage.get()+offset,len);
+        stats.bytesRead+=len;
+        stats.elapsedNs+=static_cast<unsigned long long>(len)*timing.readNsPerByte;
+        return 0;
+    }
+
+    /**
+     * Program data. As in a real NOR flash, programming can only clear bits
+     * \param buffer data to program
+     * \param len number of bytes to program, must be a multiple of progSize
+     * \param offset where to program, must be a multiple of progSize
+     * \return 0 on success, -EIO if the data requires setting bits that are
+     * not erased, which on a real flash memory leaves the content corrupted,
+     * or another negative number on failure
+     */
+    int program(const void *buffer, unsigned int len, unsigned long long offset)
+    {
+        if(check(len,offset,geometry.progSize)==false) return -EINVAL;
+        auto src=reinterpret_cast<const unsigned char*>(buffer);
+        auto dst=storage.get()+offset;
+        bool error=false;
+        for(unsigned int i=0;i<len;i++)
+        {
+            if((dst[i] & src[i])!=src[i]) error=true;
+            dst[i]&=src[i];
+        }
+        stats.bytesProgrammed+=len;
+        stats.elapsedNs+=1000ull*timing.progUs*(len/geometry.progSize);
+        if(error==false) return 0;
+        stats.progErrors++;
+        return -EIO;
+    }
+
+    /**
+     * Erase a block
+     * \param block block number
+     * \return 0 on success, or a negative number on failure
+     */
+    int erase(unsigned int block)
+    {
+        if(block>=geometry.blockCount) return -EINVAL;
+        memset(storage.get()+block*geometry.eraseSize,0xff,geometry.eraseSize);
+        unsigned int count=++eraseCounts[block];
+        if(count>stats.maxEraseCount) stats.maxEraseCount=count;
+        stats.erases++;
+        stats.elapsedNs+=1000ull*timing.eraseUs;
+        return 0;
+    }
+
+    /**
+     * \return the flash geometry
+     */
+    const BlockGeometry& getGeometry() const { return geometry; }
+
+    /**
+     * \return the flash size in bytes
+     */
+    unsigned long long size() const
+    {
+        return static_cast<unsigned long long>(geometry.eraseSize)*geometry.blockCount;
+    }
+
+    /**
+     * \param block block number, must be less than blockCount
+     * \return the number of times the block was erased
+     */
+    unsigned int getEraseCount(unsigned int block) const
+    {
+        return eraseCounts[block];
+    }
+
+    /**
+     * \return the flash statistics
+     */
+    const NorFlashStats& getStats() const { return stats; }
+
+    /**
+     * Clear the statistics, including the per-block erase counters
+     */
+    void resetStats()
+    {
+        memset(&stats,0,sizeof(stats));
+        memset(eraseCounts.get(),0,geometry.blockCount*sizeof(unsigned int));
+    }
+
+private:
+    NorFlash(const NorFlash&)=delete;
+    NorFlash& operator=(const NorFlash&)=delete;
+
+    /**
+     * \return true if the access is aligned and within the flash
+     */
+    bool check(unsigned int len, unsigned long long offset, unsigned int align)
+    {
+        if(len%align || offset%align) return false;
+        return offset<=size() && len<=size()-offset;
+    }
+
+    const BlockGeometry geometry;
+    const NorFlashTiming timing;
+    std::unique_ptr<unsigned char[]> storage;
+    std::unique_ptr<unsigned int[]> eraseCounts;
+    NorFlashStats stats;
+};
+
+} //namespace miosix
@@ -0,0 +1,115 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include "nor_flash_emulator.h"
+#include "kernel/thread.h"
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+//
+// class NorFlashEmulator
+//
+
+NorFlashEmulator::NorFlashEmulator(const BlockGeometry& geometry,
+        const NorFlashTiming& timing, bool realTime)
+    : Device(Device::BLOCK), flash(geometry,timing), realTime(realTime) {}
+
+ssize_t NorFlashEmulator::readBlock(void *buffer, size_t size, off_t where)
+{
+    if(where<0) return -EINVAL;
+    Lock<KernelMutex> l(mutex);
+    auto before=flash.getStats().elapsedNs;
+    if(int res=flash.read(buffer,size,where)) return res;
+    wait(before);
+    return size;
+}
+
+ssize_t NorFlashEmulator::writeBlock(const void *buffer, size_t size, off_t where)
+{
+    if(where<0) return -EINVAL;
+    Lock<KernelMutex> l(mutex);
+    auto before=flash.getStats().elapsedNs;
+    int res=flash.program(buffer,size,where);
+    wait(before);
+    return res==0 ? size : res;
+}
+
+int NorFlashEmulator::ioctl(int cmd, void *arg)
+{
+    switch(cmd)
+    {
+        case IOCTL_SYNC:
+            return 0;
+        case IOCTL_GET_BLOCK_GEOMETRY:
+            if(arg==nullptr) return -EFAULT;
+            *static_cast<BlockGeometry*>(arg)=flash.getGeometry();
+            return 0;
+        case IOCTL_ERASE_BLOCK:
+        {
+            if(arg==nullptr) return -EFAULT;
+            Lock<KernelMutex> l(mutex);
+            auto before=flash.getStats().elapsedNs;
+            if(int res=flash.erase(*static_cast<unsigned int*>(arg))) return res;
+            wait(before);
+            return 0;
+        }
+        default:
+            return -ENOTTY;
+    }
+}
+
+NorFlashStats NorFlashEmulator::getStats()
+{
+    Lock<KernelMutex> l(mutex);
+    return flash.getStats();
+}
+
+unsigned int NorFlashEmulator::getEraseCount(unsigned int block)
+{
+    Lock<KernelMutex> l(mutex);
+    return flash.getEraseCount(block);
+}
+
+void NorFlashEmulator::resetStats()
+{
+    Lock<KernelMutex> l(mutex);
+    flash.resetStats();
+}
+
+void NorFlashEmulator::wait(unsigned long long before)
+{
+    //Sleeping with the mutex locked, as a real flash can do one operation
+    //at a time
+    if(realTime) Thread::nanoSleep(flash.getStats().elapsedNs-before);
+}
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
@@ -0,0 +1,123 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include "devfs.h"
+#include "nor_flash.h"
+#include "kernel/sync.h"
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+/**
+ * A block device that emulates a NOR flash memory in RAM, to measure how
+ * filesystems such as LittleFS behave on flash memories before deployment.
+ * Reads and writes must be aligned to the read and program size, writes to
+ * bits that were not erased fail with -EIO, and blocks are erased with
+ * IOCTL_ERASE_BLOCK. The geometry is reported with IOCTL_GET_BLOCK_GEOMETRY.
+ *
+ * Example usage:
+ * \code
+ * intrusive_ref_ptr<NorFlashEmulator> nor(new NorFlashEmulator({1,256,4096,64}));
+ * devfs->addDevice("nor0",nor);
+ * \endcode
+ */
+class NorFlashEmulator : public Device
+{
+public:
+    /**
+     * Constructor
+     * \param geometry flash geometry, blockCount must not be zero
+     * \param timing flash timing
+     * \param realTime if true, each operation blocks the caller for the time
+     * a real flash memory would take, otherwise the time is only accounted
+     * in the statistics
+     */
+    NorFlashEmulator(const BlockGeometry& geometry,
+                     const NorFlashTiming& timing=NorFlashTiming(),
+                     bool realTime=false);
+
+    /**
+     * Read a block of data
+     * \param buffer buffer where read data will be stored
+     * \param size buffer size
+     * \param where where to read from
+     * \return number of bytes read or a negative number on failure
+     */
+    ssize_t readBlock(void *buffer, size_t size, off_t where) override;
+
+    /**
+     * Write a block of data
+     * \param buffer buffer where take data to write
+     * \param size buffer size
+     * \param where where to write to
+     * \return number of bytes written or a negative number on failure
+     */
+    ssize_t writeBlock(const void *buffer, size_t size, off_t where) override;
+
+    /**
+     * Performs device-specific operations
+     * \param cmd specifies the operation to perform
+     * \param arg optional argument that some operation require
+     * \return the exact return value depends on CMD, -1 is returned on error
+     */
+    int ioctl(int cmd, void *arg) override;
+
+    /**
+     * \return the flash statistics
+     */
+    NorFlashStats getStats();
+
+    /**
+     * \param block block number, must be less than blockCount
+     * \return the number of times the block was erased
+     */
+    unsigned int getEraseCount(unsigned int block);
+
+    /**
+     * Clear the statistics, including the per-block erase counters
+     */
+    void resetStats();
+
+private:
+    /**
+     * If realTime is true, wait for the time taken by the last operation
+     * \param before elapsed time before the operation
+     */
+    void wait(unsigned long long before);
+
+    KernelMutex mutex;
+    NorFlash flash;
+    const bool realTime;
+};
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
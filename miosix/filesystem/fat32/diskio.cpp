@@ -5,12 +5,17 @@
 
 #include "diskio.h"
 #include "filesystem/ioctl.h"
+#include "kernel/sync.h"
 #include "miosix_settings.h"
 
 #ifdef WITH_FILESYSTEM
 
 using namespace miosix;
 
+/// Since f_read() and f_write() may access the drive concurrently for different
+/// files, this mutex makes the lseek() followed by read()/write() atomic
+static KernelMutex diskMutex;
+
 // #ifdef __cplusplus
 // extern "C" {
 // #endif
@@ -52,6 +57,7 @@ DRESULT disk_read (
 	UINT count		/* Number of sectors to read (1..255) */
 )
 {
+    Lock<KernelMutex> l(diskMutex);
     if(pdrv->lseek(static_cast<off_t>(sector)*512,SEEK_SET)<0) return RES_ERROR;
     if(pdrv->read(buff,count*512)!=static_cast<ssize_t>(count)*512) return RES_ERROR;
     return RES_OK;
@@ -68,6 +74,7 @@ DRESULT disk_write (
 	UINT count		/* Number of sectors to write (1..255) */
 )
 {
+    Lock<KernelMutex> l(diskMutex);
     if(pdrv->lseek(static_cast<off_t>(sector)*512,SEEK_SET)<0) return RES_ERROR;
     if(pdrv->write(buff,count*512)!=static_cast<ssize_t>(count)*512) return RES_ERROR;
     return RES_OK;
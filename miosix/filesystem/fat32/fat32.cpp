@@ -85,14 +85,16 @@ class Fat32Directory : public DirectoryBase
 public:
     /**
      * \param parent parent filesystem
-     * \param mutex mutex to lock when accessing the fiesystem
+     * \param dirMutex mutex to lock when accessing the directory tree
+     * \param fatMutex mutex to lock when calling into FatFs
      * \param currentInode inode value for '.' entry
      * \param parentInode inode value for '..' entry
      */
-    Fat32Directory(intrusive_ref_ptr<FilesystemBase> parent, KernelMutex& mutex,
-            int currentInode, int parentInode) : DirectoryBase(parent),
-            mutex(mutex), currentInode(currentInode), parentInode(parentInode),
-            first(true), unfinished(false)
+    Fat32Directory(intrusive_ref_ptr<FilesystemBase> parent,
+            KernelMutex& dirMutex, KernelMutex& fatMutex, int currentInode,
+            int parentInode) : DirectoryBase(parent), dirMutex(dirMutex),
+            fatMutex(fatMutex), currentInode(currentInode),
+            parentInode(parentInode), first(true), unfinished(false)
     {
         //Make sure a closedir of an uninitialized dir won't do any damage
         dir.fs=0;
@@ -122,7 +124,8 @@ public:
     virtual ~Fat32Directory();
     
 private:
-    KernelMutex& mutex;  ///< Parent filesystem's mutex
+    KernelMutex& dirMutex; ///< Parent filesystem's directory tree mutex
+    KernelMutex& fatMutex; ///< Parent filesystem's FAT mutex
     DIR_ dir;          ///< Directory object
     FILINFO fi;        ///< Information on a file
     int currentInode;  ///< Inode of '.'
@@ -143,7 +146,7 @@ int Fat32Directory::getdents(void *dp, int len)
     char *buffer=begin;
     char *end=buffer+len;
     
-    Lock<KernelMutex> l(mutex);
+    Lock<KernelMutex> l(dirMutex);
     if(first)
     {
         first=false;
@@ -157,7 +160,12 @@ int Fat32Directory::getdents(void *dp, int len)
     }
     for(;;)
     {
-        if(int res=translateError(f_readdir(&dir,&fi))) return res;
+        FRESULT fr;
+        {
+            Lock<KernelMutex> l2(fatMutex);
+            fr=f_readdir(&dir,&fi);
+        }
+        if(int res=translateError(fr)) return res;
         if(fi.fname[0]=='\0')
         {
             addTerminatingEntry(&buffer,end);
@@ -175,7 +183,7 @@ int Fat32Directory::getdents(void *dp, int len)
 
 Fat32Directory::~Fat32Directory()
 {
-    Lock<KernelMutex> l(mutex);
+    Lock<KernelMutex> l(fatMutex);
     f_closedir(&dir);
 }
 
@@ -189,8 +197,11 @@ public:
      * Constructor
      * \param parent the filesystem to which this file belongs
      * \param flags file open flags
+     * \param fatMutex mutex to lock when calling into FatFs, except for
+     * f_read() and f_write() that lock it internally
      */
-    Fat32File(intrusive_ref_ptr<FilesystemBase> parent, int flags, KernelMutex& mutex);
+    Fat32File(intrusive_ref_ptr<FilesystemBase> parent, int flags,
+            KernelMutex& fatMutex);
     
     /**
      * Write data to the file, if the file supports writing.
@@ -220,6 +231,46 @@ public:
      */
     virtual off_t lseek(off_t pos, int whence);
 
+    /**
+     * Read data from the given position without moving the file pointer.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \param pos offset from the beginning of the file
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t pread(void *data, size_t len, off_t pos);
+
+    /**
+     * Write data at the given position without moving the file pointer.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \param pos offset from the beginning of the file
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t pwrite(const void *data, size_t len, off_t pos);
+
+    /**
+     * Read data into multiple buffers, atomically with respect to other
+     * operations on the same file.
+     * \param iov array of buffers
+     * \param iovcnt number of buffers
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t readv(const struct iovec *iov, int iovcnt);
+
+    /**
+     * Write data from multiple buffers, atomically with respect to other
+     * operations on the same file.
+     * \param iov array of buffers
+     * \param iovcnt number of buffers
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t writev(const struct iovec *iov, int iovcnt);
+
     /**
      * Truncate the file
      * \param size new file size
@@ -259,7 +310,8 @@ public:
     
 private:
     FIL file;
-    KernelMutex& mutex;
+    KernelMutex mutex; ///< Protects the file state, recursive
+    KernelMutex& fatMutex; ///< Parent filesystem's FAT mutex
     int inode=0;
     /// Used to map FatFs behavior into POSIX. Variable is 0 as long as we seek
     /// within, contains by how many bytes we seeked past the end otherwise
@@ -270,8 +322,9 @@ private:
 // class Fat32File
 //
 
-Fat32File::Fat32File(intrusive_ref_ptr<FilesystemBase> parent, int flags, KernelMutex& mutex)
-        : FileBase(parent,flags), mutex(mutex) {}
+Fat32File::Fat32File(intrusive_ref_ptr<FilesystemBase> parent, int flags,
+        KernelMutex& fatMutex) : FileBase(parent,flags),
+        mutex(MutexOptions::RECURSIVE), fatMutex(fatMutex) {}
 
 ssize_t Fat32File::write(const void *data, size_t len)
 {
@@ -301,6 +354,7 @@ ssize_t Fat32File::write(const void *data, size_t len)
     }
     if(int res=translateError(f_write(&file,data,len,&bytesWritten))) return res;
     #ifdef SYNC_AFTER_WRITE
+    Lock<KernelMutex> l2(fatMutex);
     if(f_sync(&file)!=FR_OK) return -EIO;
     #endif //SYNC_AFTER_WRITE    
     return static_cast<int>(bytesWritten);
@@ -349,11 +403,39 @@ off_t Fat32File::lseek(off_t pos, int whence)
         seekPastEnd=offset-fileSize;
         offset=fileSize;
     } else seekPastEnd=0;
+    Lock<KernelMutex> l2(fatMutex);
     if(int result=translateError(
         f_lseek(&file,static_cast<unsigned long>(offset)))) return result;
     return offset+seekPastEnd;
 }
 
+//The mutex is recursive, so holding it across the base class implementations
+//makes seeking and restoring the file pointer atomic
+
+ssize_t Fat32File::pread(void *data, size_t len, off_t pos)
+{
+    Lock<KernelMutex> l(mutex);
+    return FileBase::pread(data,len,pos);
+}
+
+ssize_t Fat32File::pwrite(const void *data, size_t len, off_t pos)
+{
+    Lock<KernelMutex> l(mutex);
+    return FileBase::pwrite(data,len,pos);
+}
+
+ssize_t Fat32File::readv(const struct iovec *iov, int iovcnt)
+{
+    Lock<KernelMutex> l(mutex);
+    return FileBase::readv(iov,iovcnt);
+}
+
+ssize_t Fat32File::writev(const struct iovec *iov, int iovcnt)
+{
+    Lock<KernelMutex> l(mutex);
+    return FileBase::writev(iov,iovcnt);
+}
+
 int Fat32File::ftruncate(off_t size)
 {
     Lock<KernelMutex> l(mutex);
@@ -365,6 +447,7 @@ int Fat32File::ftruncate(off_t size)
     if(size<fileSize)
     {
         //Shrinking, FatFs f_truncate truncates to the current file position
+        Lock<KernelMutex> l2(fatMutex);
         int r=translateError(f_lseek(&file,static_cast<unsigned long>(size)));
         if(r) return r;
         result=translateError(f_truncate(&file));
@@ -397,12 +480,13 @@ int Fat32File::ioctl(int cmd, void *arg)
 {
     if(cmd!=IOCTL_SYNC) return -ENOTTY;
     Lock<KernelMutex> l(mutex);
+    Lock<KernelMutex> l2(fatMutex);
     return translateError(f_sync(&file));
 }
 
 Fat32File::~Fat32File()
 {
-    Lock<KernelMutex> l(mutex);
+    Lock<KernelMutex> l(fatMutex);
     if(inode) f_close(&file); //TODO: what to do with error code?
 }
 
@@ -411,7 +495,7 @@ Fat32File::~Fat32File()
 //
 
 Fat32Fs::Fat32Fs(intrusive_ref_ptr<FileBase> disk)
-        : mutex(MutexOptions::RECURSIVE), failed(true)
+        : dirMutex(MutexOptions::RECURSIVE), failed(true)
 {
     filesystem.drv=disk;
     failed=f_mount(&filesystem,1,false)!=FR_OK;
@@ -429,6 +513,7 @@ int Fat32Fs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
     //      ok      |      ok      |    ok     | _FWRITE
     //      ok      |      ok      |    ok     | _FWRITE | _FCREAT
     
+    Lock<KernelMutex> l(dirMutex);
     struct stat st;
     bool statFailed=false;
     if(int result=lstat(name,&st))
@@ -449,10 +534,14 @@ int Fat32Fs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
         else if(flags & _FCREAT) openflags|=FA_OPEN_ALWAYS;//If !exists create
         else openflags|=FA_OPEN_EXISTING;//If not exists fail
 
-        intrusive_ref_ptr<Fat32File> f(new Fat32File(shared_from_this(),flags-1,mutex));
-        Lock<KernelMutex> l(mutex);
-        if(int res=translateError(f_open(&filesystem,f->fil(),name.c_str(),openflags)))
-            return res;
+        intrusive_ref_ptr<Fat32File> f(new Fat32File(shared_from_this(),flags-1,
+            filesystem.fatMutex));
+        FRESULT fr;
+        {
+            Lock<KernelMutex> l2(filesystem.fatMutex);
+            fr=f_open(&filesystem,f->fil(),name.c_str(),openflags);
+        }
+        if(int res=translateError(fr)) return res;
         if(statFailed)
         {
             //If we didn't stat before, stat now to get the inode
@@ -460,6 +549,7 @@ int Fat32Fs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
         }
         f->setInode(st.st_ino);
 
+        Lock<KernelMutex> l2(filesystem.fatMutex);
         #ifdef SYNC_AFTER_WRITE
         if(f_sync(f->fil())!=FR_OK) return -EFAULT;
         #endif //SYNC_AFTER_WRITE
@@ -487,10 +577,10 @@ int Fat32Fs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
         } else parentInode=parentFsMountpointInode; //Asked to list root dir
         
         
-        intrusive_ref_ptr<Fat32Directory> d(
-            new Fat32Directory(shared_from_this(),mutex,st.st_ino,parentInode));
+        intrusive_ref_ptr<Fat32Directory> d(new Fat32Directory(
+            shared_from_this(),dirMutex,filesystem.fatMutex,st.st_ino,parentInode));
          
-        Lock<KernelMutex> l(mutex);
+        Lock<KernelMutex> l2(filesystem.fatMutex);
         if(int res=translateError(f_opendir(&filesystem,d->directory(),name.c_str())))
             return res;
          
@@ -507,7 +597,6 @@ int Fat32Fs::lstat(StringPart& name, struct stat *pstat)
     pstat->st_nlink=1;
     pstat->st_blksize=512;
     
-    Lock<KernelMutex> l(mutex);
     if(name.empty())
     {
         //We are asked to stat the filesystem's root directory
@@ -519,7 +608,13 @@ int Fat32Fs::lstat(StringPart& name, struct stat *pstat)
     FILINFO info;
     info.lfname=0; //We're not interested in getting the lfname
     info.lfsize=0;
-    if(int result=translateError(f_stat(&filesystem,name.c_str(),&info))) return result;
+    FRESULT fr;
+    {
+        Lock<KernelMutex> l(dirMutex);
+        Lock<KernelMutex> l2(filesystem.fatMutex);
+        fr=f_stat(&filesystem,name.c_str(),&info);
+    }
+    if(int result=translateError(fr)) return result;
     
     pstat->st_ino=info.inode;
     pstat->st_mode=(info.fattrib & AM_DIR) ?
@@ -546,14 +641,16 @@ int Fat32Fs::unlink(StringPart& name)
 int Fat32Fs::rename(StringPart& oldName, StringPart& newName)
 {
     if(failed) return -ENOENT;
-    Lock<KernelMutex> l(mutex);
+    Lock<KernelMutex> l(dirMutex);
+    Lock<KernelMutex> l2(filesystem.fatMutex);
     return translateError(f_rename(&filesystem,oldName.c_str(),newName.c_str()));
 }
 
 int Fat32Fs::mkdir(StringPart& name, int mode)
 {
     if(failed) return -ENOENT;
-    Lock<KernelMutex> l(mutex);
+    Lock<KernelMutex> l(dirMutex);
+    Lock<KernelMutex> l2(filesystem.fatMutex);
     return translateError(f_mkdir(&filesystem,name.c_str()));
 }
 
@@ -573,13 +670,14 @@ Fat32Fs::~Fat32Fs()
 int Fat32Fs::unlinkRmdirHelper(StringPart& name, bool delDir)
 {
     if(failed) return -ENOENT;
-    Lock<KernelMutex> l(mutex);
+    Lock<KernelMutex> l(dirMutex);
     struct stat st;
     if(int result=lstat(name,&st)) return result;
     if(delDir)
     {
         if(!S_ISDIR(st.st_mode)) return -ENOTDIR;
     } else if(S_ISDIR(st.st_mode)) return -EISDIR;
+    Lock<KernelMutex> l2(filesystem.fatMutex);
     return translateError(f_unlink(&filesystem,name.c_str()));
 }
 
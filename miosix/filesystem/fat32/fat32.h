@@ -121,8 +121,8 @@ private:
     
     int unlinkRmdirHelper(StringPart& name, bool delDir);
     
-    FATFS filesystem;
-    KernelMutex mutex;
+    FATFS filesystem; ///< Also contains the mutex protecting the FAT
+    KernelMutex dirMutex; ///< Serializes operations on the directory tree
     bool failed; ///< Failed to mount
 };
 
@@ -114,6 +114,7 @@
 #include <stdlib.h>
 #include <util/unicode.h>
 #include <interfaces/atomic_ops.h>
+#include <filesystem/dentry_cache.h>
 #include "miosix_settings.h"
 
 #ifdef WITH_FILESYSTEM
@@ -179,6 +180,14 @@
 
 #define	ABORT(fs, res)		{ fp->err = (BYTE)(res); LEAVE_FF(fs, res); }
 
+/* Added by TFT: f_read() and f_write() lock fs->fatMutex only while following
+   or stretching the cluster chain, so that data transfers to different files
+   can proceed concurrently. All other functions expect the caller to hold the
+   lock. This requires file data not to go through the shared win[] */
+#if _FS_TINY
+#error _FS_TINY is not supported as file data would go through win[].
+#endif
+
 
 
 
@@ -986,6 +995,127 @@ FRESULT put_fat (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Free cluster map                                       */
+/*-----------------------------------------------------------------------*/
+
+// Free cluster map -- begin
+//
+// On large volumes create_chain() may need to read a lot of FAT sectors to find
+// a free cluster, especially when the volume is nearly full and the FSINFO
+// next free hint is stale. To speed this up a bitmap is kept in RAM, where each
+// bit stands for a group of 1<<fcmap_shift consecutive clusters. A cleared bit
+// means the group is known to be full, so its FAT sectors need not be read.
+// A set bit means the group may contain free clusters. The group size is chosen
+// so that the bitmap fits in FATFS_FREE_CLUSTER_MAP_SIZE bytes.
+// The map is either built lazily, by starting with all bits set and clearing
+// them as full groups are found, or at mount time scanning the whole FAT.
+#if !_FS_READONLY
+
+#define FCMAP_GRP(fs, clst) (((clst) - 2) >> (fs)->fcmap_shift)
+
+static
+void fcmap_set (	/* Mark the group of a cluster as possibly having free clusters */
+	FATFS* fs,		/* File system object */
+	DWORD clst		/* Cluster# that has been freed */
+)
+{
+	DWORD g;
+
+	if (!fs->fcmap || clst < 2 || clst >= fs->n_fatent) return;
+	g = FCMAP_GRP(fs, clst);
+	fs->fcmap[g / 32] |= 1UL << (g % 32);
+}
+
+static
+void fcmap_free (
+	FATFS* fs		/* File system object */
+)
+{
+	free(fs->fcmap);
+	fs->fcmap = 0;
+}
+
+static
+void fcmap_init (
+	FATFS* fs		/* File system object, must be already mounted */
+)
+{
+	DWORD nclst, nw, clst, stat, n;
+	BYTE shift;
+
+	fcmap_free(fs);
+	if (miosix::FATFS_FREE_CLUSTER_MAP_SIZE == 0) return;
+	nclst = fs->n_fatent - 2;
+	for (shift = 0; ((nclst + (1UL << shift) - 1) >> shift) > miosix::FATFS_FREE_CLUSTER_MAP_SIZE * 8; shift++) ;
+	fs->fcmap_shift = shift;
+	fs->fcmap_ngrp = (nclst + (1UL << shift) - 1) >> shift;
+	nw = (fs->fcmap_ngrp + 31) / 32;
+	fs->fcmap = (DWORD*)malloc(nw * 4);
+	if (!fs->fcmap) return;		/* Not enough memory, work without the map */
+	if (!miosix::FATFS_FREE_CLUSTER_MAP_SCAN_AT_MOUNT) {
+		mem_set(fs->fcmap, 0xFF, nw * 4);	/* Lazy, any group may have free clusters */
+		return;
+	}
+	mem_set(fs->fcmap, 0, nw * 4);
+	n = 0;
+	for (clst = 2; clst < fs->n_fatent; clst++) {
+		stat = get_fat(fs, clst);
+		if (stat == 0xFFFFFFFF || stat == 1) {	/* Error, work without the map */
+			fcmap_free(fs);
+			return;
+		}
+		if (stat == 0) {
+			fcmap_set(fs, clst);
+			n++;
+		}
+	}
+	if (fs->free_clust != n) {	/* The FSINFO free cluster count was stale */
+		fs->free_clust = n;
+		if (!(fs->fsi_flag & 0x80)) fs->fsi_flag |= 1;
+	}
+}
+
+static
+DWORD fcmap_find (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk error, >=2:Free cluster# */
+	FATFS* fs,		/* File system object */
+	DWORD scl		/* The search starts from the cluster after this one */
+)
+{
+	DWORD i, g, clst, ecl, cs, gsz = 1UL << fs->fcmap_shift;
+	int full;
+
+	if (scl < 2 || scl >= fs->n_fatent) scl = fs->n_fatent - 1;
+	for (i = 0; i <= fs->fcmap_ngrp; i++) {
+		g = (FCMAP_GRP(fs, scl) + i) % fs->fcmap_ngrp;
+		if (!((fs->fcmap[g / 32] >> (g % 32)) & 1)) continue;	/* Group known to be full */
+		clst = g * gsz + 2;
+		ecl = clst + gsz;
+		if (ecl > fs->n_fatent) ecl = fs->n_fatent;
+		full = 1;
+		if (i == 0) {					/* First visit to the start group, scan after scl */
+			clst = scl + 1;
+			full = 0;
+		} else if (i == fs->fcmap_ngrp) {	/* Wrapped around, scan up to scl */
+			ecl = scl + 1;
+			full = 0;
+		}
+		for (; clst < ecl; clst++) {
+			cs = get_fat(fs, clst);
+			if (cs == 0) return clst;
+			if (cs == 0xFFFFFFFF || cs == 1) return cs;
+		}
+		if (full) fs->fcmap[g / 32] &= ~(1UL << (g % 32));
+	}
+	return 0;
+}
+
+#endif /* !_FS_READONLY */
+// Free cluster map -- end
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* FAT handling - Remove a cluster chain                                 */
 /*-----------------------------------------------------------------------*/
@@ -1014,6 +1144,7 @@ FRESULT remove_chain (
 			if (nxt == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }	/* Disk error? */
 			res = put_fat(fs, clst, 0);			/* Mark the cluster "empty" */
 			if (res != FR_OK) break;
+			fcmap_set(fs, clst);
 			if (fs->free_clust != 0xFFFFFFFF) {	/* Update FSINFO */
 				fs->free_clust++;
 				fs->fsi_flag |= 1;
@@ -1064,6 +1195,10 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 		scl = clst;
 	}
 
+	if (fs->fcmap) {		/* Skip groups known to be full */
+		ncl = fcmap_find(fs, scl);
+		if (ncl == 0 || ncl == 1 || ncl == 0xFFFFFFFF) return ncl;
+	} else {
 	ncl = scl;				/* Start cluster */
 	for (;;) {
 		ncl++;							/* Next cluster */
@@ -1077,6 +1212,7 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 			return cs;
 		if (ncl == scl) return 0;		/* No free cluster */
 	}
+	}
 
 	res = put_fat(fs, ncl, 0x0FFFFFFF);	/* Mark the new cluster "last link" */
 	if (res == FR_OK && clst != 0) {
@@ -1549,6 +1685,61 @@ FRESULT dir_find (
 
 
 
+// Added by TFT -- begin
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Find an object using the dentry cache            */
+/*-----------------------------------------------------------------------*/
+/* Positive entries store the index of the SFN entry and of the top of the
+   LFN entries, and the attribute of the object, negative entries store that
+   the name does not exist. Entries are keyed by the start cluster of the
+   directory and by the path segment, so they are invalidated whenever the
+   directory is modified, as different segments may match the same object */
+
+static
+FRESULT dir_find_cached (
+	DIR_* dp,			/* Pointer to the directory object linked to the file name */
+	const char* seg,	/* Path segment from which the file name was created */
+	UINT len			/* Length of the path segment */
+)
+{
+	FRESULT res;
+	miosix::DentryData d;
+	miosix::DentryCache& cache = miosix::DentryCache::instance();
+	DWORD parent = dp->sclust;
+	int r;
+
+	r = cache.lookup(dp->fs, parent, seg, len, d);
+	if (r < 0) return FR_NO_FILE;
+	if (r > 0) {
+		res = dir_sdi(dp, (WORD)(d.inode & 0xFFFF));
+		if (res == FR_OK) res = move_window(dp->fs, dp->sect);
+		if (res != FR_OK) return res;
+		if (dp->dir[DIR_Name] != 0 && dp->dir[DIR_Name] != DDE && dp->dir[DIR_Attr] == d.info) {
+#if _USE_LFN
+			dp->lfn_idx = (WORD)(d.inode >> 16);
+#endif
+			return FR_OK;
+		}
+		cache.invalidateDirectory(dp->fs, parent);	/* Stale entry, should not happen */
+	}
+	res = dir_find(dp);
+	if (res == FR_OK) {
+		d.inode = dp->index;
+#if _USE_LFN
+		d.inode |= (DWORD)dp->lfn_idx << 16;
+#endif
+		d.info = dp->dir[DIR_Attr];
+		cache.insert(dp->fs, parent, seg, len, d);
+	} else if (res == FR_NO_FILE) {
+		cache.insertNegative(dp->fs, parent, seg, len);
+	}
+	return res;
+}
+// Added by TFT -- end
+
+
+
+
 
 /*-----------------------------------------------------------------------*/
 /* Read an object from the directory                                     */
@@ -1631,6 +1822,8 @@ FRESULT dir_register (	/* FR_OK:Successful, FR_DENIED:No free entry or too many
 	if (_FS_RPATH && (sn[NS] & NS_DOT))		/* Cannot create dot entry */
 		return FR_INVALID_NAME;
 
+	miosix::DentryCache::instance().invalidateDirectory(dp->fs, dp->sclust);	/* Added by TFT */
+
 	if (sn[NS] & NS_LOSS) {			/* When LFN is out of 8.3 format, generate a numbered name */
 		fn[NS] = 0; dp->lfn = 0;			/* Find only SFN */
 		for (n = 1; n < 100; n++) {
@@ -1665,6 +1858,7 @@ FRESULT dir_register (	/* FR_OK:Successful, FR_DENIED:No free entry or too many
 		}
 	}
 #else	/* Non LFN configuration */
+	miosix::DentryCache::instance().invalidateDirectory(dp->fs, dp->sclust);	/* Added by TFT */
 	res = dir_alloc(dp, 1);		/* Allocate an entry for SFN */
 #endif
 
@@ -1700,6 +1894,7 @@ FRESULT dir_remove (	/* FR_OK: Successful, FR_DISK_ERR: A disk error */
 #if _USE_LFN	/* LFN configuration */
 	WORD i;
 
+	miosix::DentryCache::instance().invalidateDirectory(dp->fs, dp->sclust);	/* Added by TFT */
 	i = dp->index;	/* SFN index */
 	res = dir_sdi(dp, (WORD)((dp->lfn_idx == 0xFFFF) ? i : dp->lfn_idx));	/* Goto the SFN or top of the LFN entries */
 	if (res == FR_OK) {
@@ -1715,6 +1910,7 @@ FRESULT dir_remove (	/* FR_OK: Successful, FR_DISK_ERR: A disk error */
 	}
 
 #else			/* Non LFN configuration */
+	miosix::DentryCache::instance().invalidateDirectory(dp->fs, dp->sclust);	/* Added by TFT */
 	res = dir_sdi(dp, dp->index);
 	if (res == FR_OK) {
 		res = move_window(dp->fs, dp->sect);
@@ -2084,6 +2280,7 @@ FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 {
 	FRESULT res;
 	BYTE *dir, ns;
+	const char *seg;
 
 
 #if _FS_RPATH
@@ -2103,9 +2300,11 @@ FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 		dp->dir = 0;
 	} else {								/* Follow path */
 		for (;;) {
+			seg = path;
+			while (*seg == '/' || *seg == '\\') seg++;
 			res = create_name(dp, &path);	/* Get a segment name of the path */
 			if (res != FR_OK) break;
-			res = dir_find(dp);				/* Find an object with the sagment name */
+			res = dir_find_cached(dp, seg, (UINT)(path - seg));	/* Find an object with the sagment name */
 			ns = dp->fn[NS];
 			if (res != FR_OK) {				/* Failed to find the object */
 				if (res == FR_NO_FILE) {	/* Object is not found */
@@ -2317,6 +2516,9 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 #endif
 	fs->fs_type = fmt;	/* FAT sub-type */
 	fs->id = miosix::atomicAddExchange(&Fsid,1)/*++Fsid*/;	/* File system mount ID */
+#if !_FS_READONLY
+	fcmap_init(fs);		/* Needs fs_type to be set */
+#endif
 #if _FS_RPATH
 	fs->cdir = 0;		/* Current directory (root dir) */
 #endif
@@ -2392,11 +2594,19 @@ FRESULT f_mount (
 		if (!ff_del_syncobj(cfs->sobj)) return FR_INT_ERR;
 #endif
 		cfs->fs_type = 0;				/* Clear old fs object */
+#if !_FS_READONLY
+		fcmap_free(cfs);
+#endif
+		miosix::DentryCache::instance().invalidateFilesystem(cfs);	/* Added by TFT */
 	}
 
 	if (/*fs*/!umount) {
 		fs->fs_type = 0;				/* Clear new fs object */
         memset(fs->Files,0,sizeof(FATFS::Files));
+#if !_FS_READONLY
+		fs->fcmap = 0;
+#endif
+		miosix::DentryCache::instance().invalidateFilesystem(fs);	/* Added by TFT */
 #if _FS_REENTRANT						/* Create sync object for the new volume */
 		if (!ff_cre_syncobj(vol, &fs->sobj)) return FR_INT_ERR;
 #endif
@@ -2590,7 +2800,10 @@ FRESULT f_read (
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
 					else
 #endif
+					{
+						miosix::Lock<miosix::KernelMutex> l(fp->fs->fatMutex);
 						clst = get_fat(fp->fs, fp->clust);	/* Follow cluster chain on the FAT */
+					}
 				}
 				if (clst < 2) ABORT(fp->fs, FR_INT_ERR);
 				if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
@@ -2685,15 +2898,20 @@ FRESULT f_write (
 			if (!csect) {					/* On the cluster boundary? */
 				if (fp->fptr == 0) {		/* On the top of the file? */
 					clst = fp->sclust;		/* Follow from the origin */
-					if (clst == 0)			/* When no cluster is allocated, */
+					if (clst == 0) {		/* When no cluster is allocated, */
+						miosix::Lock<miosix::KernelMutex> l(fp->fs->fatMutex);
 						fp->sclust = clst = create_chain(fp->fs, 0);	/* Create a new cluster chain */
+					}
 				} else {					/* Middle or end of the file */
 #if _USE_FASTSEEK
 					if (fp->cltbl)
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
 					else
 #endif
+					{
+						miosix::Lock<miosix::KernelMutex> l(fp->fs->fatMutex);
 						clst = create_chain(fp->fs, fp->clust);	/* Follow or stretch cluster chain on the FAT */
+					}
 				}
 				if (clst == 0) break;		/* Could not allocate a new cluster (disk full) */
 				if (clst == 1) ABORT(fp->fs, FR_INT_ERR);
@@ -3501,6 +3719,8 @@ FRESULT f_unlink (
 						) res = FR_DENIED;
 						if (res == FR_NO_FILE) res = FR_OK;	/* Empty */
 					}
+					if (res == FR_OK)		/* Added by TFT: forget the removed directory's entries */
+						miosix::DentryCache::instance().invalidateDirectory(dj.fs, dclst);
 				}
 			}
 			if (res == FR_OK) {
@@ -36,6 +36,7 @@
 //#endif
 
 #include <filesystem/file.h>
+#include <kernel/sync.h>
 #include "miosix_settings.h"
 
 #include "integer.h"	/* Basic integer types */
@@ -125,6 +126,9 @@ struct FATFS {
 #if !_FS_READONLY
 	DWORD	last_clust;		/* Last allocated cluster */
 	DWORD	free_clust;		/* Number of free clusters */
+	DWORD*	fcmap;			/* Free cluster map, a set bit means the group may have free clusters (NULL:disabled) */
+	DWORD	fcmap_ngrp;		/* Number of cluster groups (bits) in fcmap */
+	BYTE	fcmap_shift;	/* Clusters per group is 1<<fcmap_shift */
 #endif
 #if _FS_RPATH
 	DWORD	cdir;			/* Current directory start cluster (0:root) */
@@ -144,6 +148,7 @@ struct FATFS {
     FILESEM	Files[miosix::FATFS_MAX_OPEN_FILES];/* Open object lock semaphores */
 #endif
     miosix::intrusive_ref_ptr<miosix::FileBase> drv; /* drive device */
+    miosix::KernelMutex fatMutex; /* Protects win[], the FAT and allocation state, lock table */
 };
 
 
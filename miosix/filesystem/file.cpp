@@ -30,6 +30,7 @@
 #include <string>
 #include <fcntl.h>
 #include "file_access.h"
+#include "poll_table.h"
 #include "miosix_settings.h"
 
 using namespace std;
@@ -77,6 +78,56 @@ int FileBase::ioctl(int cmd, void *arg)
     return -ENOTTY; //Means the operation does not apply to this descriptor
 }
 
+ssize_t FileBase::pread(void *data, size_t len, off_t pos)
+{
+    if(pos<0) return -EINVAL;
+    off_t saved=lseek(0,SEEK_CUR);
+    if(saved<0) return saved;
+    off_t result=lseek(pos,SEEK_SET);
+    if(result<0) return result;
+    ssize_t count=read(data,len);
+    lseek(saved,SEEK_SET);
+    return count;
+}
+
+ssize_t FileBase::pwrite(const void *data, size_t len, off_t pos)
+{
+    if(pos<0) return -EINVAL;
+    off_t saved=lseek(0,SEEK_CUR);
+    if(saved<0) return saved;
+    off_t result=lseek(pos,SEEK_SET);
+    if(result<0) return result;
+    ssize_t count=write(data,len);
+    lseek(saved,SEEK_SET);
+    return count;
+}
+
+ssize_t FileBase::readv(const struct iovec *iov, int iovcnt)
+{
+    ssize_t total=0;
+    for(int i=0;i<iovcnt;i++)
+    {
+        ssize_t result=read(iov[i].iov_base,iov[i].iov_len);
+        if(result<0) return total>0 ? total : result;
+        total+=result;
+        if(static_cast<size_t>(result)<iov[i].iov_len) break;
+    }
+    return total;
+}
+
+ssize_t FileBase::writev(const struct iovec *iov, int iovcnt)
+{
+    ssize_t total=0;
+    for(int i=0;i<iovcnt;i++)
+    {
+        ssize_t result=write(iov[i].iov_base,iov[i].iov_len);
+        if(result<0) return total>0 ? total : result;
+        total+=result;
+        if(static_cast<size_t>(result)<iov[i].iov_len) break;
+    }
+    return total;
+}
+
 int FileBase::getdents(void *dp, int len)
 {
     return -EBADF;
@@ -87,6 +138,11 @@ MemoryMappedFile FileBase::getFileFromMemory()
     return MemoryMappedFile(nullptr,0); //Not supported
 }
 
+int FileBase::poll(int events, PollTable& table)
+{
+    return events & (POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM);
+}
+
 //
 // class DirectoryBase
 //
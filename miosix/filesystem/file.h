@@ -33,11 +33,36 @@
 
 #pragma once
 
+//Compilers predating pipe resizing support lack these, keep in sync with
+//libc/sys/miosix/sys/fcntl.h in the newlib patch
+#ifndef F_SETPIPE_SZ
+#define F_SETPIPE_SZ 1031
+#define F_GETPIPE_SZ 1032
+#endif //F_SETPIPE_SZ
+
+#if __has_include(<sys/uio.h>)
+#include <sys/uio.h>
+#else //__has_include(<sys/uio.h>)
+
+//Compilers predating readv/writev support lack sys/uio.h, keep in sync with
+//libc/sys/miosix/sys/uio.h in the newlib patch
+
+struct iovec
+{
+    void *iov_base; ///< Start of the buffer
+    size_t iov_len; ///< Size of the buffer
+};
+
+#define IOV_MAX 16
+
+#endif //__has_include(<sys/uio.h>)
+
 namespace miosix {
 
 // Forward decls
 class FilesystemBase;
 class StringPart;
+class PollTable;
 
 /**
  * Return value of FileBase::getFileFromMemory()
@@ -51,8 +76,14 @@ struct MemoryMappedFile
      * Constructor
      * \param data pointer to first byte of file content
      * \param size file size in bytes
-     */
-    MemoryMappedFile(const void *data, unsigned int size) : data(data), size(size) {}
+     * \param writable true if the file content can be modified through memory
+     * \param sharedMemory true if the file is a shared memory object in RAM,
+     * false if it is stored in an XIP filesystem
+     */
+    MemoryMappedFile(const void *data, unsigned int size, bool writable=false,
+                     bool sharedMemory=false)
+        : data(data), size(size), writable(writable),
+          sharedMemory(sharedMemory) {}
 
     /**
      * \return true if the object refers to a valid file
@@ -61,6 +92,8 @@ struct MemoryMappedFile
 
     const void *data;  ///< Pointer to first byte of file content
     unsigned int size; ///< File size in bytes
+    bool writable;     ///< File content can be modified through memory
+    bool sharedMemory; ///< File is a shared memory object
 };
 
 /**
@@ -125,6 +158,52 @@ public:
      * completed, or a negative number in case of errors
      */
     virtual off_t lseek(off_t pos, int whence)=0;
+
+    /**
+     * Read data from the given position without moving the file pointer.
+     * The default implementation saves the file pointer, seeks and restores
+     * it, so it is not atomic with respect to other threads accessing the
+     * same file. Files that can do better should override it.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \param pos offset from the beginning of the file
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t pread(void *data, size_t len, off_t pos);
+
+    /**
+     * Write data at the given position without moving the file pointer.
+     * The default implementation saves the file pointer, seeks and restores
+     * it, so it is not atomic with respect to other threads accessing the
+     * same file. Files that can do better should override it.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \param pos offset from the beginning of the file
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t pwrite(const void *data, size_t len, off_t pos);
+
+    /**
+     * Read data into multiple buffers. The default implementation calls read()
+     * for each buffer, stopping at the first short read
+     * \param iov array of buffers
+     * \param iovcnt number of buffers, at most IOV_MAX
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t readv(const struct iovec *iov, int iovcnt);
+
+    /**
+     * Write data from multiple buffers. The default implementation calls
+     * write() for each buffer, stopping at the first short write
+     * \param iov array of buffers
+     * \param iovcnt number of buffers, at most IOV_MAX
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    virtual ssize_t writev(const struct iovec *iov, int iovcnt);
     
     /**
      * Truncate the file
@@ -184,6 +263,19 @@ public:
      */
     virtual MemoryMappedFile getFileFromMemory();
 
+    /**
+     * Check whether the file is ready for reading and writing, used to
+     * implement poll(). Files whose readiness can change must also add the
+     * table to their PollQueue, and do so before checking their state, so that
+     * state changes after the check wake up the poller.
+     * \param events requested events (POLLIN, POLLOUT, ...)
+     * \param table poll table to add to the file's PollQueue
+     * \return the events that are ready, POLLERR and POLLHUP may be returned
+     * even if not requested. The default implementation reports the file as
+     * always readable and writable, as regular files are
+     */
+    virtual int poll(int events, PollTable& table);
+
     /**
      * \return a pointer to the parent filesystem
      */
@@ -396,7 +488,12 @@ public:
     
     /**
      * \return true if the filesystem supports symbolic links.
-     * In this case, the filesystem should override readlink
+     * In this case, the filesystem should override readlink.
+     * Path resolution caches the result of lstat on path components of these
+     * filesystems in the DentryCache, using the filesystem as owner and the
+     * inode of the directory (DentryCache::rootDir for the root directory) as
+     * parent, so filesystems that are not read-only must invalidate it when
+     * modifying a directory
      */
     virtual bool supportsSymlinks() const;
     
@@ -26,8 +26,11 @@
  ***************************************************************************/
 
 #include "file_access.h"
+#include "dentry_cache.h"
 #include <vector>
 #include <climits>
+#include <algorithm>
+#include <new>
 #include <fcntl.h>
 #include "console/console_device.h"
 #include "mountpointfs/mountpointfs.h"
@@ -35,9 +38,11 @@
 #include "fat32/fat32.h"
 #include "littlefs/lfs_miosix.h"
 #include "pipe/pipe.h"
+#include "procfs/procfs.h"
 #include "kernel/logging.h"
 #ifdef WITH_PROCESSES
 #include "kernel/process.h"
+#include "kernel/syscall_trace.h"
 #endif //WITH_PROCESSES
 
 using namespace std;
@@ -140,6 +145,13 @@ void FileDescriptorTable::closeAll()
         atomic_exchange(files+i,intrusive_ref_ptr<FileBase>());
 }
 
+int FileDescriptorTable::getOpenFileCount() const
+{
+    int result=0;
+    for(int i=0;i<MAX_OPEN_FILES;i++) if(getFile(i)) result++;
+    return result;
+}
+
 int FileDescriptorTable::fcntl(int fd, int cmd, int opt)
 {
     intrusive_ref_ptr<FileBase> file=getFile(fd);
@@ -304,14 +316,156 @@ int FileDescriptorTable::pipe(int fds[2])
         }
     }
     if(availableFds<2) return -EMFILE;
-    intrusive_ref_ptr<FileBase> pipe(new Pipe);
-    files[fds[0]]=pipe;
-    files[fds[1]]=pipe;
+    Pipe::create(files[fds[0]],files[fds[1]]);
     filesCloexec[fds[0]]=false;
     filesCloexec[fds[1]]=false;
     return 0;
 }
 
+int FileDescriptorTable::add(intrusive_ref_ptr<FileBase> file, int flags)
+{
+    Lock<KernelMutex> l(mutex);
+    int fd=getAvailableFd();
+    if(fd<0) return fd;
+    files[fd]=file;
+    filesCloexec[fd]=(flags & O_CLOEXEC)!=0;
+    return fd;
+}
+
+int FileDescriptorTable::poll(struct pollfd *fds, unsigned int nfds,
+        long long timeout)
+{
+    if(nfds>MAX_OPEN_FILES) return -EINVAL;
+    if(fds==nullptr && nfds>0) return -EFAULT;
+    long long absTime= timeout<0 ? -1 : getTime()+timeout;
+    //Hold a reference to the polled files so that their PollQueue can't be
+    //deleted by a concurrent close
+    intrusive_ref_ptr<FileBase> polled[MAX_OPEN_FILES];
+    for(unsigned int i=0;i<nfds;i++) polled[i]=getFile(fds[i].fd);
+    PollTable table(timeout!=0);
+    for(;;)
+    {
+        int result=0;
+        for(unsigned int i=0;i<nfds;i++)
+        {
+            fds[i].revents=0;
+            if(fds[i].fd<0) continue;
+            if(!polled[i]) fds[i].revents=POLLNVAL;
+            else {
+                int events=fds[i].events | POLLERR | POLLHUP;
+                fds[i].revents=polled[i]->poll(events,table) & events;
+            }
+            if(fds[i].revents) result++;
+        }
+        if(result>0 || timeout==0) return result;
+        if(absTime>=0 && getTime()>=absTime) return 0;
+        if(Thread::testTerminate()) return -EINTR;
+        table.wait(absTime);
+    }
+}
+
+ssize_t FileDescriptorTable::sendfile(int outFd, int inFd, off_t *offset,
+        size_t count)
+{
+    intrusive_ref_ptr<FileBase> out=getFile(outFd);
+    intrusive_ref_ptr<FileBase> in=getFile(inFd);
+    if(!out || !in) return -EBADF;
+    if(offset && *offset<0) return -EINVAL;
+    count=min<size_t>(count,SSIZE_MAX);
+    if(count==0) return 0;
+
+    MemoryMappedFile mm=in->getFileFromMemory();
+    if(mm.isValid())
+    {
+        //Zero copy, write directly from the file backing storage
+        off_t pos= offset ? *offset : in->lseek(0,SEEK_CUR);
+        if(pos<0) return pos;
+        if(pos>=static_cast<off_t>(mm.size)) return 0;
+        size_t len=min<size_t>(count,mm.size-pos);
+        ssize_t result=out->write(
+            reinterpret_cast<const char*>(mm.data)+pos,len);
+        if(result<=0) return result;
+        if(offset) *offset+=result;
+        else in->lseek(pos+result,SEEK_SET);
+        return result;
+    }
+
+    ssize_t total=0, error=0;
+    char *buffer=new (nothrow) char[SENDFILE_BUFFER_SIZE];
+    if(buffer==nullptr) error=-ENOMEM;
+    else while(count>0)
+    {
+        size_t chunk=min<size_t>(count,SENDFILE_BUFFER_SIZE);
+        ssize_t r= offset ? in->pread(buffer,chunk,*offset+total)
+                          : in->read(buffer,chunk);
+        if(r<=0)
+        {
+            error=r;
+            break;
+        }
+        ssize_t w=0;
+        while(w<r)
+        {
+            ssize_t result=out->write(buffer+w,r-w);
+            if(result<=0)
+            {
+                error=result;
+                break;
+            }
+            w+=result;
+        }
+        total+=w;
+        count-=w;
+        if(w<r)
+        {
+            //Give back the data that was read but not written, if possible
+            if(offset==nullptr) in->lseek(w-r,SEEK_CUR);
+            break;
+        }
+        //Short read, don't block waiting for more data from pipes and devices
+        if(r<static_cast<ssize_t>(chunk)) break;
+    }
+    delete[] buffer;
+    if(offset) *offset+=total;
+    return total>0 ? total : error;
+}
+
+/**
+ * \param iov array of buffers
+ * \param iovcnt number of buffers
+ * \return 0 if the buffers are valid for readv/writev, a negative number if not
+ */
+static int validateIovec(const struct iovec *iov, int iovcnt)
+{
+    if(iovcnt<=0 || iovcnt>IOV_MAX) return -EINVAL;
+    if(iov==nullptr) return -EFAULT;
+    size_t total=0;
+    for(int i=0;i<iovcnt;i++)
+    {
+        if(iov[i].iov_base==nullptr && iov[i].iov_len>0) return -EFAULT;
+        //The total length has to fit in the signed return value
+        total+=iov[i].iov_len;
+        if(static_cast<ssize_t>(total)<0 || total<iov[i].iov_len) return -EINVAL;
+    }
+    return 0;
+}
+
+ssize_t FileDescriptorTable::writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    if(int result=validateIovec(iov,iovcnt)) return result;
+    intrusive_ref_ptr<FileBase> file=getFile(fd);
+    if(!file) return -EBADF;
+    return file->writev(iov,iovcnt);
+}
+
+ssize_t FileDescriptorTable::readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    if(int result=validateIovec(iov,iovcnt)) return result;
+    intrusive_ref_ptr<FileBase> file=getFile(fd);
+    if(!file) return -EBADF;
+    return file->readv(iov,iovcnt);
+}
+
 int FileDescriptorTable::statImpl(const char* name, struct stat* pstat, bool f)
 {
     if(name==0 || name[0]=='\0' || pstat==0) return -EFAULT;
@@ -392,6 +546,24 @@ private:
      * \return 0 on success, a negative number on failure
      */
     int followSymlink(string& path);
+
+    /**
+     * Lookup the current path component, using the dentry cache if possible
+     * \param path path string. The relative path into the current filesystem
+     * ends with the component to lookup
+     * \param data the inode and mode of the component are stored here
+     * \return 0 on success, a negative number on failure
+     */
+    int lookupComponent(string& path, DentryData& data);
+
+    /**
+     * Called when entering the root directory of a filesystem
+     */
+    void atFsRoot()
+    {
+        parentKnown=true;
+        parentInode=DentryCache::rootDir;
+    }
     
     /**
      * Find to which filesystem this path belongs
@@ -423,6 +595,14 @@ private:
     
     /// How many symlinks we've found so far
     int linksFollowed;
+
+    /// Inode of the directory containing the next path component, used as key
+    /// for the dentry cache. Valid only if parentKnown is true
+    unsigned int parentInode;
+
+    /// False if the inode of the current directory is not known, as happens
+    /// after a /../ in the path
+    bool parentKnown;
     
     /// Maximum number of symbolic links to follow (to avoid endless loops)
     static const int maxLinkToFollow=2;
@@ -439,6 +619,7 @@ ResolvedPath PathResolution::resolvePath(string& path, bool followLastSymlink)
     indexIntoFs=1; //NOTE: caller must ensure path[0]=='/'
     depthIntoFs=1;
     linksFollowed=0;
+    atFsRoot();
     for(;;)
     {
         size_t slash=path.find_first_of('/',index);
@@ -491,7 +672,11 @@ int PathResolution::upPathComponent(string& path, size_t slash)
     if(path.empty()) path='/';
     //This may happen if the new last path component is a fs, e.g. "/dev/null/.."
     if(indexIntoFs>path.length()) indexIntoFs=path.length();
-    if(--depthIntoFs>0) return 0;
+    if(--depthIntoFs>0)
+    {
+        if(depthIntoFs==1) atFsRoot(); else parentKnown=false;
+        return 0;
+    }
     
     //Depth went to zero, escape current filesystem
     return recursiveFindFs(path);
@@ -510,19 +695,18 @@ int PathResolution::normalPathComponent(string& path, bool followIfSymlink)
         syms=fs->supportsSymlinks();
         indexIntoFs=index>path.length() ? index-1 : index;
         depthIntoFs=1;
+        atFsRoot();
         return 0;
     }
     depthIntoFs++;
     if(syms && followIfSymlink)
     {
-        struct stat st;
-        {
-            StringPart sp(path,index-1,indexIntoFs);
-            if(int res=fs->lstat(sp,&st)<0) return res;
-        }
-        if(S_ISLNK(st.st_mode)) return followSymlink(path);
-        else if(index<=path.length() && !S_ISDIR(st.st_mode)) return -ENOTDIR;
-    }
+        DentryData data;
+        if(int res=lookupComponent(path,data)) return res;
+        if(S_ISLNK(data.info)) return followSymlink(path);
+        else if(index<=path.length() && !S_ISDIR(data.info)) return -ENOTDIR;
+        parentInode=data.inode;
+    } else parentKnown=false;
     return 0;
 }
 
@@ -551,6 +735,7 @@ int PathResolution::followSymlink(string& path)
         index=1;
         indexIntoFs=1;
         depthIntoFs=1;
+        atFsRoot();
     } else {
         //Symlink is relative
         size_t removeStart=path.find_last_of('/',index-2);
@@ -563,12 +748,41 @@ int PathResolution::followSymlink(string& path)
         if(index<=path.length())
             newPath.insert(newPath.length(),path,index-1,string::npos);
         path.swap(newPath);
+        //The parent directory does not change, so parentInode is still valid
         index=removeStart+1;
         depthIntoFs--;
     }
     return 0;
 }
 
+int PathResolution::lookupComponent(string& path, DentryData& data)
+{
+    //The component is path.substr(start,index-1-start)
+    size_t start=path.find_last_of('/',index-2)+1;
+    unsigned int len=index-1-start;
+    DentryCache& cache=DentryCache::instance();
+    if(parentKnown)
+    {
+        int res=cache.lookup(fs.get(),parentInode,path.data()+start,len,data);
+        if(res>0) return 0;
+        if(res<0) return res;
+    }
+    struct stat st;
+    int res;
+    {
+        StringPart sp(path,index-1,indexIntoFs);
+        res=fs->lstat(sp,&st);
+    }
+    if(res==-ENOENT && parentKnown)
+        cache.insertNegative(fs.get(),parentInode,path.data()+start,len);
+    if(res<0) return res;
+    data.inode=st.st_ino;
+    data.info=st.st_mode;
+    if(parentKnown)
+        cache.insert(fs.get(),parentInode,path.data()+start,len,data);
+    return 0;
+}
+
 int PathResolution::recursiveFindFs(string& path)
 {
     depthIntoFs=1;
@@ -594,6 +808,7 @@ int PathResolution::recursiveFindFs(string& path)
         depthIntoFs++;
     }
     syms=fs->supportsSymlinks();
+    if(depthIntoFs==1) atFsRoot(); else parentKnown=false;
     return 0;
 }
 
@@ -714,7 +929,10 @@ int FilesystemManager::umount(const char* path, bool force)
     
     //It is now safe to umount all filesystems
     for(it5=fsToUmount.begin();it5!=fsToUmount.end();++it5)
+    {
+        DentryCache::instance().invalidateFilesystem((*it5)->second.get());
         filesystems.erase(*it5);
+    }
     return 0;
 }
 
@@ -727,6 +945,8 @@ void FilesystemManager::umountAll()
     #else //WITH_PROCESSES
     getFileDescriptorTable().closeAll();
     #endif //WITH_PROCESSES
+    for(auto& it : filesystems)
+        DentryCache::instance().invalidateFilesystem(it.second.get());
     filesystems.clear();
 }
 
@@ -861,6 +1081,10 @@ basicFilesystemSetup(intrusive_ref_ptr<Device> dev)
     bootlog(devFsOk ? "Ok\n" : "Failed\n");
     if(!devFsOk) return devfs;
     fsm.setDevFs(devfs);
+    #ifdef WITH_SYSCALL_TRACE
+    devfs->addDevice("strace",
+        intrusive_ref_ptr<Device>(new SyscallTraceDevice));
+    #endif //WITH_SYSCALL_TRACE
     #endif //WITH_DEVFS
 
     #ifdef WITH_ROMFS
@@ -882,6 +1106,20 @@ basicFilesystemSetup(intrusive_ref_ptr<Device> dev)
     }
     #endif //WITH_ROMFS
 
+    #ifdef WITH_PROCFS
+    {
+        bootlog("Mounting ProcFs as /proc ... ");
+        StringPart sp("proc");
+        bool ok=false;
+        if(rootFs->mkdir(sp,0755)==0)
+        {
+            intrusive_ref_ptr<ProcFs> proc(new ProcFs);
+            if(fsm.kmount("/proc",proc)==0) ok=true;
+        }
+        bootlog(ok ? "Ok\n" : "Failed\n");
+    }
+    #endif //WITH_PROCFS
+
     if(dev)
     {
         #ifdef WITH_DEVFS
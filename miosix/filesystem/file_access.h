@@ -34,6 +34,7 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include "file.h"
+#include "poll_table.h"
 #include "stringpart.h"
 #include "devfs/devfs.h"
 #include "kernel/sync.h"
@@ -167,6 +168,58 @@ public:
         if(!file) return -EBADF;
         return file->read(data,len);
     }
+
+    /**
+     * Write data at the given position without moving the file pointer.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \param pos offset from the beginning of the file
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    ssize_t pwrite(int fd, const void *data, size_t len, off_t pos)
+    {
+        if(data==0) return -EFAULT;
+        if(static_cast<ssize_t>(len)<0 || pos<0) return -EINVAL;
+        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        if(!file) return -EBADF;
+        return file->pwrite(data,len,pos);
+    }
+
+    /**
+     * Read data from the given position without moving the file pointer.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \param pos offset from the beginning of the file
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    ssize_t pread(int fd, void *data, size_t len, off_t pos)
+    {
+        if(data==0) return -EFAULT;
+        if(static_cast<ssize_t>(len)<0 || pos<0) return -EINVAL;
+        intrusive_ref_ptr<FileBase> file=getFile(fd);
+        if(!file) return -EBADF;
+        return file->pread(data,len,pos);
+    }
+
+    /**
+     * Write data from multiple buffers with a single call
+     * \param iov array of buffers
+     * \param iovcnt number of buffers, between 1 and IOV_MAX
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
+
+    /**
+     * Read data into multiple buffers with a single call
+     * \param iov array of buffers
+     * \param iovcnt number of buffers, between 1 and IOV_MAX
+     * \return the number of read characters, or a negative number in case
+     * of errors
+     */
+    ssize_t readv(int fd, const struct iovec *iov, int iovcnt);
     
     /**
      * Move file pointer, if the file supports random-access.
@@ -367,6 +420,43 @@ public:
      * \return 0 on success, or a negative number on failure
      */
     int pipe(int fds[2]);
+
+    /**
+     * Add an already open file to the table, used for files that are not part
+     * of a filesystem, such as shared memory objects
+     * \param file file to add
+     * \param flags file open flags, only O_CLOEXEC is considered
+     * \return the file descriptor, or a negative number on failure
+     */
+    int add(intrusive_ref_ptr<FileBase> file, int flags);
+
+    /**
+     * Wait until one or more file descriptors are ready for I/O
+     * \param fds file descriptors and requested events, the events that are
+     * ready are returned in the revents field. Negative file descriptors are
+     * ignored
+     * \param nfds number of elements in fds, at most MAX_OPEN_FILES
+     * \param timeout timeout in nanoseconds, 0 to return immediately, or a
+     * negative number to wait forever
+     * \return the number of file descriptors with nonzero revents, 0 on
+     * timeout, or a negative number on failure
+     */
+    int poll(struct pollfd *fds, unsigned int nfds, long long timeout);
+
+    /**
+     * Copy data between two file descriptors within the kernel. If the input
+     * file is memory-mapped the data is written straight from the backing
+     * storage, otherwise it goes through a kernel buffer
+     * \param outFd file descriptor to write to
+     * \param inFd file descriptor to read from
+     * \param offset if nullptr data is read starting from the file position of
+     * inFd, which is advanced. Otherwise data is read starting from *offset,
+     * which is updated, and the file position of inFd is left unchanged
+     * \param count maximum number of bytes to copy
+     * \return the number of bytes copied, 0 at end of file, or a negative
+     * number on failure
+     */
+    ssize_t sendfile(int outFd, int inFd, off_t *offset, size_t count);
     
     /**
      * Retrieves an entry in the file descriptor table
@@ -381,6 +471,11 @@ public:
         return atomic_load(files+fd);
     }
 
+    /**
+     * \return the number of open file descriptors
+     */
+    int getOpenFileCount() const;
+
     /**
      * Append cwd to path if it is not an absolute path
      * \param path an absolute or relative path, must not be null
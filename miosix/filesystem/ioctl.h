@@ -27,6 +27,8 @@
 
 #pragma once
 
+#include <errno.h>
+
 namespace miosix {
 
 enum Ioctl
@@ -36,7 +38,74 @@ enum Ioctl
     IOCTL_TCSETATTR_NOW=102,
     IOCTL_TCSETATTR_FLUSH=103,
     IOCTL_TCSETATTR_DRAIN=104,
-    IOCTL_FLUSH=105
+    IOCTL_FLUSH=105,
+    IOCTL_GET_BLOCK_GEOMETRY=106, ///< Argument is a BlockGeometry*
+    IOCTL_ERASE_BLOCK=107,        ///< Argument is an unsigned int* block number
+    IOCTL_GET_TX_STATS=108,       ///< Argument is a TerminalTxStats*
+    IOCTL_SET_ASYNC_TX=109,       ///< Argument is an unsigned int* queue size
+    IOCTL_MQ_SEND=110,            ///< Argument is a MessageQueueTransfer*
+    IOCTL_MQ_RECEIVE=111,         ///< Argument is a MessageQueueTransfer*
+    IOCTL_MQ_GETATTR=112          ///< Argument is a MessageQueueAttr*
+};
+
+/**
+ * Geometry of a block device, returned by IOCTL_GET_BLOCK_GEOMETRY.
+ * All sizes are in bytes. Devices that need no explicit erase, such as SD
+ * cards, report their sector size as erase size
+ */
+struct BlockGeometry
+{
+    unsigned int readSize;   ///< Minimum read size
+    unsigned int progSize;   ///< Minimum program (write) size
+    unsigned int eraseSize;  ///< Erase block size
+    unsigned int blockCount; ///< Number of erase blocks, 0 if unknown
+};
+
+/**
+ * Implements IOCTL_GET_BLOCK_GEOMETRY for SD cards, which are accessed in 512
+ * byte sectors and perform erase internally. The card size is not read from
+ * the CSD, so it is reported as unknown
+ * \param arg ioctl argument, a BlockGeometry*
+ * \return 0 on success, or a negative number on failure
+ */
+inline int sdCardBlockGeometry(void *arg)
+{
+    if(arg==nullptr) return -EFAULT;
+    *static_cast<BlockGeometry*>(arg)={512,512,512,0};
+    return 0;
+}
+
+/**
+ * Transmit statistics of a terminal, returned by IOCTL_GET_TX_STATS.
+ * The average number of bytes per transaction is bytes/transactions
+ */
+struct TerminalTxStats
+{
+    unsigned int bytes;        ///< Bytes passed to the device
+    unsigned int transactions; ///< Calls to the device writeBlock()
+};
+
+/**
+ * Message to send or receive with IOCTL_MQ_SEND and IOCTL_MQ_RECEIVE.
+ * When receiving, size is the buffer size and priority is returned
+ */
+struct MessageQueueTransfer
+{
+    void *data;            ///< Message data
+    unsigned int size;     ///< Message size
+    unsigned int priority; ///< Message priority
+};
+
+/**
+ * Attributes of a message queue, returned by IOCTL_MQ_GETATTR.
+ * Same layout as struct mq_attr in the newlib patch, keep in sync
+ */
+struct MessageQueueAttr
+{
+    long flags;           ///< O_NONBLOCK if the file is non blocking
+    long maxMessages;     ///< Maximum number of queued messages
+    long messageSize;     ///< Maximum message size
+    long currentMessages; ///< Number of queued messages
 };
 
 }
@@ -31,6 +31,7 @@
 #include "kernel/logging.h"
 #include <fcntl.h>
 #include <memory>
+#include <algorithm>
 
 namespace miosix {
 
@@ -87,11 +88,15 @@ public:
                  std::unique_ptr<lfs_file_t> file, bool forceSync,
                  StringPart &name)
         : FileBase(parentFS,flags), file(std::move(file)), forceSync(forceSync),
-          name(name) {}
+          name(name), mutex(MutexOptions::RECURSIVE) {}
 
     virtual ssize_t write(const void *buf, size_t count) override;
     virtual ssize_t read(void *buf, size_t count) override;
     virtual off_t lseek(off_t pos, int whence) override;
+    virtual ssize_t pread(void *buf, size_t count, off_t pos) override;
+    virtual ssize_t pwrite(const void *buf, size_t count, off_t pos) override;
+    virtual ssize_t readv(const struct iovec *iov, int iovcnt) override;
+    virtual ssize_t writev(const struct iovec *iov, int iovcnt) override;
     virtual int ftruncate(off_t size) override;
     virtual int fstat(struct stat *pstat) const override;
 
@@ -107,6 +112,8 @@ private:
     /// Force the file to be synced on every write
     bool forceSync;
     StringPart name;
+    /// Protects the file pointer, LittleFS only locks each call individually
+    KernelMutex mutex;
 };
 
 class LittleFSDirectory : public DirectoryBase
@@ -155,7 +162,35 @@ private:
     int addLastLFSDirEntry(char **pos, char *end);
 };
 
-LittleFS::LittleFS(intrusive_ref_ptr<FileBase> disk)
+/**
+ * \param geometry block device geometry
+ * \return the default cache size for the device
+ */
+static unsigned int defaultCacheSize(const BlockGeometry& geometry)
+{
+    // The smallest size compatible with the device, but at least 512 bytes if
+    // the erase block is large enough, as smaller caches fragment transfers
+    unsigned int result=std::max(geometry.readSize,geometry.progSize);
+    while(result<512 && result*2<=geometry.eraseSize) result*=2;
+    return result;
+}
+
+/**
+ * \param geometry block device geometry
+ * \return the default lookahead buffer size for the device
+ */
+static unsigned int defaultLookaheadSize(const BlockGeometry& geometry)
+{
+    // Enough to track all blocks, up to 512 bytes (4096 blocks). If the device
+    // size is unknown, use the maximum
+    const unsigned int maxSize=512;
+    if(geometry.blockCount==0) return maxSize;
+    unsigned int result=(geometry.blockCount+63)/64*8;
+    return std::min(result,maxSize);
+}
+
+LittleFS::LittleFS(intrusive_ref_ptr<FileBase> disk,
+                   const LittleFSOptions& options)
     : // Put the drive instance into the config context. Note that a raw pointer
       // is passed, but the object is kept alive by the intrusive_ref_ptr in the
       // drv member variable. Hence, the object is deleted when the LittleFS
@@ -165,13 +200,31 @@ LittleFS::LittleFS(intrusive_ref_ptr<FileBase> disk)
     int err;
     drv = disk;
 
+    BlockGeometry geometry;
+    if(disk->ioctl(IOCTL_GET_BLOCK_GEOMETRY, &geometry) != 0)
+        geometry = {512, 512, 512, 0};
+
     config = {};
-    config.read_size = 512;
-    config.prog_size = 512;
-    config.block_size = 512;
-    config.block_cycles = 500;
-    config.cache_size = 512;
-    config.lookahead_size = 512;
+    config.read_size = geometry.readSize;
+    config.prog_size = geometry.progSize;
+    config.block_size = geometry.eraseSize;
+    // If zero, LittleFS takes the block count from the superblock
+    config.block_count = geometry.blockCount;
+    config.block_cycles = options.blockCycles;
+    config.cache_size = options.cacheSize ? options.cacheSize
+                                          : defaultCacheSize(geometry);
+    config.lookahead_size = options.lookaheadSize ? options.lookaheadSize
+                                                  : defaultLookaheadSize(geometry);
+
+    if(config.read_size == 0 || config.prog_size == 0
+        || config.cache_size % config.read_size != 0
+        || config.cache_size % config.prog_size != 0
+        || config.block_size % config.cache_size != 0
+        || config.lookahead_size == 0 || config.lookahead_size % 8 != 0)
+    {
+        mountError = -EINVAL;
+        return;
+    }
 
     config.context = &context;
 
@@ -347,6 +400,7 @@ int posixOpenToLfsFlags(int posix_flags)
 
 ssize_t LittleFSFile::write(const void *buf, size_t count)
 {
+    Lock<KernelMutex> l(mutex);
     LittleFS *lfs_driver = static_cast<LittleFS *>(getParent().get());
     auto result=lfs_file_write(lfs_driver->getLfs(), file.get(), buf, count);
     if(forceSync) lfs_file_sync(lfs_driver->getLfs(), file.get());
@@ -356,6 +410,7 @@ ssize_t LittleFSFile::write(const void *buf, size_t count)
 
 ssize_t LittleFSFile::read(void *buf, size_t count)
 {
+    Lock<KernelMutex> l(mutex);
     // Get the LittleFS driver instance using getParent()
     LittleFS *lfs_driver = static_cast<LittleFS *>(getParent().get());
     auto result=lfs_file_read(lfs_driver->getLfs(), file.get(), buf, count);
@@ -384,6 +439,7 @@ off_t LittleFSFile::lseek(off_t pos, int whence)
 
     //TODO: check seek past the end behavior
     LittleFS *lfs_driver = static_cast<LittleFS *>(getParent().get());
+    Lock<KernelMutex> l(mutex);
     off_t result = static_cast<off_t>(
         lfs_file_seek(lfs_driver->getLfs(), file.get(),
                       static_cast<lfs_off_t>(pos), whence_lfs));
@@ -391,6 +447,33 @@ off_t LittleFSFile::lseek(off_t pos, int whence)
     return lfsErrorToPosix(result);
 }
 
+//The mutex is recursive, so holding it across the base class implementations
+//makes seeking and restoring the file pointer atomic
+
+ssize_t LittleFSFile::pread(void *buf, size_t count, off_t pos)
+{
+    Lock<KernelMutex> l(mutex);
+    return FileBase::pread(buf,count,pos);
+}
+
+ssize_t LittleFSFile::pwrite(const void *buf, size_t count, off_t pos)
+{
+    Lock<KernelMutex> l(mutex);
+    return FileBase::pwrite(buf,count,pos);
+}
+
+ssize_t LittleFSFile::readv(const struct iovec *iov, int iovcnt)
+{
+    Lock<KernelMutex> l(mutex);
+    return FileBase::readv(iov,iovcnt);
+}
+
+ssize_t LittleFSFile::writev(const struct iovec *iov, int iovcnt)
+{
+    Lock<KernelMutex> l(mutex);
+    return FileBase::writev(iov,iovcnt);
+}
+
 int LittleFSFile::ftruncate(off_t size)
 {
     LittleFS *lfs_driver = static_cast<LittleFS *>(getParent().get());
@@ -511,6 +594,14 @@ int miosixBlockDeviceProg(const lfs_config *c, lfs_block_t block,
 
 int miosixBlockDeviceErase(const lfs_config *c, lfs_block_t block)
 {
+    FileBase *drv = GET_DRIVER_FROM_LFS_CONTEXT(c);
+
+    // LittleFS blocks are the device erase blocks, see the constructor.
+    // Devices that don't need explicit erase, like SD cards, don't support
+    // the ioctl
+    unsigned int eraseBlock = block;
+    int result = drv->ioctl(IOCTL_ERASE_BLOCK, &eraseBlock);
+    if(result != 0 && result != -ENOTTY) return LFS_ERR_IO;
     return LFS_ERR_OK;
 }
 
@@ -49,6 +49,20 @@ public:
     KernelMutex mutex;
 };
 
+/**
+ * LittleFS mount options
+ */
+struct LittleFSOptions
+{
+    /// Cache size in bytes, 0 to choose it from the block device geometry
+    unsigned int cacheSize=LITTLEFS_CACHE_SIZE;
+    /// Lookahead buffer size in bytes, 0 to choose it from the device size
+    unsigned int lookaheadSize=LITTLEFS_LOOKAHEAD_SIZE;
+    /// Erase cycles before metadata is moved to another block, lower values
+    /// improve wear leveling at the cost of performance
+    int blockCycles=500;
+};
+
 /**
  * LittleFS Filesystem.
  */
@@ -57,8 +71,13 @@ class LittleFS : public FilesystemBase
 public:
     /**
      * Constructor
+     * \param disk block device where the filesystem is stored. Its geometry
+     * is queried with IOCTL_GET_BLOCK_GEOMETRY, devices that do not support
+     * it are accessed in 512 byte blocks
+     * \param options mount options
      */
-    LittleFS(intrusive_ref_ptr<FileBase> disk);
+    LittleFS(intrusive_ref_ptr<FileBase> disk,
+             const LittleFSOptions& options=LittleFSOptions());
 
     /**
      * Open a file
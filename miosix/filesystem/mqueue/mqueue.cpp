@@ -0,0 +1,294 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include "mqueue.h"
+#include "kernel/thread.h"
+#include <map>
+#include <string>
+#include <cstring>
+#include <new>
+#include <sys/stat.h>
+
+using namespace std;
+
+#ifdef WITH_FILESYSTEM
+
+namespace miosix {
+
+static KernelMutex mqMutex; ///< Guards the message queue namespace
+///Message queues that have not been unlinked yet
+static map<string,intrusive_ref_ptr<MessageQueue>> mqObjects;
+
+/**
+ * \param messageSize maximum message size
+ * \return the size of a message slot, including the header, rounded so that
+ * the message data is word aligned
+ */
+static unsigned int slotSize(unsigned int messageSize)
+{
+    return (sizeof(Message)+messageSize+3) & ~3;
+}
+
+//
+// class MessageQueue
+//
+
+int MessageQueue::open(const char *name, int flags,
+        const MessageQueueAttr *attr, intrusive_ref_ptr<MessageQueue>& mq)
+{
+    constexpr size_t maxNameLength=255;
+    if(name[0]!='/' || name[1]=='\0') return -EINVAL;
+    if(strchr(name+1,'/')) return -EINVAL;
+    if(strlen(name)>maxNameLength) return -ENAMETOOLONG;
+    Lock<KernelMutex> l(mqMutex);
+    auto it=mqObjects.find(name);
+    if(it!=mqObjects.end())
+    {
+        if((flags & (O_CREAT | O_EXCL))==(O_CREAT | O_EXCL)) return -EEXIST;
+        mq=it->second;
+        return 0;
+    }
+    if((flags & O_CREAT)==0) return -ENOENT;
+    unsigned int maxMessages=MQ_DEFAULT_MAXMSG;
+    unsigned int messageSize=MQ_DEFAULT_MSGSIZE;
+    if(attr)
+    {
+        if(attr->maxMessages<=0 || attr->messageSize<=0) return -EINVAL;
+        //Compare separately first to prevent overflow in the multiplication
+        if(static_cast<unsigned long>(attr->maxMessages)>MQ_MAX_SIZE ||
+           static_cast<unsigned long>(attr->messageSize)>MQ_MAX_SIZE)
+            return -EINVAL;
+        maxMessages=attr->maxMessages;
+        messageSize=attr->messageSize;
+    }
+    if(maxMessages*slotSize(messageSize)>MQ_MAX_SIZE) return -EINVAL;
+    intrusive_ref_ptr<MessageQueue> result(new (nothrow)
+        MessageQueue(maxMessages,messageSize));
+    if(!result || result->pool==nullptr) return -ENOMEM;
+    mqObjects[name]=result;
+    mq=result;
+    return 0;
+}
+
+int MessageQueue::open(const char *name, int flags,
+        const MessageQueueAttr *attr, intrusive_ref_ptr<FileBase>& file)
+{
+    intrusive_ref_ptr<MessageQueue> mq;
+    int result=open(name,flags,attr,mq);
+    if(result<0) return result;
+    file=intrusive_ref_ptr<FileBase>(new MessageQueueFile(mq,flags));
+    return 0;
+}
+
+int MessageQueue::unlink(const char *name)
+{
+    Lock<KernelMutex> l(mqMutex);
+    if(mqObjects.erase(name)==0) return -ENOENT;
+    return 0;
+}
+
+Message *MessageQueue::allocate(bool block)
+{
+    Lock<KernelMutex> l(m);
+    while(freeList==nullptr)
+    {
+        if(block==false || Thread::testTerminate()) return nullptr;
+        senders.wait(l);
+    }
+    Message *msg=freeList;
+    freeList=msg->next;
+    return msg;
+}
+
+void MessageQueue::post(Message *msg)
+{
+    Lock<KernelMutex> l(m);
+    //Insert after the messages with the same or higher priority
+    Message **pos=&queue;
+    while(*pos && (*pos)->priority>=msg->priority) pos=&(*pos)->next;
+    msg->next=*pos;
+    *pos=msg;
+    if(count++==0) readPoll.wakeup();
+    receivers.signal();
+}
+
+Message *MessageQueue::fetch(bool block)
+{
+    Lock<KernelMutex> l(m);
+    while(queue==nullptr)
+    {
+        if(block==false || Thread::testTerminate()) return nullptr;
+        receivers.wait(l);
+    }
+    Message *msg=queue;
+    queue=msg->next;
+    count--;
+    return msg;
+}
+
+void MessageQueue::release(Message *msg)
+{
+    Lock<KernelMutex> l(m);
+    if(freeList==nullptr) writePoll.wakeup();
+    msg->next=freeList;
+    freeList=msg;
+    senders.signal();
+}
+
+int MessageQueue::send(const void *data, size_t len, unsigned int priority,
+                       bool block)
+{
+    if(len>messageSize) return -EMSGSIZE;
+    if(priority>=maxPriority) return -EINVAL;
+    Message *msg=allocate(block);
+    if(msg==nullptr) return block ? -EINTR : -EAGAIN;
+    memcpy(msg->data(),data,len);
+    msg->size=len;
+    msg->priority=priority;
+    post(msg);
+    return 0;
+}
+
+ssize_t MessageQueue::receive(void *data, size_t len, unsigned int *priority,
+                              bool block)
+{
+    if(len<messageSize) return -EMSGSIZE;
+    Message *msg=fetch(block);
+    if(msg==nullptr) return block ? -EINTR : -EAGAIN;
+    ssize_t result=msg->size;
+    memcpy(data,msg->data(),result);
+    if(priority) *priority=msg->priority;
+    release(msg);
+    return result;
+}
+
+int MessageQueue::poll(PollTable& table, bool read, bool write)
+{
+    if(read) table.add(readPoll);
+    if(write) table.add(writePoll);
+    Lock<KernelMutex> l(m);
+    int result=0;
+    if(read && queue) result|=POLLIN | POLLRDNORM;
+    if(write && freeList) result|=POLLOUT | POLLWRNORM;
+    return result;
+}
+
+void MessageQueue::getAttributes(MessageQueueAttr& attr)
+{
+    Lock<KernelMutex> l(m);
+    attr.flags=0;
+    attr.maxMessages=maxMessages;
+    attr.messageSize=messageSize;
+    attr.currentMessages=count;
+}
+
+MessageQueue::~MessageQueue() { delete[] pool; }
+
+MessageQueue::MessageQueue(unsigned int maxMessages, unsigned int messageSize)
+    : pool(new (nothrow) char[maxMessages*slotSize(messageSize)]),
+      maxMessages(maxMessages), messageSize(messageSize)
+{
+    if(pool==nullptr) return;
+    for(unsigned int i=0;i<maxMessages;i++)
+    {
+        auto msg=reinterpret_cast<Message*>(pool+i*slotSize(messageSize));
+        msg->next=freeList;
+        freeList=msg;
+    }
+}
+
+//
+// class MessageQueueFile
+//
+
+MessageQueueFile::MessageQueueFile(intrusive_ref_ptr<MessageQueue> mq,
+        int flags) : FileBase(intrusive_ref_ptr<FilesystemBase>(),flags),
+        mq(mq) {}
+
+ssize_t MessageQueueFile::write(const void *data, size_t len)
+{
+    if(writable()==false) return -EBADF;
+    int result=mq->send(data,len,0,blocking());
+    return result<0 ? result : len;
+}
+
+ssize_t MessageQueueFile::read(void *data, size_t len)
+{
+    if(readable()==false) return -EBADF;
+    return mq->receive(data,len,nullptr,blocking());
+}
+
+off_t MessageQueueFile::lseek(off_t pos, int whence) { return -ESPIPE; }
+
+int MessageQueueFile::ftruncate(off_t size) { return -EINVAL; }
+
+int MessageQueueFile::fstat(struct stat *pstat) const
+{
+    memset(pstat,0,sizeof(struct stat));
+    pstat->st_mode=S_IFIFO | 0600;
+    pstat->st_nlink=1;
+    pstat->st_blksize=mq->getMessageSize();
+    return 0;
+}
+
+int MessageQueueFile::ioctl(int cmd, void *arg)
+{
+    switch(cmd)
+    {
+        case IOCTL_MQ_SEND:
+        {
+            if(writable()==false) return -EBADF;
+            auto t=reinterpret_cast<MessageQueueTransfer*>(arg);
+            return mq->send(t->data,t->size,t->priority,blocking());
+        }
+        case IOCTL_MQ_RECEIVE:
+        {
+            if(readable()==false) return -EBADF;
+            auto t=reinterpret_cast<MessageQueueTransfer*>(arg);
+            return mq->receive(t->data,t->size,&t->priority,blocking());
+        }
+        case IOCTL_MQ_GETATTR:
+        {
+            auto attr=reinterpret_cast<MessageQueueAttr*>(arg);
+            mq->getAttributes(*attr);
+            attr->flags=flags & O_NONBLOCK;
+            return 0;
+        }
+    }
+    return -ENOTTY;
+}
+
+int MessageQueueFile::poll(int events, PollTable& table)
+{
+    return mq->poll(table,readable() && (events & (POLLIN | POLLRDNORM)),
+                    writable() && (events & (POLLOUT | POLLWRNORM)));
+}
+
+} //namespace miosix
+
+#endif //WITH_FILESYSTEM
@@ -0,0 +1,304 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include <fcntl.h>
+#include "filesystem/file.h"
+#include "filesystem/poll_table.h"
+#include "filesystem/ioctl.h"
+#include "kernel/sync.h"
+#include "miosix_settings.h"
+
+#ifdef WITH_FILESYSTEM
+
+namespace miosix {
+
+/**
+ * A message slot of a MessageQueue. Kernel code using the zero-copy interface
+ * of MessageQueue writes and reads the message directly in the slot, which
+ * has room for MessageQueue::getMessageSize() bytes
+ */
+class Message
+{
+public:
+    /**
+     * \return the message data, stored right after the slot header
+     */
+    char *data() { return reinterpret_cast<char*>(this+1); }
+
+    unsigned int size;     ///< Message size in bytes
+    unsigned int priority; ///< Higher priority messages are received first
+
+private:
+    Message *next; ///< Next message in the queue or free list
+    friend class MessageQueue;
+};
+
+/**
+ * A message queue, with the semantics of POSIX mq_*: message boundaries are
+ * preserved, messages are received in order of decreasing priority, and in
+ * FIFO order among messages with the same priority.
+ *
+ * All the message slots are allocated when the queue is created, so sending
+ * a message never allocates memory. Kernel code can use allocate(), post(),
+ * fetch() and release() to pass messages without copying them, while
+ * processes go through send() and receive() which copy the message into and
+ * out of a slot.
+ *
+ * Queues are identified by a name and removed from the namespace with
+ * unlink(). The memory is freed when the queue has been unlinked and the last
+ * reference to it has been dropped.
+ */
+class MessageQueue : public IntrusiveRefCounted<MessageQueue>
+{
+public:
+    /// Priorities must be less than this value
+    static const unsigned int maxPriority=32;
+
+    /**
+     * Open a message queue
+     * \param name queue name, must start with '/' and contain no other '/'
+     * \param flags O_RDONLY, O_WRONLY or O_RDWR, optionally ORed with O_CREAT,
+     * O_EXCL, O_NONBLOCK and O_CLOEXEC
+     * \param attr if a queue is created, its maximum number of messages and
+     * message size are taken from here. If nullptr, MQ_DEFAULT_MAXMSG and
+     * MQ_DEFAULT_MSGSIZE are used. Ignored if the queue already exists
+     * \param mq the queue is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    static int open(const char *name, int flags, const MessageQueueAttr *attr,
+                    intrusive_ref_ptr<MessageQueue>& mq);
+
+    /**
+     * Open a message queue as a file. Reading from the file receives a
+     * message, writing to it sends a message with priority 0, and the
+     * IOCTL_MQ_SEND, IOCTL_MQ_RECEIVE and IOCTL_MQ_GETATTR ioctls are
+     * supported. Blocking operations fail with EAGAIN if the file has been
+     * opened with O_NONBLOCK
+     * \param name queue name, must start with '/' and contain no other '/'
+     * \param flags as in the other overload
+     * \param attr as in the other overload
+     * \param file a file referring to the queue is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    static int open(const char *name, int flags, const MessageQueueAttr *attr,
+                    intrusive_ref_ptr<FileBase>& file);
+
+    /**
+     * Remove a message queue name, the queue is destroyed once it is no
+     * longer referenced
+     * \param name queue name
+     * \return 0 on success, or a negative number on failure
+     */
+    static int unlink(const char *name);
+
+    /**
+     * Get a free message slot to fill and pass to post()
+     * \param block if true wait until a slot is free
+     * \return a free slot, or nullptr if block is false and the queue is full
+     * or if the calling thread is being terminated
+     */
+    Message *allocate(bool block);
+
+    /**
+     * Add a message to the queue, waking up a receiver
+     * \param msg slot returned by allocate(), its size must not exceed
+     * getMessageSize() and its priority must be less than maxPriority
+     */
+    void post(Message *msg);
+
+    /**
+     * Remove the highest priority message from the queue
+     * \param block if true wait until a message is available
+     * \return the message, that must be passed to release() once read, or
+     * nullptr if block is false and the queue is empty or if the calling
+     * thread is being terminated
+     */
+    Message *fetch(bool block);
+
+    /**
+     * Return a slot to the free list, waking up a sender
+     * \param msg slot returned by allocate() or fetch()
+     */
+    void release(Message *msg);
+
+    /**
+     * Copy a message into the queue
+     * \param data message data
+     * \param len message size
+     * \param priority message priority
+     * \param block if true wait until the queue is not full
+     * \return 0 on success, or a negative number on failure
+     */
+    int send(const void *data, size_t len, unsigned int priority, bool block);
+
+    /**
+     * Copy the highest priority message out of the queue
+     * \param data buffer where the message is stored
+     * \param len buffer size, must be at least getMessageSize()
+     * \param priority if not nullptr, the message priority is stored here
+     * \param block if true wait until the queue is not empty
+     * \return the message size, or a negative number on failure
+     */
+    ssize_t receive(void *data, size_t len, unsigned int *priority, bool block);
+
+    /**
+     * Check whether the queue is ready for receiving or sending
+     * \param table poll table to add to the queue's PollQueue
+     * \param read true to register for receiving
+     * \param write true to register for sending
+     * \return the events that are ready
+     */
+    int poll(PollTable& table, bool read, bool write);
+
+    /**
+     * \param attr the queue attributes are returned here, flags is set to 0
+     */
+    void getAttributes(MessageQueueAttr& attr);
+
+    /**
+     * \return the maximum message size
+     */
+    unsigned int getMessageSize() const { return messageSize; }
+
+    /**
+     * Destructor
+     */
+    ~MessageQueue();
+
+private:
+    /**
+     * Constructor, check that pool is not nullptr after construction
+     * \param maxMessages number of message slots
+     * \param messageSize maximum message size
+     */
+    MessageQueue(unsigned int maxMessages, unsigned int messageSize);
+
+    MessageQueue(const MessageQueue&)=delete;
+    MessageQueue& operator=(const MessageQueue&)=delete;
+
+    KernelMutex m;
+    ConditionVariable receivers; ///< Receivers waiting for a message
+    ConditionVariable senders;   ///< Senders waiting for a free slot
+    PollQueue readPoll;          ///< Threads polling for receiving
+    PollQueue writePoll;         ///< Threads polling for sending
+    char *pool;                  ///< Memory of all the message slots
+    Message *queue=nullptr;      ///< Queued messages, by decreasing priority
+    Message *freeList=nullptr;   ///< Free slots
+    const unsigned int maxMessages, messageSize;
+    unsigned int count=0;        ///< Number of queued messages
+};
+
+/**
+ * A file referring to a message queue
+ */
+class MessageQueueFile : public FileBase
+{
+public:
+    /**
+     * Constructor
+     * \param mq the message queue
+     * \param flags file open flags
+     */
+    MessageQueueFile(intrusive_ref_ptr<MessageQueue> mq, int flags);
+
+    /**
+     * Send a message with priority 0
+     * \param data the message
+     * \param len the message size
+     * \return the message size, or a negative number in case of errors
+     */
+    virtual ssize_t write(const void *data, size_t len);
+
+    /**
+     * Receive a message
+     * \param data buffer where the message is stored
+     * \param len buffer size, must be at least the maximum message size
+     * \return the message size, or a negative number in case of errors
+     */
+    virtual ssize_t read(void *data, size_t len);
+
+    /**
+     * Message queues are not seekable
+     * \return -ESPIPE
+     */
+    virtual off_t lseek(off_t pos, int whence);
+
+    /**
+     * Message queues can't be truncated
+     * \return -EINVAL
+     */
+    virtual int ftruncate(off_t size);
+
+    /**
+     * Return file information.
+     * \param pstat pointer to stat struct
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fstat(struct stat *pstat) const;
+
+    /**
+     * Supports IOCTL_MQ_SEND, IOCTL_MQ_RECEIVE and IOCTL_MQ_GETATTR
+     * \param cmd specifies the operation to perform
+     * \param arg argument of the operation, depending on cmd
+     * \return 0 or the received message size on success, or a negative
+     * number on failure
+     */
+    virtual int ioctl(int cmd, void *arg);
+
+    /**
+     * Check whether the queue is ready for receiving or sending
+     * \param events requested events (POLLIN, POLLOUT, ...)
+     * \param table poll table to add to the queue's PollQueue
+     * \return the events that are ready
+     */
+    virtual int poll(int events, PollTable& table);
+
+private:
+    /**
+     * \return true if the file can be used to receive messages
+     */
+    bool readable() const { return (flags & O_ACCMODE)!=O_WRONLY; }
+
+    /**
+     * \return true if the file can be used to send messages
+     */
+    bool writable() const { return (flags & O_ACCMODE)!=O_RDONLY; }
+
+    /**
+     * \return true if operations should block
+     */
+    bool blocking() const { return (flags & O_NONBLOCK)==0; }
+
+    intrusive_ref_ptr<MessageQueue> mq; ///< The message queue
+};
+
+} //namespace miosix
+
+#endif //WITH_FILESYSTEM
@@ -25,9 +25,12 @@
  *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
  ***************************************************************************/
 
+
 #include "pipe.h"
 #include "kernel/thread.h"
 #include <algorithm>
+#include <cstring>
+#include <new>
 
 using namespace std;
 
@@ -35,8 +38,17 @@ using namespace std;
 
 namespace miosix {
 
-Pipe::Pipe() : FileBase(intrusive_ref_ptr<FilesystemBase>(),O_RDWR), put(0),
-    get(0), size(0), capacity(defaultSize), buffer(new char[defaultSize]) {}
+//
+// class Pipe
+//
+
+void Pipe::create(intrusive_ref_ptr<FileBase>& readEnd,
+        intrusive_ref_ptr<FileBase>& writeEnd)
+{
+    intrusive_ref_ptr<Pipe> pipe(new Pipe);
+    readEnd=intrusive_ref_ptr<FileBase>(new PipeFile(pipe,false));
+    writeEnd=intrusive_ref_ptr<FileBase>(new PipeFile(pipe,true));
+}
 
 ssize_t Pipe::write(const void *data, size_t len)
 {
@@ -45,23 +57,31 @@ ssize_t Pipe::write(const void *data, size_t len)
     ssize_t written=0;
     while(len>0)
     {
-        if(unconnected()) return -EPIPE;
-        int writable=min<int>(len,capacity-size);
-        //HACK: if the other end of the pipe is closed after we wait on the
-        //condition variable, we'll wait forever. To fix that, we set a timeout
-        if(writable==0) cv.timedWait(l,getTime()+pollTime);
-        else {
-            for(int i=0;i<writable;i++)
-            {
-                buffer[put]=d[i];
-                if(++put>=capacity) put=0;
-            }
-            size+=writable;
-            d+=writable;
-            len-=writable;
-            written+=writable;
-            cv.broadcast();
+        if(readEndOpen==false) return written>0 ? written : -EPIPE;
+        if(size==capacity)
+        {
+            //The thread may be killed while waiting, e.g. by exit() or execve()
+            if(Thread::testTerminate()) return written>0 ? written : -EINTR;
+            writers.wait(l);
+            continue;
+        }
+        int writable=min<size_t>(len,capacity-size);
+        //Free space may wrap around the end of the buffer
+        int chunk=min(writable,capacity-put);
+        memcpy(buffer+put,d,chunk);
+        memcpy(buffer,d+chunk,writable-chunk);
+        put+=writable;
+        if(put>=capacity) put-=capacity;
+        //Readers only wait if the pipe is empty
+        if(size==0)
+        {
+            readers.broadcast();
+            readPoll.wakeup();
         }
+        size+=writable;
+        d+=writable;
+        len-=writable;
+        written+=writable;
     }
     return written;
 }
@@ -71,63 +91,145 @@ ssize_t Pipe::read(void *data, size_t len)
     if(len==0) return 0;
     auto d=reinterpret_cast<char*>(data);
     Lock<KernelMutex> l(m);
-    for(;;)
+    while(size==0)
     {
-        int readable=min<int>(len,size);
-        if(unconnected() && readable==0) return 0;
-        //HACK: if the other end of the pipe is closed after we wait on the
-        //condition variable, we'll wait forever. To fix that, we set a timeout
-        if(readable==0) cv.timedWait(l,getTime()+pollTime);
-        else {
-            for(int i=0;i<readable;i++)
-            {
-                d[i]=buffer[get];
-                if(++get>=capacity) get=0;
-            }
-            size-=readable;
-            cv.broadcast();
-            return readable;
-        }
+        if(writeEndOpen==false) return 0;
+        if(Thread::testTerminate()) return -EINTR;
+        readers.wait(l);
     }
+    int readable=min<size_t>(len,size);
+    //Data may wrap around the end of the buffer
+    int chunk=min(readable,capacity-get);
+    memcpy(d,buffer+get,chunk);
+    memcpy(d+chunk,buffer,readable-chunk);
+    get+=readable;
+    if(get>=capacity) get-=capacity;
+    //Writers only wait if the pipe is full
+    if(size==capacity)
+    {
+        writers.broadcast();
+        writePoll.wakeup();
+    }
+    size-=readable;
+    return readable;
 }
 
-off_t Pipe::lseek(off_t pos, int whence) { return -ESPIPE; }
+int Pipe::poll(bool writeEnd, PollTable& table)
+{
+    table.add(writeEnd ? writePoll : readPoll);
+    Lock<KernelMutex> l(m);
+    int result=0;
+    if(writeEnd)
+    {
+        if(size<capacity) result|=POLLOUT | POLLWRNORM;
+        if(readEndOpen==false) result|=POLLERR;
+    } else {
+        if(size>0) result|=POLLIN | POLLRDNORM;
+        if(writeEndOpen==false) result|=POLLHUP;
+    }
+    return result;
+}
 
-int Pipe::ftruncate(off_t size) { return -EINVAL; }
+int Pipe::setCapacity(int newCapacity)
+{
+    if(newCapacity<=0) return -EINVAL;
+    if(newCapacity>static_cast<int>(PIPE_MAX_SIZE)) return -EPERM;
+    Lock<KernelMutex> l(m);
+    if(newCapacity==capacity) return capacity;
+    if(newCapacity<size) return -EBUSY;
+    char *newBuffer=new (nothrow) char[newCapacity];
+    if(newBuffer==nullptr) return -ENOMEM;
+    int chunk=min(size,capacity-get);
+    memcpy(newBuffer,buffer+get,chunk);
+    memcpy(newBuffer+chunk,buffer,size-chunk);
+    delete[] buffer;
+    bool wasFull= size==capacity;
+    buffer=newBuffer;
+    capacity=newCapacity;
+    get=0;
+    put= size==capacity ? 0 : size;
+    if(wasFull && size<capacity)
+    {
+        writers.broadcast();
+        writePoll.wakeup();
+    }
+    return capacity;
+}
 
-int Pipe::fstat(struct stat *pstat) const
+int Pipe::getCapacity()
 {
-    return -EFAULT; //TODO
+    Lock<KernelMutex> l(m);
+    return capacity;
 }
 
-int Pipe::fcntl(int cmd, int opt)
+void Pipe::close(bool writeEnd)
 {
-    switch(cmd)
+    Lock<KernelMutex> l(m);
+    if(writeEnd)
     {
-        case F_GETFD:
-        case F_GETFL: //TODO: also return file access mode
-            return O_RDWR;
+        writeEndOpen=false;
+        readers.broadcast();
+        readPoll.wakeup();
+    } else {
+        readEndOpen=false;
+        writers.broadcast();
+        writePoll.wakeup();
     }
-    return -EBADF;
 }
 
 Pipe::~Pipe() { delete[] buffer; }
 
-bool Pipe::unconnected()
+Pipe::Pipe() : buffer(new char[PIPE_DEFAULT_SIZE]), put(0), get(0), size(0),
+    capacity(PIPE_DEFAULT_SIZE) {}
+
+//
+// class PipeFile
+//
+
+PipeFile::PipeFile(intrusive_ref_ptr<Pipe> pipe, bool writeEnd)
+    : FileBase(intrusive_ref_ptr<FilesystemBase>(),writeEnd ? O_WRONLY : O_RDONLY),
+      pipe(pipe), writeEnd(writeEnd) {}
+
+ssize_t PipeFile::write(const void *data, size_t len)
+{
+    if(writeEnd==false) return -EBADF;
+    return pipe->write(data,len);
+}
+
+ssize_t PipeFile::read(void *data, size_t len)
+{
+    if(writeEnd) return -EBADF;
+    return pipe->read(data,len);
+}
+
+off_t PipeFile::lseek(off_t pos, int whence) { return -ESPIPE; }
+
+int PipeFile::ftruncate(off_t size) { return -EINVAL; }
+
+int PipeFile::fstat(struct stat *pstat) const
 {
-    //How many references does an unconnected pipe have? One in the file
-    //descriptor table. Then, since we check whether we are unconnected within
-    //either a read or write operation, either FileDescriptorTable::read or
-    //FileDescriptorTable::write hold a temporary reference to make sure a
-    //concurrent close doesn't lead to a dangling pointer in the middle of a
-    //syscall, bringing the reference count to 2. Finally, to get the reference
-    //count, we need to get the intrusive_shared_ptr first as a temporary through
-    //shared_from_this() and this adds to the reference count, reaching 3.
-    //This should be done with the mutex locked to prevent concurrent calls from
-    //not spotting that we are unconnected
-    return shared_from_this().use_count()<=3;
+    return -EFAULT; //TODO
 }
 
+int PipeFile::fcntl(int cmd, int opt)
+{
+    switch(cmd)
+    {
+        case F_GETPIPE_SZ:
+            return pipe->getCapacity();
+        case F_SETPIPE_SZ:
+            return pipe->setCapacity(opt);
+    }
+    return FileBase::fcntl(cmd,opt);
+}
+
+int PipeFile::poll(int events, PollTable& table)
+{
+    return pipe->poll(writeEnd,table);
+}
+
+PipeFile::~PipeFile() { pipe->close(writeEnd); }
+
 } //namespace miosix
 
 #endif //WITH_FILESYSTEM
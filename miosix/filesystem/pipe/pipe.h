@@ -25,9 +25,11 @@
  *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
  ***************************************************************************/
 
+
 #pragma once
 
 #include "filesystem/file.h"
+#include "filesystem/poll_table.h"
 #include "kernel/sync.h"
 #include "miosix_settings.h"
 
@@ -37,22 +39,111 @@ namespace miosix {
 
 /**
  * Pipe
- * This is an almost standard compliant pipe implementation. A pipe should in
- * theory have two separate file descriptors pointing to two file objects, one
- * for the read end and one for the write end. This pipe implementation is a
- * single file object that does both. This file object is aliased through
- * reference counting to both file descriptors, which can be used
- * interchangeably as read/write end. Code that uses those file descriptor in a
- * standard compliant way won't notice the difference.
+ * The buffer and synchronization state shared by the two ends of a pipe.
+ * The ends are PipeFile objects, one for reading and one for writing, and each
+ * end notifies the pipe when its last file descriptor is closed, so that
+ * threads blocked on the other end are woken up.
+ *
+ * Readers and writers wait on separate condition variables and poll queues,
+ * and are only woken up when the pipe goes from empty to non-empty, from full
+ * to non-full, or when the other end is closed.
  */
-class Pipe : public FileBase
+class Pipe : public IntrusiveRefCounted<Pipe>
 {
 public:
+    /**
+     * Create a pipe
+     * \param readEnd the read end of the pipe is returned here
+     * \param writeEnd the write end of the pipe is returned here
+     */
+    static void create(intrusive_ref_ptr<FileBase>& readEnd,
+                       intrusive_ref_ptr<FileBase>& writeEnd);
+
+    /**
+     * Write data to the pipe, blocking until all data has been written or
+     * the read end is closed
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \return the number of written characters, or a negative number in case
+     * of errors
+     */
+    ssize_t write(const void *data, size_t len);
+
+    /**
+     * Read data from the pipe, blocking until at least one byte is available
+     * or the write end is closed
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \return the number of read characters, 0 if the pipe is empty and the
+     * write end is closed, or a negative number in case of errors
+     */
+    ssize_t read(void *data, size_t len);
+
+    /**
+     * Check whether an end of the pipe is ready
+     * \param writeEnd true if polling the write end
+     * \param table poll table to add to the pipe's PollQueue
+     * \return the events that are ready
+     */
+    int poll(bool writeEnd, PollTable& table);
+
+    /**
+     * Change the size of the pipe buffer
+     * \param newCapacity new buffer size in bytes
+     * \return the new buffer size, or a negative number in case of errors
+     */
+    int setCapacity(int newCapacity);
+
+    /**
+     * \return the size of the pipe buffer
+     */
+    int getCapacity();
+
+    /**
+     * Called when the last file descriptor referring to an end of the pipe is
+     * closed, wakes up threads blocked on the other end
+     * \param writeEnd true if the write end was closed
+     */
+    void close(bool writeEnd);
+
+    /**
+     * Destructor
+     */
+    ~Pipe();
+
+private:
     /**
      * Constructor
      */
     Pipe();
 
+    Pipe(const Pipe&)=delete;
+    Pipe& operator=(const Pipe&)=delete;
+
+    KernelMutex m;
+    ConditionVariable readers; ///< Readers waiting for data
+    ConditionVariable writers; ///< Writers waiting for space
+    PollQueue readPoll;        ///< Threads polling the read end
+    PollQueue writePoll;       ///< Threads polling the write end
+    char *buffer;
+    int put, get, size, capacity;
+    bool readEndOpen=true, writeEndOpen=true;
+};
+
+/**
+ * One end of a pipe. Reading from the write end or writing to the read end
+ * fails with EBADF.
+ */
+class PipeFile : public FileBase
+{
+public:
+    /**
+     * Constructor
+     * \param pipe the pipe
+     * \param writeEnd true if this is the write end, false if the read end
+     */
+    PipeFile(intrusive_ref_ptr<Pipe> pipe, bool writeEnd);
+
     /**
      * Write data to the file, if the file supports writing.
      * \param data the data to write
@@ -96,7 +187,8 @@ public:
     virtual int fstat(struct stat *pstat) const;
 
     /**
-     * Perform various operations on a file descriptor
+     * Perform various operations on a file descriptor. In addition to the
+     * common ones, F_GETPIPE_SZ and F_SETPIPE_SZ are supported
      * \param cmd specifies the operation to perform
      * \param opt optional argument that some operation require
      * \return the exact return value depends on CMD, -1 is returned on error
@@ -104,23 +196,21 @@ public:
     virtual int fcntl(int cmd, int opt);
 
     /**
-     * Destructor
+     * Check whether the pipe is ready for reading or writing
+     * \param events requested events (POLLIN, POLLOUT, ...)
+     * \param table poll table to add to the pipe's PollQueue
+     * \return the events that are ready, POLLHUP if the other end is closed
      */
-    ~Pipe();
+    virtual int poll(int events, PollTable& table);
 
-private:
     /**
-     * \return true if there is only one file descriptor associated with the pipe
-     * Must be called with mutex locked
+     * Destructor, closes this end of the pipe
      */
-    bool unconnected();
+    ~PipeFile();
 
-    static const int defaultSize=256;
-    static const int pollTime=100000000; //100ms
-    KernelMutex m;
-    ConditionVariable cv;
-    int put, get, size, capacity;
-    char *buffer;
+private:
+    intrusive_ref_ptr<Pipe> pipe; ///< The pipe
+    const bool writeEnd;          ///< True if this is the write end
 };
 
 } //namespace miosix
@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include "poll_table.h"
+#include "kernel/thread.h"
+#include "kernel/lock.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+//
+// class PollQueue
+//
+
+void PollQueue::wakeup()
+{
+    FastGlobalIrqLock dLock;
+    IRQwakeup();
+}
+
+void PollQueue::IRQwakeup()
+{
+    for(auto e : entries) e->table->IRQwakeup();
+}
+
+//
+// class PollTable
+//
+
+void PollTable::add(PollQueue& queue)
+{
+    if(registering==false) return;
+    if(numEntries>=maxEntries)
+    {
+        requestPeriodicWakeup(overflowPollTime);
+        return;
+    }
+    PollEntry *e=&entries[numEntries++];
+    e->table=this;
+    e->queue=&queue;
+    FastGlobalIrqLock dLock;
+    queue.entries.push_back(e);
+}
+
+void PollTable::requestPeriodicWakeup(long long period)
+{
+    if(this->period<0) this->period=period;
+    else this->period=min(this->period,period);
+}
+
+void PollTable::wait(long long absTime)
+{
+    registering=false;
+    if(period>=0)
+    {
+        long long periodic=getTime()+period;
+        absTime= absTime<0 ? periodic : min(absTime,periodic);
+    }
+    FastGlobalIrqLock dLock;
+    if(woken==false)
+    {
+        waiting=Thread::IRQgetCurrentThread();
+        while(waiting)
+        {
+            //Thread::terminate() wakes the thread only once
+            if(Thread::IRQtestTerminate())
+            {
+                waiting=nullptr;
+                break;
+            }
+            if(absTime<0) Thread::IRQglobalIrqUnlockAndWait(dLock);
+            else if(Thread::IRQglobalIrqUnlockAndTimedWait(dLock,absTime)
+                    ==TimedWaitResult::Timeout) waiting=nullptr;
+        }
+    }
+    woken=false;
+}
+
+PollTable::~PollTable()
+{
+    FastGlobalIrqLock dLock;
+    for(unsigned int i=0;i<numEntries;i++)
+        entries[i].queue->entries.removeFast(&entries[i]);
+}
+
+void PollTable::IRQwakeup()
+{
+    woken=true;
+    if(waiting)
+    {
+        waiting->IRQwakeup();
+        waiting=nullptr;
+    }
+}
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
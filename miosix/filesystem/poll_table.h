@@ -0,0 +1,197 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include "kernel/intrusive.h"
+#include "miosix_settings.h"
+
+#if __has_include(<sys/poll.h>)
+#include <sys/poll.h>
+#else //__has_include(<sys/poll.h>)
+
+//Compilers predating poll() support lack sys/poll.h, keep in sync with
+//libc/sys/miosix/sys/poll.h in the newlib patch
+
+struct pollfd
+{
+    int fd;        ///< File descriptor to poll, ignored if negative
+    short events;  ///< Requested events
+    short revents; ///< Returned events
+};
+
+typedef unsigned int nfds_t;
+
+#define POLLIN     0x001
+#define POLLPRI    0x002
+#define POLLOUT    0x004
+#define POLLERR    0x008
+#define POLLHUP    0x010
+#define POLLNVAL   0x020
+#define POLLRDNORM 0x040
+#define POLLRDBAND 0x080
+#define POLLWRNORM 0x100
+#define POLLWRBAND 0x200
+
+#endif //__has_include(<sys/poll.h>)
+
+namespace miosix {
+
+#ifdef WITH_FILESYSTEM
+
+class Thread;
+class PollTable;
+class PollQueue;
+
+/**
+ * \internal
+ * Links a PollTable to one of the PollQueue it is registered on
+ */
+class PollEntry : public IntrusiveListItem
+{
+public:
+    PollTable *table=nullptr; ///< Poll table this entry belongs to
+    PollQueue *queue=nullptr; ///< Queue this entry is registered on, if any
+};
+
+/**
+ * Queue of threads polling on a file or device.
+ * Objects that support poll() own one or more PollQueue, register the
+ * PollTable passed to their poll() member function on the relevant queues
+ * through PollTable::add(), and call wakeup() (or IRQwakeup() from interrupt
+ * context) whenever their state changes in a way that can make them readable,
+ * writable or hung up. Waking up a queue nobody is polling on is cheap.
+ *
+ * A PollQueue must outlive all the PollTable registered on it. This is
+ * guaranteed if the queue is a member of the polled object, as
+ * FileDescriptorTable::poll() holds a reference to the polled files for the
+ * duration of the call.
+ */
+class PollQueue
+{
+public:
+    /**
+     * Constructor
+     */
+    PollQueue() {}
+
+    /**
+     * Wake up all threads polling on this queue
+     */
+    void wakeup();
+
+    /**
+     * Wake up all threads polling on this queue. Can only be called inside an
+     * IRQ or when interrupts are disabled.
+     */
+    void IRQwakeup();
+
+    PollQueue(const PollQueue&)=delete;
+    PollQueue& operator=(const PollQueue&)=delete;
+
+private:
+    IntrusiveList<PollEntry> entries; ///< Registered PollTable
+    friend class PollTable;
+};
+
+/**
+ * State of a single poll() call. Files add the table to their PollQueue when
+ * their poll() member function is called, and the table then sleeps until
+ * one of these queues is woken up.
+ *
+ * To avoid losing wakeups, files must register on their queues before
+ * checking their state. Only the first scan of the polled files registers the
+ * table, subsequent scans after a wakeup only check the state as the table is
+ * still registered.
+ */
+class PollTable
+{
+public:
+    /**
+     * Constructor
+     * \param registering false if the table should not be registered on any
+     * queue, used when poll() is called with a zero timeout
+     */
+    explicit PollTable(bool registering=true) : registering(registering) {}
+
+    /**
+     * Register this table on a queue. Does nothing if the table is not
+     * registering. If the table runs out of entries, wait() falls back to
+     * periodically waking up.
+     * \param queue queue to register on
+     */
+    void add(PollQueue& queue);
+
+    /**
+     * For objects that can't notify some of their state changes through a
+     * PollQueue, request wait() to wake up periodically so their state is
+     * checked again
+     * \param period maximum time in nanoseconds wait() will sleep
+     */
+    void requestPeriodicWakeup(long long period);
+
+    /**
+     * Sleep until one of the queues this table is registered on is woken up,
+     * or a timeout occurs. Also stops registering the table on queues.
+     * Returns immediately if a queue was woken up since the last call, or if
+     * the calling thread is being terminated.
+     * \param absTime absolute timeout in nanoseconds, or a negative number to
+     * wait forever
+     */
+    void wait(long long absTime);
+
+    /**
+     * Destructor, removes the table from all queues
+     */
+    ~PollTable();
+
+    PollTable(const PollTable&)=delete;
+    PollTable& operator=(const PollTable&)=delete;
+
+private:
+    /**
+     * Called by PollQueue::IRQwakeup()
+     */
+    void IRQwakeup();
+
+    friend class PollQueue;
+
+    static const unsigned int maxEntries=2*MAX_OPEN_FILES;
+    static const int overflowPollTime=10000000; //10ms
+
+    PollEntry entries[maxEntries];  ///< Queues the table is registered on
+    unsigned int numEntries=0;      ///< Number of used entries
+    long long period=-1;            ///< Periodic wakeup, or -1 if not needed
+    Thread *waiting=nullptr;        ///< Thread waiting in wait(), if any
+    volatile bool woken=false;      ///< A queue was woken up
+    bool registering;               ///< True if add() registers the table
+};
+
+#endif //WITH_FILESYSTEM
+
+} //namespace miosix
@@ -0,0 +1,388 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include "procfs.h"
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include "kernel/process.h"
+
+using namespace std;
+
+#ifdef WITH_PROCFS
+
+namespace miosix {
+
+static void fillStatHelper(struct stat* pstat, unsigned int st_ino,
+        short st_dev, mode_t mode)
+{
+    memset(pstat,0,sizeof(struct stat));
+    pstat->st_dev=st_dev;
+    pstat->st_ino=st_ino;
+    pstat->st_mode=mode;
+    pstat->st_nlink=1;
+    pstat->st_blksize=0; //If zero means file buffer equals to BUFSIZ
+}
+
+/**
+ * Append formatted text to a string
+ * \param s string where to append the text
+ * \param fmt printf-like format string, only integers are supported
+ */
+static void append(string& s, const char *fmt, ...)
+{
+    char line[64];
+    va_list arg;
+    va_start(arg,fmt);
+    int len=vsniprintf(line,sizeof(line),fmt,arg);
+    va_end(arg);
+    s.append(line,min<int>(len,sizeof(line)-1));
+}
+
+/**
+ * Append a CPU time to a string, in seconds with microsecond resolution
+ * \param s string where to append the time
+ * \param ns CPU time in nanoseconds, or a negative number if not available
+ */
+static void appendCpuTime(string& s, long long ns)
+{
+    if(ns<0) s+="-";
+    else append(s,"%u.%06u",static_cast<unsigned int>(ns/1000000000),
+                static_cast<unsigned int>(ns%1000000000/1000));
+}
+
+/**
+ * File type for the files in the directory of a process
+ */
+class ProcFsFile : public FileBase
+{
+public:
+    /**
+     * Constructor
+     * \param parent pointer to ProcFs
+     * \param pid process pid
+     * \param entry which file
+     */
+    ProcFsFile(intrusive_ref_ptr<FilesystemBase> parent, pid_t pid,
+            ProcFs::Entry entry) : FileBase(parent,O_RDONLY), pid(pid),
+            entry(entry), seekPoint(0) {}
+
+    /**
+     * Write data to the file, if the file supports writing.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \return the number of written characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t write(const void *data, size_t len);
+
+    /**
+     * Read data from the file, if the file supports reading.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \return the number of read characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t read(void *data, size_t len);
+
+    /**
+     * Move file pointer, if the file supports random-access.
+     * \param pos offset to sum to the beginning of the file, current position
+     * or end of file, depending on whence
+     * \param whence SEEK_SET, SEEK_CUR or SEEK_END
+     * \return the offset from the beginning of the file if the operation
+     * completed, or a negative number in case of errors
+     */
+    virtual off_t lseek(off_t pos, int whence);
+
+    /**
+     * Truncate the file
+     * \param size new file size
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int ftruncate(off_t size);
+
+    /**
+     * Return file information.
+     * \param pstat pointer to stat struct
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fstat(struct stat *pstat) const;
+
+private:
+    const pid_t pid;
+    const ProcFs::Entry entry;
+    string content;  ///< Generated when reading from the beginning
+    off_t seekPoint; ///< Seek point (note that off_t is 64bit)
+};
+
+ssize_t ProcFsFile::write(const void *data, size_t len) { return -EBADF; }
+
+ssize_t ProcFsFile::read(void *data, size_t len)
+{
+    if(seekPoint==0)
+    {
+        content.clear();
+        int result=ProcFs::generate(pid,entry,content);
+        if(result<0) return result;
+    }
+    if(seekPoint>=static_cast<off_t>(content.size())) return 0;
+    size_t toRead=min<size_t>(len,content.size()-seekPoint);
+    memcpy(data,content.data()+seekPoint,toRead);
+    seekPoint+=toRead;
+    return toRead;
+}
+
+off_t ProcFsFile::lseek(off_t pos, int whence)
+{
+    off_t newSeekPoint=seekPoint;
+    switch(whence)
+    {
+        case SEEK_CUR:
+            newSeekPoint+=pos;
+            break;
+        case SEEK_SET:
+            newSeekPoint=pos;
+            break;
+        default:
+            return -EINVAL; //The size is only known after reading
+    }
+    if(newSeekPoint<0) return -EOVERFLOW;
+    seekPoint=newSeekPoint;
+    return seekPoint;
+}
+
+int ProcFsFile::ftruncate(off_t size) { return -EROFS; }
+
+int ProcFsFile::fstat(struct stat *pstat) const
+{
+    //As in Linux, the size is reported as zero as the content is generated
+    fillStatHelper(pstat,ProcFs::inode(pid,entry),getParent()->getFsId(),
+                   S_IFREG | 0444); //-r--r--r--
+    return 0;
+}
+
+/**
+ * Directory class for ProcFs, both for the root directory and the directory
+ * of a process
+ */
+class ProcFsDirectory : public DirectoryBase
+{
+public:
+    /**
+     * Constructor
+     * \param parent pointer to ProcFs
+     * \param pid process pid, 0 for the root directory
+     */
+    ProcFsDirectory(intrusive_ref_ptr<FilesystemBase> parent, pid_t pid)
+            : DirectoryBase(parent), pid(pid) {}
+
+    /**
+     * Also directories can be opened as files. In this case, this system
+     * call allows to retrieve directory entries.
+     * \param dp pointer to a memory buffer where one or more struct dirent
+     * will be placed. dp must be four words aligned.
+     * \param len memory buffer size.
+     * \return the number of bytes read on success, or a negative number on
+     * failure.
+     */
+    virtual int getdents(void *dp, int len);
+
+private:
+    const pid_t pid;
+    vector<pid_t> pids;     ///< Processes listed in the root directory
+    unsigned int index=0;   ///< First unhandled directory entry
+    bool first=true;        ///< True if first time getdents is called
+};
+
+int ProcFsDirectory::getdents(void *dp, int len)
+{
+    if(len<minimumBufferSize) return -EINVAL;
+
+    char *begin=reinterpret_cast<char*>(dp);
+    char *buffer=begin;
+    char *end=buffer+len;
+    if(first)
+    {
+        first=false;
+        if(pid==0)
+        {
+            //Processes created or deleted while listing are not noticed
+            pids=Process::getPids();
+            addDefaultEntries(&buffer,ProcFs::rootDirInode,
+                              getParent()->getParentFsMountpointInode());
+        } else {
+            addDefaultEntries(&buffer,ProcFs::inode(pid,ProcFs::Directory),
+                              ProcFs::rootDirInode);
+        }
+    }
+    if(pid==0)
+    {
+        for(;index<pids.size();index++)
+        {
+            char name[12];
+            sniprintf(name,sizeof(name),"%d",pids[index]);
+            if(addEntry(&buffer,end,ProcFs::inode(pids[index],ProcFs::Directory),
+                        DT_DIR,name)<0) return buffer-begin;
+        }
+    } else {
+        static const char *names[]={"status","threads","syscalls"};
+        for(;index<3;index++)
+        {
+            auto entry=static_cast<ProcFs::Entry>(ProcFs::Status+index);
+            if(addEntry(&buffer,end,ProcFs::inode(pid,entry),DT_REG,
+                        names[index])<0) return buffer-begin;
+        }
+    }
+    addTerminatingEntry(&buffer,end);
+    return buffer-begin;
+}
+
+//
+// class ProcFs
+//
+
+ProcFs::ProcFs() {}
+
+int ProcFs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
+        int flags, int mode)
+{
+    if(flags & (O_APPEND | O_EXCL | O_WRONLY | O_RDWR)) return -EROFS;
+    pid_t pid;
+    Entry entry;
+    int result=parse(name,pid,entry);
+    if(result<0) return result;
+    if(entry==Directory)
+        file=intrusive_ref_ptr<FileBase>(
+            new ProcFsDirectory(shared_from_this(),pid));
+    else file=intrusive_ref_ptr<FileBase>(
+            new ProcFsFile(shared_from_this(),pid,entry));
+    return 0;
+}
+
+int ProcFs::lstat(StringPart& name, struct stat *pstat)
+{
+    pid_t pid;
+    Entry entry;
+    int result=parse(name,pid,entry);
+    if(result<0) return result;
+    if(pid==0)
+        fillStatHelper(pstat,rootDirInode,getFsId(),S_IFDIR | 0555);//dr-xr-xr-x
+    else if(entry==Directory)
+        fillStatHelper(pstat,inode(pid,entry),getFsId(),S_IFDIR | 0555);
+    else fillStatHelper(pstat,inode(pid,entry),getFsId(),S_IFREG | 0444);
+    return 0;
+}
+
+int ProcFs::truncate(StringPart& name, off_t size) { return -EROFS; }
+int ProcFs::unlink(StringPart& name) { return -EROFS; }
+int ProcFs::rename(StringPart& oldName, StringPart& newName) { return -EROFS; }
+int ProcFs::mkdir(StringPart& name, int mode) { return -EROFS; }
+int ProcFs::rmdir(StringPart& name) { return -EROFS; }
+
+int ProcFs::generate(pid_t pid, Entry entry, string& content)
+{
+    //ProcessInfo is too large to be allocated on the stack
+    unique_ptr<Process::ProcessInfo> info(new Process::ProcessInfo);
+    int result=Process::getInfo(pid,*info);
+    if(result<0) return result;
+    switch(entry)
+    {
+        case Status:
+        {
+            unsigned int syscalls=0;
+            for(auto count : info->syscalls) syscalls+=count;
+            append(content,"pid: %d\nppid: %d\nstate: %s\n",info->pid,
+                   info->ppid,info->zombie ? "zombie" : "running");
+            append(content,"program: %u (%s)\n",info->elfSize,
+                   info->elfInRam ? "ram" : "xip");
+            append(content,"image: %u\ndata+bss: %u\nheap used: %u\n",
+                   info->imageSize,info->dataBssSize,info->heapUsed);
+            append(content,"open files: %d\nthreads: %u\nsyscalls: %u\n",
+                   info->openFiles,
+                   static_cast<unsigned int>(info->threads.size()),syscalls);
+            content+="cpu time: ";
+            appendCpuTime(content,info->cpuTime);
+            content+="\n";
+            break;
+        }
+        case Threads:
+            content+="tid cpu_time stack_used stack_size"
+                     " kstack_used kstack_size\n";
+            for(auto& t : info->threads)
+            {
+                append(content,"%d ",t.tid);
+                appendCpuTime(content,t.cpuTime);
+                append(content," %u %u %u %u\n",t.stackUsed,t.stackSize,
+                       t.kernelStackUsed,t.kernelStackSize);
+            }
+            break;
+        case Syscalls:
+            for(unsigned int i=0;i<NUM_SYSCALLS;i++)
+                if(info->syscalls[i]) append(content,"%u %u\n",i,info->syscalls[i]);
+            break;
+        default:
+            return -EISDIR;
+    }
+    return 0;
+}
+
+int ProcFs::parse(StringPart& name, pid_t& pid, Entry& entry)
+{
+    pid=0;
+    entry=Directory;
+    if(name.empty()) return 0; //Root directory
+    const char *s=name.c_str();
+    unsigned int i=0;
+    for(;s[i]>='0' && s[i]<='9';i++)
+    {
+        if(pid>100000000) return -ENOENT; //Prevent overflow
+        pid=pid*10+s[i]-'0';
+    }
+    if(i==0 || pid<=0) return -ENOENT;
+    if(s[i]=='/')
+    {
+        const char *file=s+i+1;
+        if(strcmp(file,"status")==0) entry=Status;
+        else if(strcmp(file,"threads")==0) entry=Threads;
+        else if(strcmp(file,"syscalls")==0) entry=Syscalls;
+        else return -ENOENT;
+    } else if(s[i]!='\0') return -ENOENT;
+    //Only report existing processes
+    if(Process::getppid(pid)<0) return -ENOENT;
+    return 0;
+}
+
+} //namespace miosix
+
+#endif //WITH_PROCFS
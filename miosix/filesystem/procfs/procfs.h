@@ -0,0 +1,161 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include <string>
+#include "filesystem/file.h"
+#include "filesystem/stringpart.h"
+#include "miosix_settings.h"
+
+#ifdef WITH_PROCFS
+
+namespace miosix {
+
+/**
+ * ProcFs is a read-only filesystem that reports the resource usage of
+ * processes, so that it can be monitored with ordinary file reads. It contains
+ * a directory for each process, named after its pid, with the following files:
+ * - status: memory usage, open files, syscall count and CPU time
+ * - threads: CPU time and stack usage of each thread
+ * - syscalls: number of calls of each syscall, by syscall id
+ * The content of a file is generated when it is read from the beginning.
+ */
+class ProcFs : public FilesystemBase
+{
+public:
+    /**
+     * Files within the directory of a process
+     */
+    enum Entry
+    {
+        Directory=0, ///< The process directory itself
+        Status=1,    ///< status file
+        Threads=2,   ///< threads file
+        Syscalls=3   ///< syscalls file
+    };
+
+    /**
+     * Constructor
+     */
+    ProcFs();
+
+    /**
+     * Open a file
+     * \param file the file object will be stored here, if the call succeeds
+     * \param name the name of the file to open, relative to the local
+     * filesystem
+     * \param flags file flags (open for reading, writing, ...)
+     * \param mode file permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
+            int flags, int mode);
+
+    /**
+     * Obtain information on a file, identified by a path name. Does not follow
+     * symlinks
+     * \param name path name, relative to the local filesystem
+     * \param pstat file information is stored here
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int lstat(StringPart& name, struct stat *pstat);
+
+    /**
+     * Change file size
+     * \param name path name, relative to the local filesystem
+     * \param size new file size
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int truncate(StringPart& name, off_t size);
+
+    /**
+     * Remove a file or directory
+     * \param name path name of file or directory to remove
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int unlink(StringPart& name);
+
+    /**
+     * Rename a file or directory
+     * \param oldName old file name
+     * \param newName new file name
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int rename(StringPart& oldName, StringPart& newName);
+
+    /**
+     * Create a directory
+     * \param name directory name
+     * \param mode directory permissions
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int mkdir(StringPart& name, int mode);
+
+    /**
+     * Remove a directory if empty
+     * \param name directory name
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int rmdir(StringPart& name);
+
+    /**
+     * \internal
+     * Generate the content of a file
+     * \param pid process pid
+     * \param entry which file, must not be Directory
+     * \param content the file content is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    static int generate(pid_t pid, Entry entry, std::string& content);
+
+    /**
+     * \internal
+     * \param pid process pid, must be greater than zero
+     * \param entry file within the process directory
+     * \return the inode of the file
+     */
+    static int inode(pid_t pid, Entry entry) { return pid*4+entry; }
+
+    static const int rootDirInode=1; ///< Lower than the inode of any process
+
+private:
+    /**
+     * Parse a path
+     * \param name path name, relative to the local filesystem
+     * \param pid the pid of the process is returned here, 0 for the root
+     * directory
+     * \param entry the file within the process directory is returned here
+     * \return 0 on success, or a negative number if the path does not exist
+     */
+    static int parse(StringPart& name, pid_t& pid, Entry& entry);
+};
+
+} //namespace miosix
+
+#endif //WITH_PROCFS
@@ -27,6 +27,7 @@
 
 #include "romfs.h"
 #include <string>
+#include <new>
 #include <errno.h>
 #include <fcntl.h>
 #include "filesystem/path.h"
@@ -41,6 +42,8 @@ using namespace std;
 
 namespace miosix {
 
+static_assert(ROMFS_BLOCK_CACHE_SIZE>=1,"ROMFS_BLOCK_CACHE_SIZE must be at least 1");
+
 const void *getRomFsAddressAfterKernel()
 {
     // We don't (yet) have a symbol marking the end of the kernel, but we can
@@ -99,6 +102,61 @@ static const RomFsDirectoryEntry *nextEntry(const RomFsDirectoryEntry *entry)
         (last+romFsStructAlignment-1) & (0-romFsStructAlignment));
 }
 
+/**
+ * Decompress data in the LZ4 block format
+ * \param src compressed data
+ * \param srcLen compressed data size
+ * \param dst buffer where decompressed data is stored
+ * \param dstLen buffer size
+ * \return the decompressed data size, or -1 if the compressed data is corrupted
+ * or does not fit in the buffer
+ */
+static int lz4Decompress(const unsigned char *src, unsigned int srcLen,
+                         unsigned char *dst, unsigned int dstLen)
+{
+    const unsigned char *srcEnd=src+srcLen;
+    unsigned char *dstStart=dst;
+    unsigned char *dstEnd=dst+dstLen;
+    auto getLength=[&](unsigned int& len)
+    {
+        if(len!=15) return true;
+        unsigned char b;
+        do {
+            if(src>=srcEnd) return false;
+            b=*src++;
+            len+=b;
+        } while(b==255);
+        return true;
+    };
+    for(;;)
+    {
+        if(src>=srcEnd) return -1;
+        unsigned char token=*src++;
+        //Literals
+        unsigned int len=token>>4;
+        if(getLength(len)==false) return -1;
+        if(len>static_cast<unsigned int>(srcEnd-src)) return -1;
+        if(len>static_cast<unsigned int>(dstEnd-dst)) return -1;
+        memcpy(dst,src,len);
+        dst+=len;
+        src+=len;
+        if(src==srcEnd) break; //Last sequence has only literals
+        //Match
+        if(srcEnd-src<2) return -1;
+        unsigned int offset=src[0] | src[1]<<8;
+        src+=2;
+        if(offset==0 || offset>static_cast<unsigned int>(dst-dstStart)) return -1;
+        len=token & 0xf;
+        if(getLength(len)==false) return -1;
+        len+=4; //Minimum match length
+        if(len>static_cast<unsigned int>(dstEnd-dst)) return -1;
+        //Byte by byte copy as source and destination may overlap
+        const unsigned char *match=dst-offset;
+        for(unsigned int i=0;i<len;i++) *dst++=*match++;
+    }
+    return dst-dstStart;
+}
+
 /**
  * File class for MemoryMappedRomFs
  */
@@ -110,10 +168,13 @@ public:
      * \param parent pointer to parent filesystem
      * \param flags file open flags
      * \param entry directory entry containing the file information
+     * \param compressed compressed file header, or nullptr if the file is
+     * not compressed
      */
     MemoryMappedRomFsFile(intrusive_ref_ptr<FilesystemBase> parent, int flags,
-            const RomFsDirectoryEntry *entry) : FileBase(parent,flags),
-            entry(entry), seekPoint(0) {}
+            const RomFsDirectoryEntry *entry,
+            const RomFsCompressedFile *compressed) : FileBase(parent,flags),
+            entry(entry), compressed(compressed), seekPoint(0) {}
 
     /**
      * Write data to the file, if the file supports writing.
@@ -132,6 +193,25 @@ public:
      * case of errors
      */
     virtual ssize_t read(void *data, size_t len);
+
+    /**
+     * Read data from the given position without moving the file pointer.
+     * \param data buffer to store read data
+     * \param len the number of bytes to read
+     * \param pos offset from the beginning of the file
+     * \return the number of read characters, or a negative number in
+     * case of errors
+     */
+    virtual ssize_t pread(void *data, size_t len, off_t pos);
+
+    /**
+     * Write data at the given position, not supported by a read-only fs.
+     * \param data the data to write
+     * \param len the number of bytes to write
+     * \param pos offset from the beginning of the file
+     * \return a negative number as the operation always fails
+     */
+    virtual ssize_t pwrite(const void *data, size_t len, off_t pos);
     
     /**
      * Move file pointer, if the file supports random-access.
@@ -169,6 +249,7 @@ public:
 
 private:
     const RomFsDirectoryEntry * const entry;
+    const RomFsCompressedFile * const compressed; ///< nullptr if uncompressed
     off_t seekPoint; ///< Seek point (note that off_t is 64bit)
 };
 
@@ -176,19 +257,33 @@ ssize_t MemoryMappedRomFsFile::write(const void *data, size_t len) { return -EIN
 
 ssize_t MemoryMappedRomFsFile::read(void *data, size_t len)
 {
+    ssize_t result=pread(data,len,seekPoint);
+    if(result>0) seekPoint+=result;
+    return result;
+}
+
+ssize_t MemoryMappedRomFsFile::pread(void *data, size_t len, off_t pos)
+{
+    if(pos<0) return -EINVAL;
     unsigned int size=fromLittleEndian32(entry->size);
-    if(seekPoint>=size) return 0;
-    size_t toRead=min<size_t>(len,size-seekPoint);
+    if(pos>=size) return 0;
+    size_t toRead=min<size_t>(len,size-pos);
     #ifdef __NO_EXCEPTIONS
     auto parent=static_pointer_cast<MemoryMappedRomFs>(getParent());
     #else
     auto parent=dynamic_pointer_cast<MemoryMappedRomFs>(getParent());
     #endif
-    memcpy(data,parent->ptr(fromLittleEndian32(entry->inode))+seekPoint,toRead);
-    seekPoint+=toRead;
+    if(compressed)
+        return parent->readCompressed(compressed,size,pos,data,toRead);
+    memcpy(data,parent->ptr(fromLittleEndian32(entry->inode))+pos,toRead);
     return toRead;
 }
 
+ssize_t MemoryMappedRomFsFile::pwrite(const void *data, size_t len, off_t pos)
+{
+    return -EINVAL;
+}
+
 off_t MemoryMappedRomFsFile::lseek(off_t pos, int whence)
 {
     off_t newSeekPoint=seekPoint;
@@ -221,6 +316,8 @@ int MemoryMappedRomFsFile::fstat(struct stat *pstat) const
 
 MemoryMappedFile MemoryMappedRomFsFile::getFileFromMemory()
 {
+    //Compressed files are not stored as-is, so they can't be accessed directly
+    if(compressed) return MemoryMappedFile(nullptr,0);
     #ifdef __NO_EXCEPTIONS
     auto parent=static_pointer_cast<MemoryMappedRomFs>(getParent());
     #else
@@ -303,14 +400,26 @@ int MemoryMappedRomFsDirectory::getdents(void *dp, int len)
 //
 
 MemoryMappedRomFs::MemoryMappedRomFs(const void *baseAddress)
-    : base(reinterpret_cast<const char*>(baseAddress)), failed(false)
+    : base(reinterpret_cast<const char*>(baseAddress)), failed(false),
+      dirIndex(false), compression(false)
 {
     auto header=ptr<const RomFsHeader*>(0);
-    if(strncmp(header->fsName,"RomFs 2.01",11)==0) return;
+    if(strncmp(header->fsName,"RomFs 2.01",11)==0)
+    {
+        unsigned int features=fromLittleEndian32(header->features);
+        dirIndex=features & romFsFeatureDirIndex;
+        compression=features & romFsFeatureCompression;
+        return;
+    }
     errorLog("Unexpected FS version %s\n",header->fsName);
     failed=true;
 }
 
+MemoryMappedRomFs::~MemoryMappedRomFs()
+{
+    for(auto& b : blockCache) delete[] b.data;
+}
+
 int MemoryMappedRomFs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
         int flags, int mode)
 {
@@ -322,7 +431,7 @@ int MemoryMappedRomFs::open(intrusive_ref_ptr<FileBase>& file, StringPart& name,
     {
         case S_IFREG:
             file=intrusive_ref_ptr<FileBase>(new MemoryMappedRomFsFile(
-                shared_from_this(),flags,entry));
+                shared_from_this(),flags,entry,compressedFile(entry)));
             break;
         case S_IFDIR:
             file=intrusive_ref_ptr<FileBase>(new MemoryMappedRomFsDirectory(
@@ -363,6 +472,85 @@ int MemoryMappedRomFs::readlink(StringPart& name, string& target)
 
 bool MemoryMappedRomFs::supportsSymlinks() const { return true; }
 
+const RomFsCompressedFile *MemoryMappedRomFs::compressedFile(
+        const RomFsDirectoryEntry *entry)
+{
+    if(compression==false) return nullptr;
+    if(fromLittleEndian32(entry->size)<sizeof(romFsCompressedMagic)) return nullptr;
+    auto file=ptr<const RomFsCompressedFile*>(fromLittleEndian32(entry->inode));
+    if(memcmp(file->magic,romFsCompressedMagic,sizeof(romFsCompressedMagic)))
+        return nullptr;
+    return file;
+}
+
+ssize_t MemoryMappedRomFs::readCompressed(const RomFsCompressedFile *file,
+        unsigned int size, unsigned int offset, void *data, unsigned int len)
+{
+    unsigned int blockSize=fromLittleEndian32(file->blockSize);
+    if(blockSize==0 || blockSize>romFsMaxBlockSize) return -EIO;
+    char *buffer=reinterpret_cast<char*>(data);
+    ssize_t done=0;
+    Lock<KernelMutex> l(cacheMutex);
+    while(done<static_cast<ssize_t>(len))
+    {
+        unsigned int block=(offset+done)/blockSize;
+        unsigned int blockOffset=(offset+done)%blockSize;
+        unsigned int blockLen=min(blockSize,size-block*blockSize);
+        const char *blockData;
+        if(int res=getBlock(file,block,blockLen,blockData))
+            return done>0 ? done : res;
+        unsigned int toCopy=min<unsigned int>(len-done,blockLen-blockOffset);
+        memcpy(buffer+done,blockData+blockOffset,toCopy);
+        done+=toCopy;
+    }
+    return done;
+}
+
+int MemoryMappedRomFs::getBlock(const RomFsCompressedFile *file,
+        unsigned int block, unsigned int blockLen, const char *& result)
+{
+    unsigned int start=fromLittleEndian32(file->blocks[block]);
+    unsigned int end=fromLittleEndian32(file->blocks[block+1]);
+    if(end<start) return -EIO;
+    auto blockData=reinterpret_cast<const char*>(file)+start;
+    //Blocks that would not get smaller are stored uncompressed
+    if(end-start==blockLen)
+    {
+        result=blockData;
+        return 0;
+    }
+    CachedBlock *cached=&blockCache[0];
+    for(auto& b : blockCache)
+    {
+        if(b.file==file && b.block==block)
+        {
+            b.lastUse=++useCounter;
+            result=b.data;
+            return 0;
+        }
+        if(b.lastUse<cached->lastUse) cached=&b;
+    }
+    //Not found, replace the least recently used block
+    cached->file=nullptr;
+    if(cached->bufSize<blockLen)
+    {
+        delete[] cached->data;
+        cached->bufSize=0;
+        cached->data=new (nothrow) char[blockLen];
+        if(cached->data==nullptr) return -ENOMEM;
+        cached->bufSize=blockLen;
+    }
+    int decompressed=lz4Decompress(
+        reinterpret_cast<const unsigned char*>(blockData),end-start,
+        reinterpret_cast<unsigned char*>(cached->data),blockLen);
+    if(decompressed!=static_cast<int>(blockLen)) return -EIO;
+    cached->file=file;
+    cached->block=block;
+    cached->lastUse=++useCounter;
+    result=cached->data;
+    return 0;
+}
+
 const RomFsDirectoryEntry *MemoryMappedRomFs::findEntry(StringPart& name)
 {
     auto entry=ptr<const RomFsDirectoryEntry *>(sizeof(RomFsHeader));
@@ -372,18 +560,48 @@ const RomFsDirectoryEntry *MemoryMappedRomFs::findEntry(StringPart& name)
     {
         if((fromLittleEndian16(entry->mode) & S_IFMT)!=S_IFDIR) return nullptr;
         unsigned int inode=fromLittleEndian32(entry->inode);
-        const void *end=ptr(inode+fromLittleEndian32(entry->size));
-        entry=ptr<const RomFsDirectoryEntry *>(inode+sizeof(RomFsFirstEntry));
-        while(entry<end)
-        {
-            if(strcmp(element->c_str(),entry->name)==0) break;
-            entry=nextEntry(entry);
-        }
-        if(entry>=end) return nullptr; //Not found
+        unsigned int size=fromLittleEndian32(entry->size);
+        if(dirIndex) entry=findEntryIndexed(inode,size,element->c_str());
+        else entry=findEntryLinear(inode,size,element->c_str());
+        if(entry==nullptr) return nullptr; //Not found
     }
     return entry;
 }
 
+const RomFsDirectoryEntry *MemoryMappedRomFs::findEntryLinear(
+        unsigned int inode, unsigned int size, const char *name)
+{
+    const void *end=ptr(inode+size);
+    auto entry=ptr<const RomFsDirectoryEntry *>(inode+sizeof(RomFsFirstEntry));
+    while(entry<end)
+    {
+        if(strcmp(name,entry->name)==0) return entry;
+        entry=nextEntry(entry);
+    }
+    return nullptr;
+}
+
+const RomFsDirectoryEntry *MemoryMappedRomFs::findEntryIndexed(
+        unsigned int inode, unsigned int size, const char *name)
+{
+    //The index starts right after the last directory entry
+    unsigned int indexOffset=inode+size;
+    indexOffset=(indexOffset+romFsStructAlignment-1) & (0-romFsStructAlignment);
+    auto index=ptr<const RomFsDirectoryIndex *>(indexOffset);
+    //Binary search, entries are sorted by name
+    unsigned int lo=0, hi=fromLittleEndian32(index->count);
+    while(lo<hi)
+    {
+        unsigned int mid=lo+(hi-lo)/2;
+        auto entry=ptr<const RomFsDirectoryEntry *>(
+            fromLittleEndian32(index->entries[mid]));
+        int cmp=strcmp(name,entry->name);
+        if(cmp==0) return entry;
+        if(cmp<0) hi=mid; else lo=mid+1;
+    }
+    return nullptr;
+}
+
 } //namespace miosix
 
 #endif //WITH_FILESYSTEM
@@ -29,12 +29,14 @@
 
 #include "filesystem/file.h"
 #include "filesystem/stringpart.h"
+#include "kernel/sync.h"
 #include "miosix_settings.h"
 
 #ifdef WITH_FILESYSTEM
 
 //Forward decl
 struct RomFsDirectoryEntry;
+struct RomFsCompressedFile;
 
 namespace miosix {
 
@@ -58,6 +60,11 @@ public:
      * where the RomFs is stored
      */
     MemoryMappedRomFs(const void *baseAddress);
+
+    /**
+     * Destructor
+     */
+    ~MemoryMappedRomFs();
     
     /**
      * Open a file
@@ -147,6 +154,27 @@ public:
      */
     template<typename T=const char*>
     T ptr(unsigned int offset) { return reinterpret_cast<T>(base+offset); }
+
+    /**
+     * \internal
+     * \param entry directory entry of a regular file
+     * \return the compressed file header if the file is compressed, or nullptr
+     */
+    const RomFsCompressedFile *compressedFile(const RomFsDirectoryEntry *entry);
+
+    /**
+     * \internal
+     * Read from a compressed file
+     * \param file compressed file header
+     * \param size uncompressed file size
+     * \param offset offset within the file where to start reading, must be
+     * less than size
+     * \param data buffer where to store read data
+     * \param len number of bytes to read, offset+len must not exceed size
+     * \return the number of read bytes, or a negative number on failure
+     */
+    ssize_t readCompressed(const RomFsCompressedFile *file, unsigned int size,
+            unsigned int offset, void *data, unsigned int len);
     
 private:
     /**
@@ -155,8 +183,59 @@ private:
      */
     const RomFsDirectoryEntry *findEntry(StringPart& name);
 
+    /**
+     * Find an entry in a directory by scanning all its entries, works with
+     * all images
+     * \param inode directory inode
+     * \param size directory size
+     * \param name name of the entry to find
+     * \return corresponding entry if found, or nullptr
+     */
+    const RomFsDirectoryEntry *findEntryLinear(unsigned int inode,
+            unsigned int size, const char *name);
+
+    /**
+     * Find an entry in a directory by binary search in the directory index,
+     * requires an image with the romFsFeatureDirIndex feature
+     * \param inode directory inode
+     * \param size directory size
+     * \param name name of the entry to find
+     * \return corresponding entry if found, or nullptr
+     */
+    const RomFsDirectoryEntry *findEntryIndexed(unsigned int inode,
+            unsigned int size, const char *name);
+
+    /**
+     * Get a block of a compressed file, decompressing it in the block cache if
+     * needed. Must be called with cacheMutex locked
+     * \param file compressed file header
+     * \param block block number
+     * \param blockLen uncompressed block size
+     * \param result pointer to the uncompressed block data
+     * \return 0 on success, or a negative number on failure
+     */
+    int getBlock(const RomFsCompressedFile *file, unsigned int block,
+            unsigned int blockLen, const char *& result);
+
+    /**
+     * A decompressed block of a compressed file
+     */
+    struct CachedBlock
+    {
+        const RomFsCompressedFile *file=nullptr; ///< File, nullptr if unused
+        unsigned int block=0;    ///< Block number within the file
+        unsigned int lastUse=0;  ///< For least recently used replacement
+        unsigned int bufSize=0;  ///< Size of the data buffer
+        char *data=nullptr;      ///< Decompressed data, allocated on first use
+    };
+
     const char * const base;
-    bool failed; ///< Failed to mount
+    bool failed;      ///< Failed to mount
+    bool dirIndex;    ///< Image has directory indices
+    bool compression; ///< Image has compressed files
+    KernelMutex cacheMutex; ///< Protects the block cache
+    CachedBlock blockCache[ROMFS_BLOCK_CACHE_SIZE];
+    unsigned int useCounter=0;
 };
 
 } //namespace miosix
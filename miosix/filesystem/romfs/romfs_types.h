@@ -38,7 +38,25 @@ struct RomFsHeader
     char fsName[11];           ///< "RomFs 2.00", null terminated
     char osName[7];            ///< "Miosix", null terminated
     unsigned int imageSize;    ///< Size of the entire filesystem image
-    unsigned int unused;       ///< Reserved for future use, set as 0 for now
+    unsigned int features;     ///< Bitmask of RomFsFeatures, 0 in older images
+};
+
+/**
+ * Optional features of a RomFs image, stored in RomFsHeader::features.
+ * Images produced before a feature was introduced have the corresponding bit
+ * cleared, and features are designed so that older kernels that do not know
+ * about them can still read the image.
+ */
+enum RomFsFeatures
+{
+    /// Every directory inode is followed by a RomFsDirectoryIndex. The index is
+    /// placed after the last directory entry, aligned to romFsStructAlignment,
+    /// and is not included in the directory size, so that older kernels ignore
+    /// it
+    romFsFeatureDirIndex=1,
+    /// Some regular files are compressed, see RomFsCompressedFile. Older
+    /// kernels can read the image, but not the content of compressed files
+    romFsFeatureCompression=2
 };
 
 /**
@@ -61,6 +79,42 @@ struct __attribute__((packed)) RomFsDirectoryEntry
     char name[];              ///< File name, null teminated
 };
 
+/**
+ * Directory index, allowing binary search of directory entries by name
+ */
+struct RomFsDirectoryIndex
+{
+    unsigned int count;        ///< Number of directory entries
+    unsigned int entries[];    ///< Offset of entries, sorted as by strcmp()
+};
+
+/**
+ * Header of a compressed regular file. If the image has the
+ * romFsFeatureCompression feature, every regular file whose content starts with
+ * romFsCompressedMagic is compressed, and mx-buildromfs guarantees that no
+ * uncompressed file starts with it.
+ *
+ * The size field of the directory entry is the uncompressed file size.
+ * The file content is split in blocks of blockSize bytes (the last one may be
+ * shorter), each compressed independently using the LZ4 block format, so that
+ * random access only requires decompressing one block. Blocks that would not
+ * get smaller are stored uncompressed, and can be identified as their stored
+ * size is equal to their uncompressed size.
+ */
+struct RomFsCompressedFile
+{
+    char magic[4];             ///< romFsCompressedMagic
+    unsigned int blockSize;    ///< Uncompressed block size
+    unsigned int blocks[];     ///< Offset of blocks from the start of this
+                               ///< struct, with an additional one at the end
+};
+
+/// Marker of compressed files
+const char romFsCompressedMagic[4]={'\x89','L','Z','4'};
+/// Maximum block size of compressed files, limits the RAM used for
+/// decompression. Must be a power of 2
+const unsigned int romFsMaxBlockSize=4096;
+
 /// Alignment of all filesystem data structures. Must be a power of 2. Chosen as
 /// 4 bytes for compatibility to architectures without unaligned memory accesses
 const unsigned int romFsStructAlignment=4;
@@ -78,3 +132,5 @@ static_assert(romFsImageAlignment>=romFsStructAlignment,"");
 static_assert(sizeof(RomFsHeader)==32,"");
 static_assert(sizeof(RomFsFirstEntry)==4,"");
 static_assert(sizeof(RomFsDirectoryEntry)==14,"");
+static_assert(sizeof(RomFsDirectoryIndex)==4,"");
+static_assert(sizeof(RomFsCompressedFile)==8,"");
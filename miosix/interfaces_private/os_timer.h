@@ -34,6 +34,7 @@
 
 #include "miosix_settings.h"
 #include "kernel/timeconversion.h"
+#include "kernel/time_page.h"
 
 /**
  * \addtogroup Interfaces
@@ -275,6 +276,20 @@ void IRQosTimerSetTime(long long ns) noexcept;
  */
 unsigned int osTimerGetFrequency();
 
+/**
+ * \internal
+ * It is used by the kernel, and should not be used by end users.
+ * Fill a process time page so that processes can compute the time by reading
+ * the hardware timer directly. Timers that support this must also call
+ * TimePage::IRQupdate() every time the software extended upper bits of the
+ * tick count change.
+ * Must be called with interrupts disabled.
+ * \param page time page to fill
+ * \return false if the timer registers can't be read by processes, in this
+ * case processes get the time through a syscall
+ */
+bool IRQosTimerInitTimePage(time_page& page) noexcept;
+
 /**
  * Helper class providing a generic implementation capable of providing time
  * in nanoseconds starting from a hardware timer.
@@ -313,6 +328,9 @@ unsigned int osTimerGetFrequency();
  *     void IRQinitTimer() {}
  * };
  * \endcode
+ * Timers whose counter and overflow flag can be read without side effects can
+ * additionally provide IRQgetCounterRegister(), IRQgetOverflowRegister() and
+ * IRQgetOverflowMask() to let processes read the time without syscalls.
  * 
  * \tparam D the derived class (see curiously recurring template pattern)
  * \tparam bits the bits of the underlying hardware timer, up to 32 bit.
@@ -407,6 +425,29 @@ public:
     {
         return irqNs;
     }
+
+    /**
+     * Fill a process time page, see IRQosTimerInitTimePage()
+     * \param page time page to fill
+     * \return false if the timer can't be read by processes
+     */
+    bool IRQinitTimePage(time_page& page)
+    {
+        page.counter=D::IRQgetCounterRegister();
+        if(page.counter==nullptr) return false;
+        page.status=D::IRQgetOverflowRegister();
+        page.overflow_mask=D::IRQgetOverflowMask();
+        page.to_ns_int=tc.getTick2nsConversion().integerPart();
+        page.to_ns_frac=tc.getTick2nsConversion().fractionalPart();
+        page.upper_tick=upperTimeTick;
+        page.upper_incr=upperIncr;
+        return true;
+    }
+
+    //Defaults for timers that processes can't read, drivers can shadow these
+    static const volatile unsigned int *IRQgetCounterRegister() { return nullptr; }
+    static const volatile unsigned int *IRQgetOverflowRegister() { return nullptr; }
+    static unsigned int IRQgetOverflowMask() { return 0; }
     
     /**
      * Set the current time
@@ -425,6 +466,9 @@ public:
             upperTimeTick = tick & upperMask;
             D::IRQsetTimerCounter(static_cast<unsigned int>(tick & lowerMask));
             D::IRQclearOverflowFlag();
+            #ifdef WITH_PROCESSES
+            TimePage::IRQupdate(upperTimeTick);
+            #endif //WITH_PROCESSES
             //Adjust also when the next interrupt will be fired, if it is set
             long long nextIrqTick = IRQgetIrqTick();
             if(nextIrqTick!=0x7FFFFFFFFFFFFFFFLL && nextIrqTick>oldTick)
@@ -516,6 +560,9 @@ public:
         {
             D::IRQclearOverflowFlag();
             upperTimeTick += upperIncr;
+            #ifdef WITH_PROCESSES
+            TimePage::IRQupdate(upperTimeTick);
+            #endif //WITH_PROCESSES
         }
     }
     
@@ -540,6 +587,9 @@ public:
     void IRQquirkIncrementUpperCounter()
     {
         upperTimeTick += upperIncr;
+        #ifdef WITH_PROCESSES
+        TimePage::IRQupdate(upperTimeTick);
+        #endif //WITH_PROCESSES
     }
 
     /**
@@ -614,6 +664,11 @@ unsigned int osTimerGetFrequency()                 \
 {                                                  \
     FastGlobalIrqLock dLock;                       \
     return timer.IRQTimerFrequency();              \
+}                                                  \
+                                                   \
+bool IRQosTimerInitTimePage(time_page& page) noexcept \
+{                                                  \
+    return timer.IRQinitTimePage(page);            \
 }
 
 /**
@@ -153,6 +153,19 @@ private:
  */
 inline unsigned int peekSyscallId(unsigned int *context);
 
+/**
+ * \internal
+ * Initialize a context that only serves to construct a SyscallParameters for a
+ * syscall that was not issued through its own supervisor call, such as each
+ * syscall of a batch.
+ * \param context array of CTXSAVE_SIZE elements to initialize
+ * \param id syscall id
+ * \param params array of MAX_NUM_SYSCALL_PARAMETERS syscall parameters, that
+ * will also receive the values set through SyscallParameters::setParameter()
+ */
+inline void initSyscallContext(unsigned int *context, unsigned int id,
+                               unsigned int *params);
+
 /**
  * \internal
  * This class contains information about whether a fault occurred in a process.
@@ -246,6 +259,17 @@ public:
      */
     static void IRQdisable();
 
+    /**
+     * This method is used in place of IRQdisable() when switching to the
+     * kernelspace side of a thread to serve one of the hot syscalls of this
+     * process, that is guaranteed not to touch the process code. Where the
+     * architecture allows it, the userspace MPU regions are left in place so
+     * that the following IRQenable() on the same core only needs to switch
+     * back to unprivileged mode instead of reprogramming the MPU.
+     * Can only be called inside an IRQ, not even with interrupts disabled.
+     */
+    void IRQdisableForSyscall();
+
     /**
      * Print the MPU configuration for debugging purposes
      */
@@ -286,8 +310,51 @@ public:
      */
     bool withinForReading(const char *str) const;
 
+    /**
+     * Add a non executable region to the process memory, used to map files
+     * stored in an XIP filesystem and shared memory objects. Only one such
+     * region is supported.
+     * Must be called with interrupts disabled as the configuration is read by
+     * context switches.
+     * \param base base address of the region, already rounded with
+     * roundRegionForMPU()
+     * \param size size of the region, already rounded with roundRegionForMPU()
+     * \param writable if true the region is read-write, otherwise read-only
+     * \return false if the architecture has no MPU region to spare
+     */
+    bool IRQaddMappedRegion(const unsigned int *base, unsigned int size,
+            bool writable);
+
+    /**
+     * Remove the region added with IRQaddMappedRegion(), if any.
+     * Must be called with interrupts disabled.
+     */
+    void IRQremoveMappedRegion();
+
+    /**
+     * Make a range of peripheral registers readable by all processes, used to
+     * let processes read the os timer counter. The region is shared by all
+     * processes and stays configured until reboot, the registers in the range
+     * must thus have no side effects when read.
+     * Must be called with interrupts disabled.
+     * \param base base address of the registers
+     * \param size size of the register range, will be rounded with
+     * roundRegionForMPU()
+     * \return false if the architecture has no MPU region to spare
+     */
+    static bool IRQaddPeripheralRegion(const unsigned int *base,
+            unsigned int size);
+
     //Uses default copy constructor and operator=
 private:
+    /**
+     * \param start start of the region added with IRQaddMappedRegion()
+     * \param end end of the region added with IRQaddMappedRegion()
+     * \return false if there is no such region, start and end are not
+     * modified in this case
+     */
+    bool mappedRegion(size_t& start, size_t& end) const;
+
     #ifndef __CORTEX_M
     #error Invalid MPUConfiguration for this architecture
     #endif
@@ -308,12 +375,20 @@ private:
     ///regions, one for the process code, one for data, and overlay them on top
     ///of the kernelspace MPU regions
     ///These value are copied into the MPU registers to configure them
-    ///Miosix processes only need two regions (code and data), since each MPU
-    ///region requires two registers to be configured, we need 4 registers
-    ///When no MPU is present, we reuse these 4 variables to just store the
-    ///start and end of the two regions (code, data) of the process
-    unsigned int regValues[4];
+    ///Miosix processes need two regions (code and data), plus an optional one
+    ///for file and shared memory mappings, since each MPU region requires two
+    ///registers to be configured, we need 6 registers
+    ///When no MPU is present, we reuse these 6 variables to just store the
+    ///start and end of the three regions (code, data, mapping) of the process
+    unsigned int regValues[6];
+    #if __MPU_PRESENT==1
+    ///Configuration whose regions are currently loaded in the MPU of each
+    ///core, used by IRQenable() to skip reprogramming the MPU when returning
+    ///from a syscall to the same process
+    static const MPUConfiguration *loaded[CPU_NUM_CORES];
+    #endif //__MPU_PRESENT==1
     #endif //defined(__CORTEX_M) && __CORTEX_M == 33 && __MPU_PRESENT==1
+    bool mapWritable=false; ///< True if the mapped region is read-write
 };
 
 #endif //WITH_PROCESSES
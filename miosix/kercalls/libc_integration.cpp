@@ -41,6 +41,7 @@
 #include "miosix_settings.h"
 //// Filesystem
 #include "filesystem/file_access.h"
+#include "filesystem/poll_table.h"
 //// Console
 #include "kernel/logging.h"
 //// kernel interface
@@ -428,6 +429,118 @@ ssize_t read(int fd, void *buf, size_t size)
     return _read_r(miosix::getReent(),fd,buf,size);
 }
 
+/**
+ * \internal
+ * pwrite, write to a file at a given position
+ */
+ssize_t pwrite(int fd, const void *buf, size_t size, off_t pos)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        ssize_t result=miosix::getFileDescriptorTable().pwrite(fd,buf,size,pos);
+        if(result>=0) return result;
+        miosix::getReent()->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        miosix::getReent()->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+
+    #else //WITH_FILESYSTEM
+    miosix::getReent()->_errno=EBADF;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+/**
+ * \internal
+ * pread, read from a file at a given position
+ */
+ssize_t pread(int fd, void *buf, size_t size, off_t pos)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        ssize_t result=miosix::getFileDescriptorTable().pread(fd,buf,size,pos);
+        if(result>=0) return result;
+        miosix::getReent()->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        miosix::getReent()->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+
+    #else //WITH_FILESYSTEM
+    miosix::getReent()->_errno=EBADF;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+/**
+ * \internal
+ * writev, write to a file from multiple buffers
+ */
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        ssize_t result=miosix::getFileDescriptorTable().writev(fd,iov,iovcnt);
+        if(result>=0) return result;
+        miosix::getReent()->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        miosix::getReent()->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+
+    #else //WITH_FILESYSTEM
+    miosix::getReent()->_errno=EBADF;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+/**
+ * \internal
+ * readv, read from a file into multiple buffers
+ */
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    #ifdef WITH_FILESYSTEM
+
+    #ifndef __NO_EXCEPTIONS
+    try {
+    #endif //__NO_EXCEPTIONS
+        ssize_t result=miosix::getFileDescriptorTable().readv(fd,iov,iovcnt);
+        if(result>=0) return result;
+        miosix::getReent()->_errno=-result;
+        return -1;
+    #ifndef __NO_EXCEPTIONS
+    } catch(exception& e) {
+        miosix::getReent()->_errno=ENOMEM;
+        return -1;
+    }
+    #endif //__NO_EXCEPTIONS
+
+    #else //WITH_FILESYSTEM
+    miosix::getReent()->_errno=EBADF;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
 /**
  * \internal
  * _lseek_r, move file pointer
@@ -1118,6 +1231,34 @@ int pipe(int fds[2])
     #endif //WITH_FILESYSTEM
 }
 
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    #ifdef WITH_FILESYSTEM
+    int result=miosix::getFileDescriptorTable().poll(fds,nfds,
+        timeout<0 ? -1 : static_cast<long long>(timeout)*1000000);
+    if(result>=0) return result;
+    miosix::getReent()->_errno=-result;
+    return -1;
+    #else //WITH_FILESYSTEM
+    miosix::getReent()->_errno=ENOENT;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
+ssize_t sendfile(int outFd, int inFd, off_t *offset, size_t count)
+{
+    #ifdef WITH_FILESYSTEM
+    ssize_t result=miosix::getFileDescriptorTable().sendfile(outFd,inFd,
+        offset,count);
+    if(result>=0) return result;
+    miosix::getReent()->_errno=-result;
+    return -1;
+    #else //WITH_FILESYSTEM
+    miosix::getReent()->_errno=ENOENT;
+    return -1;
+    #endif //WITH_FILESYSTEM
+}
+
 /*
  * Time API in Miosix
  * ==================
@@ -141,6 +141,10 @@ void *mainLoader(void *argv)
     //Starting part of bsp that must be started after kernel
     bspInit2();
 
+    #ifdef WITH_DEFERRED_LOG
+    startDeferredLogThread();
+    #endif //WITH_DEFERRED_LOG
+
     //Initialize application C++ global constructors (called after boot)
     extern unsigned long __preinit_array_start asm("__preinit_array_start");
     extern unsigned long __preinit_array_end asm("__preinit_array_end");
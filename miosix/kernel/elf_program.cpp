@@ -30,10 +30,13 @@
 #include "process_pool.h"
 #include "filesystem/file_access.h"
 #include "interfaces/cpu_const.h"
+#include "util/util.h"
 #include <stdexcept>
 #include <cstring>
 #include <cstdio>
 #include <memory>
+#include <algorithm>
+#include <new>
 
 using namespace std;
 
@@ -79,6 +82,25 @@ public:
      */
     static void unload(const unsigned int *elf);
 
+    /**
+     * Copy into a process image the relocated .data of a program previously
+     * loaded at the same address, if available
+     * \param elf program base address
+     * \param image process image
+     * \return true if the snapshot was found and copied
+     */
+    static bool restoreSnapshot(unsigned int elf, unsigned int *image);
+
+    /**
+     * Save the relocated .data of a program, to speed up loading it again at
+     * the same address
+     * \param elf program base address
+     * \param image process image
+     * \param size size of the relocated part of the image
+     */
+    static void saveSnapshot(unsigned int elf, const unsigned int *image,
+                             unsigned int size);
+
 private:
     /**
      * An entry into the cache of programs loaded in RAM
@@ -102,8 +124,21 @@ private:
         int useCount; ///< Used for reference counting the cache entry
     };
 
+    /**
+     * A relocated .data image of a program at a given address
+     */
+    class Snapshot
+    {
+    public:
+        unsigned int elf;          ///< Program base address
+        const unsigned int *image; ///< Process image address
+        unsigned int size;         ///< Size of data
+        unique_ptr<char[]> data;   ///< Relocated .data
+    };
+
     static KernelMutex m; ///< Protect programs against concurrent accesses
     static list<Entry> programs; ///< Cache entries
+    static list<Snapshot> snapshots; ///< Snapshots, most recently used first
 };
 
 //
@@ -192,6 +227,9 @@ void ProgramCache::unload(const unsigned int *elf)
         if(--it->useCount<=0)
         {
             DBG("ProgramCache::unload(%p): deallocate\n",elf);
+            //Another program may be loaded at the same address
+            auto e=reinterpret_cast<unsigned int>(elf);
+            snapshots.remove_if([e](const Snapshot& s){ return s.elf==e; });
             ProcessPool::instance().deallocate(it->elf);
             programs.erase(it);
         }
@@ -200,18 +238,52 @@ void ProgramCache::unload(const unsigned int *elf)
     DBG("ProgramCache::unload(%p): bug: not in cache\n",elf);
 }
 
+bool ProgramCache::restoreSnapshot(unsigned int elf, unsigned int *image)
+{
+    Lock<KernelMutex> l(m);
+    for(auto it=begin(snapshots);it!=end(snapshots);++it)
+    {
+        if(it->elf!=elf || it->image!=image) continue;
+        memcpy(image,it->data.get(),it->size);
+        snapshots.splice(begin(snapshots),snapshots,it);
+        return true;
+    }
+    return false;
+}
+
+void ProgramCache::saveSnapshot(unsigned int elf, const unsigned int *image,
+                                unsigned int size)
+{
+    if(PROCESS_RELOCATION_SNAPSHOTS==0) return;
+    //Snapshots are only an optimization, don't let them take the heap that
+    //the kernel and drivers need
+    unsigned int freeHeap=MemoryProfiling::getCurrentFreeHeap();
+    if(freeHeap<size || freeHeap-size<PROCESS_RELOCATION_SNAPSHOT_HEAP_MARGIN)
+        return;
+    unique_ptr<char[]> data(new (nothrow) char[size]);
+    if(!data) return;
+    memcpy(data.get(),image,size);
+    Lock<KernelMutex> l(m);
+    if(snapshots.size()>=PROCESS_RELOCATION_SNAPSHOTS) snapshots.pop_back();
+    snapshots.push_front({elf,image,size,std::move(data)});
+}
+
 KernelMutex ProgramCache::m;
 list<ProgramCache::Entry> ProgramCache::programs;
+list<ProgramCache::Snapshot> ProgramCache::snapshots;
 
 //
 // class ElfProgram
 //
 
 ElfProgram::ElfProgram(const char *name)
-    : elf(nullptr), size(0), ec(-ENOEXEC), copiedInRam(false)
+    : elf(nullptr), size(0), ec(-ENOEXEC), copiedInRam(false), fromFile(false)
 {
     if(int ec=ProgramCache::load(name,elf,size,copiedInRam)) this->ec=ec;
-    else validateHeader();
+    else {
+        fromFile=true;
+        validateHeader();
+    }
 }
 
 void ElfProgram::validateHeader()
@@ -483,11 +555,13 @@ ElfProgram& ElfProgram::operator= (ElfProgram&& rhs)
     size=rhs.size;
     ec=rhs.ec;
     copiedInRam=rhs.copiedInRam;
+    fromFile=rhs.fromFile;
     //Invalidate rhs
     rhs.elf=nullptr;
     rhs.size=0;
     rhs.ec=-ENOEXEC;
     rhs.copiedInRam=false;
+    rhs.fromFile=false;
     return *this;
 }
 
@@ -552,29 +626,42 @@ void ProcessImage::load(const ElfProgram& program)
                 break;
         }
     }
-    const char *dataSegmentInFile=
-        reinterpret_cast<const char*>(base+dataSegment->p_offset);
     char *dataSegmentInMem=reinterpret_cast<char*>(image);
-    memcpy(dataSegmentInMem,dataSegmentInFile,dataSegment->p_filesz);
-    dataSegmentInMem+=dataSegment->p_filesz;
-    //Zero only .bss section (faster but processes leak data to other processes)
-    //memset(dataSegmentInMem,0,dataSegment->p_memsz-dataSegment->p_filesz);
+    #ifndef WITH_PROCESS_LAZY_HEAP_ZEROING
     //Zero the entire process image to prevent data leakage, exclude .data as
     //it is initialized, and the stack size since it will be filled later
     //NOTE: as the args block size isn't known here, we can't account for that.
     //This is not an issue though, we may just unnecessary fill with zeros up to
     //MAX_PROCESS_ARGS_BLOCK_SIZE bytes into the stack
-    memset(dataSegmentInMem,0,size-dataSegment->p_filesz-mainStackSize-WATERMARK_LEN);
+    memset(dataSegmentInMem+dataSegment->p_filesz,0,
+           size-dataSegment->p_filesz-mainStackSize-WATERMARK_LEN);
+    #else //WITH_PROCESS_LAZY_HEAP_ZEROING
+    //Zero only .bss, the process zeroes heap memory in _sbrk_r when used
+    memset(dataSegmentInMem+dataSegment->p_filesz,0,
+           dataSegment->p_memsz-dataSegment->p_filesz);
+    #endif //WITH_PROCESS_LAZY_HEAP_ZEROING
     dataBssSize=dataSegment->p_memsz;
+    //The relocated .data only depends on the code and data addresses, so if
+    //the program was already loaded here, copy it instead of relocating again.
+    //Snapshots are keyed by address, so only use them for programs whose
+    //memory can't be reused for another program without ProgramCache knowing
+    const bool useSnapshots=hasRelocs && program.isFromFile();
+    if(useSnapshots && ProgramCache::restoreSnapshot(base,image)) return;
+    const char *dataSegmentInFile=
+        reinterpret_cast<const char*>(base+dataSegment->p_offset);
+    memcpy(dataSegmentInMem,dataSegmentInFile,dataSegment->p_filesz);
     if(hasRelocs)
     {
         const Elf32_Rel *rel=reinterpret_cast<const Elf32_Rel*>(base+dtRel);
         const int relSize=dtRelsz/sizeof(Elf32_Rel);
         const unsigned int ramBase=reinterpret_cast<unsigned int>(image);
+        //Relocations normally only target .data, but track how far they go
+        unsigned int relocatedSize=dataSegment->p_filesz;
         //DBG("Relocations -- start (code base @0x%x, data base @ 0x%x)\n",base,ramBase);
         for(int i=0;i<relSize;i++,rel++)
         {
             unsigned int offset=(rel->r_offset-DATA_BASE)/4;
+            relocatedSize=max(relocatedSize,(offset+1)*4);
             switch(ELF32_R_TYPE(rel->r_info))
             {
                 case R_ARM_RELATIVE:
@@ -594,6 +681,8 @@ void ProcessImage::load(const ElfProgram& program)
             }
         }
         //DBG("Relocations -- end\n");
+        if(useSnapshots && relocatedSize<=size)
+            ProgramCache::saveSnapshot(base,image,relocatedSize);
     }
 }
 
@@ -45,7 +45,8 @@ public:
     /**
      * Default constructor
      */
-    ElfProgram() : elf(nullptr), size(0), ec(-ENOEXEC), copiedInRam(false) {}
+    ElfProgram() : elf(nullptr), size(0), ec(-ENOEXEC), copiedInRam(false),
+        fromFile(false) {}
 
     /**
      * Constructor from file.
@@ -78,7 +79,8 @@ public:
      * content of the elf file
      */
     ElfProgram(const unsigned int *elf, unsigned int size)
-        : elf(elf), size(size), ec(-ENOEXEC), copiedInRam(false)
+        : elf(elf), size(size), ec(-ENOEXEC), copiedInRam(false),
+          fromFile(false)
     {
         validateHeader();
     }
@@ -93,6 +95,14 @@ public:
      * and thus it was required to copy the file content in RAM
      */
     bool isCopiedInRam() const { return copiedInRam; }
+
+    /**
+     * \return true if the elf was loaded with the constructor from file, so
+     * its memory is either a ProgramCache entry or a file in a XIP capable
+     * filesystem, and not a caller-owned buffer that may be reused for another
+     * program while still at the same address
+     */
+    bool isFromFile() const { return fromFile; }
     
     /**
      * \return the a pointer to the elf header
@@ -190,6 +200,7 @@ private:
     unsigned int size;  ///< Size in bytes of the elf file
     int ec;             ///< Error code
     bool copiedInRam;   ///< If true, elf is allocated in RAM and *this owns it
+    bool fromFile;      ///< If true, elf was loaded through ProgramCache
 };
 
 /**
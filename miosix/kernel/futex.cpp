@@ -0,0 +1,105 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include "futex.h"
+#include "sync.h"
+#include "thread.h"
+#include "intrusive.h"
+#include <errno.h>
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+/**
+ * A thread blocked in Futex::wait(), lives on the waiting thread's stack
+ */
+class FutexWaiter : public IntrusiveListItem
+{
+public:
+    FutexWaiter(const volatile int *addr) : addr(addr) {}
+
+    const volatile int *addr; ///< Address the thread is waiting on
+    ConditionVariable cv;     ///< Signaled by Futex::wake()
+    bool woken=false;         ///< Set by Futex::wake()
+};
+
+static KernelMutex futexMutex; ///< Guards futexWaiters
+static IntrusiveList<FutexWaiter> futexWaiters; ///< All blocked threads
+
+//
+// class Futex
+//
+
+int Futex::wait(const volatile int *addr, int expected, long long timeout)
+{
+    long long absTime= timeout<0 ? -1 : getTime()+timeout;
+    Lock<KernelMutex> l(futexMutex);
+    //Wakers take the mutex, so a wake() after the value has been changed
+    //can't be lost between this check and blocking
+    if(*addr!=expected) return -EAGAIN;
+    FutexWaiter waiter(addr);
+    futexWaiters.push_back(&waiter);
+    while(waiter.woken==false)
+    {
+        //The waiter lives on the stack, it must not be left in the list
+        if(Thread::testTerminate())
+        {
+            futexWaiters.removeFast(&waiter);
+            return -EINTR;
+        }
+        if(absTime<0) waiter.cv.wait(l);
+        else if(waiter.cv.timedWait(l,absTime)==TimedWaitResult::Timeout)
+        {
+            if(waiter.woken) break;
+            futexWaiters.removeFast(&waiter);
+            return -ETIMEDOUT;
+        }
+    }
+    return 0;
+}
+
+int Futex::wake(const volatile int *addr, int count)
+{
+    int result=0;
+    Lock<KernelMutex> l(futexMutex);
+    for(auto it=futexWaiters.begin();it!=futexWaiters.end() && result<count;)
+    {
+        FutexWaiter *waiter=*it;
+        if(waiter->addr!=addr) { ++it; continue; }
+        it=futexWaiters.erase(it);
+        waiter->woken=true;
+        waiter->cv.signal();
+        result++;
+    }
+    return result;
+}
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
@@ -0,0 +1,75 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include "miosix_settings.h"
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+/**
+ * Futex-like notification, lets processes block until another process or
+ * thread signals a change to a word in memory. Processes have no virtual
+ * memory, so the address of a word, such as one in a shared memory object,
+ * is the same in all processes and is used as the key to match waiters and
+ * wakers.
+ */
+class Futex
+{
+public:
+    /**
+     * Block until woken by wake() on the same address, but only if the word
+     * at addr is still equal to expected. The check and the blocking are
+     * atomic with respect to wake()
+     * \param addr address of the word, must have been validated to be readable
+     * by the process
+     * \param expected value the word is expected to have
+     * \param timeout relative timeout in nanoseconds, or a negative number to
+     * wait forever
+     * \return 0 if woken, -EAGAIN if the word was not equal to expected,
+     * -ETIMEDOUT on timeout, -EINTR if the calling thread is being terminated
+     */
+    static int wait(const volatile int *addr, int expected, long long timeout);
+
+    /**
+     * Wake up threads blocked in wait() on an address
+     * \param addr address of the word
+     * \param count maximum number of threads to wake
+     * \return the number of threads woken
+     */
+    static int wake(const volatile int *addr, int count);
+
+private:
+    Futex()=delete;
+};
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
@@ -0,0 +1,308 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include "io_ring.h"
+#include "thread.h"
+#include <new>
+#include <fcntl.h>
+#include "filesystem/ioctl.h"
+
+using namespace std;
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+static bool isPowerOfTwo(unsigned int x) { return x!=0 && (x & (x-1))==0; }
+
+//
+// class IoRing
+//
+
+KernelMutex IoRing::mutex;
+ConditionVariable IoRing::workAvailable;
+IntrusiveList<IoRing::Request> IoRing::queue;
+bool IoRing::workersStarted=false;
+
+IoRing *IoRing::create(io_ring *ring, FileDescriptorTable& fileTable,
+                       const MPUConfiguration& mpu, int& error)
+{
+    error=-EFAULT;
+    if(mpu.withinForWriting(ring,sizeof(io_ring))==false ||
+       (reinterpret_cast<unsigned int>(ring) & 0b11)) return nullptr;
+    //Copy the ring geometry, as the process could change it after validation
+    unsigned int sqEntries=ring->sq_entries;
+    unsigned int cqEntries=ring->cq_entries;
+    io_sqe *sqes=ring->sqes;
+    io_cqe *cqes=ring->cqes;
+    error=-EINVAL;
+    if(!isPowerOfTwo(sqEntries) || sqEntries>IO_RING_MAX_ENTRIES) return nullptr;
+    if(!isPowerOfTwo(cqEntries) || cqEntries>IO_RING_MAX_ENTRIES) return nullptr;
+    error=-EFAULT;
+    //sqes contain an off_t, so they need 8 byte alignment
+    if(mpu.withinForWriting(sqes,sqEntries*sizeof(io_sqe))==false ||
+       (reinterpret_cast<unsigned int>(sqes) & 0b111)) return nullptr;
+    if(mpu.withinForWriting(cqes,cqEntries*sizeof(io_cqe))==false ||
+       (reinterpret_cast<unsigned int>(cqes) & 0b11)) return nullptr;
+
+    error=-ENOMEM;
+    {
+        Lock<KernelMutex> l(mutex);
+        if(workersStarted==false)
+        {
+            //Workers are shared by all processes and never terminate
+            for(unsigned int i=0;i<IO_RING_WORKERS;i++)
+            {
+                if(Thread::create(worker,IO_RING_WORKER_STACK_SIZE,
+                    DEFAULT_PRIORITY,nullptr,Thread::DETACHED)!=nullptr)
+                    workersStarted=true;
+            }
+            if(workersStarted==false) return nullptr;
+        }
+    }
+    //At most one request per completion ring entry can be in progress
+    Request *requests=new (nothrow) Request[cqEntries];
+    if(requests==nullptr) return nullptr;
+    IoRing *result=new (nothrow) IoRing(ring,sqes,cqes,sqEntries,cqEntries,
+                                        fileTable,mpu,requests);
+    if(result==nullptr)
+    {
+        delete[] requests;
+        return nullptr;
+    }
+    error=0;
+    return result;
+}
+
+int IoRing::submit(unsigned int toSubmit)
+{
+    Lock<KernelMutex> l(mutex);
+    unsigned int sqTail=__atomic_load_n(&ring->sq_tail,__ATOMIC_ACQUIRE);
+    unsigned int submitted=0;
+    while(submitted<toSubmit && sqHead!=sqTail)
+    {
+        //Never submit more than the completion ring can hold
+        if(availableCompletions()+inProgress>=cqMask+1) break;
+        Request *r=freeList.front();
+        freeList.pop_front();
+        r->sqe=sqes[sqHead & sqMask];
+        sqHead++;
+        submitted++;
+        int error=prepare(r);
+        if(error==0)
+        {
+            inProgress++;
+            queue.push_back(r);
+            workAvailable.signal();
+        } else {
+            postCompletion(r->sqe.user_data,error);
+            freeList.push_front(r);
+        }
+    }
+    __atomic_store_n(&ring->sq_head,sqHead,__ATOMIC_RELEASE);
+    return submitted;
+}
+
+void IoRing::waitCompletions(unsigned int minComplete)
+{
+    Lock<KernelMutex> l(mutex);
+    for(;;)
+    {
+        unsigned int available=availableCompletions();
+        if(available>=minComplete || inProgress==0) break;
+        //Operations on pipes or serial ports may never complete
+        if(Thread::testTerminate()) break;
+        //Don't wait for more completions than the operations in progress
+        if(available+inProgress<minComplete) minComplete=available+inProgress;
+        completed.wait(l);
+    }
+}
+
+bool IoRing::busy()
+{
+    Lock<KernelMutex> l(mutex);
+    return inProgress>0;
+}
+
+IoRing::~IoRing()
+{
+    {
+        Lock<KernelMutex> l(mutex);
+        cancelled=true;
+        //Requests still in the queue are dropped, as the process is going away
+        for(auto it=queue.begin();it!=queue.end();)
+        {
+            if((*it)->ring!=this) ++it;
+            else {
+                (*it)->file.reset();
+                it=queue.erase(it);
+                inProgress--;
+            }
+        }
+        cancelQueue.wakeup();
+        while(inProgress>0) completed.wait(l);
+    }
+    delete[] requests;
+}
+
+IoRing::IoRing(io_ring *ring, io_sqe *sqes, io_cqe *cqes,
+               unsigned int sqEntries, unsigned int cqEntries,
+               FileDescriptorTable& fileTable, const MPUConfiguration& mpu,
+               Request *requests)
+    : ring(ring), sqes(sqes), cqes(cqes),
+      sqMask(sqEntries-1), cqMask(cqEntries-1),
+      fileTable(fileTable), mpu(mpu), requests(requests)
+{
+    for(unsigned int i=0;i<=cqMask;i++)
+    {
+        requests[i].ring=this;
+        freeList.push_back(&requests[i]);
+    }
+    ring->sq_head=0;
+    ring->sq_tail=0;
+    ring->cq_head=0;
+    ring->cq_tail=0;
+}
+
+int IoRing::prepare(Request *r)
+{
+    const io_sqe& sqe=r->sqe;
+    if(sqe.flags!=0) return -EINVAL;
+    if(sqe.opcode==IORING_OP_NOP) return 0;
+    r->file=fileTable.getFile(sqe.fd);
+    if(!r->file) return -EBADF;
+    switch(sqe.opcode)
+    {
+        case IORING_OP_READ:
+            if(mpu.withinForWriting(sqe.addr,sqe.len)==false) return -EFAULT;
+            break;
+        case IORING_OP_WRITE:
+            if(mpu.withinForReading(sqe.addr,sqe.len)==false) return -EFAULT;
+            break;
+        case IORING_OP_FSYNC:
+        case IORING_OP_POLL:
+            break;
+        default:
+            return -EINVAL;
+    }
+    if(sqe.off<-1) return -EINVAL;
+    return 0;
+}
+
+void IoRing::postCompletion(unsigned int userData, int result)
+{
+    io_cqe& cqe=cqes[cqTail & cqMask];
+    cqe.user_data=userData;
+    cqe.res=result;
+    cqTail++;
+    __atomic_store_n(&ring->cq_tail,cqTail,__ATOMIC_RELEASE);
+}
+
+unsigned int IoRing::availableCompletions() const
+{
+    //The process may corrupt cq_head, never report more than the ring size
+    unsigned int cqHead=__atomic_load_n(&ring->cq_head,__ATOMIC_ACQUIRE);
+    return min(cqTail-cqHead,cqMask+1);
+}
+
+int IoRing::waitReady(Request *r, int events)
+{
+    PollTable table;
+    //Registering on the ring's queue allows the destructor to interrupt the
+    //wait
+    table.add(r->ring->cancelQueue);
+    events|=POLLERR | POLLHUP;
+    for(;;)
+    {
+        int result=r->file->poll(events,table) & events;
+        if(result) return result;
+        if(r->ring->cancelled) return -ECANCELED;
+        table.wait(-1);
+    }
+}
+
+int IoRing::execute(Request *r)
+{
+    const io_sqe& sqe=r->sqe;
+    FileBase *file=r->file.get();
+    switch(sqe.opcode)
+    {
+        case IORING_OP_READ:
+        {
+            //Reading a pipe or serial port may block forever, so only start
+            //once the file is readable, which the destructor can interrupt
+            int ready=waitReady(r,POLLIN);
+            if(ready<0) return ready;
+            if(sqe.off<0) return file->read(sqe.addr,sqe.len);
+            return file->pread(sqe.addr,sqe.len,sqe.off);
+        }
+        case IORING_OP_WRITE:
+        {
+            int ready=waitReady(r,POLLOUT);
+            if(ready<0) return ready;
+            if(sqe.off<0) return file->write(sqe.addr,sqe.len);
+            return file->pwrite(sqe.addr,sqe.len,sqe.off);
+        }
+        case IORING_OP_FSYNC:
+        {
+            int result=file->ioctl(IOCTL_SYNC,nullptr);
+            return result==-ENOTTY ? -EINVAL : result;
+        }
+        case IORING_OP_POLL:
+            return waitReady(r,sqe.poll_events);
+        default:
+            return 0;
+    }
+}
+
+void *IoRing::worker(void *)
+{
+    Lock<KernelMutex> l(mutex);
+    for(;;)
+    {
+        while(queue.empty()) workAvailable.wait(l);
+        Request *r=queue.front();
+        queue.pop_front();
+        IoRing *ring=r->ring;
+        int result;
+        {
+            Unlock<KernelMutex> u(l);
+            result=execute(r);
+            r->file.reset();
+        }
+        ring->postCompletion(r->sqe.user_data,result);
+        ring->freeList.push_front(r);
+        ring->inProgress--;
+        ring->completed.broadcast();
+    }
+    return nullptr;
+}
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
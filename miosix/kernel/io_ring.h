@@ -0,0 +1,247 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include <sys/types.h>
+#include "sync.h"
+#include "intrusive.h"
+#include "miosix_settings.h"
+#include "filesystem/file_access.h"
+#include "filesystem/poll_table.h"
+#include "interfaces_private/userspace.h"
+
+#if __has_include(<sys/io_ring.h>)
+#include <sys/io_ring.h>
+#else //__has_include(<sys/io_ring.h>)
+
+//Compilers predating io rings lack sys/io_ring.h, keep in sync with
+//libc/sys/miosix/sys/io_ring.h in the newlib patch
+
+#define IORING_OP_NOP   0
+#define IORING_OP_READ  1
+#define IORING_OP_WRITE 2
+#define IORING_OP_FSYNC 3
+#define IORING_OP_POLL  4
+
+struct io_sqe
+{
+    unsigned char opcode;
+    unsigned char flags;
+    short poll_events;
+    int fd;
+    void *addr;
+    unsigned int len;
+    off_t off;
+    unsigned int user_data;
+    unsigned int reserved;
+};
+
+struct io_cqe
+{
+    unsigned int user_data;
+    int res;
+};
+
+struct io_ring
+{
+    volatile unsigned int sq_head;
+    volatile unsigned int sq_tail;
+    volatile unsigned int cq_head;
+    volatile unsigned int cq_tail;
+    unsigned int sq_entries;
+    unsigned int cq_entries;
+    struct io_sqe *sqes;
+    struct io_cqe *cqes;
+};
+
+#endif //__has_include(<sys/io_ring.h>)
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+/**
+ * Asynchronous I/O for processes through a submission and a completion ring
+ * stored in process memory.
+ *
+ * The process fills submission queue entries and advances sq_tail, then calls
+ * io_ring_enter() that validates the new entries and queues them to a pool of
+ * IO_RING_WORKERS kernel threads shared by all processes. Workers perform the
+ * blocking operation on the FileBase and append the result to the completion
+ * ring, so a single-threaded process can have up to cq_entries operations in
+ * progress at the same time.
+ *
+ * Operations that were submitted but not yet started are cancelled when the
+ * ring is destroyed, as are poll operations in progress and reads and writes
+ * still waiting for the file to become ready. Reads and writes that already
+ * started are waited for, as they access process memory.
+ */
+class IoRing
+{
+public:
+    /**
+     * Create an io ring for a process
+     * \param ring pointer to the ring structure in process memory
+     * \param fileTable file descriptor table of the process
+     * \param mpu memory protection of the process, used to validate the ring
+     * and the buffers of the submitted operations
+     * \param error 0 on success, or a negative number if the ring is invalid
+     * \return the io ring, or nullptr on failure
+     */
+    static IoRing *create(io_ring *ring, FileDescriptorTable& fileTable,
+                          const MPUConfiguration& mpu, int& error);
+
+    /**
+     * Submit operations
+     * \param toSubmit maximum number of submission queue entries to consume.
+     * Fewer are consumed if the completion ring could not hold the results
+     * \return the number of consumed submission queue entries, or a negative
+     * number on failure
+     */
+    int submit(unsigned int toSubmit);
+
+    /**
+     * Wait for completions
+     * \param minComplete wait until at least this many completions are
+     * available in the completion ring. Operations that are not in progress
+     * are not waited for, and the wait ends if the calling thread is being
+     * terminated, so this function can't wait forever
+     */
+    void waitCompletions(unsigned int minComplete);
+
+    /**
+     * \return true if operations are queued or in progress. As they may
+     * access process memory, the memory they were validated against must not
+     * be unmapped
+     */
+    bool busy();
+
+    /**
+     * Destructor, cancels queued operations and waits for operations in
+     * progress to complete, as they may access process memory
+     */
+    ~IoRing();
+
+    IoRing(const IoRing&)=delete;
+    IoRing& operator=(const IoRing&)=delete;
+
+private:
+    /**
+     * An operation queued to the worker threads
+     */
+    class Request : public IntrusiveListItem
+    {
+    public:
+        io_sqe sqe;                       ///< Kernel copy of the sqe
+        intrusive_ref_ptr<FileBase> file; ///< File the operation targets
+        IoRing *ring;                     ///< Ring to complete the request to
+    };
+
+    /**
+     * Constructor. The ring geometry is passed separately as the copy in
+     * process memory may have changed since create() validated it
+     * \param ring pointer to the ring structure in process memory
+     * \param sqes validated submission queue entries
+     * \param cqes validated completion queue entries
+     * \param sqEntries validated number of submission queue entries
+     * \param cqEntries validated number of completion queue entries, and size
+     * of the requests array
+     * \param fileTable file descriptor table of the process
+     * \param mpu memory protection of the process
+     * \param requests preallocated requests
+     */
+    IoRing(io_ring *ring, io_sqe *sqes, io_cqe *cqes, unsigned int sqEntries,
+           unsigned int cqEntries, FileDescriptorTable& fileTable,
+           const MPUConfiguration& mpu, Request *requests);
+
+    /**
+     * Validate a submission queue entry and fill a request with it
+     * \param r request to fill, r->sqe is already filled
+     * \return 0 if the request can be queued, or a negative number that
+     * should be posted as its result
+     */
+    int prepare(Request *r);
+
+    /**
+     * Append a completion to the completion ring.
+     * Must be called with mutex locked
+     */
+    void postCompletion(unsigned int userData, int result);
+
+    /**
+     * \return the number of completions available to the process.
+     * Must be called with mutex locked
+     */
+    unsigned int availableCompletions() const;
+
+    /**
+     * Wait until a file is ready, or the ring is destroyed.
+     * Called by the worker threads without holding mutex
+     * \param r request whose file to wait for
+     * \param events events to wait for, POLLERR and POLLHUP are always added
+     * \return the events that are ready, or -ECANCELED
+     */
+    static int waitReady(Request *r, int events);
+
+    /**
+     * Perform an operation, called by the worker threads without holding mutex
+     * \param r request to perform
+     * \return the operation result
+     */
+    static int execute(Request *r);
+
+    /**
+     * Worker thread entry point
+     */
+    static void *worker(void *);
+
+    io_ring *ring;                 ///< Ring in process memory
+    io_sqe *sqes;                  ///< Kernel copy of ring->sqes
+    io_cqe *cqes;                  ///< Kernel copy of ring->cqes
+    unsigned int sqMask, cqMask;   ///< Ring sizes minus one
+    unsigned int sqHead=0;         ///< Kernel copy of ring->sq_head
+    unsigned int cqTail=0;         ///< Kernel copy of ring->cq_tail
+    unsigned int inProgress=0;     ///< Requests queued or being performed
+    volatile bool cancelled=false; ///< Set by the destructor
+    FileDescriptorTable& fileTable;
+    const MPUConfiguration& mpu;
+    Request *requests;             ///< Preallocated requests, cq_entries
+    IntrusiveList<Request> freeList;
+    ConditionVariable completed;   ///< Signaled when a request completes
+    PollQueue cancelQueue;         ///< Interrupts waitReady() in progress
+
+    static KernelMutex mutex;              ///< Guards all io rings
+    static ConditionVariable workAvailable;///< Signaled when work is queued
+    static IntrusiveList<Request> queue;   ///< Requests waiting for a worker
+    static bool workersStarted;
+};
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
@@ -0,0 +1,151 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include "logging.h"
+#include "thread.h"
+#include "interfaces/atomic_ops.h"
+#include "interfaces/cpu_const.h"
+
+#ifdef WITH_DEFERRED_LOG
+
+namespace miosix {
+
+/**
+ * A deferred log message
+ */
+struct DeferredLogRecord
+{
+    const char *fmt;                          ///< Format string
+    unsigned int args[DEFERRED_LOG_MAX_ARGS]; ///< Arguments
+    volatile unsigned int seq;                ///< Index+1 once published
+};
+
+/**
+ * Ring of deferred log messages. Any number of producers reserve a record
+ * with a compare and swap and publish it by writing its sequence number, the
+ * single consumer is the deferred log thread
+ */
+struct DeferredLogRing
+{
+    DeferredLogRecord records[DEFERRED_LOG_ENTRIES];
+    volatile int reserved=0;        ///< Records reserved by producers
+    volatile unsigned int tail=0;   ///< Records consumed by the log thread
+    volatile int dropped=0;         ///< Records dropped as the ring was full
+};
+
+//One ring per core so that cores don't contend on the same indices
+static DeferredLogRing rings[CPU_NUM_CORES];
+
+void deferredLogImpl(const char *fmt, const unsigned int *args,
+                     unsigned int nargs) noexcept
+{
+    //If the thread migrates after reading the core id it will share the ring
+    //with the producers of another core, which is slower but still correct
+    DeferredLogRing& ring=rings[getCurrentCoreId()];
+    int index;
+    for(;;)
+    {
+        index=ring.reserved;
+        if(static_cast<unsigned int>(index)-ring.tail>=DEFERRED_LOG_ENTRIES)
+        {
+            atomicAdd(&ring.dropped,1);
+            return;
+        }
+        if(atomicCompareAndSwap(&ring.reserved,index,index+1)==index) break;
+    }
+    DeferredLogRecord& record=ring.records[index & (DEFERRED_LOG_ENTRIES-1)];
+    record.fmt=fmt;
+    for(unsigned int i=0;i<DEFERRED_LOG_MAX_ARGS;i++)
+        record.args[i]= i<nargs ? args[i] : 0;
+    __atomic_store_n(&record.seq,index+1,__ATOMIC_RELEASE);
+}
+
+DeferredLogStats getDeferredLogStats() noexcept
+{
+    DeferredLogStats result={0,0};
+    for(auto& ring : rings)
+    {
+        result.logged+=ring.tail;
+        result.dropped+=ring.dropped;
+    }
+    return result;
+}
+
+static void *deferredLogThread(void *)
+{
+    int printedDrops[CPU_NUM_CORES]={0};
+    for(;;)
+    {
+        bool idle=true;
+        for(unsigned int i=0;i<CPU_NUM_CORES;i++)
+        {
+            DeferredLogRing& ring=rings[i];
+            for(;;)
+            {
+                unsigned int tail=ring.tail;
+                DeferredLogRecord& record=
+                    ring.records[tail & (DEFERRED_LOG_ENTRIES-1)];
+                //A producer preempted between reserving and publishing the
+                //record stalls the ring until it resumes
+                if(__atomic_load_n(&record.seq,__ATOMIC_ACQUIRE)!=tail+1) break;
+                //Copy the record and release it before the slow formatting
+                const char *fmt=record.fmt;
+                unsigned int a[DEFERRED_LOG_MAX_ARGS];
+                for(unsigned int j=0;j<DEFERRED_LOG_MAX_ARGS;j++)
+                    a[j]=record.args[j];
+                __atomic_store_n(&ring.tail,tail+1,__ATOMIC_RELEASE);
+                static_assert(DEFERRED_LOG_MAX_ARGS==4,"Fix call below");
+                iprintf(fmt,a[0],a[1],a[2],a[3]);
+                idle=false;
+            }
+            int dropped=ring.dropped;
+            if(dropped!=printedDrops[i])
+            {
+                iprintf("[%d log messages dropped]\n",dropped-printedDrops[i]);
+                printedDrops[i]=dropped;
+            }
+        }
+        if(idle) Thread::nanoSleep(DEFERRED_LOG_POLL_PERIOD);
+    }
+    return nullptr;
+}
+
+void startDeferredLogThread()
+{
+    #ifdef SCHED_TYPE_EDF
+    const auto priority=DEFAULT_PRIORITY; //No deadline, runs in background
+    #else //SCHED_TYPE_EDF
+    const auto priority=0; //Lowest priority
+    #endif //SCHED_TYPE_EDF
+    Thread::create(deferredLogThread,STACK_DEFAULT_FOR_PTHREAD,priority,
+                   nullptr,Thread::DETACHED);
+}
+
+} //namespace miosix
+
+#endif //WITH_DEFERRED_LOG
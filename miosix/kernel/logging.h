@@ -31,6 +31,8 @@
 #include "filesystem/console/console_device.h"
 #include <cstdio>
 #include <cstdarg>
+#include <cstdint>
+#include <type_traits>
 
 namespace miosix {
 
@@ -100,4 +102,76 @@ inline void IRQerrorLog(const char *string)
 #define IRQerrorLog(x)
 #endif //WITH_ERRLOG
 
+#ifdef WITH_DEFERRED_LOG
+
+/**
+ * Deferred log statistics, returned by getDeferredLogStats()
+ */
+struct DeferredLogStats
+{
+    unsigned int logged;  ///< Messages printed so far
+    unsigned int dropped; ///< Messages dropped because the ring was full
+};
+
+/**
+ * \internal
+ * Store a deferred log record in the ring of the current core
+ * \param fmt format string
+ * \param args arguments
+ * \param nargs number of arguments
+ */
+void deferredLogImpl(const char *fmt, const unsigned int *args,
+                     unsigned int nargs) noexcept;
+
+/**
+ * \internal
+ * Start the thread printing deferred log messages, called during boot
+ */
+void startDeferredLogThread();
+
+/**
+ * \internal
+ * Convert a deferredLog() argument to a ring word
+ */
+template<typename T>
+inline unsigned int deferredLogArg(T x) noexcept
+{
+    static_assert((std::is_integral_v<T> || std::is_enum_v<T> ||
+        std::is_pointer_v<T>) && sizeof(T)<=sizeof(unsigned int),
+        "deferredLog() only supports integer and pointer arguments up to 32 bit");
+    if constexpr(std::is_pointer_v<T>) return reinterpret_cast<uintptr_t>(x);
+    else return static_cast<unsigned int>(x);
+}
+
+/**
+ * Print log messages from any context, IRQ included, in constant time.
+ * Instead of formatting the message, the format string pointer and the
+ * arguments are stored in a lock-free ring, and a low priority kernel thread
+ * formats and prints them later. If the ring is full the message is dropped
+ * and the drop is reported by the printing thread.
+ * Since formatting is deferred, the format string and all strings passed for
+ * %s must remain valid forever, such as string literals. Only integer and
+ * pointer arguments up to 32 bit are supported, and at most
+ * DEFERRED_LOG_MAX_ARGS of them. Messages logged from different cores may be
+ * printed out of order.
+ * \param fmt format string
+ */
+template<typename... Args>
+inline void deferredLog(const char *fmt, Args... args) noexcept
+{
+    static_assert(sizeof...(Args)<=DEFERRED_LOG_MAX_ARGS,
+        "Too many arguments for deferredLog()");
+    const unsigned int a[]={deferredLogArg(args)...,0};
+    deferredLogImpl(fmt,a,sizeof...(Args));
+}
+
+/**
+ * \return deferred log statistics
+ */
+DeferredLogStats getDeferredLogStats() noexcept;
+
+#else //WITH_DEFERRED_LOG
+#define deferredLog(x,...)
+#endif //WITH_DEFERRED_LOG
+
 } //namespace miosix
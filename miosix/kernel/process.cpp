@@ -27,6 +27,7 @@
 
 #include <stdexcept>
 #include <memory>
+#include <new>
 #include <cstdio>
 #include <cstring>
 #include <cassert>
@@ -38,10 +39,29 @@
 #include <signal.h>
 #include <limits.h>
 #include <spawn.h>
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#else //__has_include(<sys/mman.h>)
+//Compilers built before mmap() was added lack this header, keep in sync with
+//newlib's sys/mman.h
+#define PROT_NONE     0
+#define PROT_READ     1
+#define PROT_WRITE    2
+#define PROT_EXEC     4
+#define MAP_SHARED    0x01
+#define MAP_PRIVATE   0x02
+#define MAP_FIXED     0x10
+#define MAP_ANONYMOUS 0x20
+#endif //__has_include(<sys/mman.h>)
 
 #include "sync.h"
 #include "process_pool.h"
 #include "process.h"
+#include "shared_memory.h"
+#include "filesystem/mqueue/mqueue.h"
+#include "futex.h"
+#include "cpu_time_counter.h"
+#include "syscall_trace.h"
 #include "interfaces/cpu_const.h"
 #include "interfaces_private/userspace.h"
 
@@ -66,7 +86,20 @@ namespace miosix {
 /**
  * Used to check if a pointer passed from userspace is aligned
  */
-static bool aligned(void *x) { return (reinterpret_cast<unsigned>(x) & 0b11)==0; }
+static bool aligned(const void *x) { return (reinterpret_cast<unsigned>(x) & 0b11)==0; }
+
+/**
+ * \return the end of the kernel in the code address space, including the
+ * .data initializers that follow the kernel code
+ */
+static const char *kernelEnd()
+{
+    //These are defined in the linker script
+    extern char _data asm("_data");
+    extern char _edata asm("_edata");
+    extern char _etext asm("_etext");
+    return &_etext+(&_edata-&_data);
+}
 
 /**
  * Validate that a string array parameter, such as the one passed to the execve
@@ -190,7 +223,7 @@ pid_t Process::create(ElfProgram&& program, ArgsBlock&& args)
     //This ensures we will never be in the uncomfortable situation where a
     //thread has already been created but there's no memory to list it
     //among the threads of a process
-    proc->threads.push_back(thr);
+    proc->threads.push_back({thr});
     thr->wakeup(); //Actually start the thread, now that everything is set up
     pid_t result=proc->pid;
     proc.release(); //Do not delete the pointer
@@ -237,6 +270,7 @@ pid_t Process::waitpid(pid_t pid, int* exit, int options)
         while(self->zombies.empty())
         {
             if(self->childs.empty()) return -ECHILD;
+            if(Thread::testTerminate()) return -EINTR;
             processTable.genericWaiting.wait(l);
         }
         joined=self->zombies.front();
@@ -252,6 +286,7 @@ pid_t Process::waitpid(pid_t pid, int* exit, int options)
         while(joined->zombie==false)
         {
             if(options & WNOHANG) return 0; //Process hasn't terminated yet
+            if(Thread::testTerminate()) return -EINTR;
             joined->waitCount++;
             joined->waiting.wait(l);
             joined->waitCount--;
@@ -271,9 +306,161 @@ pid_t Process::waitpid(pid_t pid, int* exit, int options)
     return result;
 }
 
+#ifdef WITH_PROCFS
+
+/**
+ * \param bottom lowest address of a stack filled with STACK_FILL
+ * \param size stack size
+ * \return the maximum stack used
+ */
+static unsigned int usedStack(const unsigned int *bottom, unsigned int size)
+{
+    unsigned int unused=0;
+    while(unused<size && *bottom++==STACK_FILL) unused+=4;
+    return size-unused;
+}
+
+vector<pid_t> Process::getPids()
+{
+    auto& processTable=ProcessTable::instance();
+    Lock<KernelMutex> l(processTable.procMutex);
+    vector<pid_t> result;
+    result.reserve(processTable.processes.size());
+    for(auto& p : processTable.processes) if(p.first!=0) result.push_back(p.first);
+    return result;
+}
+
+int Process::getInfo(pid_t pid, ProcessInfo& info)
+{
+    auto& processTable=ProcessTable::instance();
+    //Holding procMutex prevents the process from being deleted
+    Lock<KernelMutex> l(processTable.procMutex);
+    auto it=processTable.processes.find(pid);
+    if(pid==0 || it==processTable.processes.end()) return -ESRCH;
+    //Since the case when pid==0 has been singled out, this cast is safe
+    auto proc=static_cast<Process*>(it->second);
+    info.pid=pid;
+    info.ppid=proc->ppid;
+    info.zombie=proc->zombie;
+    info.openFiles=proc->fileTable.getOpenFileCount();
+    memcpy(info.syscalls,proc->syscallCounts,sizeof(info.syscalls));
+    info.cpuTime=-1;
+    info.threads.clear();
+    //Reserve before locking threadMutex, not to allocate while holding it
+    info.threads.reserve(MAX_THREADS_PER_PROCESS);
+    //Holding threadMutex prevents the threads from being joined and the
+    //process image from being replaced by execve
+    Lock<KernelMutex> l2(proc->threadMutex);
+    info.elfSize=proc->program.getElfSize();
+    info.elfInRam=proc->program.isCopiedInRam();
+    auto base=reinterpret_cast<const char*>(proc->image.getProcessBasePointer());
+    info.imageSize=proc->image.getProcessImageSize();
+    info.dataBssSize=proc->image.getDataBssSize();
+    info.heapUsed=0;
+    if(proc->zombie) return 0; //Threads have exited, and the heap is unused
+    if(proc->maxUsedHeap)
+    {
+        //The process may have written anything, only trust it if it is valid
+        const char *heapStart=base+info.dataBssSize;
+        const char *maxUsedHeap=*proc->maxUsedHeap;
+        if(maxUsedHeap>heapStart && maxUsedHeap<=base+info.imageSize)
+            info.heapUsed=maxUsedHeap-heapStart;
+    }
+    Thread *threads[MAX_THREADS_PER_PROCESS];
+    for(unsigned int tid=0;tid<proc->threads.size();tid++)
+    {
+        Thread *thr=proc->threads[tid].thread;
+        if(thr==nullptr) continue;
+        ThreadInfo ti;
+        ti.tid=tid;
+        ti.cpuTime=-1;
+        //The main thread stack is in the process image, the other threads
+        //have been allocated by the process, in its heap
+        ti.stackSize= tid==0 ? proc->image.getMainStackSize()
+                             : proc->threads[tid].stackSize;
+        //After execve the main thread points to the old image until it starts
+        const unsigned int *bottom=thr->userWatermark+WATERMARK_LEN/4;
+        auto b=reinterpret_cast<const char*>(bottom);
+        if(b>=base && b+ti.stackSize<=base+info.imageSize)
+            ti.stackUsed=usedStack(bottom,ti.stackSize);
+        else ti.stackUsed=0;
+        ti.kernelStackSize=thr->stacksize;
+        ti.kernelStackUsed=usedStack(thr->watermark+WATERMARK_LEN/4,thr->stacksize);
+        threads[info.threads.size()]=thr;
+        info.threads.push_back(ti);
+    }
+    #ifdef WITH_CPU_TIME_COUNTER
+    {
+        FastGlobalIrqLock dLock;
+        long long t=IRQgetTime();
+        auto end=CPUTimeCounter::IRQend();
+        for(auto it=CPUTimeCounter::IRQbegin(t);it!=end;++it)
+        {
+            CPUTimeCounter::Data data=*it;
+            if(data.thread->proc!=proc) continue;
+            for(unsigned int i=0;i<info.threads.size();i++)
+            {
+                if(threads[i]!=data.thread) continue;
+                long long cpuTime=0;
+                for(auto ns : data.usedCpuTime) cpuTime+=ns;
+                info.threads[i].cpuTime=cpuTime;
+                break;
+            }
+        }
+    }
+    info.cpuTime=0;
+    for(auto& ti : info.threads) if(ti.cpuTime>0) info.cpuTime+=ti.cpuTime;
+    #endif //WITH_CPU_TIME_COUNTER
+    return 0;
+}
+
+#endif //WITH_PROCFS
+
+#ifdef WITH_SYSCALL_TRACE
+
+int Process::setTracing(pid_t pid, bool enable)
+{
+    auto& processTable=ProcessTable::instance();
+    Lock<KernelMutex> l(processTable.procMutex);
+    auto it=processTable.processes.find(pid);
+    if(pid==0 || it==processTable.processes.end()) return -ESRCH;
+    auto proc=static_cast<Process*>(it->second);
+    if(proc->zombie) return -ESRCH;
+    if(enable && !proc->histogram)
+    {
+        proc->histogram.reset(new (nothrow) SyscallHistogram);
+        if(!proc->histogram) return -ENOMEM;
+    }
+    proc->traced=enable;
+    return 0;
+}
+
+int Process::getSyscallHistogram(pid_t pid, SyscallHistogram& histogram)
+{
+    auto& processTable=ProcessTable::instance();
+    Lock<KernelMutex> l(processTable.procMutex);
+    auto it=processTable.processes.find(pid);
+    if(pid==0 || it==processTable.processes.end()) return -ESRCH;
+    auto proc=static_cast<Process*>(it->second);
+    if(!proc->histogram) histogram=SyscallHistogram();
+    else {
+        //The histogram is updated with interrupts disabled, but copying it
+        //all at once would disable them for too long
+        for(unsigned int i=0;i<NUM_SYSCALLS;i++)
+        {
+            FastGlobalIrqLock dLock;
+            memcpy(histogram.counts[i],proc->histogram->counts[i],
+                   sizeof(histogram.counts[i]));
+        }
+    }
+    return 0;
+}
+
+#endif //WITH_SYSCALL_TRACE
+
 Process::~Process()
 {
-    for(auto t : threads) if(t) t->join();
+    for(auto& t : threads) if(t.thread) t.thread->join();
 }
 
 Process::Process(const FileDescriptorTable& fdt, ElfProgram&& program,
@@ -282,11 +469,24 @@ Process::Process(const FileDescriptorTable& fdt, ElfProgram&& program,
     //This is required so that bad_alloc can never be thrown when the first
     //thread of the process will be stored in this vector
     threads.reserve(1);
+    //The main thread is created by create() with a process not yet shared
+    //with other threads, so the threads vector is accessed without locking
     load(std::move(program),std::move(args));
 }
 
 void Process::load(ElfProgram&& program, ArgsBlock&& args)
 {
+    #ifdef WITH_PROCFS
+    //getInfo() may be reading the old process image
+    Lock<KernelMutex> l(threadMutex);
+    #endif //WITH_PROCFS
+    //Operations in progress may access the old process image
+    ioRing.reset();
+    timePage.reset();
+    maxUsedHeap=nullptr;
+    //The new MPUConfiguration assigned below drops the mapping, if any
+    mappedBase=nullptr;
+    mappedFile.reset();
     this->program=std::move(program);
     //Done here so if not enough memory the new process is not even created
     image.load(this->program);
@@ -324,43 +524,92 @@ void Process::load(ElfProgram&& program, ArgsBlock&& args)
             image.getProcessBasePointer(),image.getProcessImageSize());
 }
 
+int Process::mmap(size_t size, int prot, int flags, int fd, off_t offset,
+                  const void *& addr)
+{
+    if(size==0 || offset<0) return -EINVAL;
+    if(flags & (MAP_FIXED | MAP_ANONYMOUS)) return -EINVAL;
+    if((flags & (MAP_SHARED | MAP_PRIVATE))==0) return -EINVAL;
+    Lock<KernelMutex> l(mappingMutex);
+    //Executing code requires relocation, which is only done when loading
+    //programs
+    if(prot!=PROT_READ && prot!=(PROT_READ | PROT_WRITE)) return -EACCES;
+    intrusive_ref_ptr<FileBase> file=fileTable.getFile(fd);
+    if(!file) return -EBADF;
+    MemoryMappedFile mmf=file->getFileFromMemory();
+    if(mmf.isValid()==false) return -ENODEV;
+    //Files in XIP filesystems can't be written through memory, only shared
+    //memory objects opened with O_RDWR can, and there's no copy on write
+    bool writable=(prot & PROT_WRITE)!=0;
+    if(writable && (mmf.writable==false || (flags & MAP_SHARED)==0))
+        return -EACCES;
+    if(offset>=mmf.size || size>mmf.size-offset) return -ENXIO;
+    auto start=reinterpret_cast<const char*>(mmf.data)+offset;
+    //As for XIP programs, the region is rounded to the minimum MPU-capable
+    //region. This may give read access to neighbouring memory, so only allow
+    //mapping files stored in the code address space which holds no kernel data.
+    //Shared memory objects are allocated from the process pool aligned to
+    //their rounded size, so the region never exceeds the object
+    const unsigned int *base;
+    unsigned int rsize;
+    tie(base,rsize)=MPUConfiguration::roundRegionForMPU(
+        reinterpret_cast<const unsigned int*>(start),size);
+    if(mmf.sharedMemory==false)
+    {
+        if(reinterpret_cast<unsigned int>(base)+rsize>0x20000000) return -ENODEV;
+        //The region is not executable and stays enabled while the process
+        //runs, so if rounding made it cover the kernel code, interrupts would
+        //fault
+        if(reinterpret_cast<const char*>(base)<kernelEnd()) return -ENODEV;
+    }
+    {
+        FastGlobalIrqLock dLock;
+        if(mappedBase) return -ENOMEM;
+        if(mpu.IRQaddMappedRegion(base,rsize,writable)==false) return -ENODEV;
+        mappedBase=start;
+    }
+    //Keep a reference to the file so the filesystem can't be unmounted
+    mappedFile=file;
+    addr=start;
+    return 0;
+}
+
+int Process::munmap(const void *addr, size_t size)
+{
+    Lock<KernelMutex> l(mappingMutex);
+    if(size==0 || addr==nullptr || addr!=mappedBase) return -EINVAL;
+    //Ring operations in progress may be accessing the mapping
+    if(ioRing && ioRing->busy()) return -EBUSY;
+    {
+        FastGlobalIrqLock dLock;
+        mpu.IRQremoveMappedRegion();
+        mappedBase=nullptr;
+    }
+    mappedFile.reset();
+    return 0;
+}
+
 void *Process::start(void *)
 {
     //This function is never called with a kernel thread, so the cast is safe
-    Process *proc=static_cast<Process*>(Thread::getCurrentThread()->proc);
-    bool running=true;
+    Thread *cur=Thread::getCurrentThread();
+    Process *proc=static_cast<Process*>(cur->proc);
+    SvcResult svcResult;
     do {
         unsigned int entry=proc->program.getEntryPoint();
-        Thread::setupUserspaceContext(entry,proc->argc,proc->argvSp,proc->envp,
-            proc->image.getProcessBasePointer(),proc->image.getMainStackSize());
-        SvcResult svcResult;
-        do {
-            SyscallParameters sp=Thread::switchToUserspace();
-
-            bool fault=proc->fault.faultHappened();
-            if(fault) svcResult=Segfault;
-            else svcResult=proc->handleSvc(sp); //Handle svc only if no fault
-
-            if(Thread::testTerminate() || svcResult==Exit) running=false;
-            //Segfault either because fault==true or handleSvc returned Segfault
-            if(svcResult==Segfault)
-            {
-                running=false;
-                proc->exitCode=SIGSEGV; //Segfault
-                #ifdef WITH_ERRLOG
-                iprintf("Process %d terminated due to a fault\n"
-                        "* Code base address was 0x%x\n"
-                        "* Data base address was %p\n",proc->pid,
-                        proc->program.getElfBase(),
-                        proc->image.getProcessBasePointer());
-                proc->mpu.dumpConfiguration();
-                if(fault) proc->fault.print();
-                #endif //WITH_ERRLOG
-            }
-        } while(running && svcResult!=Execve);
+        Thread::setupUserspaceContext(cur,entry,proc->argc,proc->argvSp,
+            proc->envp,proc->image.getProcessBasePointer(),
+            proc->image.getMainStackSize());
+        svcResult=proc->runUserspace();
         if(svcResult==Execve) proc->fileTable.cloexec();
-    } while(running);
+    } while(svcResult==Execve);
+    //The process memory can't be deallocated while other threads use it
+    proc->stopThreads();
+    //Closing files first wakes ring operations on pipes the process is the
+    //other end of
     proc->fileTable.closeAll();
+    proc->ioRing.reset();
+    proc->timePage.reset();
     {
         auto& processTable=ProcessTable::instance();
         Lock<KernelMutex> l(processTable.procMutex);
@@ -389,7 +638,180 @@ void *Process::start(void *)
     return nullptr;
 }
 
+void *Process::startThread(void *)
+{
+    //This function is never called with a kernel thread, so the cast is safe
+    Thread *cur=Thread::getCurrentThread();
+    Process *proc=static_cast<Process*>(cur->proc);
+    SvcResult svcResult=proc->runUserspace();
+    Lock<KernelMutex> l(proc->threadMutex);
+    //Exiting or faulting in any thread terminates the whole process, unless
+    //this thread has itself been terminated by another one
+    if(svcResult!=ThreadExit && Thread::testTerminate()==false)
+        proc->terminateThreads();
+    proc->threads[cur->userTid].exited=true;
+    proc->threadCv.broadcast();
+    return nullptr;
+}
+
+Process::SvcResult Process::runUserspace()
+{
+    for(;;)
+    {
+        if(Thread::testTerminate()) return Exit;
+        SyscallParameters sp=Thread::switchToUserspace();
+        //Terminated threads are brought back to kernelspace at their next
+        //context switch, in this case sp does not contain a syscall
+        if(Thread::testTerminate()) return Exit;
+
+        bool fault=this->fault.faultHappened();
+        SvcResult svcResult;
+        if(fault) svcResult=Segfault;
+        else svcResult=handleSvc(sp); //Handle svc only if no fault
+
+        //Segfault either because fault==true or handleSvc returned Segfault
+        if(svcResult==Segfault)
+        {
+            exitCode=SIGSEGV; //Segfault
+            #ifdef WITH_ERRLOG
+            iprintf("Process %d terminated due to a fault\n"
+                    "* Code base address was 0x%x\n"
+                    "* Data base address was %p\n",pid,
+                    program.getElfBase(),image.getProcessBasePointer());
+            mpu.dumpConfiguration();
+            if(fault) this->fault.print();
+            #endif //WITH_ERRLOG
+        }
+        if(svcResult!=Resume) return svcResult;
+    }
+}
+
+int Process::createThread(unsigned int entry, void *arg, char *stack,
+                          unsigned int size)
+{
+    //The initial stack pointer must be 8 byte aligned as required by the ABI
+    auto top=reinterpret_cast<char*>(
+        (reinterpret_cast<unsigned int>(stack)+size) & ~7);
+    if(top-stack<static_cast<int>(STACK_MIN+WATERMARK_LEN)) return -EINVAL;
+    Lock<KernelMutex> l(threadMutex);
+    if(stopping) return -EAGAIN;
+    unsigned int tid=1;
+    while(tid<threads.size() && threads[tid].thread) tid++;
+    if(tid>=MAX_THREADS_PER_PROCESS) return -EAGAIN;
+    if(tid==threads.size()) threads.emplace_back(); //May throw bad_alloc
+    Thread *thr=Thread::createUserspace(Process::startThread,this);
+    if(thr==nullptr) return -EAGAIN;
+    thr->userTid=tid;
+    Thread::setupUserspaceContext(thr,entry,reinterpret_cast<int>(arg),top,
+        nullptr,image.getProcessBasePointer(),top-stack-WATERMARK_LEN);
+    threads[tid]={thr,stack,static_cast<unsigned int>(top-stack-WATERMARK_LEN)};
+    //Holding threadMutex ensures terminateThreads() sees the new thread
+    thr->wakeup();
+    return tid;
+}
+
+int Process::joinThread(int tid, void *& result, void *& stack)
+{
+    Lock<KernelMutex> l(threadMutex);
+    //The main thread can't be joined as it is joined when the process exits
+    if(tid<=0 || tid>=static_cast<int>(threads.size())
+        || threads[tid].thread==nullptr) return -ESRCH;
+    if(threads[tid].thread==Thread::getCurrentThread()) return -EDEADLK;
+    if(threads[tid].joining) return -EINVAL;
+    threads[tid].joining=true;
+    //Access the vector by index, as creating threads may reallocate it
+    while(threads[tid].exited==false)
+    {
+        if(Thread::testTerminate())
+        {
+            //Let stopThreads() join it
+            threads[tid].joining=false;
+            threadCv.broadcast();
+            return -EINTR;
+        }
+        threadCv.wait(l);
+    }
+    Thread *thr=threads[tid].thread;
+    {
+        Unlock<KernelMutex> u(l);
+        thr->join(); //The thread has exited, so this won't block for long
+    }
+    result=threads[tid].result;
+    stack=threads[tid].stack;
+    threads[tid]=ProcessThread();
+    threadCv.broadcast();
+    return 0;
+}
+
+void Process::terminateThreads()
+{
+    stopping=true;
+    Thread *cur=Thread::getCurrentThread();
+    for(auto& t : threads) if(t.thread && t.thread!=cur) t.thread->terminate();
+}
+
+void Process::stopThreads()
+{
+    Lock<KernelMutex> l(threadMutex);
+    terminateThreads();
+    for(;;)
+    {
+        //Threads being joined are left to the thread joining them
+        unsigned int tid=1;
+        bool remaining=false;
+        for(;tid<threads.size();tid++)
+        {
+            if(threads[tid].thread==nullptr) continue;
+            remaining=true;
+            if(threads[tid].joining==false) break;
+        }
+        if(remaining==false) break;
+        if(tid==threads.size())
+        {
+            threadCv.wait(l);
+            continue;
+        }
+        Thread *thr=threads[tid].thread;
+        threads[tid].joining=true;
+        {
+            Unlock<KernelMutex> u(l);
+            thr->join();
+        }
+        threads[tid]=ProcessThread();
+    }
+    stopping=false;
+}
+
 Process::SvcResult Process::handleSvc(SyscallParameters sp)
+{
+    #ifdef WITH_SYSCALL_TRACE
+    if(traced)
+    {
+        SyscallTraceRecord record;
+        record.id=sp.getSyscallId();
+        //Parameters must be read before dispatchSvc() overwrites them
+        for(int i=0;i<4;i++) record.args[i]=sp.getParameter(i);
+        record.timestamp=getTime();
+        SvcResult result=dispatchSvc(sp);
+        long long duration=getTime()-record.timestamp;
+        record.duration=min<long long>(duration,UINT_MAX);
+        record.result=sp.getParameter(0);
+        record.pid=pid;
+        record.tid=Thread::getCurrentThread()->userTid;
+        if(record.id<NUM_SYSCALLS)
+        {
+            FastGlobalIrqLock dLock;
+            histogram->counts[record.id]
+                [SyscallHistogram::bucket(record.duration)]++;
+        }
+        SyscallTrace::record(record);
+        return result;
+    }
+    #endif //WITH_SYSCALL_TRACE
+    return dispatchSvc(sp);
+}
+
+Process::SvcResult Process::dispatchSvc(SyscallParameters sp)
 {
     try {
         switch(static_cast<Syscall>(sp.getSyscallId()))
@@ -502,6 +924,7 @@ Process::SvcResult Process::handleSvc(SyscallParameters sp)
                     case F_DUPFD: //Third parameter is int, no validation needed
                     case F_SETFD:
                     case F_SETFL:
+                    case F_SETPIPE_SZ:
                         result=fileTable.fcntl(sp.getParameter(0),cmd,
                                                sp.getParameter(2));
                         break;
@@ -727,14 +1150,369 @@ Process::SvcResult Process::handleSvc(SyscallParameters sp)
                 break;
             }
 
-            case Syscall::GETTIME64:
+            case Syscall::POLL:
+            {
+                auto fds=reinterpret_cast<struct pollfd*>(sp.getParameter(0));
+                unsigned int nfds=sp.getParameter(1);
+                int timeout=sp.getParameter(2);
+                //Check nfds first, to prevent overflow in the size computation
+                if(nfds>MAX_OPEN_FILES) sp.setParameter(0,-EINVAL);
+                else if(nfds>0 && (!aligned(fds) ||
+                        !mpu.withinForWriting(fds,nfds*sizeof(struct pollfd))))
+                    sp.setParameter(0,-EFAULT);
+                else {
+                    int result=fileTable.poll(fds,nfds,
+                        timeout<0 ? -1 : static_cast<long long>(timeout)*1000000);
+                    sp.setParameter(0,result);
+                }
+                break;
+            }
+
+            case Syscall::SENDFILE:
+            {
+                auto offset=reinterpret_cast<off_t*>(sp.getParameter(2));
+                if(offset==nullptr ||
+                   (mpu.withinForWriting(offset,sizeof(off_t)) && aligned(offset)))
+                {
+                    ssize_t result=fileTable.sendfile(sp.getParameter(0),
+                        sp.getParameter(1),offset,sp.getParameter(3));
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::PREAD:
+            {
+                int fd=sp.getParameter(0);
+                void *ptr=reinterpret_cast<void*>(sp.getParameter(1));
+                size_t size=sp.getParameter(2);
+                auto pos=reinterpret_cast<const off_t*>(sp.getParameter(3));
+                if(mpu.withinForWriting(ptr,size) &&
+                   mpu.withinForReading(pos,sizeof(off_t)) && aligned(pos))
+                {
+                    ssize_t result=fileTable.pread(fd,ptr,size,*pos);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::PWRITE:
+            {
+                int fd=sp.getParameter(0);
+                void *ptr=reinterpret_cast<void*>(sp.getParameter(1));
+                size_t size=sp.getParameter(2);
+                auto pos=reinterpret_cast<const off_t*>(sp.getParameter(3));
+                if(mpu.withinForReading(ptr,size) &&
+                   mpu.withinForReading(pos,sizeof(off_t)) && aligned(pos))
+                {
+                    ssize_t result=fileTable.pwrite(fd,ptr,size,*pos);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::READV:
+            case Syscall::WRITEV:
             {
-                long long t=getTime();
-                sp.setParameter(0,t & 0xffffffff);
-                sp.setParameter(1,t>>32);
+                bool isRead=sp.getSyscallId()==static_cast<unsigned int>(Syscall::READV);
+                int fd=sp.getParameter(0);
+                auto iov=reinterpret_cast<const struct iovec*>(sp.getParameter(1));
+                int iovcnt=sp.getParameter(2);
+                if(iovcnt<=0 || iovcnt>IOV_MAX)
+                {
+                    sp.setParameter(0,-EINVAL);
+                    break;
+                }
+                if(!mpu.withinForReading(iov,iovcnt*sizeof(struct iovec)) ||
+                   !aligned(iov))
+                {
+                    sp.setParameter(0,-EFAULT);
+                    break;
+                }
+                //Copy the array to prevent the process from changing it after
+                //the buffers have been validated
+                struct iovec kiov[IOV_MAX];
+                bool valid=true;
+                for(int i=0;i<iovcnt;i++)
+                {
+                    kiov[i]=iov[i];
+                    if(isRead) valid&=mpu.withinForWriting(kiov[i].iov_base,kiov[i].iov_len);
+                    else valid&=mpu.withinForReading(kiov[i].iov_base,kiov[i].iov_len);
+                }
+                if(valid==false) sp.setParameter(0,-EFAULT);
+                else if(isRead) sp.setParameter(0,fileTable.readv(fd,kiov,iovcnt));
+                else sp.setParameter(0,fileTable.writev(fd,kiov,iovcnt));
+                break;
+            }
+
+            case Syscall::MMAP:
+            {
+                //Only four parameters fit in registers, so fd and offset are
+                //passed through a pointer to the caller's stack
+                struct MmapArgs { int fd; int pad; off_t offset; };
+                auto args=reinterpret_cast<const MmapArgs*>(sp.getParameter(0));
+                const void *addr=nullptr;
+                int result;
+                if(mpu.withinForReading(args,sizeof(MmapArgs)) && aligned(args))
+                    result=mmap(sp.getParameter(1),sp.getParameter(2),
+                                sp.getParameter(3),args->fd,args->offset,addr);
+                else result=-EFAULT;
+                sp.setParameter(0,reinterpret_cast<unsigned int>(addr));
+                sp.setParameter(1,result);
+                break;
+            }
+
+            case Syscall::MUNMAP:
+            {
+                auto addr=reinterpret_cast<const void*>(sp.getParameter(0));
+                sp.setParameter(0,munmap(addr,sp.getParameter(1)));
+                break;
+            }
+
+            case Syscall::IORING_SETUP:
+            {
+                auto ring=reinterpret_cast<io_ring*>(sp.getParameter(0));
+                //Only one ring per process, setting up a new one or passing
+                //nullptr destroys the previous one
+                Lock<KernelMutex> l(mappingMutex);
+                int result=0;
+                if(ioRingWaiters>0) result=-EBUSY;
+                else {
+                    ioRing.reset();
+                    if(ring) ioRing.reset(IoRing::create(ring,fileTable,mpu,result));
+                }
+                sp.setParameter(0,result);
+                break;
+            }
+
+            case Syscall::IORING_ENTER:
+            {
+                IoRing *ring;
+                {
+                    //Buffers are validated against the current mappings
+                    Lock<KernelMutex> l(mappingMutex);
+                    ring=ioRing.get();
+                    if(ring==nullptr)
+                    {
+                        sp.setParameter(0,-EINVAL);
+                        break;
+                    }
+                    sp.setParameter(0,ring->submit(sp.getParameter(0)));
+                    ioRingWaiters++;
+                }
+                //Wait without holding the mutex, as it may take forever, while
+                //ioRingWaiters keeps other threads from destroying the ring
+                ring->waitCompletions(sp.getParameter(1));
+                Lock<KernelMutex> l(mappingMutex);
+                ioRingWaiters--;
+                break;
+            }
+
+            case Syscall::TIMEPAGE_SETUP:
+            {
+                auto page=reinterpret_cast<time_page*>(sp.getParameter(0));
+                Lock<KernelMutex> l(mappingMutex);
+                if(mpu.withinForWriting(page,sizeof(time_page)) && aligned(page))
+                    sp.setParameter(0,timePage.setup(page));
+                else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::BATCH:
+            {
+                auto descs=reinterpret_cast<syscall_desc*>(sp.getParameter(0));
+                unsigned int count=sp.getParameter(1);
+                //Validate the whole array once, the syscalls in the batch
+                //validate their own pointer parameters as usual
+                if(count>SYSCALL_BATCH_MAX) sp.setParameter(0,-EINVAL);
+                else if(mpu.withinForWriting(descs,count*sizeof(syscall_desc))
+                        && aligned(descs))
+                    sp.setParameter(0,handleBatch(descs,count));
+                else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::SHM_OPEN:
+            {
+                auto name=reinterpret_cast<const char*>(sp.getParameter(0));
+                int flags=sp.getParameter(1);
+                if(mpu.withinForReading(name))
+                {
+                    intrusive_ref_ptr<FileBase> file;
+                    int result=SharedMemory::open(name,flags,file);
+                    if(result==0) result=fileTable.add(file,flags);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::SHM_UNLINK:
+            {
+                auto name=reinterpret_cast<const char*>(sp.getParameter(0));
+                if(mpu.withinForReading(name))
+                    sp.setParameter(0,SharedMemory::unlink(name));
+                else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::FUTEX_WAIT:
+            {
+                auto addr=reinterpret_cast<const int*>(sp.getParameter(0));
+                int expected=sp.getParameter(1);
+                long long timeout=sp.getParameter(2);
+                timeout|=static_cast<long long>(sp.getParameter(3))<<32;
+                if(mpu.withinForReading(addr,sizeof(int)) && aligned(addr))
+                    sp.setParameter(0,Futex::wait(addr,expected,timeout));
+                else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::FUTEX_WAKE:
+            {
+                //Not dereferenced, only used as a key, no need to validate it
+                auto addr=reinterpret_cast<const int*>(sp.getParameter(0));
+                sp.setParameter(0,Futex::wake(addr,sp.getParameter(1)));
+                break;
+            }
+
+            case Syscall::THREAD_CREATE:
+            {
+                auto stack=reinterpret_cast<char*>(sp.getParameter(2));
+                unsigned int size=sp.getParameter(3);
+                if(mpu.withinForWriting(stack,size) && aligned(stack))
+                {
+                    auto arg=reinterpret_cast<void*>(sp.getParameter(1));
+                    sp.setParameter(0,createThread(sp.getParameter(0),arg,
+                                                   stack,size));
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::THREAD_EXIT:
+            {
+                Thread *cur=Thread::getCurrentThread();
+                //The main thread exits by returning from main() or calling
+                //exit(), terminating the process
+                if(cur->userTid==0)
+                {
+                    sp.setParameter(0,-EINVAL);
+                    break;
+                }
+                Lock<KernelMutex> l(threadMutex);
+                threads[cur->userTid].result=
+                    reinterpret_cast<void*>(sp.getParameter(0));
+                return ThreadExit;
+            }
+
+            case Syscall::THREAD_JOIN:
+            {
+                auto result=reinterpret_cast<void**>(sp.getParameter(1));
+                auto stack=reinterpret_cast<void**>(sp.getParameter(2));
+                if((result==nullptr ||
+                    (mpu.withinForWriting(result,sizeof(void*)) && aligned(result)))
+                    && mpu.withinForWriting(stack,sizeof(void*)) && aligned(stack))
+                {
+                    void *r, *s;
+                    int error=joinThread(sp.getParameter(0),r,s);
+                    if(error==0)
+                    {
+                        if(result) *result=r;
+                        *stack=s;
+                    }
+                    sp.setParameter(0,error);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            //THREAD_SELF and ATOMIC_CAS are handled in Thread::IRQhandleSvc()
+
+            case Syscall::HEAP_SETUP:
+            {
+                auto p=reinterpret_cast<const char* const*>(sp.getParameter(0));
+                if(mpu.withinForReading(p,sizeof(char*)) && aligned(p))
+                {
+                    maxUsedHeap=p;
+                    sp.setParameter(0,0);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::MQ_OPEN:
+            {
+                auto name=reinterpret_cast<const char*>(sp.getParameter(0));
+                int flags=sp.getParameter(1);
+                //attr is only passed by the caller together with O_CREAT
+                auto attr=(flags & O_CREAT)==0 ? nullptr :
+                    reinterpret_cast<const MessageQueueAttr*>(sp.getParameter(2));
+                if(mpu.withinForReading(name) && (attr==nullptr ||
+                    (mpu.withinForReading(attr,sizeof(MessageQueueAttr))
+                    && aligned(attr))))
+                {
+                    intrusive_ref_ptr<FileBase> file;
+                    int result=MessageQueue::open(name,flags,attr,file);
+                    if(result==0) result=fileTable.add(file,flags);
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::MQ_UNLINK:
+            {
+                auto name=reinterpret_cast<const char*>(sp.getParameter(0));
+                if(mpu.withinForReading(name))
+                    sp.setParameter(0,MessageQueue::unlink(name));
+                else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            case Syscall::MQ_SEND:
+            case Syscall::MQ_RECEIVE:
+            {
+                int fd=sp.getParameter(0);
+                MessageQueueTransfer t;
+                t.data=reinterpret_cast<void*>(sp.getParameter(1));
+                t.size=sp.getParameter(2);
+                bool send=static_cast<Syscall>(sp.getSyscallId())==
+                    Syscall::MQ_SEND;
+                auto prio=reinterpret_cast<unsigned int*>(sp.getParameter(3));
+                bool ok;
+                if(send)
+                {
+                    t.priority=sp.getParameter(3);
+                    ok=mpu.withinForReading(t.data,t.size);
+                } else {
+                    ok=mpu.withinForWriting(t.data,t.size) && (prio==nullptr
+                        || (mpu.withinForWriting(prio,sizeof(unsigned int))
+                        && aligned(prio)));
+                }
+                if(ok)
+                {
+                    int result=fileTable.ioctl(fd,
+                        send ? IOCTL_MQ_SEND : IOCTL_MQ_RECEIVE,&t);
+                    //Not a message queue
+                    if(result==-ENOTTY) result=-EBADF;
+                    if(result>=0 && !send && prio) *prio=t.priority;
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
                 break;
             }
 
+            case Syscall::MQ_GETATTR:
+            {
+                int fd=sp.getParameter(0);
+                auto attr=reinterpret_cast<MessageQueueAttr*>(sp.getParameter(1));
+                if(mpu.withinForWriting(attr,sizeof(MessageQueueAttr))
+                    && aligned(attr))
+                {
+                    int result=fileTable.ioctl(fd,IOCTL_MQ_GETATTR,attr);
+                    if(result==-ENOTTY) result=-EBADF;
+                    sp.setParameter(0,result);
+                } else sp.setParameter(0,-EFAULT);
+                break;
+            }
+
+            //GETTIME64 is handled in Thread::IRQhandleSvc()
+
             case Syscall::NANOSLEEP64:
             {
                 long long t=sp.getParameter(0);
@@ -820,6 +1598,13 @@ Process::SvcResult Process::handleSvc(SyscallParameters sp)
                 auto path=reinterpret_cast<const char*>(sp.getParameter(0));
                 auto argv=reinterpret_cast<char* const*>(sp.getParameter(1));
                 auto envp=reinterpret_cast<char* const*>(sp.getParameter(2));
+                //Only the main thread can replace the program, as it's the
+                //one that restarts from the program entry point
+                if(Thread::getCurrentThread()->userTid!=0)
+                {
+                    sp.setParameter(0,-EINVAL);
+                    break;
+                }
                 int narg=validateStringArray(mpu,argv);
                 int nenv=validateStringArray(mpu,envp);
                 if(mpu.withinForReading(path) && narg>=0 && nenv>=0)
@@ -831,8 +1616,8 @@ Process::SvcResult Process::handleSvc(SyscallParameters sp)
                         if(program.errorCode()==0)
                         {
                             try {
-                                //TODO: when threads within processes are
-                                //implemented, kill all other threads
+                                //Other threads would run the old program
+                                stopThreads();
                                 load(std::move(program),std::move(args));
                             } catch(exception& e) {
                                 //TODO currently load causes the old process
@@ -895,11 +1680,7 @@ Process::SvcResult Process::handleSvc(SyscallParameters sp)
                 break;
             }
 
-            case Syscall::GETPID:
-            {
-                sp.setParameter(0,this->pid);
-                break;
-            }
+            //GETPID is handled in Thread::IRQhandleSvc()
 
             case Syscall::GETPPID:
             {
@@ -980,6 +1761,92 @@ Process::SvcResult Process::handleSvc(SyscallParameters sp)
     return Resume;
 }
 
+int Process::handleBatch(syscall_desc *descs, unsigned int count)
+{
+    unsigned int context[CTXSAVE_SIZE];
+    for(unsigned int i=0;i<count;i++)
+    {
+        //Copy the id in the context only once, as the process memory could
+        //change after batchable() has checked it
+        unsigned int id=descs[i].id;
+        if(batchable(id)==false)
+        {
+            descs[i].args[0]=-ENOSYS;
+            return i+1;
+        }
+        initSyscallContext(context,id,descs[i].args);
+        #ifdef WITH_PROCFS
+        {
+            FastGlobalIrqLock dLock;
+            syscallCounts[id]++;
+        }
+        #endif //WITH_PROCFS
+        //Batchable syscalls always resume, the result is in args[0]
+        handleSvc(SyscallParameters(context));
+        //lseek has a 64 bit result, its sign is in the upper word, while
+        //getcwd leaves the buffer pointer in args[0]
+        int result;
+        switch(static_cast<Syscall>(id))
+        {
+            case Syscall::LSEEK:
+            case Syscall::GETCWD:
+                result=descs[i].args[1];
+                break;
+            default:
+                result=descs[i].args[0];
+        }
+        if(result<0 || Thread::testTerminate()) return i+1;
+    }
+    return count;
+}
+
+bool Process::batchable(unsigned int id)
+{
+    switch(static_cast<Syscall>(id))
+    {
+        case Syscall::OPEN:
+        case Syscall::CLOSE:
+        case Syscall::READ:
+        case Syscall::WRITE:
+        case Syscall::LSEEK:
+        case Syscall::STAT:
+        case Syscall::LSTAT:
+        case Syscall::FSTAT:
+        case Syscall::FCNTL:
+        case Syscall::IOCTL:
+        case Syscall::ISATTY:
+        case Syscall::GETCWD:
+        case Syscall::CHDIR:
+        case Syscall::GETDENTS:
+        case Syscall::MKDIR:
+        case Syscall::RMDIR:
+        case Syscall::LINK:
+        case Syscall::UNLINK:
+        case Syscall::SYMLINK:
+        case Syscall::READLINK:
+        case Syscall::TRUNCATE:
+        case Syscall::FTRUNCATE:
+        case Syscall::RENAME:
+        case Syscall::CHMOD:
+        case Syscall::FCHMOD:
+        case Syscall::CHOWN:
+        case Syscall::FCHOWN:
+        case Syscall::LCHOWN:
+        case Syscall::DUP:
+        case Syscall::DUP2:
+        case Syscall::ACCESS:
+        case Syscall::PREAD:
+        case Syscall::PWRITE:
+        case Syscall::READV:
+        case Syscall::WRITEV:
+        case Syscall::MQ_SEND:
+        case Syscall::MQ_RECEIVE:
+            return true;
+        default:
+            return false;
+    }
+}
+
 //
 // class ArgsBlock
 //
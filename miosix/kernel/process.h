@@ -31,14 +31,34 @@
 #include <map>
 #include <list>
 #include <set>
+#include <memory>
 #include <sys/types.h>
 #include "thread.h"
 #include "sync.h"
 #include "elf_program.h"
 #include "miosix_settings.h"
 #include "filesystem/file_access.h"
+#include "io_ring.h"
+#include "time_page.h"
 #include "interfaces_private/userspace.h" //TODO: avoid including private header
 
+#if __has_include(<sys/syscall_batch.h>)
+#include <sys/syscall_batch.h>
+#else //__has_include(<sys/syscall_batch.h>)
+
+//Compilers predating batched syscalls lack sys/syscall_batch.h, keep in sync
+//with libc/sys/miosix/sys/syscall_batch.h in the newlib patch
+
+struct syscall_desc
+{
+    unsigned int id;
+    unsigned int args[4];
+};
+
+#define SYSCALL_BATCH_MAX 64
+
+#endif //__has_include(<sys/syscall_batch.h>)
+
 #ifdef WITH_PROCESSES
 
 namespace miosix {
@@ -46,6 +66,11 @@ namespace miosix {
 //Forware decl
 class Process;
 class ArgsBlock;
+struct SyscallHistogram;
+
+/// Must be greater than the highest syscall number, used to size the per
+/// process syscall counters
+const unsigned int NUM_SYSCALLS=85;
 
 /**
  * This class contains the fields that are in common between the kernel and
@@ -163,6 +188,81 @@ public:
      * 0 is returned
      */
     static pid_t waitpid(pid_t pid, int *exit, int options);
+
+    #ifdef WITH_PROCFS
+
+    /**
+     * Resource usage of a thread of a process
+     */
+    struct ThreadInfo
+    {
+        int tid;                      ///< Thread id, the main thread has id 0
+        long long cpuTime;            ///< CPU time in ns, -1 if not available
+        unsigned int stackSize;       ///< Userspace stack size
+        unsigned int stackUsed;       ///< Max userspace stack used
+        unsigned int kernelStackSize; ///< Stack size of the kernel side
+        unsigned int kernelStackUsed; ///< Max stack used by the kernel side
+    };
+
+    /**
+     * Resource usage of a process
+     */
+    struct ProcessInfo
+    {
+        pid_t pid;                ///< Process pid
+        pid_t ppid;               ///< Parent process pid
+        bool zombie;              ///< True if the process has terminated
+        unsigned int elfSize;     ///< Size of the program
+        bool elfInRam;            ///< True if the program is copied in RAM
+        unsigned int imageSize;   ///< Size of the process image
+        unsigned int dataBssSize; ///< Size of .data and .bss
+        unsigned int heapUsed;    ///< Max heap used
+        int openFiles;            ///< Number of open file descriptors
+        long long cpuTime;        ///< Sum of the CPU time of the threads
+        std::vector<ThreadInfo> threads; ///< Empty for zombie processes
+        ///Number of syscalls made, indexed by syscall id. Syscalls in a batch
+        ///are counted both individually and as part of the batch
+        unsigned int syscalls[NUM_SYSCALLS];
+    };
+
+    /**
+     * \return the pids of all processes, including zombies but excluding the
+     * kernel, in increasing order
+     */
+    static std::vector<pid_t> getPids();
+
+    /**
+     * Collect the resource usage of a process
+     * \param pid process pid
+     * \param info resource usage is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    static int getInfo(pid_t pid, ProcessInfo& info);
+
+    #endif //WITH_PROCFS
+
+    #ifdef WITH_SYSCALL_TRACE
+
+    /**
+     * Start or stop tracing the syscalls made by a process. The syscalls of a
+     * traced process are recorded in the SyscallTrace ring buffer and their
+     * duration is added to the process latency histograms
+     * \param pid process pid
+     * \param enable true to start tracing, false to stop
+     * \return 0 on success, or a negative number on failure
+     */
+    static int setTracing(pid_t pid, bool enable);
+
+    /**
+     * Get the syscall latency histograms of a process
+     * \param pid process pid
+     * \param histogram histograms are returned here. They are cleared if the
+     * process has never been traced
+     * \return 0 on success, or a negative number on failure
+     */
+    static int getSyscallHistogram(pid_t pid, SyscallHistogram& histogram);
+
+    #endif //WITH_SYSCALL_TRACE
     
     /**
      * Destructor
@@ -186,6 +286,31 @@ private:
      * \param args program arguments and environment variables
      */
     void load(ElfProgram&& program, ArgsBlock&& args);
+
+    /**
+     * Map a file stored in memory, such as a file in an XIP filesystem, in
+     * the process address space. Only read-only mappings are supported, and
+     * only one file at a time can be mapped, as each mapping takes an MPU
+     * region. Due to MPU alignment constraints the process may gain read
+     * access also to memory surrounding the file.
+     * \param size size of the mapping
+     * \param prot memory protection, only PROT_READ is supported
+     * \param flags MAP_SHARED or MAP_PRIVATE
+     * \param fd file descriptor of the file to map
+     * \param offset offset within the file
+     * \param addr the address of the mapping is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    int mmap(size_t size, int prot, int flags, int fd, off_t offset,
+             const void *& addr);
+
+    /**
+     * Remove the mapping created by mmap()
+     * \param addr address returned by mmap()
+     * \param size size of the mapping, the whole mapping is always removed
+     * \return 0 on success, or a negative number on failure
+     */
+    int munmap(const void *addr, size_t size);
     
     /**
      * Contains the process' main loop. 
@@ -194,21 +319,98 @@ private:
      */
     static void *start(void *argv);
 
+    /**
+     * Entry point of the kernel side of threads created by the process with
+     * pthread_create(), other than the main thread
+     * \param argv unused
+     * \return null
+     */
+    static void *startThread(void *argv);
+
     enum SvcResult
     {
         Resume=0,   ///< Process can switch to userspace and resume operation
         Exit=1,     ///< Process exited
         Execve=2,   ///< Process can resume, but the program has been switched
-        Segfault=3  ///< Unrecoverable error occurred
+        Segfault=3, ///< Unrecoverable error occurred
+        ThreadExit=4 ///< The calling thread exited, the process keeps running
     };
+
+    /**
+     * Run the calling thread in userspace, serving its syscalls
+     * \return the reason why the thread can't continue running the current
+     * program. Exit is also returned if the thread has been terminated
+     */
+    SvcResult runUserspace();
+
+    /**
+     * Create a new thread within the process
+     * \param entry userspace entry point of the thread
+     * \param arg argument passed to the entry point
+     * \param stack userspace stack of the thread, must have been validated to
+     * be in the process memory
+     * \param size stack size
+     * \return the thread id, or a negative number on failure
+     */
+    int createThread(unsigned int entry, void *arg, char *stack,
+                     unsigned int size);
+
+    /**
+     * Wait for a thread of the process to exit
+     * \param tid thread id
+     * \param result the value passed to pthread_exit() is returned here
+     * \param stack the userspace stack of the thread is returned here, so
+     * that the process can deallocate it
+     * \return 0 on success, or a negative number on failure
+     */
+    int joinThread(int tid, void *& result, void *& stack);
+
+    /**
+     * Terminate all threads of the process except the calling one, and
+     * prevent the creation of new ones. Does not wait for them to exit.
+     * Must be called with threadMutex locked
+     */
+    void terminateThreads();
+
+    /**
+     * Terminate all threads of the process except the main thread, which
+     * must be the caller, and wait for them to exit
+     */
+    void stopThreads();
     
     /**
-     * Handle a supervisor call
+     * Handle a supervisor call, tracing it if the process is traced
      * \param sp syscall parameters
      * \return true if the process can continue running, false if it has
      * terminated
      */
     SvcResult handleSvc(SyscallParameters sp);
+
+    /**
+     * Serve a supervisor call, called by handleSvc()
+     * \param sp syscall parameters
+     * \return true if the process can continue running, false if it has
+     * terminated
+     */
+    SvcResult dispatchSvc(SyscallParameters sp);
+
+    /**
+     * Execute a batch of syscalls submitted with a single supervisor call
+     * \param descs array of syscall descriptors, must have been validated to
+     * be in the process memory
+     * \param count number of descriptors
+     * \return the number of descriptors executed, stopping after the first
+     * syscall that failed
+     */
+    int handleBatch(syscall_desc *descs, unsigned int count);
+
+    /**
+     * \param id syscall id
+     * \return true if the syscall can be part of a batch. Syscalls that change
+     * the process control flow or its memory map, or that are handled in
+     * Thread::IRQhandleSvc() can't
+     */
+    static bool batchable(unsigned int id);
     
     ElfProgram program; ///<The program that is running inside the process
     ProcessImage image; ///<The RAM image of a process
@@ -217,8 +419,48 @@ private:
     int argc;   ///< Process argument count
     void *argvSp; ///< Ptr to argument array within ProcessImage and initial sp
     void *envp; ///< Pointer to the environment array within the ProcessImage
+    intrusive_ref_ptr<FileBase> mappedFile; ///< File mapped with mmap()
+    const void *mappedBase=nullptr; ///< Address of the mapping, if any
+    std::unique_ptr<IoRing> ioRing; ///< Asynchronous I/O ring, if any
+    TimePage timePage; ///< Time page kept up to date by the kernel, if any
+    ///Serializes the syscalls of the process threads that change mappedFile,
+    ///mappedBase, ioRing and timePage
+    KernelMutex mappingMutex;
+    ///Threads waiting for ring completions, the ring can't be replaced while
+    ///it is nonzero
+    unsigned int ioRingWaiters=0;
+    ///Variable where the process stores its heap high-water mark, if any
+    const char * const *maxUsedHeap=nullptr;
+    #ifdef WITH_PROCFS
+    ///Number of syscalls made, indexed by syscall id
+    unsigned int syscallCounts[NUM_SYSCALLS]={0};
+    #endif //WITH_PROCFS
+    #ifdef WITH_SYSCALL_TRACE
+    bool traced=false; ///< True if the syscalls of the process are traced
+    ///Allocated the first time the process is traced, kept until it exits as
+    ///threads may be using it while tracing is stopped
+    std::unique_ptr<SyscallHistogram> histogram;
+    #endif //WITH_SYSCALL_TRACE
     
-    std::vector<Thread *> threads; ///<Threads that belong to the process
+    /**
+     * Kernel side bookkeeping of a thread of the process
+     */
+    struct ProcessThread
+    {
+        Thread *thread=nullptr; ///< Thread, or nullptr if the slot is free
+        void *stack=nullptr;    ///< Userspace stack allocated by the process
+        unsigned int stackSize=0; ///< Userspace stack size, excluding watermark
+        void *result=nullptr;   ///< Value passed to pthread_exit()
+        bool exited=false;      ///< True when the thread has exited
+        bool joining=false;     ///< True if a thread is joining this one
+    };
+
+    ///Threads that belong to the process, indexed by thread id. The main
+    ///thread has id 0, slots of joined threads are reused
+    std::vector<ProcessThread> threads;
+    KernelMutex threadMutex; ///< Protects threads and stopping
+    ConditionVariable threadCv; ///< Signaled when a thread exits or is joined
+    bool stopping=false; ///< True while the threads are being terminated
     
     ///Contains the count of active wait calls which specifically requested
     ///to wait on this process
@@ -363,7 +605,8 @@ enum class Syscall
     DUP2      = 31,
     PIPE      = 32,
     ACCESS    = 33,
-    //From 34 to 35 reserved for future use
+    POLL      = 34,
+    SENDFILE  = 35,
 
     // Time syscalls
     GETTIME64   = 36,
@@ -395,9 +638,55 @@ enum class Syscall
     MKFS      = 58, //Moving filesystem creation code to kernel
 
     // Misc syscalls
-    SYSCONF   = 59
+    SYSCONF   = 59,
+
+    // Positional and scatter-gather file syscalls
+    PREAD     = 60,
+    PWRITE    = 61,
+    READV     = 62,
+    WRITEV    = 63,
+
+    // Memory mapping syscalls
+    MMAP      = 64,
+    MUNMAP    = 65,
+
+    // Asynchronous I/O syscalls
+    IORING_SETUP = 66,
+    IORING_ENTER = 67,
+
+    // Time syscalls (continued)
+    TIMEPAGE_SETUP = 68,
+
+    // Batched syscall submission
+    BATCH     = 69,
+
+    // Shared memory syscalls
+    SHM_OPEN   = 70,
+    SHM_UNLINK = 71,
+    FUTEX_WAIT = 72,
+    FUTEX_WAKE = 73,
+
+    // Thread syscalls
+    THREAD_CREATE = 74,
+    THREAD_EXIT   = 75,
+    THREAD_JOIN   = 76,
+    THREAD_SELF   = 77,
+    ATOMIC_CAS    = 78,
+
+    // Memory accounting syscalls
+    HEAP_SETUP    = 79,
+
+    // Message queue syscalls
+    MQ_OPEN    = 80,
+    MQ_UNLINK  = 81,
+    MQ_SEND    = 82,
+    MQ_RECEIVE = 83,
+    MQ_GETATTR = 84
 };
 
+static_assert(static_cast<unsigned int>(Syscall::MQ_GETATTR)<NUM_SYSCALLS,
+              "NUM_SYSCALLS too small");
+
 } //namespace miosix
 
 #endif //WITH_PROCESSES
@@ -44,9 +44,21 @@ using namespace std;
 
 namespace miosix {
 
+//ARMv8-M MPU regions only need to be a multiple of 32 bytes, while older MPUs
+//need power of 2 regions aligned to their size
+#if (defined(__CORTEX_M) && __CORTEX_M == 33) || defined(TEST_EXACT_SIZE)
+#define EXACT_SIZE_ALLOCATION
+#endif
+
+#ifdef EXACT_SIZE_ALLOCATION
+///This constant specifies the size of the minimum allocatable block,
+///in bits. The minimum block size is 2^5 or 32 bytes, the MPU granularity.
+static const unsigned int blockBits=5;
+#else //EXACT_SIZE_ALLOCATION
 ///This constant specifies the size of the minimum allocatable block,
 ///in bits. The minimum supported block size is 2^10 or 1KB.
 static const unsigned int blockBits=10;
+#endif //EXACT_SIZE_ALLOCATION
 ///This constant is the the size of the minimum allocatable block, in bytes.
 static const unsigned int blockSize=1<<blockBits;
 
@@ -61,50 +73,56 @@ ProcessPool& ProcessPool::instance()
         reinterpret_cast<unsigned int>(&_process_pool_start));
     return pool;
     #else //TEST_ALLOC
-    static ProcessPool pool(reinterpret_cast<unsigned int*>(0x20008000),96*1024);
+    //The allocator stores its free lists in the pool, so it must be real memory
+    alignas(32*1024) static unsigned int testPool[96*1024/sizeof(unsigned int)];
+    static ProcessPool pool(testPool,sizeof(testPool));
     return pool;
     #endif //TEST_ALLOC
 }
     
 tuple<unsigned int *, unsigned int> ProcessPool::allocate(unsigned int size)
 {
-    //This allocator was originally designed to round each allocation to the
-    //next power of two, and to return a pointer aligned to the (rounded-up)
-    //size, as this was required by the MPU of ARMv7/ARMv6 CPUs.
+    //This is a buddy allocator, blocks are a power of two in size and aligned
+    //to their size, as this is required by the MPU of ARMv7/ARMv6 CPUs.
     //Newer ARMv8 CPUs support any size that is a multiple of 32 bytes and only
-    //require 32 byte alignment.
-    //However, the old contraint also solved the problem of allocator
-    //fragmentation so for the time being, regardless of the CPU version, we
-    //always round sizes to the next power of 2, and return aligned pointers.
-    size=std::bit_ceil(max(size,blockSize));
+    //require 32 byte alignment, so the unused tail of the block is split into
+    //smaller blocks and given back to the free lists.
     if(size>poolSize) throw bad_alloc();
+    unsigned int requested=size;
+    size=max(size,blockSize);
+    const unsigned int bits=std::bit_width(size-1);
+    #ifdef EXACT_SIZE_ALLOCATION
+    size=(size+blockSize-1) & ~(blockSize-1);
+    #else //EXACT_SIZE_ALLOCATION
+    size=1<<bits;
+    #endif //EXACT_SIZE_ALLOCATION
     
     #ifndef TEST_ALLOC
     Lock<KernelMutex> l(mutex);
     #endif //TEST_ALLOC
-    unsigned int offset=0;
-    if(reinterpret_cast<unsigned int>(poolBase) % size)
-        offset=size-(reinterpret_cast<unsigned int>(poolBase) % size);
-    unsigned int startBit=offset/blockSize;
-    unsigned int sizeBit=size/blockSize;
-
-    for(unsigned int i=startBit;i<=poolSize/blockSize;i+=sizeBit)
+    unsigned int i=bits;
+    while(i<32 && freeLists[i]==nullptr) i++;
+    if(i>=32) throw bad_alloc();
+    FreeBlock *block=freeLists[i];
+    removeFree(block);
+    auto result=reinterpret_cast<unsigned int*>(block);
+    try {
+        allocatedBlocks[result]={size,requested};
+    } catch(...) {
+        addFree(reinterpret_cast<unsigned int>(block),i);
+        throw;
+    }
+    //Split the block until it is of the right size
+    unsigned int addr=reinterpret_cast<unsigned int>(block);
+    while(i>bits)
     {
-        bool notEmpty=false;
-        for(unsigned int j=0;j<sizeBit;j++)
-        {
-            if(testBit(i+j)==0) continue;
-            notEmpty=true;
-            break;
-        }
-        if(notEmpty) continue;
-        
-        for(unsigned int j=0;j<sizeBit;j++) setBit(i+j);
-        unsigned int *result=poolBase+i*blockSize/sizeof(unsigned int);
-        allocatedBlocks[result]=size;
-        return {result,size};
+        i--;
+        addFree(addr+(1<<i),i);
     }
-    throw bad_alloc();
+    #ifdef EXACT_SIZE_ALLOCATION
+    freeRange(addr+size,addr+(1<<bits));
+    #endif //EXACT_SIZE_ALLOCATION
+    return {result,size};
 }
 
 void ProcessPool::deallocate(unsigned int *ptr)
@@ -119,11 +137,34 @@ void ProcessPool::deallocate(unsigned int *ptr)
     #else //TEST_ALLOC
         throw runtime_error("ProcessPool::deallocate corrupted pointer");
     #endif //TEST_ALLOC
-    unsigned int size=(it->second)/blockSize;
-    unsigned int firstBit=(reinterpret_cast<unsigned int>(ptr)-
-                           reinterpret_cast<unsigned int>(poolBase))/blockSize;
-    for(unsigned int i=firstBit;i<firstBit+size;i++) clearBit(i);
+    unsigned int addr=reinterpret_cast<unsigned int>(ptr);
+    unsigned int size=it->second.size;
+    //Must be erased before freeing, as isFree() looks for allocated blocks
     allocatedBlocks.erase(it);
+    freeRange(addr,addr+size);
+}
+
+ProcessPool::Stats ProcessPool::getStats()
+{
+    #ifndef TEST_ALLOC
+    Lock<KernelMutex> l(mutex);
+    #endif //TEST_ALLOC
+    Stats result={poolSize,0,0,0,0,0};
+    for(auto& it : allocatedBlocks)
+    {
+        result.requested+=it.second.requested;
+        result.allocated+=it.second.size;
+        result.allocatedBlocks++;
+    }
+    for(unsigned int i=0;i<32;i++)
+    {
+        for(FreeBlock *b=freeLists[i];b!=nullptr;b=b->next)
+        {
+            result.freeBlocks++;
+            result.largestFree=1<<i;
+        }
+    }
+    return result;
 }
 
 #ifdef TEST_ALLOC
@@ -135,40 +176,157 @@ void ProcessPool::printAllocatedBlocks()
     using namespace std;
     cout<<endl;
     for(auto it : allocatedBlocks)
-        cout<<"block of size "<<it.second<<" allocated @ "<<it.first<<endl;
-
-    cout<<"Bitmap:";
-    for(unsigned int i=0;i<poolSize/blockSize;i++)
-    {
-        if(i%32==0) cout<<endl;
-        cout<<testBit(i) ? '1' : '0';
-    }
-    cout<<endl;
+        cout<<"block of size "<<it.second.size<<" (requested "
+            <<it.second.requested<<") allocated @ "<<it.first<<endl;
+    for(unsigned int i=0;i<32;i++)
+        for(FreeBlock *b=freeLists[i];b!=nullptr;b=b->next)
+            cout<<"free block of size "<<(1<<i)<<" @ "<<b<<endl;
+    Stats s=getStats();
+    cout<<"requested "<<s.requested<<" allocated "<<s.allocated<<" free "
+        <<s.poolSize-s.allocated<<" largest free "<<s.largestFree<<endl;
 }
 #endif //TEST_ALLOC
 
 ProcessPool::ProcessPool(unsigned int *poolBase, unsigned int poolSize)
     : poolBase(poolBase), poolSize(poolSize)
 {
-    int numBytes=poolSize/blockSize/8;
-    bitmap=new unsigned int[numBytes/sizeof(unsigned int)];
-    memset(bitmap,0,numBytes);
+    //Split the pool in the largest blocks aligned to their size. No merging
+    //is attempted, as the rest of the pool is not yet initialized
+    unsigned int addr=reinterpret_cast<unsigned int>(poolBase);
+    unsigned int end=addr+poolSize;
+    while(addr<end)
+    {
+        unsigned int bits=min<unsigned int>(std::countr_zero(addr),31);
+        while((1u<<bits)>end-addr) bits--;
+        addFree(addr,bits);
+        addr+=1<<bits;
+    }
+}
+
+void ProcessPool::addFree(unsigned int addr, unsigned int bits)
+{
+    auto block=reinterpret_cast<FreeBlock*>(addr);
+    block->prev=nullptr;
+    block->next=freeLists[bits];
+    block->bits=bits;
+    if(block->next) block->next->prev=block;
+    freeLists[bits]=block;
+}
+
+void ProcessPool::removeFree(FreeBlock *block)
+{
+    if(block->prev) block->prev->next=block->next;
+    else freeLists[block->bits]=block->next;
+    if(block->next) block->next->prev=block->prev;
+}
+
+bool ProcessPool::isFree(unsigned int addr, unsigned int bits)
+{
+    const unsigned int size=1<<bits;
+    const unsigned int base=reinterpret_cast<unsigned int>(poolBase);
+    if(addr<base || addr-base>poolSize || size>poolSize-(addr-base)) return false;
+    //The header is only meaningful if the block contains no allocated memory,
+    //otherwise it may be process data. If it doesn't, it is entirely free and
+    //since blocks are aligned to their size, a free block starts at addr
+    //Blocks in the part of the range being freed that freeRange() has not
+    //yet freed contain process data, not a header
+    if(addr<pendingEnd && addr+size>pendingStart) return false;
+    auto it=allocatedBlocks.lower_bound(reinterpret_cast<unsigned int*>(addr));
+    if(it!=allocatedBlocks.end()
+        && reinterpret_cast<unsigned int>(it->first)<addr+size) return false;
+    if(it!=allocatedBlocks.begin())
+    {
+        --it;
+        if(reinterpret_cast<unsigned int>(it->first)+it->second.size>addr)
+            return false;
+    }
+    return reinterpret_cast<FreeBlock*>(addr)->bits==bits;
+}
+
+void ProcessPool::freeBlock(unsigned int addr, unsigned int bits)
+{
+    while(bits<31)
+    {
+        unsigned int buddy=addr ^ (1<<bits);
+        if(isFree(buddy,bits)==false) break;
+        removeFree(reinterpret_cast<FreeBlock*>(buddy));
+        addr=min(addr,buddy);
+        bits++;
+    }
+    addFree(addr,bits);
 }
 
-ProcessPool::~ProcessPool()
+void ProcessPool::freeRange(unsigned int start, unsigned int end)
 {
-    delete[] bitmap;
+    //Blocks are found from left to right taking the largest possible one, so
+    //their size first increases and their buddy is on the left, then decreases
+    //and their buddy is on the right. Blocks are freed from both ends towards
+    //the middle, so the part not yet freed is always [pendingStart,pendingEnd)
+    //and isFree() rejects it. Merge cascades would otherwise reach it, as
+    //merged blocks can have a buddy in the part not yet freed
+    unsigned int addrs[64];
+    unsigned char bits[64];
+    int n=0;
+    for(unsigned int addr=start;addr<end;n++)
+    {
+        unsigned int b=min<unsigned int>(std::countr_zero(addr),31);
+        while((1u<<b)>end-addr) b--;
+        addrs[n]=addr;
+        bits[n]=b;
+        addr+=1<<b;
+    }
+    int i=0;
+    pendingEnd=end;
+    for(;i<n && (addrs[i] & (1<<bits[i]));i++)
+    {
+        pendingStart=addrs[i]+(1<<bits[i]);
+        freeBlock(addrs[i],bits[i]);
+    }
+    for(int j=n-1;j>=i;j--)
+    {
+        pendingStart=addrs[i];
+        pendingEnd=addrs[j];
+        freeBlock(addrs[j],bits[j]);
+    }
+    pendingStart=pendingEnd=0;
 }
 
 } //namespace miosix
 
 #ifdef TEST_ALLOC
 //g++ -m32 -std=c++23 -o pp -DTEST_ALLOC -DWITH_PROCESSES process_pool.cpp && ./pp
+//Add -DTEST_EXACT_SIZE to test the ARMv8-M allocation policy
+
+#ifdef TEST_EXACT_SIZE
+/**
+ * Free a non power of two block whose tail merges with a free buddy, while
+ * the block still contains data that looks like a free block header
+ */
+static void testMergeWithUnfreedBuddy(miosix::ProcessPool& pool)
+{
+    using namespace miosix;
+    ProcessPool::Stats before=pool.getStats();
+    unsigned int *ptr; unsigned int size;
+    tie(ptr,size)=pool.allocate(33*1024);
+    //Fake header at the start of the block, as a process could write it.
+    //Both its size and its list pointers are 15, which is an invalid address
+    for(int i=0;i<8;i++) ptr[i]=15;
+    pool.deallocate(ptr);
+    ProcessPool::Stats after=pool.getStats();
+    if(after.allocated!=0 || after.freeBlocks!=before.freeBlocks
+        || after.largestFree!=before.largestFree)
+        throw runtime_error("testMergeWithUnfreedBuddy failed");
+    cout<<"testMergeWithUnfreedBuddy passed"<<endl;
+}
+#endif //TEST_EXACT_SIZE
 
 int main()
 {
     using namespace miosix;
     ProcessPool& pool=ProcessPool::instance();
+    #ifdef TEST_EXACT_SIZE
+    testMergeWithUnfreedBuddy(pool);
+    #endif //TEST_EXACT_SIZE
     for(;;)
     {
         cout<<"a<size(exponent)>|d<addr>"<<endl;
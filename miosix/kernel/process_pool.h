@@ -57,12 +57,12 @@ public:
      * unsigned int*) of the requested memory
      * \return a pair with the pointer to the allocated memory and the actual
      * allocated size, which could be greater or equal than the requested size.
-     * NOTE in the current implementation allocations are at least 1KB and
-     * rounded to the next power of 2. Additionally, the returned pointer is
-     * size-aligned, so that for example if a 16KByte block is requested, the
-     * returned pointer is aligned on a 16KB boundary.
-     * This is required by the MPU of certain ARM CPUs, and also structurally
-     * prevents allocator fragmentation.
+     * NOTE on CPUs whose MPU requires power of 2 regions (ARMv6-M, ARMv7-M)
+     * allocations are at least 1KB and rounded to the next power of 2.
+     * Additionally, the returned pointer is size-aligned, so that for example
+     * if a 16KByte block is requested, the returned pointer is aligned on a
+     * 16KB boundary. On ARMv8-M allocations are only rounded to a multiple of
+     * 32 bytes, and the returned pointer is 32 byte aligned.
      * \throws bad_alloc if out of memory
      */
     std::tuple<unsigned int *, unsigned int> allocate(unsigned int size);
@@ -73,6 +73,28 @@ public:
      * \throws runtime_error if the pointer is invalid
      */
     void deallocate(unsigned int *ptr);
+
+    /**
+     * Memory usage statistics of the process pool
+     */
+    struct Stats
+    {
+        unsigned int poolSize;        ///< Size of the process pool
+        unsigned int requested;       ///< Sum of the requested sizes
+        unsigned int allocated;       ///< Allocated bytes, including rounding
+        unsigned int allocatedBlocks; ///< Number of allocated blocks
+        unsigned int freeBlocks;      ///< Number of free blocks
+        unsigned int largestFree;     ///< Size of the largest free block
+    };
+
+    /**
+     * Report the pool usage and fragmentation. The difference between
+     * allocated and requested is the memory lost to rounding, while free
+     * memory that is not in the largest free block can't be used by a single
+     * allocation of that size
+     * \return the pool statistics
+     */
+    Stats getStats();
     
     #ifdef TEST_ALLOC
     /**
@@ -93,43 +115,69 @@ private:
     ProcessPool(unsigned int *poolBase, unsigned int poolSize);
     
     /**
-     * Destructor
+     * Header stored at the start of each free block. Free blocks are not
+     * accessible by processes, so the header can't be tampered with
      */
-    ~ProcessPool();
-    
+    struct FreeBlock
+    {
+        FreeBlock *prev;   ///< Previous free block of the same size
+        FreeBlock *next;   ///< Next free block of the same size
+        unsigned int bits; ///< The block size is 1<<bits
+    };
+
     /**
-     * \param bit bit to test, from 0 to poolSize/blockSize
-     * \return true if the bit is set
+     * Size of an allocated block
      */
-    bool testBit(unsigned int bit)
+    struct AllocatedBlock
     {
-        return (bitmap[bit/(sizeof(unsigned int)*8)] &
-            1<<(bit % (sizeof(unsigned int)*8))) ? true : false;
-    }
-    
+        unsigned int size;      ///< Allocated size
+        unsigned int requested; ///< Size passed to allocate()
+    };
+
     /**
-     * \param bit bit to set, from 0 to poolSize/blockSize
+     * Add a block to the free lists, without merging it with its buddy
+     * \param addr block address, aligned to its size
+     * \param bits the block size is 1<<bits
      */
-    void setBit(unsigned int bit)
-    {
-        bitmap[(bit/(sizeof(unsigned int)*8))] |= 
-            1<<(bit % (sizeof(unsigned int)*8));
-    }
-    
+    void addFree(unsigned int addr, unsigned int bits);
+
     /**
-     * \param bit bit to clear, from 0 to poolSize/blockSize
+     * Remove a block from the free lists
+     * \param block block to remove
      */
-    void clearBit(unsigned int bit)
-    {
-        bitmap[bit/(sizeof(unsigned int)*8)] &= 
-            ~(1<<(bit % (sizeof(unsigned int)*8)));
-    }
-    
-    unsigned int *bitmap;   ///< Pointer to the status of the allocator
+    void removeFree(FreeBlock *block);
+
+    /**
+     * \param addr block address, aligned to its size
+     * \param bits the block size is 1<<bits
+     * \return true if the block is entirely within the pool, and is a free
+     * block not split into smaller blocks
+     */
+    bool isFree(unsigned int addr, unsigned int bits);
+
+    /**
+     * Free a block, merging it with its buddy as long as possible
+     * \param addr block address, aligned to its size
+     * \param bits the block size is 1<<bits
+     */
+    void freeBlock(unsigned int addr, unsigned int bits);
+
+    /**
+     * Free a memory range, splitting it in blocks whose size is a power of 2
+     * and that are aligned to their size
+     * \param start start of the range, multiple of the minimum block size
+     * \param end end of the range, multiple of the minimum block size
+     */
+    void freeRange(unsigned int start, unsigned int end);
+
     unsigned int *poolBase; ///< Base address of the entire pool
     unsigned int poolSize;  ///< Size of the pool, in bytes
+    ///Free lists, freeLists[i] lists free blocks whose size is 1<<i
+    FreeBlock *freeLists[32]={nullptr};
     ///Lists all allocated blocks, allows to retrieve their sizes
-    std::map<unsigned int*,unsigned int> allocatedBlocks;
+    std::map<unsigned int*,AllocatedBlock> allocatedBlocks;
+    ///Part of the range being freed by freeRange() that is not yet free
+    unsigned int pendingStart=0, pendingEnd=0;
     #ifndef TEST_ALLOC
     KernelMutex mutex;      ///< Mutex to guard concurrent access
     #endif //TEST_ALLOC
@@ -157,6 +157,15 @@ public:
      */
     void get(T& elem);
 
+    /**
+     * Same as get(), but gives up waiting if the calling thread is being
+     * terminated, as Thread::terminate() wakes it up only once.
+     * \param elem an element from the queue. The element is valid only if the
+     * return value is true
+     * \return false if the thread is being terminated and the queue is empty
+     */
+    bool getUnlessTerminated(T& elem);
+
     /**
      * Get an element from the queue. If the queue is empty, then use the dLock
      * parameter to enable interrupts and wait until a place becomes available.
@@ -249,6 +258,19 @@ void QueueBase<T,BufferT>::get(T& elem)
     }
 }
 
+template <typename T, typename BufferT>
+bool QueueBase<T,BufferT>::getUnlessTerminated(T& elem)
+{
+    FastGlobalIrqLock dLock;
+    while(IRQget(elem)==false)
+    {
+        if(Thread::IRQtestTerminate()) return false;
+        waiting=Thread::IRQgetCurrentThread();
+        Thread::IRQglobalIrqUnlockAndWait(dLock);
+    }
+    return true;
+}
+
 template <typename T, typename BufferT>
 void QueueBase<T,BufferT>::IRQgetBlocking(T& elem, FastGlobalIrqLock& dLock)
 {
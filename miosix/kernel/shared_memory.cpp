@@ -0,0 +1,146 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include "shared_memory.h"
+#include "process_pool.h"
+#include <map>
+#include <string>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+static KernelMutex shmMutex; ///< Guards the shared memory namespace
+///Shared memory objects that have not been unlinked yet
+static map<string,intrusive_ref_ptr<SharedMemory>> shmObjects;
+
+//
+// class SharedMemory
+//
+
+int SharedMemory::open(const char *name, int flags,
+                       intrusive_ref_ptr<FileBase>& file)
+{
+    constexpr size_t maxNameLength=255;
+    if(name[0]!='/' || name[1]=='\0') return -EINVAL;
+    if(strchr(name+1,'/')) return -EINVAL;
+    if(strlen(name)>maxNameLength) return -ENAMETOOLONG;
+    int mode=flags & O_ACCMODE;
+    if(mode!=O_RDONLY && mode!=O_RDWR) return -EINVAL;
+    if(flags & O_TRUNC) return -EINVAL;
+    Lock<KernelMutex> l(shmMutex);
+    auto it=shmObjects.find(name);
+    intrusive_ref_ptr<SharedMemory> shm;
+    if(it!=shmObjects.end())
+    {
+        if((flags & (O_CREAT | O_EXCL))==(O_CREAT | O_EXCL)) return -EEXIST;
+        shm=it->second;
+    } else {
+        if((flags & O_CREAT)==0) return -ENOENT;
+        shm=intrusive_ref_ptr<SharedMemory>(new SharedMemory);
+        shmObjects[name]=shm;
+    }
+    file=intrusive_ref_ptr<FileBase>(new SharedMemoryFile(shm,flags));
+    return 0;
+}
+
+int SharedMemory::unlink(const char *name)
+{
+    Lock<KernelMutex> l(shmMutex);
+    if(shmObjects.erase(name)==0) return -ENOENT;
+    return 0;
+}
+
+int SharedMemory::truncate(off_t newSize)
+{
+    if(newSize<=0) return -EINVAL;
+    //Far larger than any process pool, also prevents overflows when the
+    //allocator rounds the size to a power of two
+    if(newSize>0x40000000) return -ENOMEM;
+    Lock<KernelMutex> l(shmMutex);
+    if(data) return newSize==size ? 0 : -EBUSY;
+    unsigned int allocatedSize;
+    try {
+        tie(data,allocatedSize)=ProcessPool::instance().allocate(newSize);
+    } catch(bad_alloc&) {
+        return -ENOMEM;
+    }
+    //Don't leak the content of previously freed process memory
+    memset(data,0,allocatedSize);
+    size=newSize;
+    return 0;
+}
+
+SharedMemory::~SharedMemory()
+{
+    if(data) ProcessPool::instance().deallocate(data);
+}
+
+//
+// class SharedMemoryFile
+//
+
+SharedMemoryFile::SharedMemoryFile(intrusive_ref_ptr<SharedMemory> shm,
+        int flags) : FileBase(intrusive_ref_ptr<FilesystemBase>(),flags),
+        shm(shm) {}
+
+ssize_t SharedMemoryFile::write(const void *data, size_t len) { return -EINVAL; }
+
+ssize_t SharedMemoryFile::read(void *data, size_t len) { return -EINVAL; }
+
+off_t SharedMemoryFile::lseek(off_t pos, int whence) { return -EINVAL; }
+
+int SharedMemoryFile::ftruncate(off_t size)
+{
+    if((flags & O_ACCMODE)!=O_RDWR) return -EINVAL;
+    return shm->truncate(size);
+}
+
+int SharedMemoryFile::fstat(struct stat *pstat) const
+{
+    memset(pstat,0,sizeof(struct stat));
+    pstat->st_mode=S_IFREG | 0600;
+    pstat->st_nlink=1;
+    pstat->st_size=shm->getSize();
+    return 0;
+}
+
+MemoryMappedFile SharedMemoryFile::getFileFromMemory()
+{
+    return MemoryMappedFile(shm->getData(),shm->getSize(),
+                            (flags & O_ACCMODE)==O_RDWR,true);
+}
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
@@ -0,0 +1,163 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include "sync.h"
+#include "miosix_settings.h"
+#include "filesystem/file.h"
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+/**
+ * A shared memory object, a block of memory allocated from the process pool
+ * that processes can map in their address space with mmap(MAP_SHARED) to
+ * exchange data without copies through the kernel.
+ *
+ * Objects are identified by a name, are created with shm_open(O_CREAT),
+ * sized once with ftruncate() and removed from the namespace with
+ * shm_unlink(). The memory is freed when the object has been unlinked and the
+ * last file descriptor and mapping referring to it have been closed.
+ *
+ * As the process pool allocates blocks aligned to their size, the memory
+ * can be mapped with a single MPU region without giving access to neighbouring
+ * memory.
+ */
+class SharedMemory : public IntrusiveRefCounted<SharedMemory>
+{
+public:
+    /**
+     * Open a shared memory object
+     * \param name object name, must start with '/' and contain no other '/'
+     * \param flags O_RDONLY or O_RDWR, optionally ORed with O_CREAT, O_EXCL
+     * and O_CLOEXEC. O_TRUNC is not supported as the object may be mapped
+     * \param file a file referring to the object is returned here
+     * \return 0 on success, or a negative number on failure
+     */
+    static int open(const char *name, int flags,
+                    intrusive_ref_ptr<FileBase>& file);
+
+    /**
+     * Remove a shared memory object name, the object is destroyed once it is
+     * no longer open nor mapped
+     * \param name object name
+     * \return 0 on success, or a negative number on failure
+     */
+    static int unlink(const char *name);
+
+    /**
+     * Set the object size, allocating its memory. The size can only be set
+     * once, as the memory may already be mapped by processes
+     * \param newSize object size in bytes
+     * \return 0 on success, or a negative number on failure
+     */
+    int truncate(off_t newSize);
+
+    /**
+     * \return the object memory, or nullptr if the size has not been set yet
+     */
+    void *getData() const { return data; }
+
+    /**
+     * \return the object size in bytes
+     */
+    unsigned int getSize() const { return size; }
+
+    /**
+     * Destructor, frees the memory
+     */
+    ~SharedMemory();
+
+private:
+    SharedMemory() {}
+    SharedMemory(const SharedMemory&)=delete;
+    SharedMemory& operator=(const SharedMemory&)=delete;
+
+    unsigned int *data=nullptr; ///< Memory allocated from the process pool
+    unsigned int size=0;        ///< Size requested with truncate()
+};
+
+/**
+ * A file descriptor referring to a shared memory object
+ */
+class SharedMemoryFile : public FileBase
+{
+public:
+    /**
+     * Constructor
+     * \param shm shared memory object
+     * \param flags file open flags
+     */
+    SharedMemoryFile(intrusive_ref_ptr<SharedMemory> shm, int flags);
+
+    /**
+     * Shared memory can only be accessed through mmap()
+     * \return -EINVAL
+     */
+    virtual ssize_t write(const void *data, size_t len);
+
+    /**
+     * Shared memory can only be accessed through mmap()
+     * \return -EINVAL
+     */
+    virtual ssize_t read(void *data, size_t len);
+
+    /**
+     * Shared memory can only be accessed through mmap()
+     * \return -EINVAL
+     */
+    virtual off_t lseek(off_t pos, int whence);
+
+    /**
+     * Set the shared memory object size, see SharedMemory::truncate()
+     * \param size new object size
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int ftruncate(off_t size);
+
+    /**
+     * Return file information.
+     * \param pstat pointer to stat struct
+     * \return 0 on success, or a negative number on failure
+     */
+    virtual int fstat(struct stat *pstat) const;
+
+    /**
+     * \return the object memory, writable if the file was opened with O_RDWR
+     */
+    virtual MemoryMappedFile getFileFromMemory();
+
+private:
+    intrusive_ref_ptr<SharedMemory> shm;
+};
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
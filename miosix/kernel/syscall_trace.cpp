@@ -0,0 +1,147 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include "syscall_trace.h"
+#include "sync.h"
+#include "thread.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+
+using namespace std;
+
+#ifdef WITH_SYSCALL_TRACE
+
+namespace miosix {
+
+static KernelMutex traceMutex;  ///< Guards the ring buffer
+static ConditionVariable traceCv; ///< Signaled when records are added
+static SyscallTraceRecord traceBuffer[SYSCALL_TRACE_BUFFER_SIZE];
+static unsigned int traceGet=0;   ///< Index of the oldest record
+static unsigned int traceSize=0;  ///< Number of records in the buffer
+static unsigned int traceSeq=0;   ///< Sequence number of the next record
+
+//
+// class SyscallHistogram
+//
+
+int SyscallHistogram::bucket(unsigned int duration)
+{
+    unsigned int us=duration/1000;
+    if(us==0) return 0;
+    return min<int>(32-__builtin_clz(us),SYSCALL_HISTOGRAM_BUCKETS-1);
+}
+
+void SyscallHistogram::print() const
+{
+    iprintf("id ");
+    for(int i=0;i<SYSCALL_HISTOGRAM_BUCKETS-1;i++) iprintf(" <%dus",1<<i);
+    iprintf(" more\n");
+    for(unsigned int i=0;i<NUM_SYSCALLS;i++)
+    {
+        bool used=false;
+        for(int j=0;j<SYSCALL_HISTOGRAM_BUCKETS;j++)
+            if(counts[i][j]) used=true;
+        if(used==false) continue;
+        iprintf("%2u:",i);
+        for(int j=0;j<SYSCALL_HISTOGRAM_BUCKETS;j++) iprintf(" %u",counts[i][j]);
+        iprintf("\n");
+    }
+}
+
+//
+// class SyscallTrace
+//
+
+void SyscallTrace::record(SyscallTraceRecord& record)
+{
+    Lock<KernelMutex> l(traceMutex);
+    record.seq=traceSeq++;
+    unsigned int put=(traceGet+traceSize)%SYSCALL_TRACE_BUFFER_SIZE;
+    traceBuffer[put]=record;
+    //When full, overwrite the oldest record
+    if(traceSize<SYSCALL_TRACE_BUFFER_SIZE) traceSize++;
+    else traceGet=(traceGet+1)%SYSCALL_TRACE_BUFFER_SIZE;
+    traceCv.broadcast();
+}
+
+int SyscallTrace::read(SyscallTraceRecord *records, int count)
+{
+    if(count<=0) return 0;
+    Lock<KernelMutex> l(traceMutex);
+    while(traceSize==0)
+    {
+        if(Thread::testTerminate()) return -EINTR;
+        traceCv.wait(l);
+    }
+    int result=min<unsigned int>(count,traceSize);
+    for(int i=0;i<result;i++)
+    {
+        records[i]=traceBuffer[traceGet];
+        traceGet=(traceGet+1)%SYSCALL_TRACE_BUFFER_SIZE;
+    }
+    traceSize-=result;
+    return result;
+}
+
+//
+// class SyscallTraceDevice
+//
+
+ssize_t SyscallTraceDevice::readBlock(void *buffer, size_t size, off_t where)
+{
+    int count=size/sizeof(SyscallTraceRecord);
+    if(count==0) return -EINVAL;
+    //Copy through a kernel buffer, as the caller buffer may not be aligned
+    SyscallTraceRecord records[4];
+    count=SyscallTrace::read(records,min<int>(count,4));
+    if(count<0) return count;
+    memcpy(buffer,records,count*sizeof(SyscallTraceRecord));
+    return count*sizeof(SyscallTraceRecord);
+}
+
+ssize_t SyscallTraceDevice::writeBlock(const void *buffer, size_t size,
+                                       off_t where)
+{
+    char command[12];
+    if(size<2 || size>=sizeof(command)) return -EINVAL;
+    memcpy(command,buffer,size);
+    command[size]='\0';
+    if(command[0]!='+' && command[0]!='-') return -EINVAL;
+    char *end;
+    long pid=strtol(command+1,&end,10);
+    if(end==command+1 || (*end!='\0' && *end!='\n')) return -EINVAL;
+    int result=Process::setTracing(pid,command[0]=='+');
+    return result<0 ? result : size;
+}
+
+} //namespace miosix
+
+#endif //WITH_SYSCALL_TRACE
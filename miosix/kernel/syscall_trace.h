@@ -0,0 +1,132 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include "miosix_settings.h"
+#include "process.h"
+#include "filesystem/devfs/devfs.h"
+
+#ifdef WITH_SYSCALL_TRACE
+
+namespace miosix {
+
+/**
+ * A syscall made by a traced process. Records are returned as they are by
+ * reading /dev/strace, so the layout is part of the interface with
+ * tools/strace_print, which decodes them on the host
+ */
+struct SyscallTraceRecord
+{
+    long long timestamp;   ///< Time when the syscall was made, in ns
+    unsigned int seq;      ///< Sequence number, gaps mean lost records
+    int pid;               ///< Pid of the process
+    unsigned short tid;    ///< Thread id within the process
+    unsigned short id;     ///< Syscall id
+    unsigned int args[4];  ///< Syscall parameters, not all may be meaningful
+    int result;            ///< Value returned in the first register
+    unsigned int duration; ///< Time spent in the kernel in ns, saturated
+};
+
+static_assert(sizeof(SyscallTraceRecord)==48,"SyscallTraceRecord layout");
+
+/**
+ * Number of buckets of a syscall latency histogram. Bucket 0 counts syscalls
+ * that took less than 1us, bucket i syscalls that took from 2^(i-1)us to
+ * 2^i us, and the last bucket also counts all the slower ones
+ */
+const int SYSCALL_HISTOGRAM_BUCKETS=12;
+
+/**
+ * Per syscall latency histograms of a traced process
+ */
+struct SyscallHistogram
+{
+    /**
+     * \param duration syscall duration in ns
+     * \return the bucket where the syscall is counted
+     */
+    static int bucket(unsigned int duration);
+
+    /**
+     * Print the histograms of the syscalls that were made at least once
+     */
+    void print() const;
+
+    ///Number of syscalls, indexed by syscall id and bucket
+    unsigned int counts[NUM_SYSCALLS][SYSCALL_HISTOGRAM_BUCKETS]={};
+};
+
+/**
+ * Ring buffer of the syscalls made by all traced processes. When it is full
+ * the oldest records are overwritten, readers can detect it from the gaps in
+ * the sequence numbers
+ */
+class SyscallTrace
+{
+public:
+    /**
+     * Add a record to the ring buffer, waking up readers
+     * \param record record to add, its seq field is filled by this function
+     */
+    static void record(SyscallTraceRecord& record);
+
+    /**
+     * Remove records from the ring buffer, blocking until at least one is
+     * available
+     * \param records records are returned here
+     * \param count maximum number of records to return
+     * \return the number of records returned, or -EINTR if the calling thread
+     * is being terminated
+     */
+    static int read(SyscallTraceRecord *records, int count);
+
+private:
+    SyscallTrace()=delete;
+};
+
+/**
+ * The /dev/strace device. Reading returns whole SyscallTraceRecord, blocking
+ * until at least one is available. Tracing is controlled by writing a pid as
+ * text, with a '+' or '-' prefix to start or stop tracing the process, such
+ * as "+3" or "-3". A write is used instead of ioctl() as processes can't
+ * perform ioctl() calls yet
+ */
+class SyscallTraceDevice : public Device
+{
+public:
+    SyscallTraceDevice() : Device(Device::STREAM) {}
+
+    ssize_t readBlock(void *buffer, size_t size, off_t where) override;
+
+    ssize_t writeBlock(const void *buffer, size_t size, off_t where) override;
+};
+
+} //namespace miosix
+
+#endif //WITH_SYSCALL_TRACE
@@ -604,6 +604,12 @@ void Thread::terminate()
     if(this->flags.isDeleting()) return; //Prevent sleep interruption abuse
     this->flags.IRQsetDeleting();
     this->flags.IRQclearSleepAndWait(this); //Interruptibility
+    #ifdef WITH_PROCESSES
+    //A process thread running in userspace may never perform a syscall, so
+    //the next time it is scheduled make it resume in kernelspace, where it
+    //will return from switchToUserspace() and check testTerminate()
+    this->flags.IRQsetUserspace(false);
+    #endif //WITH_PROCESSES
 }
 
 bool Thread::testTerminate()
@@ -611,6 +617,11 @@ bool Thread::testTerminate()
     return getCurrentThread()->flags.isDeleting();
 }
 
+bool Thread::IRQtestTerminate()
+{
+    return IRQgetCurrentThread()->flags.isDeleting();
+}
+
 void Thread::detach()
 {
     FastGlobalIrqLock lock;
@@ -758,19 +769,79 @@ void Thread::IRQhandleSvc()
 
     //Note that it is required to use ctxsave and not cur->ctxsave because
     //at this time we do not know if the active context is user or kernel
-    switch(static_cast<Syscall>(peekSyscallId(
-        const_cast<unsigned int*>(::ctxsave[coreId]))))
+    unsigned int id=peekSyscallId(const_cast<unsigned int*>(::ctxsave[coreId]));
+    #ifdef WITH_PROCFS
+    //Count here also syscalls served without leaving userspace. Going back to
+    //userspace after a syscall is not a syscall made by the process
+    if(id<NUM_SYSCALLS && static_cast<Syscall>(id)!=Syscall::USERSPACE)
+        proc->syscallCounts[id]++;
+    #endif //WITH_PROCFS
+    switch(static_cast<Syscall>(id))
     {
         case Syscall::YIELD:
             //Yield syscall is handled here in the IRQ by calling the scheduler
             Scheduler::IRQrunScheduler();
             return;
         case Syscall::USERSPACE:
+            //Terminated threads must not go back to userspace, see terminate()
+            if(cur->flags.isDeleting()) return;
             //Userspace syscall is handled here in the IRQ by switching to userspace
             cur->flags.IRQsetUserspace(true);
             ::ctxsave[coreId]=cur->userCtxsave;
             proc->mpu.IRQenable();
             break;
+        case Syscall::GETTIME64:
+        {
+            //Hot syscalls that can't block nor fail are handled here in the
+            //IRQ without leaving userspace, saving two context switches
+            SyscallParameters sp(cur->userCtxsave);
+            long long t=IRQgetTime();
+            sp.setParameter(0,t & 0xffffffff);
+            sp.setParameter(1,t>>32);
+            return;
+        }
+        case Syscall::GETPID:
+        {
+            SyscallParameters sp(cur->userCtxsave);
+            sp.setParameter(0,proc->getPid());
+            return;
+        }
+        case Syscall::THREAD_SELF:
+        {
+            SyscallParameters sp(cur->userCtxsave);
+            sp.setParameter(0,cur->userTid);
+            return;
+        }
+        case Syscall::ATOMIC_CAS:
+        {
+            //Architectures lacking ldrex/strex such as ARMv6-M can't implement
+            //compare and swap in userspace, but here the global lock is held
+            SyscallParameters sp(cur->userCtxsave);
+            auto p=reinterpret_cast<int*>(sp.getParameter(0));
+            if(proc->mpu.withinForWriting(p,sizeof(int))==false
+                || (reinterpret_cast<unsigned int>(p) & 3))
+            {
+                IRQreportFault(FaultData(fault::MP,
+                    reinterpret_cast<unsigned int>(p)));
+                return;
+            }
+            int result=*p;
+            if(result==static_cast<int>(sp.getParameter(1)))
+                *p=sp.getParameter(2);
+            sp.setParameter(0,result);
+            return;
+        }
+        case Syscall::READ:
+        case Syscall::WRITE:
+        case Syscall::PREAD:
+        case Syscall::PWRITE:
+        case Syscall::NANOSLEEP64:
+            //Hot syscalls that never touch the process code are handled by
+            //switching to kernelspace but leaving the MPU regions in place
+            cur->flags.IRQsetUserspace(false);
+            ::ctxsave[coreId]=cur->ctxsave;
+            proc->mpu.IRQdisableForSyscall();
+            break;
         default:
             //All other syscalls are handled by switching to kernelspace
             cur->flags.IRQsetUserspace(false);
@@ -782,8 +853,12 @@ void Thread::IRQhandleSvc()
 
 bool Thread::IRQreportFault(const FaultData& fault)
 {
-    Thread *cur=const_cast<Thread*>(runningThreads[getCurrentCoreId()]);
-    if(cur->flags.isInUserspace()==false || cur->proc==kernelProcess) return false;
+    int coreId=getCurrentCoreId();
+    Thread *cur=const_cast<Thread*>(runningThreads[coreId]);
+    //Test the active context and not isInUserspace(), as terminate() clears
+    //the flag of threads that may still be running in userspace
+    if(cur->proc==kernelProcess || ::ctxsave[coreId]!=cur->userCtxsave)
+        return false;
     //We know it's not the kernel, so the cast is safe
     auto *proc=static_cast<Process*>(cur->proc);
     //Record the fault for later reporting.
@@ -791,7 +866,7 @@ bool Thread::IRQreportFault(const FaultData& fault)
     proc->fault.IRQtryAddProgramCounter(cur->userCtxsave,proc->mpu);
     //Switch to kernel mode
     cur->flags.IRQsetUserspace(false);
-    ::ctxsave[getCurrentCoreId()]=cur->ctxsave;
+    ::ctxsave[coreId]=cur->ctxsave;
     MPUConfiguration::IRQdisable();
     return true;
 }
@@ -839,22 +914,22 @@ Thread *Thread::createUserspace(void *(*startfunc)(void *), Process *proc)
     return thread;
 }
 
-void Thread::setupUserspaceContext(unsigned int entry, int argc, void *argvSp,
-    void *envp, unsigned int *gotBase, unsigned int stackSize)
+void Thread::setupUserspaceContext(Thread *thread, unsigned int entry,
+    int argc, void *argvSp, void *envp, unsigned int *gotBase,
+    unsigned int stackSize)
 {
     //Fill watermark and stack
     char *base=reinterpret_cast<char*>(argvSp)-stackSize-WATERMARK_LEN;
     memset(base, WATERMARK_FILL, WATERMARK_LEN);
     memset(base+WATERMARK_LEN, STACK_FILL, stackSize);
-    Thread *cur=getCurrentThread();
-    cur->userWatermark=reinterpret_cast<unsigned int*>(base);
+    thread->userWatermark=reinterpret_cast<unsigned int*>(base);
     //Initialize registers
     //NOTE: for the main thread in a process userWatermark is also the end of
-    //the heap, used by _sbrk_r. When we'll implement threads in processes that
-    //pointer will just point to the watermark end of the thread, but userspace
-    //threads can just ignore that value so we'll pass it unconditionally
-    initUserThreadCtxsave(cur->userCtxsave,entry,argc,argvSp,envp,
-                          gotBase,cur->userWatermark);
+    //the heap, used by _sbrk_r. For the other threads of a process it just
+    //points to the watermark end of their stack, but userspace threads ignore
+    //that value so we pass it unconditionally
+    initUserThreadCtxsave(thread->userCtxsave,entry,argc,argvSp,envp,
+                          gotBase,thread->userWatermark);
 }
 
 #endif //WITH_PROCESSES
@@ -876,6 +951,7 @@ Thread::Thread(unsigned int *watermark, unsigned int stacksize,
     #ifdef WITH_PROCESSES
     proc=kernelProcess;
     userCtxsave=nullptr;
+    userTid=0;
     #endif //WITH_PROCESSES
     #ifdef WITH_PTHREAD_KEYS
     memset(pthreadKeyValues,0,sizeof(pthreadKeyValues));
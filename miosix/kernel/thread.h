@@ -581,6 +581,13 @@ public:
      */
     static bool testTerminate();
 
+    /**
+     * Same as testTerminate(), but must be called with interrupts disabled
+     * \return true if somebody outside the thread called terminate() on this
+     * thread.
+     */
+    static bool IRQtestTerminate();
+
     /**
      * Detach the thread if it was joinable, otherwise do nothing.<br>
      * If called on a deleted joinable thread on which join was not yet called,
@@ -895,8 +902,11 @@ private:
     static Thread *createUserspace(void *(*startfunc)(void *), Process *proc);
     
     /**
-     * Setup the userspace context of the thread, so that it can be later
-     * switched to userspace. Must be called only once for each thread instance
+     * Setup the userspace context of a thread, so that it can be later
+     * switched to userspace. Must be called either by the thread itself or
+     * before the thread is started, and only once for each program the
+     * thread runs
+     * \param thread thread whose userspace context is set up
      * \param entry userspace entry point
      * \param argc number of arguments
      * \param argvSp pointer to arguments array. Since the args block is stored
@@ -908,8 +918,9 @@ private:
      * of the RAM image of the process
      * \param stackSize size of the userspace stack, used for bound checking
      */
-    static void setupUserspaceContext(unsigned int entry, int argc, void *argvSp,
-        void *envp, unsigned int *gotBase, unsigned int stackSize);
+    static void setupUserspaceContext(Thread *thread, unsigned int entry,
+        int argc, void *argvSp, void *envp, unsigned int *gotBase,
+        unsigned int stackSize);
     
     #endif //WITH_PROCESSES
 
@@ -1059,6 +1070,8 @@ private:
     ///pointer is null
     unsigned int *userCtxsave;
     unsigned int *userWatermark;
+    ///Thread id within its process, returned by pthread_self() in userspace
+    int userTid;
     #endif //WITH_PROCESSES
     #ifdef WITH_CPU_TIME_COUNTER
     CPUTimeCounterPrivateThreadData timeCounterData;
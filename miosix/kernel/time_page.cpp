@@ -0,0 +1,94 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include "time_page.h"
+#include "lock.h"
+#include "interfaces_private/os_timer.h"
+#include "interfaces_private/userspace.h"
+#include <algorithm>
+#include <errno.h>
+
+using namespace std;
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+//
+// class TimePage
+//
+
+static IntrusiveList<TimePage> timePages; ///< Registered time pages
+static bool timerMapped=false; ///< Processes can read the os timer registers
+
+int TimePage::setup(time_page *p)
+{
+    //Pages are updated without synchronizing with the other cores
+    if(CPU_NUM_CORES>1) return -ENOSYS;
+    FastGlobalIrqLock dLock;
+    if(IRQosTimerInitTimePage(*p)==false) return -ENOSYS;
+    if(timerMapped==false)
+    {
+        //The same MPU region is used by all processes, configure it only once
+        auto counter=reinterpret_cast<size_t>(p->counter);
+        auto status=reinterpret_cast<size_t>(p->status);
+        size_t base=min(counter,status);
+        size_t size=max(counter,status)+sizeof(unsigned int)-base;
+        if(MPUConfiguration::IRQaddPeripheralRegion(
+            reinterpret_cast<const unsigned int*>(base),size)==false)
+            return -ENOSYS;
+        timerMapped=true;
+    }
+    p->seq=0;
+    if(page==nullptr) timePages.push_back(this);
+    page=p;
+    return 0;
+}
+
+void TimePage::reset()
+{
+    if(page==nullptr) return;
+    FastGlobalIrqLock dLock;
+    timePages.removeFast(this);
+    page=nullptr;
+}
+
+void TimePage::IRQupdate(long long upperTick)
+{
+    for(auto it=timePages.begin();it!=timePages.end();++it)
+    {
+        time_page *p=(*it)->page;
+        p->seq=p->seq+1;
+        p->upper_tick=upperTick;
+        p->seq=p->seq+1;
+    }
+}
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
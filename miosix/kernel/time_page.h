@@ -0,0 +1,106 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#pragma once
+
+#include "intrusive.h"
+#include "miosix_settings.h"
+
+#if __has_include(<sys/time_page.h>)
+#include <sys/time_page.h>
+#else //__has_include(<sys/time_page.h>)
+
+//Compilers predating the time page lack sys/time_page.h, keep in sync with
+//libc/sys/miosix/sys/time_page.h in the newlib patch
+
+struct time_page
+{
+    volatile unsigned int seq;
+    unsigned int overflow_mask;
+    const volatile unsigned int *counter;
+    const volatile unsigned int *status;
+    unsigned int to_ns_int;
+    unsigned int to_ns_frac;
+    volatile long long upper_tick;
+    long long upper_incr;
+};
+
+#endif //__has_include(<sys/time_page.h>)
+
+#ifdef WITH_PROCESSES
+
+namespace miosix {
+
+/**
+ * Registration of a process time page, a struct time_page in process memory
+ * that the kernel keeps up to date so that the process can compute the time
+ * from the os timer counter without doing a syscall.
+ *
+ * The page contains the os timer counter and status register addresses, that
+ * are made readable by processes through an MPU region, the tick to ns
+ * conversion coefficients and the upper bits of the tick count that the os
+ * timer extends in software. These are the only part that changes at run-time,
+ * and every time they do the os timer calls IRQupdate() that updates all pages.
+ */
+class TimePage : public IntrusiveListItem
+{
+public:
+    TimePage() {}
+
+    /**
+     * Register a time page
+     * \param p pointer to the page, must have been validated to be in the
+     * process memory, which must remain allocated until reset() is called
+     * \return 0 on success, -ENOSYS if the os timer can't be read by processes
+     */
+    int setup(time_page *p);
+
+    /**
+     * Stop updating the time page, if one was registered
+     */
+    void reset();
+
+    /**
+     * Called by the os timer every time the upper bits of the tick count
+     * change. Must be called with interrupts disabled
+     * \param upperTick new value of the upper bits
+     */
+    static void IRQupdate(long long upperTick);
+
+    ~TimePage() { reset(); }
+
+    TimePage(const TimePage&)=delete;
+    TimePage& operator=(const TimePage&)=delete;
+
+private:
+    time_page *page=nullptr; ///< Registered page in process memory, if any
+};
+
+} //namespace miosix
+
+#endif //WITH_PROCESSES
@@ -32,12 +32,14 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <spawn.h>
+#include <mqueue.h>
 #include <sys/time.h>
 #include <sys/times.h>
 #include <sys/stat.h>
 #include <sys/fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/wait.h>
+#include <sys/time_page.h>
 #include <reent.h>
 #include <cxxabi.h>
 #include <new>
@@ -86,6 +88,59 @@ static int globalFlag=0;
  */
 void *__dso_handle asm("__dso_handle")=(void*) &__dso_handle;
 
+namespace __cxxabiv1
+{
+
+struct __cxa_exception; //A forward declaration of this one is enough
+
+/*
+ * This struct was taken from libsupc++/unwind-cxx.h Unfortunately that file
+ * is not deployed in the gcc installation so we can't just #include it.
+ * It is required on a per-thread basis to make C++ exceptions thread safe.
+ */
+struct __cxa_eh_globals
+{
+    __cxa_exception *caughtExceptions;
+    unsigned int uncaughtExceptions;
+    //Should be __ARM_EABI_UNWINDER__ but that's only usable inside gcc
+    #ifdef __ARM_EABI__
+    __cxa_exception* propagatingExceptions;
+    #endif //__ARM_EABI__
+};
+
+} //namespace __cxxabiv1
+
+/**
+ * Stored at the bottom of the memory block allocated by pthread_create, right
+ * below the stack. Holds the per-thread data of the C and C++ libraries
+ */
+struct alignas(8) ThreadStart
+{
+    void *(*start)(void*);         ///< Thread entry point
+    void *arg;                     ///< Thread entry point argument
+    struct _reent reent;           ///< C library reentrancy data
+    __cxxabiv1::__cxa_eh_globals eh; ///< C++ exception handling data
+};
+
+/// Must match MAX_THREADS_PER_PROCESS in the kernel's miosix_settings.h
+static const unsigned int maxThreads=8;
+
+/// Indexed by thread id, each thread fills its own entry when it starts, so
+/// entries of threads that have been joined are never looked up. The main
+/// thread has no entry and uses the global data structures
+static ThreadStart *threadStarts[maxThreads]={nullptr};
+
+/**
+ * \return the ThreadStart of the calling thread, or nullptr for the main
+ * thread
+ */
+static ThreadStart *currentThreadStart()
+{
+    //pthread_self() is one of the syscalls handled directly in the SVC handler
+    unsigned int tid=pthread_self();
+    return tid<maxThreads ? threadStarts[tid] : nullptr;
+}
+
 extern "C" {
 
 /**
@@ -209,6 +264,8 @@ const char *__processStackEnd;
 // used by memoryprofiling
 const char *__maxUsedHeap=nullptr;
 
+int __heap_setup(const char **p); //Implemented in crt0.S
+
 /**
  * \internal
  * _sbrk_r, allocates memory dynamically
@@ -237,7 +294,21 @@ void *_sbrk_r(struct _reent *ptr, ptrdiff_t incr)
         #endif //__NO_EXCEPTIONS
     }
     curHeapEnd+=incr;
-    if(curHeapEnd>__maxUsedHeap) __maxUsedHeap=curHeapEnd;
+    if(curHeapEnd>__maxUsedHeap)
+    {
+        //With WITH_PROCESS_LAZY_HEAP_ZEROING the kernel only zeroes .bss when
+        //spawning a process, while malloc expects memory the heap grows into
+        //for the first time to be zeroed
+        char *zeroStart=const_cast<char*>(__maxUsedHeap);
+        //The kernel reads __maxUsedHeap to report the process memory usage
+        if(zeroStart==nullptr)
+        {
+            __heap_setup(&__maxUsedHeap);
+            zeroStart=&_end;
+        }
+        memset(zeroStart,0,curHeapEnd-zeroStart);
+        __maxUsedHeap=curHeapEnd;
+    }
     return reinterpret_cast<void*>(prevHeapEnd);
 }
 
@@ -266,8 +337,8 @@ void __malloc_unlock()
  */
 struct _reent *__getreent()
 {
-    // For now processes can't have threads, so always return the global one
-    return _GLOBAL_REENT;
+    ThreadStart *ts=currentThreadStart();
+    return ts ? &ts->reent : _GLOBAL_REENT;
 }
 
 
@@ -411,6 +482,83 @@ int _getpid_r(struct _reent* ptr)
     return getpid();
 }
 
+//
+// Time functions. When the os timer can be read by processes the time is
+// computed in userspace from the time page, otherwise it requires a syscall
+//
+
+namespace miosix {
+long long getTimeSyscall() noexcept; //Implemented in crt0.S
+}
+
+static struct time_page timePage;
+static int timePageState=0; ///< 0=not set up yet, 1=usable, -1=unavailable
+
+/**
+ * Same as mul64x32d32() in the kernel, used to convert ticks to ns
+ * \param a 64 bit unsigned number
+ * \param bi integer part of the 32.32 fixed point number
+ * \param bf fractional part of the 32.32 fixed point number
+ * \return a*(bi+bf/2^32), rounded towards zero
+ */
+static inline unsigned long long mul64x32d32(unsigned long long a,
+        unsigned int bi, unsigned int bf)
+{
+    unsigned int aLo=a;
+    unsigned int aHi=a>>32;
+    unsigned long long result=static_cast<unsigned long long>(bi)*aLo;
+    result+=static_cast<unsigned long long>(bf)*aHi;
+    result+=(static_cast<unsigned long long>(bf)*aLo)>>32;
+    result+=static_cast<unsigned long long>(bi*aHi)<<32;
+    return result;
+}
+
+namespace miosix {
+
+long long getTime() noexcept
+{
+    if(timePageState==0)
+    {
+        int savedErrno=errno;
+        timePageState=time_page_setup(&timePage)==0 ? 1 : -1;
+        errno=savedErrno;
+    }
+    if(timePageState<0) return getTimeSyscall();
+    //The kernel can update the page between our reads, in this case seq
+    //changes and we retry. The overflow bit is read like the kernel does, see
+    //the pending bit trick in os_timer.h
+    unsigned int seq,counter;
+    long long upper;
+    do {
+        seq=timePage.seq;
+        counter=*timePage.counter;
+        upper=timePage.upper_tick;
+        if((*timePage.status & timePage.overflow_mask)
+            && *timePage.counter>=counter) upper+=timePage.upper_incr;
+    } while((seq & 1) || seq!=timePage.seq);
+    return mul64x32d32(upper | counter,timePage.to_ns_int,timePage.to_ns_frac);
+}
+
+} //namespace miosix
+
+int clock_gettime(clockid_t clock_id, struct timespec *tp)
+{
+    //Like in the kernel, all clocks are currently the monotonic clock
+    if(tp==nullptr)
+    {
+        errno=EFAULT;
+        return -1;
+    }
+    long long ns=miosix::getTime();
+    //Same as ll2timespec() in the kernel, calls __aeabi_ldivmod only once
+    register long long a asm("r0") = ns;
+    register long long b asm("r2") = 1000000000;
+    asm volatile("bl	__aeabi_ldivmod" : "+r"(a), "+r"(b) :: "lr");
+    tp->tv_sec = a;
+    tp->tv_nsec = static_cast<long>(b);
+    return 0;
+}
+
 clock_t times(struct tms *tim)
 {
     struct timespec tp;
@@ -486,6 +634,27 @@ pid_t wait(int *status)
     return waitpid(-1,status,0);
 }
 
+int mq_close(mqd_t mqdes)
+{
+    return close(mqdes);
+}
+
+int mq_setattr(mqd_t mqdes, const struct mq_attr *mqstat,
+               struct mq_attr *omqstat)
+{
+    struct mq_attr current;
+    if(mq_getattr(mqdes,&current)<0) return -1;
+    if(omqstat) *omqstat=current;
+    //O_NONBLOCK is the only flag that can be changed, but the kernel does not
+    //yet support changing it after mq_open()
+    if((mqstat->mq_flags & O_NONBLOCK)!=(current.mq_flags & O_NONBLOCK))
+    {
+        errno=ENOSYS;
+        return -1;
+    }
+    return 0;
+}
+
 #if __CORTEX_M != 0
 
 static int __LDREXW(volatile int *addr)
@@ -519,12 +688,12 @@ static int atomicCompareAndSwap(volatile int *p, int prev, int next)
 
 #else //__CORTEX_M != 0
 
+int __cas_syscall(volatile int *p, int prev, int next); //Implemented in crt0.S
+
 inline int atomicCompareAndSwap(volatile int *p, int prev, int next)
 {
-    //FIXME: not atomic at all, we can't even disable interrupts in a process
-    //we'll need a syscall to let the kernel do this operation atomically
-    int result = *p;
-    if(*p == prev) *p = next;
+    //We can't disable interrupts in a process, let the kernel do it
+    int result=__cas_syscall(p,prev,next);
     asm volatile("":::"memory");
     return result;
 }
@@ -567,7 +736,8 @@ private:
 
 void *getCurrentThread()
 {
-    return reinterpret_cast<void*>(1); //TODO: stub we need a syscall for that
+    //The main thread has id 0, but a null owner means the mutex is unlocked
+    return reinterpret_cast<void*>(pthread_self()+1);
 }
 
 struct WaitingList
@@ -652,6 +822,101 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex)
 
 int pthread_mutex_destroy(pthread_mutex_t *mutex) { return 0; }
 
+/// Default stack size for pthread_create
+static const size_t defaultThreadStackSize=2048;
+
+/// Minimum stack size for pthread_create, the kernel requires some more space
+/// than this for the stack watermark
+static const size_t minThreadStackSize=512;
+
+//Implemented in crt0.S
+int __thread_create(void (*entry)(void*), void *arg, void *stack, size_t size);
+int __thread_exit(void *result);
+int __thread_join(pthread_t tid, void **result, void **stack);
+
+/**
+ * Userspace entry point of threads created with pthread_create
+ */
+static void threadLauncher(void *argv)
+{
+    auto ts=reinterpret_cast<ThreadStart*>(argv);
+    //Done by the thread itself as it may run before pthread_create returns
+    unsigned int tid=pthread_self();
+    if(tid<maxThreads) threadStarts[tid]=ts;
+    pthread_exit(ts->start(ts->arg));
+}
+
+int pthread_create(pthread_t *pthread, const pthread_attr_t *attr,
+    void *(*start)(void *), void *arg)
+{
+    size_t size=defaultThreadStackSize;
+    if(attr!=nullptr)
+    {
+        //Detached threads are not supported
+        if(attr->detachstate!=PTHREAD_CREATE_JOINABLE) return EINVAL;
+        size=attr->stacksize;
+    }
+    size=(size+7) & ~7;
+    auto ts=reinterpret_cast<ThreadStart*>(malloc(sizeof(ThreadStart)+size));
+    if(ts==nullptr) return EAGAIN;
+    ts->start=start;
+    ts->arg=arg;
+    _REENT_INIT_PTR(&ts->reent);
+    ts->eh={};
+    int result=__thread_create(threadLauncher,ts,ts+1,size);
+    if(result<0)
+    {
+        free(ts);
+        return -result;
+    }
+    *pthread=result;
+    return 0;
+}
+
+void pthread_exit(void *value)
+{
+    __thread_exit(value);
+    //Only the main thread gets here, exit the process as returning from main
+    exit(0);
+}
+
+int pthread_join(pthread_t pthread, void **value_ptr)
+{
+    void *stack;
+    int result=__thread_join(pthread,value_ptr,&stack);
+    if(result<0) return -result;
+    auto ts=reinterpret_cast<ThreadStart*>(stack)-1;
+    _reclaim_reent(&ts->reent);
+    free(ts);
+    return 0;
+}
+
+int pthread_attr_init(pthread_attr_t *attr)
+{
+    //We only use two fields of pthread_attr_t so initialize only these
+    attr->detachstate=PTHREAD_CREATE_JOINABLE;
+    attr->stacksize=defaultThreadStackSize;
+    return 0;
+}
+
+int pthread_attr_destroy(pthread_attr_t *attr)
+{
+    return 0;
+}
+
+int pthread_attr_getstacksize(const pthread_attr_t *attr, size_t *stacksize)
+{
+    *stacksize=attr->stacksize;
+    return 0;
+}
+
+int pthread_attr_setstacksize(pthread_attr_t *attr, size_t stacksize)
+{
+    if(stacksize<minThreadStackSize) return EINVAL;
+    attr->stacksize=stacksize;
+    return 0;
+}
+
 int pthread_once(pthread_once_t *once, void (*func)())
 {
     //TODO: make thread-safe when processes can spawn threads
@@ -686,33 +951,19 @@ union MiosixGuard
 namespace __cxxabiv1
 {
 
-struct __cxa_exception; //A forward declaration of this one is enough
-
-/*
- * This struct was taken from libsupc++/unwind-cxx.h Unfortunately that file
- * is not deployed in the gcc installation so we can't just #include it.
- * It is required on a per-thread basis to make C++ exceptions thread safe.
- */
-struct __cxa_eh_globals
-{
-    __cxa_exception *caughtExceptions;
-    unsigned int uncaughtExceptions;
-    //Should be __ARM_EABI_UNWINDER__ but that's only usable inside gcc
-    #ifdef __ARM_EABI__
-    __cxa_exception* propagatingExceptions;
-    #endif //__ARM_EABI__
-};
-
+/// C++ exception handling data of the main thread
 static __cxa_eh_globals eh = { 0 };
 
 extern "C" __cxa_eh_globals* __cxa_get_globals_fast()
 {
-    return &eh; //TODO: one per-thread when processes can spawn threads
+    ThreadStart *ts=currentThreadStart();
+    return ts ? &ts->eh : &eh;
 }
 
 extern "C" __cxa_eh_globals* __cxa_get_globals()
 {
-    return &eh; //TODO: one per-thread when processes can spawn threads
+    ThreadStart *ts=currentThreadStart();
+    return ts ? &ts->eh : &eh;
 }
 
 extern "C" int __cxa_guard_acquire(__guard *g)
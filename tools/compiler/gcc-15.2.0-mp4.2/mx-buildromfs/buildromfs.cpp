@@ -32,11 +32,26 @@ int main(int argc, char *argv[])
 {
     if(argc<4)
     {
-        cerr<<"Miosix buildromfs utility v2.00"<<endl
-            <<"use: buildromfs <target file> --from-directory <source directory>"<<endl;
+        cerr<<"Miosix buildromfs utility v2.01"<<endl
+            <<"use: buildromfs <target file> --from-directory <source directory>"
+            <<" [--compress[=<block size>]]"<<endl;
         return 1;
     }
 
+    // Parse options
+    unsigned int compressBlockSize=0;
+    for(int i=4;i<argc;i++)
+    {
+        string option=argv[i];
+        if(option=="--compress") compressBlockSize=1024;
+        else if(option.compare(0,11,"--compress=")==0)
+            compressBlockSize=stoul(option.substr(11));
+        else {
+            cerr<<option<<": unsupported option"<<endl;
+            return 1;
+        }
+    }
+
     // Build the tree of files and directories that compose the image
     string mode=argv[2];
     FilesystemEntry root;
@@ -58,7 +73,10 @@ int main(int argc, char *argv[])
     }
 
     // Build the image and write it to file
-    MkRomFs img(io,root);
-    cout<<"RomFs size "<<img.size()<<endl;
+    MkRomFs img(io,root,compressBlockSize);
+    cout<<"RomFs size "<<img.size();
+    if(img.numCompressedFiles()>0)
+        cout<<" ("<<img.numCompressedFiles()<<" compressed files)";
+    cout<<endl;
     return 0;
 }
@@ -0,0 +1,90 @@
+ /***************************************************************************
+  *   Copyright (C) 2026 by Terraneo Federico                               *
+  *                                                                         *
+  *   This program is free software; you can redistribute it and/or modify  *
+  *   it under the terms of the GNU General Public License as published by  *
+  *   the Free Software Foundation; either version 2 of the License, or     *
+  *   (at your option) any later version.                                   *
+  *                                                                         *
+  *   This program is distributed in the hope that it will be useful,       *
+  *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+  *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+  *   GNU General Public License for more details.                          *
+  *                                                                         *
+  *   You should have received a copy of the GNU General Public License     *
+  *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+  ***************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+/**
+ * Compress data using the LZ4 block format. The compressor is a simple greedy
+ * one, output is compatible with any LZ4 block decompressor
+ * \param data data to compress
+ * \return the compressed data
+ */
+inline std::string lz4Compress(const std::string& data)
+{
+    using namespace std;
+    // Format constraints: the last match must start at least 12 bytes before
+    // the end of the data, and the last 5 bytes must be literals
+    const size_t matchFindLimit=12, lastLiterals=5, minMatch=4;
+    const size_t maxOffset=65535, hashBits=16;
+    const auto *src=reinterpret_cast<const unsigned char*>(data.data());
+    const size_t n=data.size();
+    string out;
+    auto hash=[src](size_t p)
+    {
+        unsigned int v;
+        memcpy(&v,src+p,sizeof(v));
+        return (v*2654435761u)>>(32-hashBits);
+    };
+    auto putLength=[&out](size_t len)
+    {
+        for(;len>=255;len-=255) out.push_back('\xff');
+        out.push_back(static_cast<char>(len));
+    };
+    auto putSequence=[&](size_t literalStart, size_t literalLen, size_t matchLen)
+    {
+        unsigned char token=min<size_t>(literalLen,15)<<4;
+        if(matchLen) token|=min<size_t>(matchLen-minMatch,15);
+        out.push_back(static_cast<char>(token));
+        if(literalLen>=15) putLength(literalLen-15);
+        out.append(data,literalStart,literalLen);
+    };
+
+    size_t anchor=0; // Start of pending literals
+    if(n>matchFindLimit)
+    {
+        vector<long long> table(1<<hashBits,-1);
+        size_t i=0;
+        while(i<n-matchFindLimit)
+        {
+            auto h=hash(i);
+            long long ref=table[h];
+            table[h]=i;
+            if(ref<0 || i-ref>maxOffset || memcmp(src+ref,src+i,minMatch)!=0)
+            {
+                i++;
+                continue;
+            }
+            size_t matchLen=minMatch;
+            while(i+matchLen<n-lastLiterals && src[ref+matchLen]==src[i+matchLen])
+                matchLen++;
+            putSequence(anchor,i-anchor,matchLen);
+            size_t offset=i-ref;
+            out.push_back(static_cast<char>(offset & 0xff));
+            out.push_back(static_cast<char>(offset>>8));
+            if(matchLen-minMatch>=15) putLength(matchLen-minMatch-15);
+            i+=matchLen;
+            anchor=i;
+        }
+    }
+    // Last sequence, literals only
+    putSequence(anchor,n-anchor,0);
+    return out;
+}
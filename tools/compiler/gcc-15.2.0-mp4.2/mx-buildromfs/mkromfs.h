@@ -20,6 +20,8 @@
 #include <cstring>
 #include <fstream>
 #include <list>
+#include <vector>
+#include <string>
 #include <cassert>
 #include <algorithm>
 #include <stdexcept>
@@ -27,6 +29,7 @@
 #include <sys/stat.h>
 #include "tree.h"
 #include "image.h"
+#include "lz4.h"
 #include "romfs_types.h"
 #include "elf_types.h"
 
@@ -71,15 +74,24 @@ public:
      * Everything is done in the constructor, the class exists as a convenience
      * \param io iostream where the image will be built
      * \param root root of the directory tree
+     * \param compressBlockSize if nonzero, compress files that are not elf
+     * files using blocks of this size
      */
-    MkRomFs(std::iostream& io, const FilesystemEntry& root) : img(io)
+    MkRomFs(std::iostream& io, const FilesystemEntry& root,
+            unsigned int compressBlockSize=0)
+        : img(io), compressBlockSize(compressBlockSize)
     {
+        if(compressBlockSize>romFsMaxBlockSize)
+            throw std::runtime_error("compression block size exceeds "
+                +std::to_string(romFsMaxBlockSize)+"Byte");
+
         // Construct the filesystem header
         RomFsHeader header;
         memset(&header,0,sizeof(RomFsHeader));
         strncpy(header.marker,"wwwww",6);
         strncpy(header.fsName,"RomFs 2.01",11);
         strncpy(header.osName,"Miosix",7);
+        header.features=toLittleEndian32(romFsFeatureDirIndex);
         //header.imageSize still unknown at this point
         auto headerOffset=img.append(header,romFsStructAlignment);
 
@@ -104,6 +116,8 @@ public:
         img.align(romFsImageAlignment);
 
         // Go back and update header
+        if(compressedFiles>0)
+            header.features|=toLittleEndian32(romFsFeatureCompression);
         header.imageSize=toLittleEndian32(img.size());
         img.put(header,headerOffset);
     }
@@ -113,6 +127,11 @@ public:
      */
     unsigned int size() const { return img.size(); }
 
+    /**
+     * \return the number of files that were compressed
+     */
+    unsigned int numCompressedFiles() const { return compressedFiles; }
+
 private:
     struct InodeInfo
     {
@@ -145,6 +164,7 @@ private:
 
         // Write entries
         list<unsigned int> entryOffsets;
+        vector<pair<string,unsigned int>> sortedEntries;
         for(auto& d : dir.directoryEntries)
         {
             RomFsDirectoryEntry de;
@@ -155,6 +175,7 @@ private:
             de.uid=toLittleEndian16(d.uid);
             de.gid=toLittleEndian16(d.gid);
             entryOffsets.push_back(img.append(de,romFsStructAlignment));
+            sortedEntries.push_back({d.name,entryOffsets.back()});
             img.appendString(d.name);
         }
 
@@ -162,6 +183,15 @@ private:
         // NOTE: Must be done before we recursively add the directory content!
         auto size=img.size()-inode; //inode is also address of first byte
 
+        // Write the directory index, not included in the directory size.
+        // Entries are sorted as by strcmp (i.e: comparing unsigned chars),
+        // which is what std::string comparison does
+        sort(begin(sortedEntries),end(sortedEntries));
+        RomFsDirectoryIndex index;
+        index.count=toLittleEndian32(sortedEntries.size());
+        img.append(index,romFsStructAlignment);
+        for(auto& e : sortedEntries) img.append(toLittleEndian32(e.second));
+
         // Then for each entry, recursively add the content
         list<InodeInfo> entryContent;
         for(auto& d : dir.directoryEntries)
@@ -205,8 +235,29 @@ private:
         assert(file.isFile());
         std::ifstream in(file.path, std::ios::binary);
         if(!in) throw std::runtime_error(file.path.u8string()+": file not found");
-        unsigned int fileAlignment=getFileAlignment(file.path.u8string(),in);
+        bool elf;
+        unsigned int fileAlignment=getFileAlignment(file.path.u8string(),in,elf);
         fileAlignment=std::max(fileAlignment,romFsFileAlignment);
+        // Elf files are never compressed so they can be executed in place
+        if(compressBlockSize>0 && !elf)
+        {
+            in.seekg(0);
+            std::string content((std::istreambuf_iterator<char>(in)),
+                                 std::istreambuf_iterator<char>());
+            // Uncompressed files can't start with the compressed file marker,
+            // so if one does, compress it even if it does not get smaller
+            bool marker=content.size()>=sizeof(romFsCompressedMagic) &&
+                memcmp(content.data(),romFsCompressedMagic,
+                       sizeof(romFsCompressedMagic))==0;
+            std::string compressed=compressFile(content);
+            if(compressed.size()<content.size() || marker)
+            {
+                compressedFiles++;
+                auto inode=img.appendString(compressed,false,romFsFileAlignment);
+                return InodeInfo(inode,content.size());
+            }
+            in.clear(); //Clear eof bit
+        }
         if(fileAlignment>romFsImageAlignment)
         {
             throw std::runtime_error(file.path.u8string()+" alignment ("
@@ -241,16 +292,50 @@ private:
         return InodeInfo(inode,size);
     }
 
+    /**
+     * Compress a file
+     * \param content file content
+     * \return the compressed file, starting with a RomFsCompressedFile
+     */
+    std::string compressFile(const std::string& content)
+    {
+        using namespace std;
+        unsigned int blockCount=(content.size()+compressBlockSize-1)/compressBlockSize;
+        unsigned int headerSize=sizeof(RomFsCompressedFile)
+                               +(blockCount+1)*sizeof(unsigned int);
+        vector<unsigned int> blocks;
+        string data;
+        for(unsigned int i=0;i<blockCount;i++)
+        {
+            blocks.push_back(toLittleEndian32(headerSize+data.size()));
+            string block=content.substr(i*compressBlockSize,compressBlockSize);
+            string compressed=lz4Compress(block);
+            // Blocks that would not get smaller are stored uncompressed
+            data+=compressed.size()<block.size() ? compressed : block;
+        }
+        blocks.push_back(toLittleEndian32(headerSize+data.size()));
+        RomFsCompressedFile header;
+        memcpy(header.magic,romFsCompressedMagic,sizeof(romFsCompressedMagic));
+        header.blockSize=toLittleEndian32(compressBlockSize);
+        string result(reinterpret_cast<const char*>(&header),sizeof(header));
+        result.append(reinterpret_cast<const char*>(blocks.data()),
+                      blocks.size()*sizeof(unsigned int));
+        return result+data;
+    }
+
     /**
      * Inspect the file looking for alignment requirements
      * Currently, only elf files are checked to support XIP
      * \param in istream to access file content
+     * \param elf set to true if the file is an elf file
      * \return alignment requirements
      */
-    unsigned int getFileAlignment(const std::string& name, std::istream& in)
+    unsigned int getFileAlignment(const std::string& name, std::istream& in,
+                                  bool& elf)
     {
         using namespace miosix;
         unsigned int result=1; //Default alignment
+        elf=false;
 
         //Check whether the file is an elf
         Elf32_Ehdr elfHeader;
@@ -263,6 +348,7 @@ private:
         }
 
         //We have an elf, pick maximum between segment alignments
+        elf=true;
         in.seekg(elfHeader.e_phoff);
         for(int i=0;i<elfHeader.e_phnum;i++)
         {
@@ -276,4 +362,6 @@ private:
     }
 
     Image<unsigned int> img; ///< Backing storage
+    unsigned int compressBlockSize; ///< Compression block size, 0 if disabled
+    unsigned int compressedFiles=0; ///< Number of compressed files
 };
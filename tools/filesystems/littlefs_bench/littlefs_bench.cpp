@@ -0,0 +1,233 @@
+ /***************************************************************************
+  *   Copyright (C) 2026 by Terraneo Federico                               *
+  *                                                                         *
+  *   This program is free software; you can redistribute it and/or modify  *
+  *   it under the terms of the GNU General Public License as published by  *
+  *   the Free Software Foundation; either version 2 of the License, or     *
+  *   (at your option) any later version.                                   *
+  *                                                                         *
+  *   This program is distributed in the hope that it will be useful,       *
+  *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+  *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+  *   GNU General Public License for more details.                          *
+  *                                                                         *
+  *   You should have received a copy of the GNU General Public License     *
+  *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+  ***************************************************************************/
+
+/*
+ * LittleFS benchmark on an emulated NOR flash, runs on the host.
+ * Replays typical embedded workloads through LittleFS and reports throughput
+ * (computed from the NOR flash timing model), erases per MByte written, write
+ * amplification and wear. Each workload is run both with the old hard-coded
+ * 512 byte configuration and with the configuration that LittleFS now derives
+ * from the device geometry.
+ *
+ * Build with
+ * mkdir build && cd build && cmake .. && make
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include "filesystem/devfs/nor_flash.h"
+#include "lfs.h"
+
+using namespace std;
+using namespace miosix;
+
+/// 1MByte NOR flash with 256 byte pages and 4KByte sectors, as common SPI ones
+const BlockGeometry norGeometry={1,256,4096,256};
+
+/**
+ * Filesystem configuration under test
+ */
+struct Config
+{
+    const char *name;
+    /// LittleFS block size, if smaller than the flash erase size erasing a
+    /// block requires a read-modify-write of the whole flash block
+    unsigned int blockSize;
+    unsigned int readSize, progSize, cacheSize, lookaheadSize;
+};
+
+/**
+ * LittleFS on a NorFlash
+ */
+class Bench
+{
+public:
+    Bench(const Config& c) : flash(norGeometry)
+    {
+        cfg={};
+        cfg.context=this;
+        cfg.read=read;
+        cfg.prog=prog;
+        cfg.erase=erase;
+        cfg.sync=sync;
+        cfg.lock=lock; //Miosix builds LittleFS with LFS_THREADSAFE
+        cfg.unlock=lock;
+        cfg.read_size=c.readSize;
+        cfg.prog_size=c.progSize;
+        cfg.block_size=c.blockSize;
+        cfg.block_count=flash.size()/c.blockSize;
+        cfg.block_cycles=500;
+        cfg.cache_size=c.cacheSize;
+        cfg.lookahead_size=c.lookaheadSize;
+        if(lfs_format(&lfs,&cfg)) throw runtime_error("format failed");
+        if(lfs_mount(&lfs,&cfg)) throw runtime_error("mount failed");
+        flash.resetStats();
+    }
+
+    ~Bench() { lfs_unmount(&lfs); }
+
+    lfs_t lfs;
+    NorFlash flash;
+
+private:
+    static Bench *self(const lfs_config *c)
+    {
+        return reinterpret_cast<Bench*>(c->context);
+    }
+
+    static unsigned long long address(const lfs_config *c, lfs_block_t block,
+                                      lfs_off_t off)
+    {
+        return static_cast<unsigned long long>(block)*c->block_size+off;
+    }
+
+    static int read(const lfs_config *c, lfs_block_t block, lfs_off_t off,
+                    void *buffer, lfs_size_t size)
+    {
+        auto res=self(c)->flash.read(buffer,size,address(c,block,off));
+        return res==0 ? 0 : LFS_ERR_IO;
+    }
+
+    static int prog(const lfs_config *c, lfs_block_t block, lfs_off_t off,
+                    const void *buffer, lfs_size_t size)
+    {
+        auto res=self(c)->flash.program(buffer,size,address(c,block,off));
+        return res==0 ? 0 : LFS_ERR_IO;
+    }
+
+    static int erase(const lfs_config *c, lfs_block_t block)
+    {
+        auto& flash=self(c)->flash;
+        const unsigned int eraseSize=norGeometry.eraseSize;
+        const unsigned int pageSize=norGeometry.progSize;
+        if(c->block_size==eraseSize) return flash.erase(block)==0 ? 0 : LFS_ERR_IO;
+        // LittleFS block smaller than the flash block, erase the flash block
+        // and program back the content of the other LittleFS blocks
+        auto addr=address(c,block,0);
+        auto flashBlock=addr/eraseSize;
+        vector<unsigned char> data(eraseSize);
+        if(flash.read(data.data(),eraseSize,flashBlock*eraseSize)) return LFS_ERR_IO;
+        if(flash.erase(flashBlock)) return LFS_ERR_IO;
+        for(unsigned int i=0;i<eraseSize;i+=pageSize)
+        {
+            auto pageAddr=flashBlock*eraseSize+i;
+            if(pageAddr>=addr && pageAddr<addr+c->block_size) continue;
+            auto page=data.begin()+i;
+            if(all_of(page,page+pageSize,[](unsigned char x){ return x==0xff; }))
+                continue;
+            if(flash.program(&*page,pageSize,pageAddr)) return LFS_ERR_IO;
+        }
+        return 0;
+    }
+
+    static int sync(const lfs_config *) { return 0; }
+
+    static int lock(const lfs_config *) { return 0; }
+
+    lfs_config cfg;
+};
+
+/**
+ * Workload under test
+ */
+struct Workload
+{
+    const char *name;
+    unsigned int ops;        ///< Number of operations
+    unsigned int bytesPerOp; ///< Data written by each operation
+    function<void (lfs_t*,unsigned int)> op; ///< Performs the i-th operation
+};
+
+static void check(int res)
+{
+    if(res<0) throw runtime_error("LittleFS error "+to_string(res));
+}
+
+/**
+ * Append 64 byte records to a log file, syncing every 16 records, and start
+ * a new log every 256KBytes. The number of operations must be a multiple of
+ * 4096 to close the last log
+ */
+static void logAppend(lfs_t *lfs, unsigned int i)
+{
+    static lfs_file_t file;
+    const unsigned int recordSize=64, syncEvery=16, rotateEvery=4096;
+    if(i%rotateEvery==0)
+        check(lfs_file_open(lfs,&file,"log",LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC));
+    char record[recordSize];
+    memset(record,'a'+i%26,recordSize);
+    check(lfs_file_write(lfs,&file,record,recordSize));
+    if(i%rotateEvery==rotateEvery-1) check(lfs_file_close(lfs,&file));
+    else if(i%syncEvery==syncEvery-1) check(lfs_file_sync(lfs,&file));
+}
+
+/**
+ * Rewrite a 256 byte configuration file
+ */
+static void configRewrite(lfs_t *lfs, unsigned int i)
+{
+    const unsigned int configSize=256;
+    lfs_file_t file;
+    check(lfs_file_open(lfs,&file,"config",LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC));
+    char config[configSize];
+    memset(config,'0'+i%10,configSize);
+    check(lfs_file_write(lfs,&file,config,configSize));
+    check(lfs_file_close(lfs,&file));
+}
+
+int main()
+{
+    // Legacy is the configuration previously hard-coded in lfs_miosix.cpp,
+    // geometry is what LittleFS now chooses by default for this flash, and
+    // the last one shows the effect of a larger cache passed as mount option
+    const Config configs[]=
+    {
+        {"legacy 512",   512, 512, 512, 512, 512},
+        {"geometry",    4096,   1, 256, 512,  32},
+        {"geometry+4K", 4096,   1, 256,4096,  32},
+    };
+    const Workload workloads[]=
+    {
+        {"log-append",     8192, 64,  logAppend},
+        {"config-rewrite", 2000, 256, configRewrite},
+    };
+
+    cout<<left<<setw(16)<<"workload"<<setw(13)<<"config"<<right
+        <<setw(10)<<"ops/s"<<setw(12)<<"erases/MB"<<setw(10)<<"write amp"
+        <<setw(11)<<"max erase"<<endl;
+    for(auto& w : workloads)
+    {
+        for(auto& c : configs)
+        {
+            Bench b(c);
+            for(unsigned int i=0;i<w.ops;i++) w.op(&b.lfs,i);
+            auto& s=b.flash.getStats();
+            double seconds=s.elapsedNs/1e9;
+            double mbytes=static_cast<double>(w.ops)*w.bytesPerOp/(1024*1024);
+            cout<<fixed<<setprecision(1)<<left<<setw(16)<<w.name<<setw(13)<<c.name
+                <<right<<setw(10)<<w.ops/seconds<<setw(12)<<s.erases/mbytes
+                <<setw(10)<<s.bytesProgrammed/(mbytes*1024*1024)
+                <<setw(11)<<s.maxEraseCount<<endl;
+            if(s.progErrors) cout<<"Error: "<<s.progErrors<<" program errors"<<endl;
+        }
+    }
+}
@@ -0,0 +1,229 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdarg>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <getopt.h>
+#include <map>
+#include <algorithm>
+
+/*
+ * Decodes the syscall trace records read from /dev/strace on a Miosix board
+ * running with WITH_SYSCALL_TRACE. The layout of the records must match
+ * struct SyscallTraceRecord in miosix/kernel/syscall_trace.h, and the syscall
+ * names the Syscall enum in miosix/kernel/process.h
+ */
+
+[[noreturn]] static void fail(const char *fmt, ...)
+{
+    fprintf(stderr, "error: ");
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(1);
+}
+
+static const char *syscallNames[]=
+{
+    "yield", "userspace", "open", "close", "read", "write", "lseek", "stat",
+    "lstat", "fstat", "fcntl", "ioctl", "isatty", "getcwd", "chdir",
+    "getdents", "mkdir", "rmdir", "link", "unlink", "symlink", "readlink",
+    "truncate", "ftruncate", "rename", "chmod", "fchmod", "chown", "fchown",
+    "lchown", "dup", "dup2", "pipe", "access", "poll", "sendfile", "gettime64",
+    "nanosleep64", "gettime", "settime", "nanosleep", "getres", "adjtime",
+    "exit", "execve", "spawn", "kill", "waitpid", "getpid", "getppid",
+    "getuid", "getgid", "geteuid", "getegid", "setuid", "setgid", "mount",
+    "umount", "mkfs", "sysconf", "pread", "pwrite", "readv", "writev", "mmap",
+    "munmap", "ioring_setup", "ioring_enter", "timepage_setup", "batch",
+    "shm_open", "shm_unlink", "futex_wait", "futex_wake", "thread_create",
+    "thread_exit", "thread_join", "thread_self", "atomic_cas", "heap_setup",
+    "mq_open", "mq_unlink", "mq_send", "mq_receive", "mq_getattr"
+};
+static const unsigned int numSyscalls=sizeof(syscallNames)/sizeof(syscallNames[0]);
+
+/// Errno values as defined by newlib, only the common ones
+static const std::map<int,const char*> errnoNames=
+{
+    {1,"EPERM"}, {2,"ENOENT"}, {3,"ESRCH"}, {4,"EINTR"}, {5,"EIO"},
+    {6,"ENXIO"}, {7,"E2BIG"}, {8,"ENOEXEC"}, {9,"EBADF"}, {10,"ECHILD"},
+    {11,"EAGAIN"}, {12,"ENOMEM"}, {13,"EACCES"}, {14,"EFAULT"}, {16,"EBUSY"},
+    {17,"EEXIST"}, {18,"EXDEV"}, {19,"ENODEV"}, {20,"ENOTDIR"}, {21,"EISDIR"},
+    {22,"EINVAL"}, {23,"ENFILE"}, {24,"EMFILE"}, {25,"ENOTTY"}, {27,"EFBIG"},
+    {28,"ENOSPC"}, {29,"ESPIPE"}, {30,"EROFS"}, {31,"EMLINK"}, {32,"EPIPE"},
+    {88,"ENOSYS"}, {90,"ENOTEMPTY"}, {91,"ENAMETOOLONG"}, {116,"ETIMEDOUT"}
+};
+
+/// Decoded struct SyscallTraceRecord
+struct Record
+{
+    long long timestamp;
+    uint32_t seq;
+    int32_t pid;
+    uint16_t tid;
+    uint16_t id;
+    uint32_t args[4];
+    int32_t result;
+    uint32_t duration;
+};
+
+static const int recordSize=48;
+
+static uint32_t get32(const unsigned char *p)
+{
+    return p[0] | p[1]<<8 | p[2]<<16 | static_cast<uint32_t>(p[3])<<24;
+}
+
+static Record decode(const unsigned char *p)
+{
+    Record r;
+    r.timestamp=get32(p) | static_cast<long long>(get32(p+4))<<32;
+    r.seq=get32(p+8);
+    r.pid=get32(p+12);
+    r.tid=p[16] | p[17]<<8;
+    r.id=p[18] | p[19]<<8;
+    for(int i=0;i<4;i++) r.args[i]=get32(p+20+4*i);
+    r.result=get32(p+36);
+    r.duration=get32(p+40);
+    return r;
+}
+
+static void printRecord(const Record& r)
+{
+    printf("%6lld.%06lld %d:%d ",r.timestamp/1000000000,
+           r.timestamp/1000%1000000,r.pid,r.tid);
+    if(r.id<numSyscalls) printf("%s",syscallNames[r.id]);
+    else printf("syscall_%d",r.id);
+    printf("(0x%x, 0x%x, 0x%x, 0x%x) = %d",r.args[0],r.args[1],r.args[2],
+           r.args[3],r.result);
+    auto it=errnoNames.find(-r.result);
+    if(it!=errnoNames.end()) printf(" %s",it->second);
+    if(r.duration==UINT32_MAX) printf(" <>4.29s>\n");
+    else printf(" <%u.%03uus>\n",r.duration/1000,r.duration%1000);
+}
+
+/// Per syscall statistics, printed by the -c option
+struct Stats
+{
+    unsigned int count=0;
+    unsigned int errors=0;
+    uint64_t total=0;
+    uint32_t max=0;
+    unsigned int histogram[12]={0}; ///< Same buckets as SyscallHistogram
+};
+
+static void addStats(Stats& s, const Record& r)
+{
+    s.count++;
+    if(r.result<0 && errnoNames.count(-r.result)) s.errors++;
+    s.total+=r.duration;
+    s.max=std::max(s.max,r.duration);
+    uint32_t us=r.duration/1000;
+    int bucket= us==0 ? 0 : 32-__builtin_clz(us);
+    s.histogram[std::min(bucket,11)]++;
+}
+
+static void printStats(const std::map<unsigned int,Stats>& stats)
+{
+    printf("%-16s %8s %8s %10s %10s  latency histogram, <1us <2us ... <1024us more\n",
+           "syscall","calls","errors","avg(us)","max(us)");
+    for(auto& [id,s] : stats)
+    {
+        if(id<numSyscalls) printf("%-16s",syscallNames[id]);
+        else printf("syscall_%-8d",id);
+        printf(" %8u %8u %10.3f %10.3f ",s.count,s.errors,
+               s.total/1000.0/s.count,s.max/1000.0);
+        for(int i=0;i<12;i++) printf(" %u",s.histogram[i]);
+        printf("\n");
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,"usage: %s [-c] [-p pid] [file]\n"
+        "Decode the syscall trace read from /dev/strace, from file or stdin\n"
+        "  -c      print per syscall statistics instead of the trace\n"
+        "  -p pid  only consider syscalls made by process pid\n",name);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    bool summary=false;
+    int pid=-1;
+    int opt;
+    while((opt=getopt(argc,argv,"cp:h"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'c': summary=true; break;
+            case 'p': pid=atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if(argc-optind>1) usage(argv[0]);
+    FILE *in=stdin;
+    if(optind<argc)
+    {
+        in=fopen(argv[optind],"rb");
+        if(in==nullptr) fail("can't open %s: %s\n",argv[optind],strerror(errno));
+    }
+
+    std::map<unsigned int,Stats> stats;
+    bool first=true;
+    uint32_t nextSeq=0;
+    unsigned int lost=0;
+    unsigned char buffer[recordSize];
+    size_t len;
+    while((len=fread(buffer,1,recordSize,in))==recordSize)
+    {
+        Record r=decode(buffer);
+        if(!first && r.seq!=nextSeq)
+        {
+            lost+=r.seq-nextSeq;
+            if(!summary) printf("--- %u records lost ---\n",r.seq-nextSeq);
+        }
+        first=false;
+        nextSeq=r.seq+1;
+        if(pid>=0 && r.pid!=pid) continue;
+        if(summary) addStats(stats[r.id],r);
+        else printRecord(r);
+    }
+    if(len!=0) fprintf(stderr,"warning: ignoring truncated record at end of input\n");
+    if(summary)
+    {
+        printStats(stats);
+        if(lost) printf("%u records lost\n",lost);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+/***************************************************************************
+ *   Copyright (C) 2026 by Terraneo Federico                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   As a special exception, if other files instantiate templates or use   *
+ *   macros or inline functions from this file, or you compile this file   *
+ *   and link it with other works to produce a work based on this file,    *
+ *   this file does not by itself cause the resulting work to be covered   *
+ *   by the GNU General Public License. However the source code for this   *
+ *   file must still be made available in accordance with the GNU General  *
+ *   Public License. This exception does not invalidate any other reasons  *
+ *   why a work based on this file might be covered by the GNU General     *
+ *   Public License.                                                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <http://www.gnu.org/licenses/>   *
+ ***************************************************************************/
+
+// Measures the cost of the hot syscalls, run by the kernel testsuite benchmark.
+// The CPU frequency in Hz can be passed as first argument, as it can't be read
+// from userspace, to also report the cost in cycles
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace miosix {
+long long getTime() noexcept;
+void nanoSleepUntil(long long absoluteTimeNs);
+}
+
+using namespace miosix;
+
+static const int iterations=4096;
+static unsigned int cpuFrequency=0;
+static long long emptyLoop;
+
+/**
+ * \param f the code to benchmark
+ * \return the time in ns taken by iterations calls to f
+ */
+template<typename F>
+long long measure(F&& f)
+{
+    long long t=getTime();
+    for(int i=0;i<iterations;i++) f();
+    return getTime()-t;
+}
+
+/**
+ * Print the cost of a syscall
+ * \param name syscall name
+ * \param t time in ns taken by iterations calls to the syscall
+ */
+static void report(const char *name, long long t)
+{
+    t=max(0ll,t-emptyLoop);
+    int ns=t/iterations;
+    if(cpuFrequency==0)
+    {
+        printf("%-22s %5dns\n",name,ns);
+    } else {
+        int cycles=(t*(cpuFrequency/1000))/(iterations*1000000ll);
+        printf("%-22s %5dns %5d cycles\n",name,ns,cycles);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc>1) cpuFrequency=atoi(argv[1]);
+    int fd=open("/dev/null",O_RDWR);
+    if(fd<0) return 1;
+    char c=0;
+    emptyLoop=measure([]{ asm volatile("":::"memory"); });
+    //Handled without leaving userspace
+    report("getpid",measure([]{ getpid(); }));
+    report("getTime",measure([]{ getTime(); }));
+    //Handled in kernelspace, but skipping the MPU reprogramming
+    report("write",measure([&]{ write(fd,&c,1); }));
+    report("read",measure([&]{ read(fd,&c,1); }));
+    report("nanoSleepUntil (past)",measure([]{ nanoSleepUntil(0); }));
+    //Regular syscall, for reference
+    report("getppid",measure([]{ getppid(); }));
+    close(fd);
+    return 0;
+}
@@ -50,6 +50,7 @@ static void fail(const char *cause);
 #include "../test_syscalls.h"
 
 static int sys_test_getpid_child(int argc, char *argv[]);
+static int proc_test_threads_blocked_child(int argc, char *argv[]);
 
 int main(int argc, char *argv[], char *envp[])
 {
@@ -59,6 +60,8 @@ int main(int argc, char *argv[], char *envp[])
     {
         if(strcmp("sys_test_getpid_child", argv[1])==0)
             return sys_test_getpid_child(argc, argv);
+        if(strcmp("threads_blocked_child", argv[1])==0)
+            return proc_test_threads_blocked_child(argc, argv);
         if(strcmp("exit_123", argv[1])==0)
             exit(123);
         if(strcmp("sleep_and_exit_234", argv[1])==0)
@@ -38,6 +38,9 @@ static void fs_test_5();
 static void fs_test_6();
 static void fs_test_7();
 static void sys_test_pipe();
+static void sys_test_poll();
+static void sys_test_sendfile();
+static void sys_test_pread_readv();
 #endif //WITH_FILESYSTEM
 static void sys_test_time();
 static void sys_test_getpid();
@@ -46,6 +49,15 @@ static void sys_test_isatty();
 static void sys_test_spawn();
 #ifdef IN_PROCESS
 static void proc_test_global_ctor_dtor();
+static void proc_test_mmap();
+static void proc_test_io_ring();
+static void proc_test_time_page();
+static void proc_test_syscall_batch();
+static void proc_test_shm();
+static void proc_test_threads();
+static void proc_test_procfs();
+static void proc_test_strace();
+static void proc_test_mqueue();
 #endif
 #endif
 
@@ -63,6 +75,9 @@ void test_syscalls()
     fs_test_6();
     fs_test_7();
     sys_test_pipe();
+    sys_test_poll();
+    sys_test_sendfile();
+    sys_test_pread_readv();
     #else //WITH_FILESYSTEM
     iprintf("Filesystem tests skipped, filesystem support is disabled\n");
     #endif //WITH_FILESYSTEM
@@ -73,6 +88,15 @@ void test_syscalls()
     sys_test_spawn();
     #ifdef IN_PROCESS
     proc_test_global_ctor_dtor();
+    proc_test_mmap();
+    proc_test_io_ring();
+    proc_test_time_page();
+    proc_test_syscall_batch();
+    proc_test_shm();
+    proc_test_threads();
+    proc_test_procfs();
+    proc_test_strace();
+    proc_test_mqueue();
     #endif
     #endif
     #ifndef IN_PROCESS
@@ -1084,6 +1108,25 @@ static void sys_test_pipe()
     if(close(dupReadFd)!=0) fail("close (4)");
     if(close(dupWriteFd)!=0) fail("close (5)");
 
+    if(pipe(pipeFds)!=0) fail("pipe (2)");
+    if(fcntl(pipeFds[0],F_GETPIPE_SZ)<=0) fail("F_GETPIPE_SZ");
+    if(fcntl(pipeFds[1],F_SETPIPE_SZ,1024)!=1024) fail("F_SETPIPE_SZ");
+    if(fcntl(pipeFds[0],F_GETPIPE_SZ)!=1024) fail("F_GETPIPE_SZ (2)");
+    if(fcntl(pipeFds[0],F_SETPIPE_SZ,0)!=-1 || errno!=EINVAL)
+        fail("F_SETPIPE_SZ (2)");
+    char wrongEnd;
+    if(read(pipeFds[1],&wrongEnd,1)!=-1 || errno!=EBADF) fail("read write end");
+    //Data must survive a resize
+    sys_test_pipe_tryReadAndWrite(pipeFds[0], pipeFds[1], 'a');
+    if(write(pipeFds[1],"bc",2)!=2) fail("write (2)");
+    if(fcntl(pipeFds[1],F_SETPIPE_SZ,1)!=-1 || errno!=EBUSY)
+        fail("F_SETPIPE_SZ (3)");
+    if(fcntl(pipeFds[1],F_SETPIPE_SZ,16)!=16) fail("F_SETPIPE_SZ (4)");
+    char rd[2];
+    if(read(pipeFds[0],rd,2)!=2 || rd[0]!='b' || rd[1]!='c') fail("read (2)");
+    if(close(pipeFds[0])!=0) fail("close (6)");
+    if(close(pipeFds[1])!=0) fail("close (7)");
+
     #ifndef IN_PROCESS
     sys_test_pipe_tryLargeReadAndWrite(100, 512);
     sys_test_pipe_tryLargeReadAndWrite(512, 512);
@@ -1093,6 +1136,176 @@ static void sys_test_pipe()
     pass();
 }
 
+/*
+tests:
+poll
+*/
+
+#ifndef IN_PROCESS
+static void sys_test_poll_thread(int wrFd)
+{
+    Thread::sleep(20);
+    char c='y';
+    if(write(wrFd,&c,1)!=1) fail("write (thread)");
+}
+#endif
+
+static void sys_test_poll()
+{
+    test_name("poll");
+    int fds[2];
+    if(pipe(fds)!=0) fail("pipe");
+    struct pollfd p[3];
+    p[0].fd=fds[0];
+    p[0].events=POLLIN;
+    p[1].fd=fds[1];
+    p[1].events=POLLOUT;
+    p[2].fd=-1; //Negative file descriptors are ignored
+    p[2].events=POLLIN;
+    if(poll(p,3,0)!=1) fail("poll (1)");
+    if(p[0].revents!=0 || p[1].revents!=POLLOUT || p[2].revents!=0)
+        fail("revents (1)");
+    if(poll(p,1,10)!=0) fail("poll timeout");
+    if(p[0].revents!=0) fail("revents (2)");
+
+    char c='x';
+    if(write(fds[1],&c,1)!=1) fail("write");
+    if(poll(p,3,-1)!=2) fail("poll (2)");
+    if(p[0].revents!=POLLIN || p[1].revents!=POLLOUT) fail("revents (3)");
+    char d;
+    if(read(fds[0],&d,1)!=1 || d!=c) fail("read (1)");
+
+    #ifndef IN_PROCESS
+    //Wakeup while blocked in poll
+    std::thread t(sys_test_poll_thread,fds[1]);
+    if(poll(p,1,1000)!=1) fail("poll (3)");
+    if(p[0].revents!=POLLIN) fail("revents (4)");
+    t.join();
+    if(read(fds[0],&d,1)!=1 || d!='y') fail("read (2)");
+    #endif
+
+    int closedFd=dup(fds[0]);
+    if(closedFd<0) fail("dup");
+    if(close(closedFd)!=0) fail("close (1)");
+    p[2].fd=closedFd;
+    if(poll(p+2,1,0)!=1 || p[2].revents!=POLLNVAL) fail("POLLNVAL");
+
+    //Polling the read end after the write end is closed reports hangup
+    if(close(fds[1])!=0) fail("close (2)");
+    if(poll(p,1,-1)!=1 || (p[0].revents & POLLHUP)==0) fail("POLLHUP");
+    if(close(fds[0])!=0) fail("close (3)");
+    pass();
+}
+
+/*
+tests:
+sendfile
+*/
+
+static void sys_test_sendfile()
+{
+    test_name("sendfile");
+    const char name[]="/sd/sendfile.txt";
+    const char data[]="0123456789abcdef";
+    const int len=sizeof(data)-1;
+    int fd=open(name,O_RDWR|O_CREAT|O_TRUNC,0666);
+    if(fd<0) fail("open");
+    if(write(fd,data,len)!=len) fail("write");
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek");
+    int fds[2];
+    if(pipe(fds)!=0) fail("pipe");
+    char buf[len];
+
+    //Using and advancing the file position
+    if(sendfile(fds[1],fd,nullptr,4)!=4) fail("sendfile (1)");
+    if(read(fds[0],buf,sizeof(buf))!=4 || memcmp(buf,data,4)) fail("read (1)");
+    if(lseek(fd,0,SEEK_CUR)!=4) fail("file position (1)");
+
+    //Using an explicit offset, the file position must not change
+    off_t offset=10;
+    if(sendfile(fds[1],fd,&offset,100)!=len-10) fail("sendfile (2)");
+    if(offset!=len) fail("offset");
+    if(lseek(fd,0,SEEK_CUR)!=4) fail("file position (2)");
+    if(read(fds[0],buf,sizeof(buf))!=len-10 || memcmp(buf,data+10,len-10))
+        fail("read (2)");
+
+    //End of file
+    if(sendfile(fds[1],fd,&offset,1)!=0) fail("sendfile (3)");
+
+    //From a pipe to a file
+    if(write(fds[1],"xyz",3)!=3) fail("write (2)");
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek (2)");
+    if(sendfile(fd,fds[0],nullptr,100)!=3) fail("sendfile (4)");
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek (3)");
+    if(read(fd,buf,4)!=4 || memcmp(buf,"xyz3",4)) fail("read (3)");
+
+    //Errors
+    offset=0;
+    if(sendfile(fd,fds[0],&offset,1)!=-1 || errno!=ESPIPE) fail("ESPIPE");
+    if(sendfile(fds[0],fd,nullptr,1)!=-1 || errno!=EBADF) fail("EBADF (1)");
+    if(close(fds[0])!=0) fail("close (1)");
+    if(sendfile(fds[1],fds[0],nullptr,1)!=-1 || errno!=EBADF) fail("EBADF (2)");
+    if(close(fds[1])!=0) fail("close (2)");
+    if(close(fd)!=0) fail("close (3)");
+    if(unlink(name)!=0) fail("unlink");
+    pass();
+}
+
+/*
+tests:
+pread
+pwrite
+readv
+writev
+*/
+
+static void sys_test_pread_readv()
+{
+    test_name("pread/pwrite/readv/writev");
+    const char name[]="/sd/pread.txt";
+    int fd=open(name,O_RDWR|O_CREAT|O_TRUNC,0666);
+    if(fd<0) fail("open");
+
+    //Scatter-gather write of a header and a payload
+    char header[]="HDR:";
+    char payload[]="0123456789";
+    struct iovec iov[2];
+    iov[0].iov_base=header;
+    iov[0].iov_len=4;
+    iov[1].iov_base=payload;
+    iov[1].iov_len=10;
+    if(writev(fd,iov,2)!=14) fail("writev");
+    if(lseek(fd,0,SEEK_CUR)!=14) fail("file position (1)");
+
+    //Positional access must not move the file pointer
+    if(pwrite(fd,"ab",2,6)!=2) fail("pwrite");
+    char buf[16];
+    if(pread(fd,buf,4,4)!=4 || memcmp(buf,"01ab",4)) fail("pread (1)");
+    if(pread(fd,buf,sizeof(buf),14)!=0) fail("pread (2)");
+    if(lseek(fd,0,SEEK_CUR)!=14) fail("file position (2)");
+
+    //Scatter read, the second buffer is only partially filled
+    if(lseek(fd,0,SEEK_SET)!=0) fail("lseek");
+    char h[4], p[16];
+    iov[0].iov_base=h;
+    iov[0].iov_len=sizeof(h);
+    iov[1].iov_base=p;
+    iov[1].iov_len=sizeof(p);
+    if(readv(fd,iov,2)!=14) fail("readv");
+    if(memcmp(h,"HDR:",4) || memcmp(p,"01ab456789",10)) fail("readv data");
+
+    //Errors
+    if(readv(fd,iov,0)!=-1 || errno!=EINVAL) fail("readv EINVAL");
+    if(pread(fd,buf,1,-1)!=-1 || errno!=EINVAL) fail("pread EINVAL");
+    int fds[2];
+    if(pipe(fds)!=0) fail("pipe");
+    if(pwrite(fds[1],"x",1,0)!=-1 || errno!=ESPIPE) fail("pwrite ESPIPE");
+    if(close(fds[0])!=0 || close(fds[1])!=0) fail("close (1)");
+    if(close(fd)!=0) fail("close (2)");
+    if(unlink(name)!=0) fail("unlink");
+    pass();
+}
+
 #endif //WITH_FILESYSTEM
 
 //
@@ -1399,6 +1612,612 @@ static void proc_test_global_ctor_dtor()
     pass();
 }
 
+//
+// Memory mapped files
+//
+/*
+tests:
+mmap
+munmap
+*/
+
+static void proc_test_mmap()
+{
+    test_name("mmap/munmap");
+    int fd=open("/bin/test_process",O_RDONLY);
+    if(fd<0) fail("open");
+    struct stat st;
+    if(fstat(fd,&st)!=0) fail("fstat");
+
+    //Only read-only mappings are supported
+    if(mmap(nullptr,st.st_size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0)!=MAP_FAILED
+        || errno!=EACCES) fail("mmap EACCES");
+    if(mmap(nullptr,st.st_size+1,PROT_READ,MAP_SHARED,fd,0)!=MAP_FAILED
+        || errno!=ENXIO) fail("mmap ENXIO");
+
+    void *addr=mmap(nullptr,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    if(addr==MAP_FAILED)
+    {
+        //Not all architectures have an MPU region to spare, and the binary
+        //may not be in an XIP filesystem
+        if(errno!=ENODEV) fail("mmap");
+        iprintf("mmap not supported, skipping\n");
+    } else {
+        //The mapping must survive closing the file
+        if(close(fd)!=0) fail("close (1)");
+        fd=open("/bin/test_process",O_RDONLY);
+        if(fd<0) fail("open");
+        char buf[64];
+        if(read(fd,buf,sizeof(buf))!=sizeof(buf)) fail("read");
+        if(memcmp(addr,buf,sizeof(buf))) fail("mapped data");
+        if(memcmp(addr,"\x7f""ELF",4)) fail("mapped data (elf header)");
+        //Only one mapping at a time
+        if(mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0)!=MAP_FAILED
+            || errno!=ENOMEM) fail("mmap ENOMEM");
+        if(munmap(addr,st.st_size)!=0) fail("munmap");
+        if(munmap(addr,st.st_size)!=-1 || errno!=EINVAL) fail("munmap EINVAL");
+    }
+
+    //Files not stored in memory can't be mapped
+    int fds[2];
+    if(pipe(fds)!=0) fail("pipe");
+    if(mmap(nullptr,16,PROT_READ,MAP_SHARED,fds[0],0)!=MAP_FAILED
+        || errno!=ENODEV) fail("mmap ENODEV");
+    if(close(fds[0])!=0 || close(fds[1])!=0) fail("close (2)");
+    if(close(fd)!=0) fail("close (3)");
+    pass();
+}
+
+//
+// Asynchronous I/O rings
+//
+/*
+tests:
+io_ring_setup
+io_ring_enter
+*/
+
+static void io_ring_submit(struct io_ring *ring, unsigned char opcode, int fd,
+        void *addr, unsigned int len, unsigned int userData)
+{
+    struct io_sqe *sqe=&ring->sqes[ring->sq_tail & (ring->sq_entries-1)];
+    memset(sqe,0,sizeof(struct io_sqe));
+    sqe->opcode=opcode;
+    sqe->fd=fd;
+    sqe->addr=addr;
+    sqe->len=len;
+    sqe->off=-1;
+    sqe->poll_events=POLLIN;
+    sqe->user_data=userData;
+    ring->sq_tail=ring->sq_tail+1;
+}
+
+static int io_ring_result(struct io_ring *ring, unsigned int userData)
+{
+    //Completions may arrive in any order
+    for(unsigned int i=ring->cq_head;i!=ring->cq_tail;i++)
+    {
+        struct io_cqe *cqe=&ring->cqes[i & (ring->cq_entries-1)];
+        if(cqe->user_data==userData) return cqe->res;
+    }
+    fail("missing completion");
+    return 0;
+}
+
+static void proc_test_io_ring()
+{
+    test_name("io_ring");
+    static struct io_sqe sqes[4] __attribute__((aligned(8)));
+    static struct io_cqe cqes[4];
+    struct io_ring ring;
+    ring.sq_entries=4;
+    ring.cq_entries=4;
+    ring.sqes=sqes;
+    ring.cqes=cqes;
+    if(io_ring_enter(1,0)!=-1 || errno!=EINVAL) fail("enter without ring");
+    ring.cq_entries=3;
+    if(io_ring_setup(&ring)!=-1 || errno!=EINVAL) fail("setup EINVAL");
+    ring.cq_entries=4;
+    if(io_ring_setup(&ring)!=0) fail("setup");
+
+    int fds[2];
+    if(pipe(fds)!=0) fail("pipe");
+    //A poll and a read submitted before the data is available
+    char buf[8];
+    io_ring_submit(&ring,IORING_OP_POLL,fds[0],nullptr,0,1);
+    io_ring_submit(&ring,IORING_OP_READ,fds[0],buf,sizeof(buf),2);
+    if(io_ring_enter(2,0)!=2) fail("enter (1)");
+    if(ring.sq_head!=2) fail("sq_head");
+    if(write(fds[1],"hello",5)!=5) fail("write");
+    if(io_ring_enter(0,2)!=0) fail("enter (2)");
+    if(ring.cq_tail-ring.cq_head!=2) fail("cq_tail (1)");
+    if((io_ring_result(&ring,1) & POLLIN)==0) fail("poll");
+    if(io_ring_result(&ring,2)!=5 || memcmp(buf,"hello",5)) fail("read");
+    ring.cq_head=ring.cq_tail;
+
+    //Errors are reported through the completion ring
+    io_ring_submit(&ring,IORING_OP_WRITE,fds[1],(void*)"x",1,3);
+    io_ring_submit(&ring,IORING_OP_READ,-1,buf,1,4);
+    io_ring_submit(&ring,IORING_OP_FSYNC,fds[1],nullptr,0,5);
+    if(io_ring_enter(3,3)!=3) fail("enter (3)");
+    if(io_ring_result(&ring,3)!=1) fail("write result");
+    if(io_ring_result(&ring,4)!=-EBADF) fail("EBADF");
+    if(io_ring_result(&ring,5)!=-EINVAL) fail("fsync on pipe");
+    ring.cq_head=ring.cq_tail;
+
+    //Destroying the ring interrupts a pending poll
+    if(read(fds[0],buf,1)!=1) fail("read");
+    io_ring_submit(&ring,IORING_OP_POLL,fds[0],nullptr,0,6);
+    if(io_ring_enter(1,0)!=1) fail("enter (4)");
+    if(io_ring_setup(nullptr)!=0) fail("setup (destroy)");
+    if(close(fds[0])!=0 || close(fds[1])!=0) fail("close");
+    pass();
+}
+
+//
+// Time page
+//
+/*
+tests:
+time_page_setup
+miosix::getTime
+*/
+
+namespace miosix {
+extern long long getTimeSyscall();
+}
+
+static void proc_test_time_page()
+{
+    test_name("time page");
+    //NOTE: not registering a page here, as that would replace the one
+    //registered by getTime()
+    if(time_page_setup(nullptr)!=-1 || errno!=EFAULT) fail("EFAULT");
+    //Time must be monotonic and agree with the kernel, regardless of whether
+    //getTime() is using the time page or falling back to the syscall
+    long long prev=miosix::getTime();
+    for(int i=0;i<10000;i++)
+    {
+        long long t=miosix::getTime();
+        if(t<prev) fail("not monotonic");
+        prev=t;
+    }
+    long long t0=miosix::getTime();
+    long long t1=miosix::getTimeSyscall();
+    long long t2=miosix::getTime();
+    if(t1<t0 || t2<t1) fail("does not agree with kernel");
+    pass();
+}
+
+//
+// Batched syscalls
+//
+/*
+tests:
+syscall_batch
+*/
+
+static void proc_test_syscall_batch()
+{
+    //syscall_batch itself can't be batched, so it has no SYS_* define
+    constexpr unsigned int SYS_syscall_batch=69;
+    test_name("syscall batch");
+    if(syscall_batch(nullptr,1)!=-1 || errno!=EFAULT) fail("EFAULT");
+    syscall_desc d[5];
+    if(syscall_batch(d,SYSCALL_BATCH_MAX+1)!=-1 || errno!=EINVAL)
+        fail("EINVAL");
+    int fds[2];
+    if(pipe(fds)!=0) fail("pipe");
+    const char msg[]="batch";
+    char buf[sizeof(msg)]={0};
+    d[0]={SYS_write,{unsigned(fds[1]),unsigned(msg),sizeof(msg),0}};
+    d[1]={SYS_read,{unsigned(fds[0]),unsigned(buf),sizeof(buf),0}};
+    d[2]={SYS_isatty,{unsigned(fds[0]),0,0,0}};
+    if(syscall_batch(d,3)!=3) fail("batch (1)");
+    if(int(d[0].args[0])!=sizeof(msg)) fail("write");
+    if(int(d[1].args[0])!=sizeof(msg)) fail("read");
+    if(strcmp(buf,msg)!=0) fail("data");
+    if(int(d[2].args[0])!=0) fail("isatty");
+    //Must stop after the first failing syscall
+    d[0]={SYS_close,{unsigned(-1),0,0,0}};
+    d[1]={SYS_close,{unsigned(fds[0]),0,0,0}};
+    if(syscall_batch(d,2)!=1) fail("batch (2)");
+    if(int(d[0].args[0])!=-EBADF) fail("EBADF");
+    //getcwd returns its result in args[1]
+    d[0]={SYS_getcwd,{unsigned(buf),1,0,0}};
+    d[1]={SYS_close,{unsigned(fds[0]),0,0,0}};
+    if(syscall_batch(d,2)!=1 || int(d[0].args[1])!=-EINVAL) fail("getcwd");
+    //Pointer parameters are still validated
+    d[0]={SYS_write,{unsigned(fds[1]),0,sizeof(msg),0}};
+    if(syscall_batch(d,1)!=1 || int(d[0].args[0])!=-EFAULT) fail("EFAULT (2)");
+    //Syscalls that can't be batched
+    d[0]={SYS_isatty,{unsigned(fds[0]),0,0,0}};
+    d[1]={SYS_syscall_batch,{0,0,0,0}};
+    d[2]={SYS_close,{unsigned(fds[0]),0,0,0}};
+    if(syscall_batch(d,3)!=2 || int(d[1].args[0])!=-ENOSYS) fail("ENOSYS");
+    d[0]={SYS_close,{unsigned(fds[0]),0,0,0}};
+    d[1]={SYS_close,{unsigned(fds[1]),0,0,0}};
+    if(syscall_batch(d,2)!=2) fail("close");
+    pass();
+}
+
+//
+// Shared memory
+//
+/*
+tests:
+shm_open
+shm_unlink
+mmap (MAP_SHARED, PROT_WRITE)
+futex_wait
+futex_wake
+*/
+
+static void proc_test_shm()
+{
+    test_name("shared memory");
+    const char name[]="/testsuite";
+    if(shm_open("noslash",O_RDWR | O_CREAT,0600)!=-1 || errno!=EINVAL)
+        fail("EINVAL");
+    if(shm_open(name,O_RDWR,0600)!=-1 || errno!=ENOENT) fail("ENOENT");
+    int fd=shm_open(name,O_RDWR | O_CREAT | O_EXCL,0600);
+    if(fd<0) fail("shm_open");
+    if(shm_open(name,O_RDWR | O_CREAT | O_EXCL,0600)!=-1 || errno!=EEXIST)
+        fail("EEXIST");
+    constexpr int size=2048;
+    if(ftruncate(fd,size)!=0) fail("ftruncate");
+    if(ftruncate(fd,2*size)!=-1 || errno!=EBUSY) fail("EBUSY");
+    struct stat st;
+    if(fstat(fd,&st)!=0 || st.st_size!=size) fail("fstat");
+    auto p=reinterpret_cast<volatile int*>(mmap(nullptr,size,
+        PROT_READ | PROT_WRITE,MAP_SHARED,fd,0));
+    if(p==MAP_FAILED)
+    {
+        //Not all architectures have an MPU region to spare
+        if(errno!=ENODEV) fail("mmap");
+        iprintf("mmap not supported, skipping\n");
+        if(close(fd)!=0) fail("close");
+        if(shm_unlink(name)!=0) fail("shm_unlink");
+        pass();
+        return;
+    }
+    for(int i=0;i<size/4;i++) if(p[i]!=0) fail("not zeroed");
+    for(int i=0;i<size/4;i++) p[i]=i;
+    //A process can't share memory with itself, but the futex semantics can
+    //still be checked
+    if(futex_wait(p,1,-1)!=-1 || errno!=EAGAIN) fail("futex EAGAIN");
+    if(futex_wait(p,0,1000000)!=-1 || errno!=ETIMEDOUT) fail("futex ETIMEDOUT");
+    if(futex_wake(p,1)!=0) fail("futex_wake");
+    if(munmap(const_cast<int*>(p),size)!=0) fail("munmap");
+    if(close(fd)!=0) fail("close");
+    //Content must survive closing all file descriptors until unlinked
+    fd=shm_open(name,O_RDONLY,0);
+    if(fd<0) fail("shm_open (2)");
+    if(mmap(nullptr,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0)!=MAP_FAILED
+        || errno!=EACCES) fail("EACCES");
+    auto q=reinterpret_cast<const int*>(mmap(nullptr,size,PROT_READ,
+        MAP_SHARED,fd,0));
+    if(q==MAP_FAILED) fail("mmap (2)");
+    for(int i=0;i<size/4;i++) if(q[i]!=i) fail("content");
+    if(munmap(const_cast<int*>(q),size)!=0) fail("munmap (2)");
+    if(close(fd)!=0) fail("close (2)");
+    if(shm_unlink(name)!=0) fail("shm_unlink");
+    if(shm_unlink(name)!=-1 || errno!=ENOENT) fail("shm_unlink ENOENT");
+    pass();
+}
+
+//
+// Threads
+//
+/*
+tests:
+pthread_create
+pthread_join
+pthread_exit
+pthread_self
+pthread_mutex_lock/unlock between threads
+*/
+
+static volatile int threadCounter;
+static pthread_mutex_t threadMutex=PTHREAD_MUTEX_INITIALIZER;
+
+static void *threadEntry(void *arg)
+{
+    if(pthread_self()==0) fail("pthread_self (thread)");
+    for(int i=0;i<1000;i++)
+    {
+        pthread_mutex_lock(&threadMutex);
+        threadCounter=threadCounter+1;
+        pthread_mutex_unlock(&threadMutex);
+    }
+    if(arg==nullptr) pthread_exit(reinterpret_cast<void*>(42));
+    return arg;
+}
+
+static void *blockedReaderEntry(void *arg)
+{
+    char c;
+    read(*reinterpret_cast<int*>(arg),&c,1); //Nobody ever writes to the pipe
+    return nullptr;
+}
+
+int proc_test_threads_blocked_child(int argc, char *argv[])
+{
+    static int fds[2];
+    if(pipe(fds)!=0) return 1;
+    pthread_t t;
+    if(pthread_create(&t,nullptr,blockedReaderEntry,&fds[0])!=0) return 1;
+    usleep(100000); //Let the thread block in read()
+    exit(56); //Must terminate the process despite the blocked thread
+}
+
+static void proc_test_threads()
+{
+    test_name("threads");
+    if(pthread_self()!=0) fail("pthread_self");
+    constexpr int numThreads=3;
+    pthread_t t[numThreads];
+    threadCounter=0;
+    for(int i=0;i<numThreads;i++)
+    {
+        //The first thread exits with pthread_exit, the others return
+        void *arg= i==0 ? nullptr : &t[i];
+        if(pthread_create(&t[i],nullptr,threadEntry,arg)!=0)
+            fail("pthread_create");
+    }
+    for(int i=0;i<numThreads;i++)
+    {
+        void *result;
+        if(pthread_join(t[i],&result)!=0) fail("pthread_join");
+        void *expected= i==0 ? reinterpret_cast<void*>(42) : &t[i];
+        if(result!=expected) fail("result");
+    }
+    if(threadCounter!=numThreads*1000) fail("mutex");
+    if(pthread_join(t[0],nullptr)!=ESRCH) fail("ESRCH");
+    //Thread ids are reused, and stacks are freed by pthread_join
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if(pthread_attr_setstacksize(&attr,16)!=EINVAL) fail("EINVAL");
+    if(pthread_attr_setstacksize(&attr,4096)!=0) fail("setstacksize");
+    for(int i=0;i<10;i++)
+    {
+        pthread_t t2;
+        if(pthread_create(&t2,&attr,threadEntry,&t2)!=0)
+            fail("pthread_create (2)");
+        if(pthread_join(t2,nullptr)!=0) fail("pthread_join (2)");
+    }
+    pthread_attr_destroy(&attr);
+    //exit() terminates threads blocked in a syscall
+    const char *arg[] = { "/bin/test_process", "threads_blocked_child", nullptr };
+    int ec=spawnAndWait(arg);
+    if(!WIFEXITED(ec) || WEXITSTATUS(ec)!=56) fail("exit with blocked thread");
+    pass();
+}
+
+//
+// ProcFs
+//
+/*
+tests:
+/proc/<pid>/status
+/proc/<pid>/threads
+/proc/<pid>/syscalls
+*/
+
+/**
+ * \param path file to read
+ * \return the file content, fails the test if it can't be read
+ */
+static string readProcFile(const char *path)
+{
+    int fd=open(path,O_RDONLY);
+    if(fd<0) fail("open");
+    string result;
+    char buf[32]; //Small on purpose, to test reads in multiple chunks
+    for(;;)
+    {
+        int r=read(fd,buf,sizeof(buf));
+        if(r<0) fail("read");
+        if(r==0) break;
+        result.append(buf,r);
+    }
+    if(close(fd)!=0) fail("close");
+    return result;
+}
+
+/**
+ * \param syscalls content of a /proc/<pid>/syscalls file
+ * \param id syscall id
+ * \return the number of calls of the syscall
+ */
+static unsigned int syscallCount(const string& syscalls, int id)
+{
+    const char *s=syscalls.c_str();
+    while(*s)
+    {
+        char *end;
+        int i=strtol(s,&end,10);
+        unsigned int count=strtoul(end,&end,10);
+        if(i==id) return count;
+        s=end;
+        while(*s=='\n') s++;
+    }
+    return 0;
+}
+
+static void proc_test_procfs()
+{
+    test_name("procfs");
+    struct stat st;
+    if(stat("/proc",&st)!=0)
+    {
+        iprintf("Skipped, ProcFs not mounted\n");
+        return;
+    }
+    char path[32], line[32];
+    sniprintf(path,sizeof(path),"/proc/%d",getpid());
+    if(stat(path,&st)!=0 || !S_ISDIR(st.st_mode)) fail("process dir");
+    if(open("/proc/0/status",O_RDONLY)!=-1 || errno!=ENOENT) fail("ENOENT");
+    sniprintf(path,sizeof(path),"/proc/%d/status",getpid());
+    if(open(path,O_WRONLY)!=-1 || errno!=EROFS) fail("EROFS");
+    //The heap is used by the test, so heap usage must have been reported
+    void *p=malloc(64);
+    string status=readProcFile(path);
+    free(p);
+    sniprintf(line,sizeof(line),"pid: %d\n",getpid());
+    if(status.find(line)!=0) fail("status pid");
+    if(status.find("state: running\n")==string::npos) fail("status state");
+    if(status.find("heap used: 0\n")!=string::npos) fail("status heap");
+    //Reading the file makes read syscalls, so their count must increase
+    sniprintf(path,sizeof(path),"/proc/%d/syscalls",getpid());
+    unsigned int before=syscallCount(readProcFile(path),SYS_read);
+    if(before==0) fail("syscalls");
+    if(syscallCount(readProcFile(path),SYS_read)<=before) fail("syscalls count");
+    sniprintf(path,sizeof(path),"/proc/%d/threads",getpid());
+    string threads=readProcFile(path);
+    if(threads.find("\n0 ")==string::npos) fail("threads main");
+    pass();
+}
+
+//
+// Syscall tracing test
+//
+/*
+tests:
+/dev/strace
+*/
+
+/**
+ * Same layout as SyscallTraceRecord in kernel/syscall_trace.h
+ */
+struct TraceRecord
+{
+    long long timestamp;
+    unsigned int seq;
+    int pid;
+    unsigned short tid;
+    unsigned short id;
+    unsigned int args[4];
+    int result;
+    unsigned int duration;
+};
+
+static void proc_test_strace()
+{
+    test_name("syscall trace");
+    struct stat st;
+    if(stat("/dev/strace",&st)!=0)
+    {
+        iprintf("Skipped, syscall tracing not enabled\n");
+        return;
+    }
+    int fd=open("/dev/strace",O_RDWR);
+    if(fd<0) fail("open");
+    char start[16], stop[16];
+    int startLen=sniprintf(start,sizeof(start),"+%d",getpid());
+    int stopLen=sniprintf(stop,sizeof(stop),"-%d",getpid());
+    if(write(fd,"x1",2)!=-1 || errno!=EINVAL) fail("EINVAL");
+    if(write(fd,"+0",2)!=-1 || errno!=ESRCH) fail("ESRCH");
+    if(write(fd,start,startLen)!=startLen) fail("start");
+    if(close(-1)!=-1 || errno!=EBADF) fail("close");
+    if(write(fd,stop,stopLen)!=stopLen) fail("stop");
+    //The write that stopped tracing is the last record of this process
+    bool closeFound=false, stopFound=false;
+    while(stopFound==false)
+    {
+        TraceRecord records[2];
+        int r=read(fd,records,sizeof(records));
+        if(r<=0 || r%sizeof(TraceRecord)) fail("read");
+        for(int i=0;i<r/static_cast<int>(sizeof(TraceRecord));i++)
+        {
+            auto& rec=records[i];
+            if(rec.pid!=getpid()) continue;
+            if(rec.id==SYS_close && rec.args[0]==static_cast<unsigned>(-1)
+                && rec.result==-EBADF && rec.tid==0) closeFound=true;
+            if(rec.id==SYS_write && rec.args[0]==static_cast<unsigned>(fd)
+                && rec.result==stopLen) stopFound=true;
+        }
+    }
+    if(closeFound==false) fail("close not traced");
+    if(close(fd)!=0) fail("close fd");
+    pass();
+}
+
+//
+// Message queue test
+//
+/*
+tests:
+mq_open
+mq_unlink
+mq_send
+mq_receive
+mq_getattr
+*/
+
+static void proc_test_mqueue()
+{
+    test_name("message queues");
+    const char name[]="/testsuite_mq";
+    mq_unlink(name); //In case a previous run failed
+    if(mq_open(name,O_RDWR)!=-1 || errno!=ENOENT) fail("ENOENT");
+    if(mq_open("noslash",O_RDWR | O_CREAT,0600,nullptr)!=-1 || errno!=EINVAL)
+        fail("EINVAL name");
+    struct mq_attr attr;
+    attr.mq_flags=0;
+    attr.mq_maxmsg=3;
+    attr.mq_msgsize=16;
+    attr.mq_curmsgs=0;
+    mqd_t mq=mq_open(name,O_RDWR | O_CREAT | O_EXCL | O_NONBLOCK,0600,&attr);
+    if(mq<0) fail("mq_open");
+    if(mq_open(name,O_RDWR | O_CREAT | O_EXCL,0600,&attr)!=-1 || errno!=EEXIST)
+        fail("EEXIST");
+    struct mq_attr a;
+    if(mq_getattr(mq,&a)!=0) fail("mq_getattr");
+    if(a.mq_maxmsg!=3 || a.mq_msgsize!=16 || a.mq_curmsgs!=0
+        || (a.mq_flags & O_NONBLOCK)==0) fail("attributes");
+    char buf[16];
+    unsigned int prio;
+    if(mq_receive(mq,buf,sizeof(buf),&prio)!=-1 || errno!=EAGAIN)
+        fail("EAGAIN empty");
+    pollfd pfd;
+    pfd.fd=mq;
+    pfd.events=POLLIN | POLLOUT;
+    if(poll(&pfd,1,0)!=1 || pfd.revents!=POLLOUT) fail("poll empty");
+    //Messages are received by decreasing priority, FIFO if same priority
+    if(mq_send(mq,"low",4,1)!=0) fail("mq_send 1");
+    if(mq_send(mq,"high",5,7)!=0) fail("mq_send 2");
+    if(mq_send(mq,"low2",5,1)!=0) fail("mq_send 3");
+    if(mq_send(mq,"full",5,1)!=-1 || errno!=EAGAIN) fail("EAGAIN full");
+    if(mq_send(mq,buf,17,1)!=-1 || errno!=EMSGSIZE) fail("EMSGSIZE send");
+    if(mq_send(mq,buf,1,MQ_PRIO_MAX)!=-1 || errno!=EINVAL) fail("EINVAL prio");
+    if(poll(&pfd,1,0)!=1 || pfd.revents!=POLLIN) fail("poll full");
+    if(mq_getattr(mq,&a)!=0 || a.mq_curmsgs!=3) fail("mq_curmsgs");
+    if(mq_receive(mq,buf,15,&prio)!=-1 || errno!=EMSGSIZE)
+        fail("EMSGSIZE receive");
+    if(mq_receive(mq,buf,sizeof(buf),&prio)!=5 || strcmp(buf,"high") || prio!=7)
+        fail("mq_receive 1");
+    if(mq_receive(mq,buf,sizeof(buf),&prio)!=4 || strcmp(buf,"low") || prio!=1)
+        fail("mq_receive 2");
+    if(mq_receive(mq,buf,sizeof(buf),nullptr)!=5 || strcmp(buf,"low2"))
+        fail("mq_receive 3");
+    //A second descriptor refers to the same queue, read() and write() send
+    //and receive messages with priority 0
+    mqd_t mq2=mq_open(name,O_WRONLY);
+    if(mq2<0) fail("mq_open 2");
+    if(write(mq2,"abc",3)!=3) fail("write");
+    if(read(mq2,buf,sizeof(buf))!=-1 || errno!=EBADF) fail("EBADF");
+    if(read(mq,buf,sizeof(buf))!=3 || memcmp(buf,"abc",3)) fail("read");
+    if(mq_send(STDOUT_FILENO,"x",1,0)!=-1 || errno!=EBADF) fail("EBADF fd");
+    if(mq_close(mq2)!=0) fail("mq_close 2");
+    if(mq_unlink(name)!=0) fail("mq_unlink");
+    if(mq_unlink(name)!=-1 || errno!=ENOENT) fail("mq_unlink ENOENT");
+    //The queue is still usable through the open descriptor
+    if(mq_send(mq,"x",1,0)!=0) fail("mq_send unlinked");
+    if(mq_close(mq)!=0) fail("mq_close");
+    pass();
+}
+
 #endif // IN_PROCESS
 
 #endif // WITH_PROCESSES
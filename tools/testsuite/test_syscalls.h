@@ -46,9 +46,20 @@
 #include <sys/times.h>
 #include <spawn.h>
 #include <sys/wait.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #ifndef IN_PROCESS
 #include <thread>
-#endif
+#else //IN_PROCESS
+#include <sys/mman.h>
+#include <sys/io_ring.h>
+#include <sys/time_page.h>
+#include <sys/syscall_batch.h>
+#include <sys/futex.h>
+#include <mqueue.h>
+#include <pthread.h>
+#endif //IN_PROCESS
 
 int spawnAndWait(const char *arg[]);
 pid_t spawnWithPipe(const char *arg[], int& pipeFdOut);
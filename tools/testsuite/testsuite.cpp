@@ -51,6 +51,7 @@
 #include <chrono>
 #include <atomic>
 #include <spawn.h>
+#include <sys/ioctl.h>
 #include <memory>
 
 #include "miosix.h"
@@ -62,6 +63,9 @@
 #include "e20/e20.h"
 #include "kernel/intrusive.h"
 #include "util/crc16.h"
+#include "filesystem/dentry_cache.h"
+#include "filesystem/ioctl.h"
+#include "kernel/logging.h"
 
 
 #if defined(_CHIP_STM32F7) || defined(_CHIP_STM32H7)
@@ -127,6 +131,12 @@ static void test_27();
 #if defined(WITH_SMP) && defined(WITH_THREAD_AFFINITY)
 static void test_28();
 #endif //defined(WITH_SMP) && defined(WITH_THREAD_AFFINITY)
+#ifdef WITH_FILESYSTEM
+static void test_29();
+#endif //WITH_FILESYSTEM
+#ifdef WITH_DEFERRED_LOG
+static void test_30();
+#endif //WITH_DEFERRED_LOG
 #if defined(_CHIP_STM32F7) || defined(_CHIP_STM32H7)
 void testCacheAndDMA();
 #endif //_CHIP_STM32F7/H7
@@ -139,6 +149,15 @@ static void benchmark_1();
 static void benchmark_2();
 static void benchmark_3();
 static void benchmark_4();
+static void benchmark_5();
+#ifdef WITH_FILESYSTEM
+static void benchmark_6();
+static void benchmark_7();
+#endif //WITH_FILESYSTEM
+#ifdef WITH_PROCESSES
+static void benchmark_8();
+static void benchmark_9();
+#endif //WITH_PROCESSES
 //Exception thread safety test
 #ifndef __NO_EXCEPTIONS
 static void exception_test();
@@ -203,6 +222,12 @@ int main()
                 #if defined(WITH_SMP) && defined(WITH_THREAD_AFFINITY)
                 test_28();
                 #endif //defined(WITH_SMP) && defined(WITH_THREAD_AFFINITY)
+                #ifdef WITH_FILESYSTEM
+                test_29();
+                #endif //WITH_FILESYSTEM
+                #ifdef WITH_DEFERRED_LOG
+                test_30();
+                #endif //WITH_DEFERRED_LOG
                 #if defined(_CHIP_STM32F7) || defined(_CHIP_STM32H7)
                 testCacheAndDMA();
                 #endif //_CHIP_STM32F7/H7
@@ -242,6 +267,15 @@ int main()
                 benchmark_2();
                 benchmark_3();
                 benchmark_4();
+                benchmark_5();
+                #ifdef WITH_FILESYSTEM
+                benchmark_6();
+                benchmark_7();
+                #endif //WITH_FILESYSTEM
+                #ifdef WITH_PROCESSES
+                benchmark_8();
+                benchmark_9();
+                #endif //WITH_PROCESSES
 
                 ledOff();
                 Thread::sleep(500);//Ensure all threads are deleted.
@@ -4490,6 +4524,109 @@ void testCacheAndDMA()
 }
 #endif //_CHIP_STM32F7/H7
 
+#ifdef WITH_FILESYSTEM
+//
+// Test 29
+//
+/*
+tests:
+DentryCache
+*/
+
+static void test_29()
+{
+    test_name("DentryCache");
+    if(DENTRY_CACHE_SIZE==0)
+    {
+        iprintf("Skipping, cache disabled\n");
+        return;
+    }
+    DentryCache& cache=DentryCache::instance();
+    //Use the address of local variables as owner, no filesystem has it
+    int owner1, owner2;
+    DentryData d;
+    DentryCacheStats s1=cache.getStats();
+    if(cache.lookup(&owner1,1,"a",1,d)!=0) fail("lookup (1)");
+    cache.insert(&owner1,1,"a",1,{10,20});
+    cache.insertNegative(&owner1,1,"b",1);
+    cache.insert(&owner1,2,"a",1,{11,21});
+    cache.insert(&owner2,1,"a",1,{12,22});
+    if(cache.lookup(&owner1,1,"a",1,d)!=1) fail("lookup (2)");
+    if(d.inode!=10 || d.info!=20) fail("lookup (3)");
+    if(cache.lookup(&owner1,1,"b",1,d)!=-ENOENT) fail("lookup (4)");
+    if(cache.lookup(&owner1,2,"a",1,d)!=1 || d.inode!=11) fail("lookup (5)");
+    if(cache.lookup(&owner2,1,"a",1,d)!=1 || d.inode!=12) fail("lookup (6)");
+    if(cache.lookup(&owner1,1,"ab",2,d)!=0) fail("lookup (7)");
+    //Replacing a negative entry with a positive one
+    cache.insert(&owner1,1,"b",1,{13,23});
+    if(cache.lookup(&owner1,1,"b",1,d)!=1 || d.inode!=13) fail("lookup (8)");
+    DentryCacheStats s2=cache.getStats();
+    if(s2.hits-s1.hits!=4) fail("hits");
+    if(s2.negativeHits-s1.negativeHits!=1) fail("negativeHits");
+    if(s2.misses-s1.misses!=2) fail("misses");
+    //Names too long are not cached
+    char longName[DENTRY_CACHE_NAME_LEN+1];
+    memset(longName,'x',sizeof(longName));
+    cache.insert(&owner1,1,longName,sizeof(longName),{14,24});
+    if(cache.lookup(&owner1,1,longName,sizeof(longName),d)!=0) fail("long name");
+    //Invalidation
+    cache.invalidateDirectory(&owner1,1);
+    if(cache.lookup(&owner1,1,"a",1,d)!=0) fail("invalidateDirectory (1)");
+    if(cache.lookup(&owner1,1,"b",1,d)!=0) fail("invalidateDirectory (2)");
+    if(cache.lookup(&owner1,2,"a",1,d)!=1) fail("invalidateDirectory (3)");
+    if(cache.lookup(&owner2,1,"a",1,d)!=1) fail("invalidateDirectory (4)");
+    cache.invalidateFilesystem(&owner1);
+    if(cache.lookup(&owner1,2,"a",1,d)!=0) fail("invalidateFilesystem (1)");
+    if(cache.lookup(&owner2,1,"a",1,d)!=1) fail("invalidateFilesystem (2)");
+    //Least recently used replacement, owner2 entry was used last, so filling
+    //the cache except for one entry must not evict it
+    for(unsigned int i=0;i<DENTRY_CACHE_SIZE-1;i++)
+        cache.insert(&owner1,3,reinterpret_cast<char*>(&i),sizeof(i),{i,0});
+    if(cache.lookup(&owner2,1,"a",1,d)!=1) fail("LRU (1)");
+    unsigned int i=DENTRY_CACHE_SIZE;
+    cache.insert(&owner1,3,reinterpret_cast<char*>(&i),sizeof(i),{i,0});
+    i=0; //Least recently used
+    if(cache.lookup(&owner1,3,reinterpret_cast<char*>(&i),sizeof(i),d)!=0)
+        fail("LRU (2)");
+    if(cache.lookup(&owner2,1,"a",1,d)!=1) fail("LRU (3)");
+    cache.invalidateFilesystem(&owner1);
+    cache.invalidateFilesystem(&owner2);
+    pass();
+}
+#endif //WITH_FILESYSTEM
+
+#ifdef WITH_DEFERRED_LOG
+//
+// Test 30
+//
+/*
+tests:
+deferredLog
+*/
+
+static void test_30()
+{
+    test_name("deferredLog");
+    DeferredLogStats s1=getDeferredLogStats();
+    deferredLog("deferredLog %d %s\n",1,"from thread");
+    {
+        //Logging with interrupts disabled, as an IRQ would do
+        FastGlobalIrqLock dLock;
+        deferredLog("deferredLog %d %s\n",2,"with IRQ disabled");
+    }
+    //Overflow the ring. The log thread runs at the lowest priority and polls
+    //the ring every DEFERRED_LOG_POLL_PERIOD, while this loop never blocks and
+    //takes far less than that, so some messages must be dropped
+    const unsigned int n=2*DEFERRED_LOG_ENTRIES;
+    for(unsigned int i=0;i<n;i++) deferredLog("%u\n",i);
+    Thread::nanoSleep(10*DEFERRED_LOG_POLL_PERIOD);
+    DeferredLogStats s2=getDeferredLogStats();
+    if(s2.logged-s1.logged+s2.dropped-s1.dropped!=n+2) fail("count");
+    if(s2.dropped==s1.dropped) fail("no drops");
+    pass();
+}
+#endif //WITH_DEFERRED_LOG
+
 //
 // Kercalls test (in a separate file, shared with syscalls)
 //
@@ -4975,3 +5112,342 @@ static void benchmark_4()
     Thread::setPriority(0); //Restore priority
     #endif //SCHED_TYPE_EDF
 }
+
+//
+// Benchmark 5
+//
+/*
+tests:
+Filesystem concurrency
+measures the read speed of a file with and without another thread writing
+to a different file on the same filesystem
+*/
+
+static const char b5_rname[]="/sd/speed_r.txt";
+static const char b5_wname[]="/sd/speed_w.txt";
+static const unsigned int b5_bufsize=1024;
+static const unsigned int b5_size=256; //In units of b5_bufsize
+static volatile bool b5_end;
+static volatile unsigned int b5_written;
+
+static void b5_writer(void *argv)
+{
+    FILE *f=fopen(b5_wname,"w");
+    if(f==NULL) return;
+    setbuf(f,NULL);
+    char *buf=reinterpret_cast<char*>(argv);
+    while(b5_end==false)
+    {
+        if(fwrite(buf,1,b5_bufsize,f)!=b5_bufsize) break;
+        b5_written+=b5_bufsize;
+        //Restart from the beginning not to fill the filesystem
+        if(b5_written%(b5_size*b5_bufsize)==0) fseek(f,0,SEEK_SET);
+    }
+    fclose(f);
+}
+
+/**
+ * \param buf buffer
+ * \return the time in ms to read the b5_rname file, or -1 on error
+ */
+static int b5_read(char *buf)
+{
+    FILE *f=fopen(b5_rname,"r");
+    if(f==NULL) return -1;
+    setbuf(f,NULL);
+    auto t=getTime();
+    for(unsigned int i=0;i<b5_size;i++)
+    {
+        if(fread(buf,1,b5_bufsize,f)!=b5_bufsize)
+        {
+            fclose(f);
+            return -1;
+        }
+    }
+    int result=(getTime()-t)/1000000;
+    fclose(f);
+    return max(result,1);
+}
+
+static void benchmark_5()
+{
+    CHECK_AVAIL_HEAP(2*b5_bufsize+EST_THREAD_HEAP_USAGE(2048));
+    char *rbuf=new char[b5_bufsize];
+    char *wbuf=new char[b5_bufsize];
+    memset(rbuf,'0',b5_bufsize);
+    memset(wbuf,'1',b5_bufsize);
+    FILE *f=fopen(b5_rname,"w");
+    if(f==NULL)
+    {
+        iprintf("Filesystem concurrency benchmark not made. Can't open file\n");
+        delete[] rbuf;
+        delete[] wbuf;
+        return;
+    }
+    setbuf(f,NULL);
+    for(unsigned int i=0;i<b5_size;i++) fwrite(rbuf,1,b5_bufsize,f);
+    fclose(f);
+
+    int alone=b5_read(rbuf);
+    b5_end=false;
+    b5_written=0;
+    Thread *t=Thread::create(b5_writer,2048,DEFAULT_PRIORITY,wbuf,Thread::JOINABLE);
+    int shared=t ? b5_read(rbuf) : -1;
+    b5_end=true;
+    if(t) t->join();
+    if(alone<0 || shared<0) iprintf("Filesystem concurrency benchmark failed\n");
+    else {
+        unsigned int kb=b5_size*b5_bufsize/1024;
+        iprintf("Filesystem concurrency benchmark\n");
+        iprintf("Read alone = %dms (%dKB/s)\n",alone,kb*1000/alone);
+        iprintf("Read with concurrent writer = %dms (%dKB/s), %dKB written\n",
+                shared,kb*1000/shared,b5_written/1024);
+    }
+    remove(b5_rname);
+    remove(b5_wname);
+    delete[] rbuf;
+    delete[] wbuf;
+}
+
+#ifdef WITH_FILESYSTEM
+//
+// Benchmark 6
+//
+/*
+tests:
+Pipe bandwidth and latency
+measures the throughput of a pipe between two threads with the default and a
+larger buffer, and the round trip time of a single byte bounced between two
+threads through a pair of pipes
+*/
+
+static const unsigned int b6_bufsize=1024;
+static const unsigned int b6_size=256; //In units of b6_bufsize
+static const unsigned int b6_roundTrips=1000;
+static int b6_data[2];
+static int b6_ping[2];
+static int b6_pong[2];
+
+static void b6_writer(void *argv)
+{
+    const char *buf=reinterpret_cast<const char*>(argv);
+    for(unsigned int i=0;i<b6_size;i++)
+        if(write(b6_data[1],buf,b6_bufsize)!=static_cast<ssize_t>(b6_bufsize)) break;
+}
+
+/**
+ * \param rbuf buffer for reading from the pipe
+ * \param wbuf buffer the writer thread writes to the pipe
+ * \param capacity pipe capacity, or 0 to leave the default one
+ * \return the time in ms to pass b6_size*b6_bufsize bytes through a pipe, or
+ * -1 on failure
+ */
+static int b6_bandwidth(char *rbuf, char *wbuf, int capacity)
+{
+    if(pipe(b6_data)!=0) return -1;
+    if(capacity>0 && fcntl(b6_data[0],F_SETPIPE_SZ,capacity)!=capacity)
+    {
+        close(b6_data[0]);
+        close(b6_data[1]);
+        return -1;
+    }
+    const unsigned int total=b6_size*b6_bufsize;
+    unsigned int received=0;
+    auto t=getTime();
+    Thread *th=Thread::create(b6_writer,2048,DEFAULT_PRIORITY,wbuf,Thread::JOINABLE);
+    while(th && received<total)
+    {
+        ssize_t r=read(b6_data[0],rbuf,b6_bufsize);
+        if(r<=0) break;
+        received+=r;
+    }
+    int result=(getTime()-t)/1000000;
+    //Closing the read end first unblocks the writer in case of failure
+    close(b6_data[0]);
+    if(th) th->join();
+    close(b6_data[1]);
+    if(received!=total) return -1;
+    return max(result,1);
+}
+
+static void b6_echo(void *argv)
+{
+    char c;
+    while(read(b6_ping[0],&c,1)==1)
+        if(write(b6_pong[1],&c,1)!=1) break;
+}
+
+/**
+ * \return the average round trip time in ns of a byte sent to another thread
+ * and back through a pair of pipes, or -1 on failure
+ */
+static long long b6_latency()
+{
+    if(pipe(b6_ping)!=0) return -1;
+    if(pipe(b6_pong)!=0)
+    {
+        close(b6_ping[0]);
+        close(b6_ping[1]);
+        return -1;
+    }
+    long long result=-1;
+    Thread *th=Thread::create(b6_echo,2048,DEFAULT_PRIORITY,nullptr,Thread::JOINABLE);
+    if(th)
+    {
+        unsigned int i;
+        auto t=getTime();
+        for(i=0;i<b6_roundTrips;i++)
+        {
+            char c=i;
+            if(write(b6_ping[1],&c,1)!=1 || read(b6_pong[0],&c,1)!=1) break;
+        }
+        if(i==b6_roundTrips) result=(getTime()-t)/b6_roundTrips;
+    }
+    close(b6_ping[1]); //Makes the echo thread terminate
+    if(th) th->join();
+    close(b6_ping[0]);
+    close(b6_pong[0]);
+    close(b6_pong[1]);
+    return result;
+}
+
+static void benchmark_6()
+{
+    const int bigCapacity=4096;
+    CHECK_AVAIL_HEAP(2*b6_bufsize+bigCapacity+2*EST_THREAD_HEAP_USAGE(2048));
+    char *rbuf=new char[b6_bufsize];
+    char *wbuf=new char[b6_bufsize];
+    memset(wbuf,'1',b6_bufsize);
+    int small=b6_bandwidth(rbuf,wbuf,0);
+    int big=b6_bandwidth(rbuf,wbuf,bigCapacity);
+    long long rtt=b6_latency();
+    if(small<0 || big<0 || rtt<0) iprintf("Pipe benchmark failed\n");
+    else {
+        unsigned int kb=b6_size*b6_bufsize/1024;
+        iprintf("Pipe benchmark\n");
+        iprintf("Bandwidth (default size) = %dms (%dKB/s)\n",small,kb*1000/small);
+        iprintf("Bandwidth (%d bytes) = %dms (%dKB/s)\n",bigCapacity,big,
+                kb*1000/big);
+        iprintf("Round trip latency = %dns\n",static_cast<int>(rtt));
+    }
+    delete[] rbuf;
+    delete[] wbuf;
+}
+
+//
+// Benchmark 7
+//
+/*
+tests:
+console write throughput and device transactions, synchronous and
+asynchronous transmit mode
+*/
+
+static const int b7_lines=64;
+
+/**
+ * Print short lines to stdout
+ * \param stats filled with the device transactions made while printing
+ * \return the time in ns taken by write() calls
+ */
+static long long b7_print(TerminalTxStats& stats)
+{
+    static const char line[]="0123456789abcdef0123456789\n";
+    TerminalTxStats before,after;
+    if(ioctl(STDOUT_FILENO,IOCTL_GET_TX_STATS,&before)!=0) return -1;
+    long long t=getTime();
+    for(int i=0;i<b7_lines;i++) write(STDOUT_FILENO,line,sizeof(line)-1);
+    t=getTime()-t;
+    ioctl(STDOUT_FILENO,IOCTL_SYNC,nullptr);
+    if(ioctl(STDOUT_FILENO,IOCTL_GET_TX_STATS,&after)!=0) return -1;
+    stats.bytes=after.bytes-before.bytes;
+    stats.transactions=after.transactions-before.transactions;
+    return t;
+}
+
+static void benchmark_7()
+{
+    const unsigned int queueSize=1024;
+    CHECK_AVAIL_HEAP(queueSize+EST_THREAD_HEAP_USAGE(STACK_DEFAULT_FOR_PTHREAD));
+    TerminalTxStats sync,async;
+    long long syncTime=b7_print(sync);
+    unsigned int size=queueSize;
+    if(syncTime<0 || ioctl(STDOUT_FILENO,IOCTL_SET_ASYNC_TX,&size)!=0)
+    {
+        iprintf("Console benchmark failed\n");
+        return;
+    }
+    long long asyncTime=b7_print(async);
+    size=0;
+    ioctl(STDOUT_FILENO,IOCTL_SET_ASYNC_TX,&size);
+    iprintf("Console benchmark (%d lines)\n",b7_lines);
+    iprintf("Synchronous:  %dus, %d bytes/transaction\n",
+            static_cast<int>(syncTime/1000),
+            sync.bytes/max(1u,sync.transactions));
+    iprintf("Asynchronous: %dus, %d bytes/transaction\n",
+            static_cast<int>(asyncTime/1000),
+            async.bytes/max(1u,async.transactions));
+}
+#endif //WITH_FILESYSTEM
+
+#ifdef WITH_PROCESSES
+//
+// Benchmark 8
+//
+/*
+tests:
+syscall cost from a process (executed in a separate process)
+*/
+
+static void benchmark_8()
+{
+    char freq[16];
+    sniprintf(freq,sizeof(freq),"%u",static_cast<unsigned int>(SystemCoreClock));
+    const char *arg[] = { "/bin/bench_syscall", freq, nullptr };
+    iprintf("Syscall benchmark\n");
+    int exitcode=spawnAndWait(arg);
+    if(!WIFEXITED(exitcode) || WEXITSTATUS(exitcode)!=0)
+        iprintf("Syscall benchmark failed\n");
+}
+
+//
+// Benchmark 9
+//
+/*
+tests:
+process spawn latency, the first spawn populates the relocation snapshot
+*/
+
+static void benchmark_9()
+{
+    const int iterations=16;
+    const char *arg[] = { "/bin/bench_spawn", nullptr };
+    const char *env[] = { nullptr };
+    long long first=0, spawnTotal=0, total=0;
+    for(int i=0;i<iterations;i++)
+    {
+        long long t1=getTime();
+        pid_t pid;
+        int ec=posix_spawn(&pid,arg[0],NULL,NULL,(char* const*)arg,(char* const*)env);
+        long long t2=getTime();
+        if(ec!=0 || waitpid(pid,&ec,0)!=pid || !WIFEXITED(ec) || WEXITSTATUS(ec)!=0)
+        {
+            iprintf("Spawn benchmark failed\n");
+            return;
+        }
+        long long t3=getTime();
+        if(i==0) first=t3-t1;
+        else {
+            spawnTotal+=t2-t1;
+            total+=t3-t1;
+        }
+    }
+    iprintf("Spawn benchmark\n"
+            "first spawn+exit+wait %dus\n"
+            "posix_spawn           %dus\n"
+            "spawn+exit+wait       %dus\n",
+            static_cast<int>(first/1000),
+            static_cast<int>(spawnTotal/(1000*(iterations-1))),
+            static_cast<int>(total/(1000*(iterations-1))));
+}
+#endif //WITH_PROCESSES